@@ -0,0 +1,93 @@
+/*****************************************************************************
+
+Copyright (c) 2004 SensAble Technologies, Inc. All rights reserved.
+
+OpenHaptics(TM) toolkit. The material embodied in this software and use of
+this software is subject to the terms and conditions of the clickthrough
+Development License Agreement.
+
+For questions, comments or bug reports, go to forums at:
+    http://dsc.sensable.com
+
+Module Name:
+
+  hdMock.h
+
+Description:
+
+  Control interface for the HDMock library.  HDMock is a software stand-in
+  for the HD library: link against libHDMock instead of libHD and the
+  unmodified hd.h API runs against simulated devices and a real-time
+  software scheduler thread.  This makes it possible to run and benchmark
+  HD applications without any hardware attached.
+
+******************************************************************************/
+
+#ifndef HD_MOCK_H_DEFINE
+#define HD_MOCK_H_DEFINE
+
+#include <HD/hdExport.h>
+#include <HD/hdDefines.h>
+#include <stdio.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* Maximum number of simulated devices that can be initialized at once. */
+#define HD_MOCK_MAX_DEVICES 4
+
+/******************************************************************************
+ Scripted trajectory.  Called once per scheduler tick in the scheduler thread,
+ before any scheduled callbacks run, with the time in seconds since the
+ scheduler was started.  Fill in the device position in millimeters and the
+ button mask.  The velocity is derived from successive positions.
+******************************************************************************/
+typedef void (HDCALLBACK *HDMockTrajectoryCallback)(HDdouble time,
+                                                    HDdouble position[3],
+                                                    HDint *pButtons,
+                                                    void *pUserData);
+
+/******************************************************************************
+ Drives the device position from a scripted trajectory.  Replaces any
+ recording loaded for the device.  Pass a null callback to hold the device
+ still at its current position.
+******************************************************************************/
+void hdMockSetTrajectoryCallback(HHD hHD,
+                                 HDMockTrajectoryCallback pCallback,
+                                 void *pUserData);
+
+/******************************************************************************
+ Drives the device from a file written by hduStartStreamingRecord.  One
+ packet is replayed per scheduler tick.  When the end is reached the
+ recording starts over if bLoop is set, otherwise the last packet is held.
+ Returns false if the file is not a valid recording.
+******************************************************************************/
+HDboolean hdMockLoadRecording(HHD hHD, FILE *file, HDboolean bLoop);
+
+/******************************************************************************
+ Timing statistics of the scheduler thread.  Tick duration is the time spent
+ updating devices and running scheduled callbacks.  Start latency is how late
+ a tick started relative to its nominal start time.  A tick overruns when its
+ duration exceeds the scheduler period.  Times are in seconds.
+******************************************************************************/
+typedef struct
+{
+    HDulong nTicks;
+    HDulong nOverruns;
+    HDdouble meanTickDuration;
+    HDdouble maxTickDuration;
+    HDdouble meanStartLatency;
+    HDdouble maxStartLatency;
+} HDMockSchedulerStats;
+
+void hdMockGetSchedulerStats(HDMockSchedulerStats *pStats);
+void hdMockResetSchedulerStats();
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* HD_MOCK_H_DEFINE */
+
+/******************************************************************************/
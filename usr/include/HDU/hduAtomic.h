@@ -0,0 +1,124 @@
+/*****************************************************************************
+
+Copyright (c) 2004 SensAble Technologies, Inc. All rights reserved.
+
+OpenHaptics(TM) toolkit. The material embodied in this software and use of
+this software is subject to the terms and conditions of the clickthrough
+Development License Agreement.
+
+For questions, comments or bug reports, go to forums at:
+    http://dsc.sensable.com
+
+Module Name:
+
+  hduAtomic.h
+
+Description:
+
+  Minimal set of atomic operations for exchanging data between the servo
+  loop thread and other threads without taking a lock.
+
+*******************************************************************************/
+
+#ifndef hduAtomic_H_
+#define hduAtomic_H_
+
+#if defined(WIN32)
+# include <intrin.h>
+# pragma intrinsic(_InterlockedExchange)
+# pragma intrinsic(_InterlockedExchangeAdd)
+# pragma intrinsic(_InterlockedCompareExchange)
+# pragma intrinsic(_ReadWriteBarrier)
+#endif
+
+#ifdef __cplusplus
+
+/* Size of a cache line, used for padding data that is written by different
+   threads so that they do not share a line. */
+#define HDU_CACHE_LINE_SIZE 64
+
+/******************************************************************************
+ Reads the value with acquire semantics.  No reads or writes following the
+ load may be reordered before it.
+******************************************************************************/
+inline long hduAtomicLoad(const volatile long *pValue)
+{
+#if defined(WIN32)
+    long value = *pValue;
+    _ReadWriteBarrier();
+    return value;
+#else
+    long value = *pValue;
+    __sync_synchronize();
+    return value;
+#endif
+}
+
+/******************************************************************************
+ Writes the value with release semantics.  No reads or writes preceding the
+ store may be reordered after it.
+******************************************************************************/
+inline void hduAtomicStore(volatile long *pValue, long value)
+{
+#if defined(WIN32)
+    _ReadWriteBarrier();
+    *pValue = value;
+#else
+    __sync_synchronize();
+    *pValue = value;
+#endif
+}
+
+/******************************************************************************
+ Atomically adds to the value.  Returns the resulting value.
+******************************************************************************/
+inline long hduAtomicAdd(volatile long *pValue, long delta)
+{
+#if defined(WIN32)
+    return _InterlockedExchangeAdd(pValue, delta) + delta;
+#else
+    return __sync_add_and_fetch(pValue, delta);
+#endif
+}
+
+/******************************************************************************
+ Atomically increments the value.  Returns the resulting value.
+******************************************************************************/
+inline long hduAtomicIncrement(volatile long *pValue)
+{
+    return hduAtomicAdd(pValue, 1);
+}
+
+/******************************************************************************
+ Atomically replaces the value.  Returns the previous value.
+******************************************************************************/
+inline long hduAtomicExchange(volatile long *pValue, long value)
+{
+#if defined(WIN32)
+    return _InterlockedExchange(pValue, value);
+#else
+    __sync_synchronize();
+    return __sync_lock_test_and_set(pValue, value);
+#endif
+}
+
+/******************************************************************************
+ Atomically replaces the value with desired if it currently equals expected.
+ Returns true if the value was replaced.
+******************************************************************************/
+inline bool hduAtomicCompareExchange(volatile long *pValue,
+                                     long expected,
+                                     long desired)
+{
+#if defined(WIN32)
+    return _InterlockedCompareExchange(pValue, desired, expected) == expected;
+#else
+    return __sync_bool_compare_and_swap(pValue, expected, desired);
+#endif
+}
+
+#endif /* __cplusplus */
+
+#endif /* hduAtomic_H_ */
+
+/*****************************************************************************/
@@ -0,0 +1,189 @@
+/*****************************************************************************
+
+Copyright (c) 2004 SensAble Technologies, Inc. All rights reserved.
+
+OpenHaptics(TM) toolkit. The material embodied in this software and use of
+this software is subject to the terms and conditions of the clickthrough
+Development License Agreement.
+
+For questions, comments or bug reports, go to forums at:
+    http://dsc.sensable.com
+
+Module Name:
+
+  hduDeviceGroup.h
+
+Description:
+
+  Reads the state of several haptic devices in one servo loop callback and
+  hands it to the graphics thread as one snapshot.
+
+*******************************************************************************/
+
+#ifndef hduDeviceGroup_H_
+#define hduDeviceGroup_H_
+
+#include <HD/hd.h>
+#include <HDU/hduMatrix.h>
+#include <HDU/hduVector.h>
+#include <HDU/hduTripleBuffer.h>
+
+#ifdef __cplusplus
+
+/*******************************************************************************
+ hduDeviceGroup
+
+ Owns a set of initialized devices and services all of them from a pair
+ of asynchronous scheduler callbacks that bracket each tick.  The first,
+ at HD_MAX_SCHEDULER_PRIORITY, begins a frame on every device and reads
+ their positions, velocities, transforms and buttons.  The last, at
+ HD_MIN_SCHEDULER_PRIORITY, sets their forces, reads the forces back and
+ ends the frames.  The state of every device thus comes from the same
+ tick, and the frames of any other callbacks, including those of HL
+ contexts, nest inside the group's, as HD_ONE_FRAME_LIMIT requires.  The
+ result is published to the graphics thread through an hduTripleBuffer,
+ so getting the state of N devices costs the graphics thread no round
+ trip to the servo loop, where one hdScheduleSynchronous per device per
+ frame costs N.
+
+ Forces come from two places, added together.  A force callback, called
+ in the servo loop with the state just read, suits forces that couple the
+ devices to each other, e.g. a spring between two users.  setForce and
+ publishForces hand forces computed on another thread, e.g. a simulation,
+ to the servo loop; a published force is applied every tick until
+ replaced.  A group with neither never sets HD_CURRENT_FORCE, and so only
+ observes the devices, e.g. alongside HL contexts that render their own
+ forces.  Force output has to be enabled on each device as usual.
+
+ HD errors are kept on one stack for the whole servo thread.  After its
+ calls in each callback the group pops every error on that stack, so
+ errors that other callbacks raised in the tick and left there are taken
+ and reported in the snapshot too.  Callbacks that run alongside the
+ group should pop their own errors before they return.
+
+ addDevice, the setters and start are for the thread that sets the group
+ up; update, getSnapshot and getState for one reading thread, typically
+ the graphics thread; setForce and publishForces for one writing thread.
+ The force callback must not be changed while the group is running.
+*******************************************************************************/
+class hduDeviceGroup
+{
+public:
+
+    enum { kMaxDevices = 16 };
+
+    struct DeviceState
+    {
+        hduVector3Dd position;
+        hduVector3Dd velocity;
+        hduMatrix transform;
+        HDint buttons;
+        hduVector3Dd force;     /* as read back after it was set */
+    };
+
+    /* The state of every device in one tick. */
+    struct Snapshot
+    {
+        Snapshot() : nDevices(0), tick(0) { error.errorCode = HD_SUCCESS; }
+
+        int nDevices;
+        HDulong tick;           /* counts ticks since start, from 0 */
+        HDErrorInfo error;      /* latest error seen by the callback */
+        DeviceState devices[kMaxDevices];
+    };
+
+    /* Called in the servo loop each tick with the state just read.  forces
+       holds snapshot.nDevices forces, already set to the published ones;
+       add to them or replace them. */
+    typedef void (HDCALLBACK *ForceCallback)(const Snapshot &snapshot,
+                                             hduVector3Dd *forces,
+                                             void *pUserData);
+
+    hduDeviceGroup();
+    ~hduDeviceGroup();
+
+    /* Adds an initialized device before start.  Returns its index in the
+       snapshot, or -1 if the group is full or running. */
+    int addDevice(HHD hHD);
+    int getNumDevices() const { return m_nDevices; }
+    HHD getDevice(int i) const { return m_hHDs[i]; }
+
+    void setForceCallback(ForceCallback pCallback, void *pUserData);
+
+    /* Schedules the servo loop callbacks.  The scheduler may be started
+       before or after.  Returns false if already running or the callbacks
+       could not be scheduled; the snapshot's error then tells why. */
+    bool start();
+    void stop();
+
+    /* False once stopped, or once the callbacks have given up after a
+       scheduler error. */
+    bool isRunning() const;
+
+    /***************************************************************************
+     Reader interface.
+    ***************************************************************************/
+
+    /* Switches to the latest snapshot.  Returns false, leaving the snapshot
+       unchanged, if the servo loop published none since the last update. */
+    bool update();
+
+    /* Before the first snapshot arrives, nDevices is 0. */
+    const Snapshot &getSnapshot() const { return m_buffer.getReadBuffer(); }
+    const DeviceState &getState(int i) const
+        { return getSnapshot().devices[i]; }
+
+    /***************************************************************************
+     Force writer interface.
+    ***************************************************************************/
+
+    /* Sets the force for device i on the next publishForces. */
+    void setForce(int i, const hduVector3Dd &force);
+
+    /* Hands the forces set so far to the servo loop. */
+    void publishForces();
+
+private:
+
+    struct Forces
+    {
+        hduVector3Dd forces[kMaxDevices];
+    };
+
+    static HDCallbackCode HDCALLBACK beginCallback(void *pUserData);
+    static HDCallbackCode HDCALLBACK endCallback(void *pUserData);
+    HDCallbackCode beginFrames();
+    HDCallbackCode endFrames();
+    void popErrors();
+
+    /* Not copyable. */
+    hduDeviceGroup(const hduDeviceGroup &);
+    hduDeviceGroup &operator=(const hduDeviceGroup &);
+
+    /* Fixed while running. */
+    HHD m_hHDs[kMaxDevices];
+    int m_nDevices;
+    ForceCallback m_pForceCallback;
+    void *m_pForceUserData;
+    HDSchedulerHandle m_hBeginCallback;
+    HDSchedulerHandle m_hEndCallback;
+
+    /* Owned by the servo loop. */
+    HDulong m_tick;
+    HDErrorInfo m_error;
+    bool m_bSchedulerError;
+    bool m_bFramesBegun;
+    bool m_bForcesPublished;
+
+    /* Owned by the force writer. */
+    hduVector3Dd m_forces[kMaxDevices];
+
+    hduTripleBuffer<Snapshot> m_buffer;
+    hduTripleBuffer<Forces> m_forceBuffer;
+};
+
+#endif /* __cplusplus */
+
+#endif /* hduDeviceGroup_H_ */
+
+/*****************************************************************************/
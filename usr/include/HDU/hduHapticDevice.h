@@ -85,6 +85,21 @@ public:
         GRAPHIC_THREAD_INTERFACE
     };
 
+    /* Determines how the graphic thread instance obtains state from the
+       haptic thread instance.
+       SYNC_SCHEDULER makes beginUpdate block on a synchronous scheduler
+       callback, so the graphic thread sees the state as of the next servo
+       tick.
+       SYNC_TRIPLE_BUFFER makes the haptic thread instance publish its state
+       at the end of every endUpdate, and the graphic thread instance picks
+       up the latest published state without waiting on the servo loop.
+       Both instances of a pair must be created with the same mode. */
+    enum SyncMode
+    {
+        SYNC_SCHEDULER,
+        SYNC_TRIPLE_BUFFER
+    };
+
     enum EventType
     {
         BUTTON_1_DOWN = 0,
@@ -99,16 +114,29 @@ public:
         NUM_EVENT_TYPES,
     };
 
+    /* Determines what happens when the haptic thread raises more events
+       than fit in the event queue before the graphics thread consumes them.
+       Either the oldest queued event or the new event is discarded.  Each
+       discarded event is counted as an overflow. */
+    enum EventOverflowPolicy
+    {
+        EVENT_OVERFLOW_DROP_OLDEST = 0,
+        EVENT_OVERFLOW_DROP_NEWEST
+    };
+
     typedef void (HapticDeviceCallback)(IHapticDevice::EventType event,
                   const IHapticDevice::IHapticDeviceState * const pState,
                   void *pUserData);
 
     static IHapticDevice *create(InterfaceType eType, HHD hHD);
+    static IHapticDevice *create(InterfaceType eType, HHD hHD,
+                                 SyncMode eSyncMode);
     static void destroy(IHapticDevice *&pInterface);
 
     virtual void beginUpdate(IHapticDevice *pSyncToDevice) = 0;
     virtual void endUpdate(IHapticDevice *pSyncToDevice) = 0;
     virtual InterfaceType getInterfaceType() const = 0;
+    virtual SyncMode getSyncMode() const = 0;
 
     virtual const IHapticDeviceState * const getCurrentState() const = 0;
     virtual IHapticDeviceState * const getCurrentState() = 0;
@@ -120,6 +148,18 @@ public:
                              HapticDeviceCallback *pCallback, 
                              void *pUserData) = 0;
 
+    /* Events are handed from the haptic thread to the graphics thread
+       through a fixed capacity queue owned by the haptic thread instance, so
+       that no memory is allocated in the servo loop.  The policy is applied
+       by the haptic thread instance; set on a graphics thread instance, it
+       is handed on to the haptic thread instance at the next
+       synchronization.  The overflow count is cumulative; a graphics thread
+       instance reports the policy and count as of its last synchronization,
+       or the policy set on it since. */
+    virtual void setEventOverflowPolicy(EventOverflowPolicy ePolicy) = 0;
+    virtual EventOverflowPolicy getEventOverflowPolicy() const = 0;
+    virtual HDulong getEventOverflowCount() const = 0;
+
 protected:
     IHapticDevice() {}
     virtual ~IHapticDevice() {}
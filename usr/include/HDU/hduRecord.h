@@ -48,6 +48,59 @@ HDboolean hduStartRecord(
     void *pCallbackData,
     unsigned int nData);
 
+/******************************************************************************
+ Streaming record file layout.  A file starts with one HDURecordFileHeader
+ followed by a sequence of fixed size HDURecordPacket entries, written in
+ host byte order.  Packets dropped because the writer fell behind show up as
+ gaps in the tick numbers.
+******************************************************************************/
+#define HDU_RECORD_FILE_MAGIC   0x52554448  /* "HDUR" */
+#define HDU_RECORD_FILE_VERSION 1
+
+typedef struct
+{
+    HDuint magic;       /* HDU_RECORD_FILE_MAGIC */
+    HDuint version;     /* HDU_RECORD_FILE_VERSION */
+    HDuint headerSize;  /* sizeof(HDURecordFileHeader) */
+    HDuint packetSize;  /* sizeof(HDURecordPacket) */
+} HDURecordFileHeader;
+
+typedef struct
+{
+    HDuint tick;        /* Scheduler ticks since recording started. */
+    HDuint reserved;
+    HDdouble force[3];
+    HDdouble position[3];
+    HDdouble velocity[3];
+} HDURecordPacket;
+
+/* Handle to a streaming recording session. */
+typedef struct hduStreamRecorder *HDURecordHandle;
+
+/******************************************************************************
+ Start a streaming recording session.  Records every scheduler tick until
+ hduStopRecord is called, writing packets to file from a background thread.
+ nBufferPackets is the number of packets that can be queued between the
+ scheduler and the writer thread; when the queue is full, new packets are
+ dropped and counted.  Pass 0 for a default of a few seconds at 1 kHz.
+ Returns 0 if recording could not be started.
+******************************************************************************/
+HDURecordHandle hduStartStreamingRecord(
+    FILE *file,
+    unsigned int nBufferPackets);
+
+/******************************************************************************
+ Stop a streaming recording session.  Waits for all queued packets to be
+ written, flushes the file and releases the handle.  The file is not closed.
+ Returns false if the handle is invalid.
+******************************************************************************/
+HDboolean hduStopRecord(HDURecordHandle hRecord);
+
+/******************************************************************************
+ Number of packets dropped so far because the writer thread fell behind.
+******************************************************************************/
+HDulong hduGetRecordDropCount(HDURecordHandle hRecord);
+
 #ifdef __cplusplus
 }
 #endif
@@ -0,0 +1,179 @@
+/*****************************************************************************
+
+Copyright (c) 2004 SensAble Technologies, Inc. All rights reserved.
+
+OpenHaptics(TM) toolkit. The material embodied in this software and use of
+this software is subject to the terms and conditions of the clickthrough
+Development License Agreement.
+
+For questions, comments or bug reports, go to forums at:
+    http://dsc.sensable.com
+
+Module Name:
+
+  hduRingBuffer.h
+
+Description:
+
+  Fixed capacity single-producer/single-consumer queue.  Suitable for passing
+  data out of (or into) the servo loop, since neither side ever blocks or
+  allocates memory once the buffer is constructed.
+
+*******************************************************************************/
+
+#ifndef hduRingBuffer_H_
+#define hduRingBuffer_H_
+
+#include <HDU/hduAtomic.h>
+
+#ifdef __cplusplus
+
+/*******************************************************************************
+ hduRingBuffer
+
+ Exactly one thread may push and exactly one other thread may pop.  Both
+ push and pop are wait-free.  Storage for all elements is allocated up front,
+ so T should be a plain data type that is cheap to assign.
+
+ The writer may fill an element in place by calling beginPush(), writing to
+ the returned slot, then calling endPush().  Likewise the reader may inspect
+ front() and then release it with popFront().
+*******************************************************************************/
+template <class T>
+class hduRingBuffer
+{
+public:
+
+    typedef T EltType;
+
+    /* Creates a buffer that can hold at least nCapacity elements. */
+    explicit hduRingBuffer(unsigned long nCapacity) :
+        m_head(0),
+        m_tail(0)
+    {
+        /* One slot is always kept empty to distinguish full from empty, and
+           the slot count is rounded up to a power of two so that wrapping is
+           a mask. */
+        m_size = 2;
+        while (m_size < (long) nCapacity + 1)
+        {
+            m_size <<= 1;
+        }
+        m_mask = m_size - 1;
+        m_data = new T[m_size];
+    }
+
+    ~hduRingBuffer()
+    {
+        delete [] m_data;
+    }
+
+    /* Number of elements the buffer can hold. */
+    unsigned long capacity() const { return (unsigned long) (m_size - 1); }
+
+    /* Approximate number of elements in the buffer.  Exact when called from
+       either the producer or the consumer while the other is idle. */
+    unsigned long size() const
+    {
+        long head = hduAtomicLoad(&m_head);
+        long tail = hduAtomicLoad(&m_tail);
+        return (unsigned long) ((tail - head) & m_mask);
+    }
+
+    bool empty() const { return size() == 0; }
+
+    /***************************************************************************
+     Producer interface.
+    ***************************************************************************/
+
+    /* Returns the slot to be written next, or 0 if the buffer is full. */
+    T *beginPush()
+    {
+        long tail = m_tail;
+        long next = (tail + 1) & m_mask;
+        if (next == hduAtomicLoad(&m_head))
+        {
+            return 0;
+        }
+        return &m_data[tail];
+    }
+
+    /* Publishes the slot returned by beginPush() to the consumer. */
+    void endPush()
+    {
+        hduAtomicStore(&m_tail, (m_tail + 1) & m_mask);
+    }
+
+    /* Copies value into the buffer.  Returns false if the buffer is full. */
+    bool push(const T &value)
+    {
+        T *pSlot = beginPush();
+        if (!pSlot)
+        {
+            return false;
+        }
+        *pSlot = value;
+        endPush();
+        return true;
+    }
+
+    /***************************************************************************
+     Consumer interface.
+    ***************************************************************************/
+
+    /* Returns the oldest element, or 0 if the buffer is empty. */
+    const T *front() const
+    {
+        long head = m_head;
+        if (head == hduAtomicLoad(&m_tail))
+        {
+            return 0;
+        }
+        return &m_data[head];
+    }
+
+    /* Releases the element returned by front() back to the producer. */
+    void popFront()
+    {
+        hduAtomicStore(&m_head, (m_head + 1) & m_mask);
+    }
+
+    /* Copies the oldest element out of the buffer.  Returns false if the
+       buffer is empty. */
+    bool pop(T &value)
+    {
+        const T *pSlot = front();
+        if (!pSlot)
+        {
+            return false;
+        }
+        value = *pSlot;
+        popFront();
+        return true;
+    }
+
+private:
+
+    /* Not copyable. */
+    hduRingBuffer(const hduRingBuffer &);
+    hduRingBuffer &operator=(const hduRingBuffer &);
+
+    T *m_data;
+    long m_size;
+    long m_mask;
+
+    /* Read index, written only by the consumer. */
+    char m_pad0[HDU_CACHE_LINE_SIZE];
+    volatile long m_head;
+
+    /* Write index, written only by the producer. */
+    char m_pad1[HDU_CACHE_LINE_SIZE - sizeof(long)];
+    volatile long m_tail;
+    char m_pad2[HDU_CACHE_LINE_SIZE - sizeof(long)];
+};
+
+#endif /* __cplusplus */
+
+#endif /* hduRingBuffer_H_ */
+
+/*****************************************************************************/
@@ -0,0 +1,136 @@
+/*****************************************************************************
+
+Copyright (c) 2004 SensAble Technologies, Inc. All rights reserved.
+
+OpenHaptics(TM) toolkit. The material embodied in this software and use of
+this software is subject to the terms and conditions of the clickthrough
+Development License Agreement.
+
+For questions, comments or bug reports, go to forums at:
+    http://dsc.sensable.com
+
+Module Name:
+
+  hduServoProfiler.h
+
+Description:
+
+  Latency histograms for the servo loop.  Measures how long each phase of
+  a scheduler tick and each profiled callback takes, and reports percentiles
+  and overruns to another thread without ever blocking the servo loop.
+
+*******************************************************************************/
+
+#ifndef hduServoProfiler_H_
+#define hduServoProfiler_H_
+
+#include <HD/hdDefines.h>
+#include <HD/hdScheduler.h>
+
+#ifdef __cplusplus
+
+/******************************************************************************
+ Summary of one histogram.  Times are in seconds.  Percentiles are upper
+ bounds, accurate to about 3%.
+******************************************************************************/
+struct hduServoProfileStats
+{
+    HDulong nSamples;
+    HDdouble p50;
+    HDdouble p99;
+    HDdouble p999;
+    HDdouble max;
+};
+
+struct hduServoProfilerData;
+
+/*******************************************************************************
+ hduServoProfiler
+
+ Constructing a profiler schedules two callbacks that bracket each tick: one
+ at the highest priority that begins a frame on the current device, and one
+ at the lowest priority that ends it.  Callbacks scheduled through the
+ profiler run in between and their own hdBeginFrame/hdEndFrame calls nest
+ inside the profiler's frame.  Each tick is split into phases:
+
+   PHASE_SCHEDULER  - from the start of the tick until the profiler's
+                      begin callback runs, i.e. scheduler overhead.
+   PHASE_BEGIN_FRAME - hdBeginFrame, reading the device state.
+   PHASE_CALLBACKS  - all callbacks between the begin and end frame.
+   PHASE_END_FRAME  - hdEndFrame, sending forces to the device.
+   PHASE_TICK       - the whole tick up to the end of hdEndFrame.
+   PHASE_INTERVAL   - the time since the previous tick, as given by
+                      HD_INSTANTANEOUS_UPDATE_RATE; its inverse is the
+                      servo loop rate.
+
+ A tick overruns when PHASE_TICK exceeds the scheduler period.
+
+ Samples are taken with hdGetSchedulerTimeStamp.  The servo thread only
+ ever increments counters; all other methods are meant for a single
+ other thread, typically the graphics thread, and never block the servo
+ loop.  Create the profiler after the device is initialized.
+*******************************************************************************/
+class hduServoProfiler
+{
+public:
+
+    enum Phase
+    {
+        PHASE_SCHEDULER = 0,
+        PHASE_BEGIN_FRAME,
+        PHASE_CALLBACKS,
+        PHASE_END_FRAME,
+        PHASE_TICK,
+        PHASE_INTERVAL,
+        NUM_PHASES
+    };
+
+    /* Maximum number of callbacks that can be profiled. */
+    enum { MAX_CALLBACKS = 16 };
+
+    hduServoProfiler();
+    ~hduServoProfiler();
+
+    /* Same as hdScheduleAsynchronous, but the run time of each invocation
+       is recorded under pName.  Returns 0 if MAX_CALLBACKS callbacks have
+       already been scheduled through this profiler. */
+    HDSchedulerHandle scheduleAsynchronous(HDSchedulerCallback pCallback,
+                                           void *pUserData,
+                                           HDushort nPriority,
+                                           const char *pName);
+
+    /* Statistics since construction or the last reset. */
+    void getPhaseStats(Phase ePhase, hduServoProfileStats &stats) const;
+    bool getCallbackStats(HDSchedulerHandle hHandle,
+                          hduServoProfileStats &stats) const;
+    HDulong getOverrunCount() const;
+
+    /* Callbacks profiled so far, including ones that have finished. */
+    int getCallbackCount() const;
+    const char *getCallbackName(int nIndex) const;
+    void getCallbackStats(int nIndex, hduServoProfileStats &stats) const;
+
+    /* Starts a new measurement interval.  Does not touch the data written
+       by the servo loop; later queries subtract the counts at the time of
+       the reset. */
+    void reset();
+
+    /* Nominal scheduler period used to detect overruns, in seconds.  By
+       default taken from HD_UPDATE_RATE when the profiler is created. */
+    void setOverrunThreshold(HDdouble period);
+    HDdouble getOverrunThreshold() const;
+
+private:
+
+    /* Not copyable. */
+    hduServoProfiler(const hduServoProfiler &);
+    hduServoProfiler &operator=(const hduServoProfiler &);
+
+    hduServoProfilerData *m_pData;
+};
+
+#endif /* __cplusplus */
+
+#endif /* hduServoProfiler_H_ */
+
+/*****************************************************************************/
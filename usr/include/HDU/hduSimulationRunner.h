@@ -0,0 +1,125 @@
+/*****************************************************************************
+
+Copyright (c) 2004 SensAble Technologies, Inc. All rights reserved.
+
+OpenHaptics(TM) toolkit. The material embodied in this software and use of
+this software is subject to the terms and conditions of the clickthrough
+Development License Agreement.
+
+For questions, comments or bug reports, go to forums at:
+    http://dsc.sensable.com
+
+Module Name:
+
+  hduSimulationRunner.h
+
+Description:
+
+  Steps a simulation on its own thread at a fixed rate, independent of the
+  graphics frame rate.
+
+*******************************************************************************/
+
+#ifndef hduSimulationRunner_H_
+#define hduSimulationRunner_H_
+
+#ifdef __cplusplus
+
+struct hduSimulationRunnerData;
+
+/*******************************************************************************
+ hduSimulationRunner
+
+ Wall clock time is gathered in an accumulator and spent in steps of the
+ same size, so the simulation sees the same step size however fast the
+ graphics run.  If the steps fall behind by more than the maximum number of
+ substeps per wake up, the time left over is dropped and counted as an
+ overrun, rather than letting the simulation fall ever further behind.
+
+ The step callback runs on the simulation thread.  Other threads change the
+ simulated system only between beginEdit and endEdit, and read its state
+ through whatever the step callback publishes, e.g. an hduTripleBuffer.
+ The statistics may be read from any thread.
+*******************************************************************************/
+class hduSimulationRunner
+{
+public:
+
+    /* Advances the simulation from t to t + dt. */
+    typedef void (*StepCallback)(double t, double dt, void *pUserData);
+
+    hduSimulationRunner();
+    ~hduSimulationRunner();
+
+    /* Starts the simulation thread.  Returns false if already running or
+       the thread could not be created. */
+    bool start(StepCallback pStep, void *pUserData);
+
+    /* Waits for the simulation thread to exit.  May be called from inside
+       an edit. */
+    void stop();
+    bool isRunning() const { return m_bThreadStarted; }
+
+    /* Steps per second of simulation time. */
+    void setRate(double rate);
+    double getRate() const { return m_rate; }
+
+    void setMaxSubsteps(int nMaxSubsteps);
+    int getMaxSubsteps() const { return m_nMaxSubsteps; }
+
+    void setPaused(bool bPaused);
+    bool isPaused() const { return m_bPaused; }
+
+    /* Holds off the simulation thread, waiting for the current steps to
+       finish.  May be nested. */
+    void beginEdit();
+    void endEdit();
+
+    /* Steps through duration seconds of simulation time on the calling
+       thread, for stepping by hand while paused. */
+    void advance(double duration);
+
+    /* Achieved steps per second, measured over the last second. */
+    double getStepRate() const;
+    unsigned long getOverruns() const;
+
+    /* Simulation time. */
+    double getTime() const;
+
+private:
+
+    friend struct hduSimulationRunnerData;
+
+    void run();
+    void doStep(double dt);
+
+    /* Not copyable. */
+    hduSimulationRunner(const hduSimulationRunner &);
+    hduSimulationRunner &operator=(const hduSimulationRunner &);
+
+    /* Thread, locks and clock. */
+    hduSimulationRunnerData *m_pData;
+
+    bool m_bThreadStarted;
+    volatile long m_bStopRequested;
+
+    StepCallback m_pStep;
+    void *m_pUserData;
+
+    /* Written under the step lock. */
+    double m_rate;
+    int m_nMaxSubsteps;
+    bool m_bPaused;
+
+    /* Written under the stats lock. */
+    double m_time;
+    double m_stepRate;
+
+    volatile long m_nOverruns;
+};
+
+#endif /* __cplusplus */
+
+#endif /* hduSimulationRunner_H_ */
+
+/*****************************************************************************/
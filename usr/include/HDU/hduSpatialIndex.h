@@ -0,0 +1,210 @@
+/*****************************************************************************
+
+Copyright (c) 2004 SensAble Technologies, Inc. All rights reserved.
+
+OpenHaptics(TM) toolkit. The material embodied in this software and use of
+this software is subject to the terms and conditions of the clickthrough
+Development License Agreement.
+
+For questions, comments or bug reports, go to forums at:
+    http://dsc.sensable.com
+
+Module Name:
+
+  hduSpatialIndex.h
+
+Description:
+
+  Nearest point queries over the vertices of a mesh or a set of particles,
+  without searching through every point.
+
+*******************************************************************************/
+
+#ifndef hduSpatialIndex_H_
+#define hduSpatialIndex_H_
+
+#include <HDU/hduVector.h>
+
+#ifdef __cplusplus
+
+#include <vector>
+
+/******************************************************************************
+ Both indices hold points numbered 0 to n-1, passed as consecutive x,y,z
+ triples so that an array of hduVector3Dd can be passed directly.  The
+ indices keep their own copy of the points; after the caller's points move,
+ the index has to be told with refit or updatePoints.
+
+ Queries return point numbers:
+
+   findNearest   - the closest point, or -1 if there are no points or none
+                   is within maxDistance.  Ties go to either point.
+   findKNearest  - the k closest points, closest first.  Fewer if there are
+                   fewer than k points.
+   findInRadius  - all points within radius, inclusive, in no particular
+                   order.
+
+ Queries do not change the index and may be made from several threads at
+ once, but not while the index is being built or updated.
+******************************************************************************/
+
+/*******************************************************************************
+ hduKdTree
+
+ For points that do not move, or only move a little, such as the vertices
+ of a static or slightly deforming mesh.  Building is O(n log n).  The tree
+ bounds each node with a box rather than a splitting plane, so refit can
+ follow moving points in O(n) by recomputing the boxes while keeping the
+ tree.  Queries stay exact after a refit, but get slower as points drift
+ far from where they were when the tree was built; rebuild then.
+*******************************************************************************/
+class hduKdTree
+{
+public:
+
+    hduKdTree();
+
+    void build(const double *points, int nPoints);
+    void build(const hduVector3Dd *points, int nPoints)
+    {
+        build(reinterpret_cast<const double *>(points), nPoints);
+    }
+
+    /* Same number of points, in the same order, as passed to build. */
+    void refit(const double *points);
+    void refit(const hduVector3Dd *points)
+    {
+        refit(reinterpret_cast<const double *>(points));
+    }
+
+    void clear();
+
+    int getNumPoints() const { return (int) m_index.size(); }
+
+    /* pDistanceSqr, if given, receives the squared distance to the point
+       found. */
+    int findNearest(const hduVector3Dd &query,
+                    double maxDistance = -1,
+                    double *pDistanceSqr = 0) const;
+    void findKNearest(const hduVector3Dd &query, int k,
+                      std::vector<int> &result) const;
+    void findInRadius(const hduVector3Dd &query, double radius,
+                      std::vector<int> &result) const;
+
+private:
+
+    struct Node
+    {
+        double lo[3];
+        double hi[3];
+        int begin;      /* range of m_index */
+        int end;
+        int left;       /* right is left + 1; 0 for a leaf */
+    };
+
+    void buildNode(int iNode, int begin, int end);
+    void computeBounds();
+
+    template <class Visitor>
+    void searchNode(int iNode, const double *q, Visitor &visitor) const;
+
+    std::vector<Node> m_nodes;
+    std::vector<int> m_index;       /* point numbers, in tree order */
+    std::vector<double> m_points;   /* coordinates, in tree order */
+};
+
+/*******************************************************************************
+ hduHashGrid
+
+ For points that move every frame, such as the particles of a simulation.
+ Space is divided into cubic cells, and the points in each cell are kept in
+ a hash table of linked lists, so moving a point that stays in its cell
+ costs a comparison and moving it into another cell a few pointer updates.
+ Queries look at the cells around the query point, which works best with
+ cells about the size of the spacing between points.
+*******************************************************************************/
+class hduHashGrid
+{
+public:
+
+    hduHashGrid();
+
+    /* cellSize 0, the default, has setPoints pick a cell size that puts a
+       few points in each cell. */
+    void setCellSize(double cellSize);
+    double getCellSize() const { return m_cellSize; }
+
+    void setPoints(const double *points, int nPoints);
+    void setPoints(const hduVector3Dd *points, int nPoints)
+    {
+        setPoints(reinterpret_cast<const double *>(points), nPoints);
+    }
+
+    /* Moves one point, or every point, to a new position.  The number of
+       points stays the same as on setPoints. */
+    void updatePoint(int i, const hduVector3Dd &position);
+    void updatePoints(const double *points);
+    void updatePoints(const hduVector3Dd *points)
+    {
+        updatePoints(reinterpret_cast<const double *>(points));
+    }
+
+    void clear();
+
+    int getNumPoints() const { return (int) m_next.size(); }
+
+    int findNearest(const hduVector3Dd &query,
+                    double maxDistance = -1,
+                    double *pDistanceSqr = 0) const;
+    void findKNearest(const hduVector3Dd &query, int k,
+                      std::vector<int> &result) const;
+    void findInRadius(const hduVector3Dd &query, double radius,
+                      std::vector<int> &result) const;
+
+private:
+
+    struct Cell
+    {
+        int c[3];
+    };
+
+    void chooseCellSize();
+    void linkAll();
+    double getOccupancy() const;
+    void getCell(const double *p, Cell &cell) const;
+    unsigned int getBucket(const Cell &cell) const;
+    static bool isSameCell(const Cell &a, const Cell &b);
+    void link(int i);
+    void unlink(int i);
+    void growBounds(const Cell &cell);
+
+    template <class Visitor>
+    void visitCell(const Cell &cell, const double *q,
+                   Visitor &visitor) const;
+    template <class Visitor>
+    int visitShell(const Cell &center, int ring, const double *q,
+                   Visitor &visitor) const;
+    template <class Visitor>
+    void searchOutward(const double *q, Visitor &visitor) const;
+
+    double m_cellSize;
+    double m_invCellSize;
+    bool m_bAutoCellSize;
+
+    /* Cells holding any point since the last setPoints. */
+    Cell m_boundsLo;
+    Cell m_boundsHi;
+
+    std::vector<int> m_buckets;     /* first point, or -1 */
+    unsigned int m_bucketMask;
+    std::vector<int> m_next;        /* next point in the bucket, or -1 */
+    std::vector<int> m_prev;        /* previous point, or -1 if first */
+    std::vector<Cell> m_cells;      /* cell of each point */
+    std::vector<double> m_points;
+};
+
+#endif /* __cplusplus */
+
+#endif /* hduSpatialIndex_H_ */
+
+/*****************************************************************************/
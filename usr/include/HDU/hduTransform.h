@@ -0,0 +1,134 @@
+/*****************************************************************************
+
+Copyright (c) 2004 SensAble Technologies, Inc. All rights reserved.
+
+OpenHaptics(TM) toolkit. The material embodied in this software and use of
+this software is subject to the terms and conditions of the clickthrough
+Development License Agreement.
+
+For questions, comments or bug reports, go to forums at:
+    http://dsc.sensable.com
+
+Module Name:
+
+  hduTransform.h
+
+Description:
+
+  Transforms arrays of points, directions and normals by a hduMatrix.
+
+*******************************************************************************/
+
+#ifndef hduTransform_H_
+#define hduTransform_H_
+
+#include <HDU/hduMatrix.h>
+#include <HDU/hduVector.h>
+
+#include <stddef.h>
+
+/******************************************************************************
+ Batched transforms
+
+ Each function transforms n vectors stored as consecutive x,y,z triples, so
+ an array of hduVector3Dd or hduVector3Df can be passed directly.  Vectors
+ are treated as row vectors, matching hduMatrix::multVecMatrix and
+ hduMatrix::multDirMatrix, so a batch gives the same results as the
+ per-element loop up to rounding.  Float arrays are transformed in double
+ precision.  in and out may be the same array but must not otherwise
+ overlap.
+
+ The loops use AVX2 or SSE2 when the processor supports them, chosen the
+ first time any of these functions is called, and portable C++ otherwise.
+******************************************************************************/
+
+/* Transforms points, i.e. out = in * m.  The homogeneous coordinate is
+   taken to be 1 and the result is divided by the resulting w unless the
+   last column of m is (0,0,0,1). */
+void hduTransformPoints(const hduMatrix &m, const double *in,
+                        double *out, size_t n);
+void hduTransformPoints(const hduMatrix &m, const float *in,
+                        float *out, size_t n);
+
+/* Transforms directions by the upper 3x3 part of m, ignoring
+   translation. */
+void hduTransformDirections(const hduMatrix &m, const double *in,
+                            double *out, size_t n);
+void hduTransformDirections(const hduMatrix &m, const float *in,
+                            float *out, size_t n);
+
+/* Transforms normals of a surface transformed by m, i.e. by the inverse
+   transpose of the upper 3x3 part of m, and rescales them to unit length.
+   Zero length normals stay zero.  A singular m gives finite but
+   meaningless results. */
+void hduTransformNormals(const hduMatrix &m, const double *in,
+                         double *out, size_t n);
+void hduTransformNormals(const hduMatrix &m, const float *in,
+                         float *out, size_t n);
+
+/* Overloads for arrays of vectors. */
+inline void hduTransformPoints(const hduMatrix &m, const hduVector3Dd *in,
+                               hduVector3Dd *out, size_t n)
+{
+    hduTransformPoints(m, reinterpret_cast<const double *>(in),
+                       reinterpret_cast<double *>(out), n);
+}
+
+inline void hduTransformPoints(const hduMatrix &m, const hduVector3Df *in,
+                               hduVector3Df *out, size_t n)
+{
+    hduTransformPoints(m, reinterpret_cast<const float *>(in),
+                       reinterpret_cast<float *>(out), n);
+}
+
+inline void hduTransformDirections(const hduMatrix &m,
+                                   const hduVector3Dd *in,
+                                   hduVector3Dd *out, size_t n)
+{
+    hduTransformDirections(m, reinterpret_cast<const double *>(in),
+                           reinterpret_cast<double *>(out), n);
+}
+
+inline void hduTransformDirections(const hduMatrix &m,
+                                   const hduVector3Df *in,
+                                   hduVector3Df *out, size_t n)
+{
+    hduTransformDirections(m, reinterpret_cast<const float *>(in),
+                           reinterpret_cast<float *>(out), n);
+}
+
+inline void hduTransformNormals(const hduMatrix &m, const hduVector3Dd *in,
+                                hduVector3Dd *out, size_t n)
+{
+    hduTransformNormals(m, reinterpret_cast<const double *>(in),
+                        reinterpret_cast<double *>(out), n);
+}
+
+inline void hduTransformNormals(const hduMatrix &m, const hduVector3Df *in,
+                                hduVector3Df *out, size_t n)
+{
+    hduTransformNormals(m, reinterpret_cast<const float *>(in),
+                        reinterpret_cast<float *>(out), n);
+}
+
+/******************************************************************************
+ Instruction set used by the batched transforms.  hduSetTransformISA forces
+ a code path, e.g. for benchmarking, and returns false if the processor
+ does not support it.  It is not safe to call while another thread is
+ transforming.
+******************************************************************************/
+enum hduTransformISA
+{
+    HDU_TRANSFORM_ISA_SCALAR = 0,
+    HDU_TRANSFORM_ISA_SSE2,
+    HDU_TRANSFORM_ISA_AVX2
+};
+
+hduTransformISA hduGetTransformISA();
+bool hduSetTransformISA(hduTransformISA isa);
+bool hduIsTransformISASupported(hduTransformISA isa);
+const char *hduGetTransformISAName(hduTransformISA isa);
+
+#endif  /* hduTransform_H_ */
+
+/*****************************************************************************/
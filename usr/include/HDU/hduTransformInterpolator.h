@@ -0,0 +1,148 @@
+/*****************************************************************************
+
+Copyright (c) 2004 SensAble Technologies, Inc. All rights reserved.
+
+OpenHaptics(TM) toolkit. The material embodied in this software and use of
+this software is subject to the terms and conditions of the clickthrough
+Development License Agreement.
+
+For questions, comments or bug reports, go to forums at:
+    http://dsc.sensable.com
+
+Module Name:
+
+  hduTransformInterpolator.h
+
+Description:
+
+  Smooth servo loop sampling of a transform that the graphics thread
+  updates once a frame.
+
+*******************************************************************************/
+
+#ifndef hduTransformInterpolator_H_
+#define hduTransformInterpolator_H_
+
+#include <HDU/hduMatrix.h>
+#include <HDU/hduQuaternion.h>
+#include <HDU/hduVector.h>
+#include <HDU/hduTripleBuffer.h>
+
+#ifdef __cplusplus
+
+/*******************************************************************************
+ hduTransformInterpolator
+
+ The graphics thread pushes a timestamped pose each frame, and the servo
+ loop samples a pose for every tick in between, so that an object moved at
+ the graphics rate moves smoothly under the device instead of in steps of
+ a frame.
+
+ Poses are affine transforms.  Each is split into a rotation, a stretch
+ (the rest of the upper 3x3 part, e.g. a scale) and a translation.
+ Between two poses the rotation is interpolated with hduSlerp, the
+ stretch linearly, and the translation with a cubic Hermite spline whose
+ tangents come from the neighbouring poses.  The last few poses are
+ published to the servo loop through an hduTripleBuffer, so neither side
+ ever waits for the other.
+
+ Interpolating needs a pose on each side of the sampled time, so the servo
+ loop samples a delay behind the present, by default one average interval
+ between pushes.  With extrapolation enabled, a time past the latest pose
+ continues its motion for at most the given time and then holds it; a
+ delay of 0 with extrapolation has no added latency, but overshoots where
+ the motion changes.  Without either, sampling holds the latest pose, as
+ if it were handed over directly.
+
+ Times are in seconds on the clock of getTime().  push, reset and the
+ setters are for one thread, typically the graphics thread; sample is for
+ one other thread, typically the servo loop.  Setters take effect on the
+ next push.
+*******************************************************************************/
+class hduTransformInterpolator
+{
+public:
+
+    hduTransformInterpolator();
+
+    /* Seconds the servo loop samples behind the present.  Negative, the
+       default, means one average interval between pushes. */
+    void setDelay(double delay);
+    double getDelay() const { return m_delay; }
+
+    /* Longest time, in seconds, to continue the motion of the latest pose
+       past it.  0, the default, holds the latest pose. */
+    void setMaxExtrapolation(double maxExtrapolation);
+    double getMaxExtrapolation() const { return m_maxExtrapolation; }
+
+    /* Adds the pose at the given time.  A pose at or before the time of
+       the previous one replaces it. */
+    void push(double time, const hduMatrix &pose);
+    void push(const hduMatrix &pose) { push(getTime(), pose); }
+
+    /* Forgets earlier poses, so that a jump, e.g. to a new scene, is not
+       interpolated across. */
+    void reset(double time, const hduMatrix &pose);
+    void reset(const hduMatrix &pose) { reset(getTime(), pose); }
+
+    /* Picks up the latest poses pushed and samples the pose at the given
+       time.  Returns false, leaving pose unchanged, if nothing was pushed
+       yet. */
+    bool sample(double time, hduMatrix &pose);
+
+    /* Samples at the start of the current servo loop tick, so that every
+       callback in a tick sees the same pose.  Call from the servo loop. */
+    bool sample(hduMatrix &pose);
+
+    /* Monotonic time in seconds, for timestamping poses. */
+    static double getTime();
+
+private:
+
+    enum { kMaxKeys = 4 };
+
+    struct Key
+    {
+        double time;
+        hduQuaternion rotation;
+        double stretch[3][3];
+        hduVector3Dd translation;
+    };
+
+    /* What the servo loop sees; keys are oldest first. */
+    struct Keys
+    {
+        Key keys[kMaxKeys];
+        int nKeys;
+        double delay;
+        double maxExtrapolation;
+    };
+
+    void publish();
+
+    static void decompose(double time, const hduMatrix &pose, Key &key);
+    static void compose(const hduQuaternion &rotation,
+                        const double stretch[3][3],
+                        const hduVector3Dd &translation,
+                        hduMatrix &pose);
+    static hduVector3Dd getTangent(const Keys &keys, int i);
+
+    /* Not copyable. */
+    hduTransformInterpolator(const hduTransformInterpolator &);
+    hduTransformInterpolator &operator=(const hduTransformInterpolator &);
+
+    /* Owned by the writer. */
+    Key m_keys[kMaxKeys];
+    int m_nKeys;
+    double m_delay;
+    double m_maxExtrapolation;
+    double m_interval;          /* average interval between pushes */
+
+    hduTripleBuffer<Keys> m_buffer;
+};
+
+#endif /* __cplusplus */
+
+#endif /* hduTransformInterpolator_H_ */
+
+/*****************************************************************************/
@@ -0,0 +1,117 @@
+/*****************************************************************************
+
+Copyright (c) 2004 SensAble Technologies, Inc. All rights reserved.
+
+OpenHaptics(TM) toolkit. The material embodied in this software and use of
+this software is subject to the terms and conditions of the clickthrough
+Development License Agreement.
+
+For questions, comments or bug reports, go to forums at:
+    http://dsc.sensable.com
+
+Module Name:
+
+  hduTripleBuffer.h
+
+Description:
+
+  Wait-free publication of the latest complete copy of a piece of state from
+  one thread to another.
+
+*******************************************************************************/
+
+#ifndef hduTripleBuffer_H_
+#define hduTripleBuffer_H_
+
+#include <HDU/hduAtomic.h>
+
+#ifdef __cplusplus
+
+/*******************************************************************************
+ hduTripleBuffer
+
+ One thread writes, one other thread reads.  The writer fills in the buffer
+ returned by getWriteBuffer() and calls publish().  The reader calls update()
+ to switch to the most recently published buffer and then reads it through
+ getReadBuffer().  Neither side ever waits for the other, and the reader
+ never sees a partially written buffer.  Intermediate buffers published
+ between two updates are skipped.
+*******************************************************************************/
+template <class T>
+class hduTripleBuffer
+{
+public:
+
+    hduTripleBuffer() :
+        m_writeIndex(0),
+        m_middle(1),
+        m_readIndex(2)
+    {
+    }
+
+    /***************************************************************************
+     Writer interface.
+    ***************************************************************************/
+
+    T &getWriteBuffer() { return m_buffers[m_writeIndex]; }
+
+    /* Hands the write buffer to the reader and takes back a free buffer.
+       The new write buffer holds stale data. */
+    void publish()
+    {
+        long middle = hduAtomicExchange(&m_middle, m_writeIndex | kFresh);
+        m_writeIndex = middle & kIndexMask;
+    }
+
+    /***************************************************************************
+     Reader interface.
+    ***************************************************************************/
+
+    /* Switches the read buffer to the latest published one.  Returns false,
+       leaving the read buffer unchanged, if nothing was published since the
+       last update. */
+    bool update()
+    {
+        if ((hduAtomicLoad(&m_middle) & kFresh) == 0)
+        {
+            return false;
+        }
+        long middle = hduAtomicExchange(&m_middle, m_readIndex);
+        m_readIndex = middle & kIndexMask;
+        return true;
+    }
+
+    const T &getReadBuffer() const { return m_buffers[m_readIndex]; }
+
+private:
+
+    enum
+    {
+        kIndexMask = 0x3,
+        kFresh = 0x4
+    };
+
+    /* Not copyable. */
+    hduTripleBuffer(const hduTripleBuffer &);
+    hduTripleBuffer &operator=(const hduTripleBuffer &);
+
+    T m_buffers[3];
+
+    /* Owned by the writer. */
+    long m_writeIndex;
+
+    /* Shared.  Index of the buffer in transit, plus kFresh if it has not
+       been picked up by the reader yet. */
+    char m_pad0[HDU_CACHE_LINE_SIZE];
+    volatile long m_middle;
+    char m_pad1[HDU_CACHE_LINE_SIZE - sizeof(long)];
+
+    /* Owned by the reader. */
+    long m_readIndex;
+};
+
+#endif /* __cplusplus */
+
+#endif /* hduTripleBuffer_H_ */
+
+/*****************************************************************************/
@@ -33,9 +33,25 @@ class SnapConstraint;
  Description: placeholder that one can add pointers to constraints 
               (of base class SnapConstraint)
 
+              Constraints are stored contiguously in the order added.  In
+              addition, constraints whose exact type is PointConstraint,
+              LineConstraint or PlaneConstraint are kept in per type groups
+              so that they can be evaluated in batches.  Subclasses of those
+              types go into the OTHER_GROUP, since they may override
+              testConstraint.
+
 ******************************************************************************/
 struct ConstraintHolder
 {
+    enum ConstraintGroup
+    {
+        POINT_GROUP = 0,
+        LINE_GROUP,
+        PLANE_GROUP,
+        OTHER_GROUP,
+        NUM_GROUPS
+    };
+
     static ConstraintHolder *create();
     static void destroy(ConstraintHolder *&pInstance);
 
@@ -44,7 +60,19 @@ struct ConstraintHolder
     virtual void removeConstraint(SnapConstraint *pConstraint) = 0;
     virtual void clearConstraints() = 0;
 
-    /* Methods for iterating through constraints. */
+    /* Indexed access.  Does not modify the holder, so several threads may
+       read the same holder at once. */
+    virtual int getNumConstraints() const = 0;
+    virtual SnapConstraint *getConstraint(int nIndex) = 0;
+    virtual const SnapConstraint *getConstraint(int nIndex) const = 0;
+
+    /* Constraints of one group as a contiguous array, in the order added. */
+    virtual int getGroupSize(ConstraintGroup eGroup) const = 0;
+    virtual SnapConstraint * const *getGroup(ConstraintGroup eGroup) const = 0;
+
+    /* Methods for iterating through constraints.  The iterator is stored in
+       the holder, so prefer indexed access when the holder may be used
+       from more than one place at a time. */
     virtual void begin() = 0;
     virtual void next() = 0;
     virtual bool done() const = 0;
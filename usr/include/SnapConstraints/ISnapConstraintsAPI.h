@@ -30,6 +30,7 @@ namespace SnapConstraints
 {
 
 class SnapConstraint;
+struct SnapIndex;
 
 /******************************************************************************
  ISnapConstraintsAPI
@@ -65,6 +66,12 @@ struct ISnapConstraintsAPI
 
     /* Clears the current applied constraint. */
     virtual void clearConstraint() = 0;
+
+    /* If no constraint is applied, looks up the closest constraint in the
+       index that the device is within snap distance of and applies it.
+       Returns the applied constraint. */
+    virtual SnapConstraint *selectConstraint(const SnapIndex *pIndex,
+                                             const hduVector3Dd &devicePt) = 0;
 };
 
 } /* namespace SnapConstraints */
@@ -0,0 +1,118 @@
+/*****************************************************************************
+
+Copyright (c) 2004 SensAble Technologies, Inc. All rights reserved.
+
+OpenHaptics(TM) toolkit. The material embodied in this software and use of
+this software is subject to the terms and conditions of the clickthrough
+Development License Agreement.
+
+For questions, comments or bug reports, go to forums at:
+    http://dsc.sensable.com
+
+Module Name:
+
+  SnapIndex.h
+
+Description:
+
+  A spatial index over SnapConstraints for finding the closest constraint
+  within snap distance of a test position without testing every one.
+
+******************************************************************************/
+
+#ifndef SnapIndex_H_
+#define SnapIndex_H_
+
+#include <HDU/hduVector.h>
+
+namespace SnapConstraints
+{
+
+class SnapConstraint;
+class PointConstraint;
+
+/*****************************************************************************
+ Struct: SnapIndex
+
+ Description: Holds pointers to constraints, each with an axis aligned box
+              that bounds the proxy positions it can produce.  The boxes are
+              kept in a bounding volume hierarchy, so that a closest
+              constraint query visits O(log N) constraints.
+
+              Constraints without finite bounds, such as planes or infinite
+              lines, can be added as unbounded and are tested on every
+              query.  A LineConstraint can be added with the bounds of a
+              segment to have it only found near that segment.
+
+              The index does not own the constraints.  When a constraint
+              moves or its snap distance changes, call moveConstraint() so
+              the index stays valid.  Constraints in an index should not be
+              auto deleted, since clearing one from ISnapConstraintsAPI
+              would leave a dangling pointer behind.
+******************************************************************************/
+struct SnapIndex
+{
+    /* Query used to search the index.  Lets the caller define its own
+       notion of distance, as long as it can give a lower bound for a box. */
+    struct Query
+    {
+        virtual ~Query() {}
+
+        /* Returns a lower bound on the distance testConstraint() returns
+           for any constraint whose bounds lie inside the box. */
+        virtual double getBoundsDistance(const hduVector3Dd &boundsMin,
+                                         const hduVector3Dd &boundsMax) const = 0;
+
+        /* Tests one candidate, with the same meaning as
+           SnapConstraint::testConstraint. */
+        virtual double testConstraint(const SnapConstraint *pConstraint,
+                                      hduVector3Dd &proxyPt) const = 0;
+    };
+
+    static SnapIndex *create();
+    static void destroy(SnapIndex *&pInstance);
+
+    /* Adds a constraint with the given bounds. */
+    virtual void addConstraint(SnapConstraint *pConstraint,
+                               const hduVector3Dd &boundsMin,
+                               const hduVector3Dd &boundsMax) = 0;
+
+    /* Adds a point constraint, bounded by its point. */
+    virtual void addConstraint(PointConstraint *pConstraint) = 0;
+
+    /* Adds a constraint that is tested on every query. */
+    virtual void addUnboundedConstraint(SnapConstraint *pConstraint) = 0;
+
+    /* Updates the bounds of a constraint already in the index.  Cheap when
+       the constraint only moved a little since it was added. */
+    virtual void moveConstraint(SnapConstraint *pConstraint,
+                                const hduVector3Dd &boundsMin,
+                                const hduVector3Dd &boundsMax) = 0;
+    virtual void moveConstraint(PointConstraint *pConstraint) = 0;
+
+    virtual void removeConstraint(SnapConstraint *pConstraint) = 0;
+    virtual void clearConstraints() = 0;
+
+    virtual int getNumConstraints() const = 0;
+
+    /* Returns the constraint with the smallest testConstraint distance that
+       is also less than its snap distance, or 0 if there is none.  proxyPt
+       receives the constrained position for the returned constraint. */
+    virtual SnapConstraint *findClosestConstraint(
+        const hduVector3Dd &testPt, hduVector3Dd &proxyPt) const = 0;
+
+    virtual SnapConstraint *findClosestConstraint(
+        const Query &query, hduVector3Dd &proxyPt) const = 0;
+
+    /* Stored bounds are grown by this margin, so that small moves
+       do not restructure the hierarchy.  Defaults to the default snap
+       distance. */
+    virtual void setMargin(double margin) = 0;
+    virtual double getMargin() const = 0;
+};
+
+} /* namespace SnapConstraints */
+
+#endif /* SnapIndex_H_ */
+
+/*****************************************************************************/
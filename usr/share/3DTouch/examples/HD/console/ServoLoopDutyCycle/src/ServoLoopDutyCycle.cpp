@@ -43,76 +43,61 @@ Description:
 #include <HD/hd.h>
 #include <HDU/hduError.h>
 
-#include "StatsSampler.h"
+#include <HDU/hduServoProfiler.h>
 
 #define TARGET_SERVOLOOP_RATE   1000
 
-StatsSamplerd gSchedulerStatsServo;
-StatsSamplerd gInputStatsServo;
-StatsSamplerd gOutputStatsServo;
-
-StatsSamplerd gSchedulerStatsApp;
-StatsSamplerd gInputStatsApp;
-StatsSamplerd gOutputStatsApp;
+/******************************************************************************
+ Prints one line of stats in ms units.
+******************************************************************************/
+void PrintStats(std::ostream &os, const char *pName,
+                const hduServoProfileStats &stats)
+{
+    os << pName << ": "
+       << "n " << stats.nSamples << " "
+       << "p50 " << 1000 * stats.p50 << " "
+       << "p99 " << 1000 * stats.p99 << " "
+       << "p99.9 " << 1000 * stats.p999 << " "
+       << "max " << 1000 * stats.max << std::endl;
+}
 
 /******************************************************************************
- Prints the duty cycles stats to the output stream provided.  
- The StatsSamplerd class has an ostream operator that handles formatting 
- the relevant data
+ Prints the duty cycle stats collected by the profiler since the last call
+ to the output stream provided.  
 ******************************************************************************/
-void PrintDutyCycleStats(std::ostream &os)
+void PrintDutyCycleStats(std::ostream &os, const hduServoProfiler &profiler)
 {
     os.precision(3);
 
     os << std::endl;
 
-    os << "Scheduler: " << gSchedulerStatsApp << std::endl;
-    os << "Input: " << gInputStatsApp << std::endl;
-    os << "Output: " << gOutputStatsApp << std::endl;
-
-    double totalMean = gSchedulerStatsApp.u() + 
-                       gInputStatsApp.u() +
-                       gOutputStatsApp.u();
-    double totalMin = gSchedulerStatsApp.getMin() +
-                      gInputStatsApp.getMin() +
-                      gOutputStatsApp.getMin();
-    double totalMax = gSchedulerStatsApp.getMax() +
-                      gInputStatsApp.getMax() +
-                      gOutputStatsApp.getMax();
-
-    os << "Summary: " 
-       << "total mean " << totalMean << " "
-       << "total min " << totalMin << " "
-       << "total max " << totalMax << std::endl;
+    hduServoProfileStats stats;
+
+    profiler.getPhaseStats(hduServoProfiler::PHASE_SCHEDULER, stats);
+    PrintStats(os, "Scheduler", stats);
+    profiler.getPhaseStats(hduServoProfiler::PHASE_BEGIN_FRAME, stats);
+    PrintStats(os, "Input", stats);
+    profiler.getPhaseStats(hduServoProfiler::PHASE_END_FRAME, stats);
+    PrintStats(os, "Output", stats);
+    profiler.getPhaseStats(hduServoProfiler::PHASE_TICK, stats);
+    PrintStats(os, "Total", stats);
+
+    os << "Overruns: " << profiler.getOverrunCount() << std::endl;
 }
 
 /******************************************************************************
- Captures stats on the duty cycle of the servo loop.
+ Commands zero force.  The profiler begins and ends the frame around this
+ callback, so the frame calls here are nested and cost next to nothing.
 ******************************************************************************/
 HDCallbackCode HDCALLBACK ServoSchedulerCallback(void *pUserData)
 {
-    // This is the time from the start of the loop until this scheduler
-    // callback was called.
-    HDdouble startTime = hdGetSchedulerTimeStamp();
-
     hdBeginFrame(hdGetCurrentDevice());    
 
-    // Capture the time it took to perform an update on the device.
-    HDdouble updateTime = hdGetSchedulerTimeStamp();
-
     float force[3] = { 0, 0, 0 };
     hdSetFloatv(HD_CURRENT_FORCE, force);
 
     hdEndFrame(hdGetCurrentDevice());
 
-    // Capture the time it took to set a force and flush it to the device.
-    HDdouble endTime = hdGetSchedulerTimeStamp();
-    
-    // Sample values and convert to ms.
-    gSchedulerStatsServo.sample(1000 * startTime);
-    gInputStatsServo.sample(1000 * (updateTime - startTime));
-    gOutputStatsServo.sample(1000 * (endTime - updateTime));
-
     HDErrorInfo error;
     if (HD_DEVICE_ERROR(error = hdGetError()))
     {
@@ -128,23 +113,6 @@ HDCallbackCode HDCALLBACK ServoSchedulerCallback(void *pUserData)
     return HD_CALLBACK_CONTINUE;
 }
 
-/******************************************************************************
- Call this sychronously from the main thread.  Obtains a thread-safe copy of 
- the duty cycle stats.
-******************************************************************************/
-HDCallbackCode HDCALLBACK CopyDutyCycleStats(void *pUserData)
-{
-    gSchedulerStatsApp = gSchedulerStatsServo;
-    gInputStatsApp = gInputStatsServo;
-    gOutputStatsApp = gOutputStatsServo;
-
-    gSchedulerStatsServo.clear();
-    gInputStatsServo.clear();
-    gOutputStatsServo.clear();
-
-    return HD_CALLBACK_DONE;    
-}
-
 /******************************************************************************
  Runs ths haptic device servo loop and captures stats on its idle duty cycle.
 ******************************************************************************/
@@ -164,12 +132,15 @@ int main(int argc, char* argv[])
     HDstring model = hdGetString(HD_DEVICE_MODEL_TYPE);
     std::cout << "Initialized: " << model << std::endl;
 
-    HDSchedulerHandle hServoCallback = hdScheduleAsynchronous(
-        ServoSchedulerCallback, 0, HD_MAX_SCHEDULER_PRIORITY);
+    hduServoProfiler *pProfiler = new hduServoProfiler;
+
+    HDSchedulerHandle hServoCallback = pProfiler->scheduleAsynchronous(
+        ServoSchedulerCallback, 0, HD_DEFAULT_SCHEDULER_PRIORITY, "Servo");
     if (HD_DEVICE_ERROR(error = hdGetError()))
     {
         std::cerr << error << std::endl;
         std::cerr << "Failed to schedule servoloop callback" << std::endl;
+        delete pProfiler;
         hdDisableDevice(hHD);
         return -1;
     }
@@ -179,6 +150,7 @@ int main(int argc, char* argv[])
     {
         std::cerr << error << std::endl;
         std::cerr << "Failed to set servoloop rate" << std::endl;
+        delete pProfiler;
         hdDisableDevice(hHD);
         return -1;        
     }
@@ -191,6 +163,7 @@ int main(int argc, char* argv[])
     {
         std::cerr << error << std::endl;
         std::cerr << "Failed to start servoloop" << std::endl;        
+        delete pProfiler;
         hdDisableDevice(hHD);
         return -1;        
     }
@@ -207,10 +180,9 @@ int main(int argc, char* argv[])
         /* Print the average update DutyCycle every second. */
         Sleep(1000);
 
-        hdScheduleSynchronous(CopyDutyCycleStats, 0, HD_MIN_SCHEDULER_PRIORITY);
-
-        PrintDutyCycleStats(std::cout);
-        PrintDutyCycleStats(fout);
+        PrintDutyCycleStats(std::cout, *pProfiler);
+        PrintDutyCycleStats(fout, *pProfiler);
+        pProfiler->reset();
 
         if (!hdWaitForCompletion(hServoCallback, HD_WAIT_CHECK_STATUS))
         {
@@ -222,7 +194,7 @@ int main(int argc, char* argv[])
     }
 
     hdStopScheduler();
-    hdUnschedule(hServoCallback);
+    delete pProfiler;
     hdDisableDevice(hHD);
 
     return 0;
@@ -16,7 +16,7 @@ Module Name:
 Description: 
 
   This application serves as a unit test for collecting statistics on the
-  update intervals of the device.
+  update intervals of the device, using hduServoProfiler.
 
 *******************************************************************************/
 #ifdef  _WIN64
@@ -39,35 +39,44 @@ Description:
 #include <HD/hd.h>
 #include <HDU/hduError.h>
 
-#include "StatsSampler.h"
+#include <HDU/hduServoProfiler.h>
 
 #define TARGET_SERVOLOOP_RATE   1000
 
-StatsSamplerd gUpdateRateServo;
-StatsSamplerd gUpdateRateApp;
-
 /******************************************************************************
- Prints the update rate statistics to the specified output stream
+ Prints the update rate statistics collected by the profiler since the last
+ call to the output stream provided.  The profiler keeps the intervals
+ between ticks; the rate at the median interval is the typical rate, and
+ the rate at the longest interval the lowest one.
 ******************************************************************************/
-void PrintUpdateRateStats(std::ostream &os)
+void PrintUpdateRateStats(std::ostream &os, const hduServoProfiler &profiler)
 {
-    os << "Rate: " << gUpdateRateApp << std::endl;
+    hduServoProfileStats stats;
+    profiler.getPhaseStats(hduServoProfiler::PHASE_INTERVAL, stats);
+
+    os << "Interval: "
+       << "n " << stats.nSamples << " "
+       << "p50 " << 1000 * stats.p50 << " "
+       << "p99 " << 1000 * stats.p99 << " "
+       << "p99.9 " << 1000 * stats.p999 << " "
+       << "max " << 1000 * stats.max << std::endl;
+
+    if (stats.nSamples > 0)
+    {
+        os << "Rate: median " << 1 / stats.p50 << " "
+           << "min " << 1 / stats.max << std::endl;
+    }
 }
 
 /******************************************************************************
- The main servo loop scheduler callback.  Samples the haptic frame rate.
+ The main servo loop scheduler callback.  The profiler samples the rate
+ around it; this only checks for errors.
 ******************************************************************************/
 HDCallbackCode HDCALLBACK ServoSchedulerCallback(void *pUserData)
 {
     hdBeginFrame(hdGetCurrentDevice());    
-
-    HDdouble rate;
-    hdGetDoublev(HD_INSTANTANEOUS_UPDATE_RATE, &rate);
-
     hdEndFrame(hdGetCurrentDevice());
 
-    gUpdateRateServo.sample(rate);
-
     HDErrorInfo error;
     if (HD_DEVICE_ERROR(error = hdGetError()))
     {
@@ -83,19 +92,6 @@ HDCallbackCode HDCALLBACK ServoSchedulerCallback(void *pUserData)
     return HD_CALLBACK_CONTINUE;
 }
 
-/******************************************************************************
- Use this callback synchronously.  Makes a thread-safe copy of the servo
- loop rate statistics.
-******************************************************************************/
-HDCallbackCode HDCALLBACK CopyUpdateRateStats(void *pUserData)
-{
-    gUpdateRateApp = gUpdateRateServo;
-
-    gUpdateRateServo.clear();
-
-    return HD_CALLBACK_DONE;    
-}
-
 /******************************************************************************
  Collects statistics about the update rate of the haptic device.
 ******************************************************************************/
@@ -114,12 +110,15 @@ int main(int argc, char* argv[])
     HDstring model = hdGetString(HD_DEVICE_MODEL_TYPE);
     std::cout << "Initialized: " << model << std::endl;
 
-    HDSchedulerHandle hServoCallback = hdScheduleAsynchronous(
-        ServoSchedulerCallback, 0, HD_MAX_SCHEDULER_PRIORITY);
+    hduServoProfiler *pProfiler = new hduServoProfiler;
+
+    HDSchedulerHandle hServoCallback = pProfiler->scheduleAsynchronous(
+        ServoSchedulerCallback, 0, HD_DEFAULT_SCHEDULER_PRIORITY, "Servo");
     if (HD_DEVICE_ERROR(error = hdGetError()))
     {
         std::cerr << error << std::endl;
         std::cerr << "Failed to schedule servoloop callback" << std::endl;
+        delete pProfiler;
         hdDisableDevice(hHD);
         return -1;
     }
@@ -129,6 +128,7 @@ int main(int argc, char* argv[])
     {
         std::cerr << error << std::endl;
         std::cerr << "Failed to set servoloop rate" << std::endl;
+        delete pProfiler;
         hdDisableDevice(hHD);
         return -1;        
     }
@@ -140,11 +140,13 @@ int main(int argc, char* argv[])
     {
         std::cerr << error << std::endl;
         std::cerr << "Failed to start servoloop" << std::endl;
+        delete pProfiler;
         hdDisableDevice(hHD);
         return -1;        
     }
 
-    std::cout << "Printing servoloop rate stats. All numbers are in Hz units" << std::endl;
+    std::cout << "Printing servoloop rate stats. Intervals are in ms units, "
+              << "rates in Hz units" << std::endl;
     std::cout << std::endl;
         
     char fileName[256];
@@ -155,11 +157,10 @@ int main(int argc, char* argv[])
     {
         Sleep(1000);
 
-        hdScheduleSynchronous(CopyUpdateRateStats, 0, HD_MIN_SCHEDULER_PRIORITY);
-
         // Prints some stats about the rate as well as log it to file.
-        PrintUpdateRateStats(std::cout);
-        PrintUpdateRateStats(fout);
+        PrintUpdateRateStats(std::cout, *pProfiler);
+        PrintUpdateRateStats(fout, *pProfiler);
+        pProfiler->reset();
 
         if (!hdWaitForCompletion(hServoCallback, HD_WAIT_CHECK_STATUS))
         {
@@ -171,7 +172,7 @@ int main(int argc, char* argv[])
     }
 
     hdStopScheduler();
-    hdUnschedule(hServoCallback);
+    delete pProfiler;
     hdDisableDevice(hHD);
 
     return 0;
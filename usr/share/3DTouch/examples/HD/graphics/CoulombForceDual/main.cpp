@@ -17,7 +17,8 @@ Description:
   a) show SDK usage with GLUT
   b) a Coulomb force field: one static elec charge, the other elec charge's
          position is changed as haptic cursor
-  c) show dual Phantom usage
+  c) show dual Phantom usage, with every device serviced by one
+         hduDeviceGroup
 
 *******************************************************************************/
 
@@ -29,6 +30,7 @@ Description:
 #include <HD/hd.h>
 #include <HDU/hduError.h>
 #include <HDU/hduVector.h>
+#include <HDU/hduDeviceGroup.h>
 
 using namespace std;
 
@@ -48,17 +50,23 @@ using namespace std;
 
 #include "helper.h"
 
-/* The names of the two haptic devices. */
-#define DEVICE_NAME_1  "PHANToM 1"
-#define DEVICE_NAME_2  "PHANToM 2"
+/* The haptic devices used when none are named on the command line.  Each
+   device holds a charge. */
+static const char *kDefaultDeviceNames[] = { "PHANToM 1", "PHANToM 2" };
+static const int kNumDefaultDevices =
+    sizeof(kDefaultDeviceNames) / sizeof(kDefaultDeviceNames[0]);
 
 static double sphereRadius = 12.0;
 
 /* Charge (positive/negative) */
 int charge = 1;
 
-HHD phantomId_1, phantomId_2; // Dual Phantom devices.
-HDSchedulerHandle gSchedulerCallback = HD_INVALID_HANDLE;
+HHD phantomIds[hduDeviceGroup::kMaxDevices]; // Phantom devices.
+int numDevices = 0;
+
+/* Services every device in one scheduler callback and hands their state to
+   the graphics thread. */
+hduDeviceGroup gDeviceGroup;
 
 /* Glut callback functions used by helper.cpp */
 void displayFuntion(void);
@@ -67,29 +75,6 @@ void handleIdle(void );
 hduVector3Dd forceField(hduVector3Dd pos);
 
 HDErrorInfo lastError;
-/* Haptic device record. */
-struct DeviceDisplayStates
-{
-    HHD m_hHD;
-    hduVector3Dd position;
-    hduVector3Dd force;
-};
-
-
-/******************************************************************************
- Makes a device specified in the pUserData current.
- Queries haptic device state: position, force, etc. 
-******************************************************************************/
-HDCallbackCode HDCALLBACK DeviceStateCallback(void *pUserData)
-{
-    DeviceDisplayStates *pDisplayState = static_cast<DeviceDisplayStates *>(pUserData);
-
-    hdMakeCurrentDevice(pDisplayState->m_hHD);      
-    hdGetDoublev(HD_CURRENT_POSITION, pDisplayState->position);
-    hdGetDoublev(HD_CURRENT_FORCE, pDisplayState->force);
-
-    return HD_CALLBACK_DONE;
-}
 
 /******************************************************************************
  Graphics main loop function.
@@ -109,36 +94,32 @@ void displayFunction( void )
 
     GLUquadricObj* pQuadObj = gluNewQuadric();
 
-    // First sphere charge.  
-    // Get the current position of end effector 1.
-    DeviceDisplayStates state_1;
-    state_1.m_hHD = phantomId_1;
-
-    hdScheduleSynchronous(DeviceStateCallback, &state_1,
-                          HD_MIN_SCHEDULER_PRIORITY);
-
-    // Display one sphere to represent the haptic cursor and the 
-    // dynamic charge.
-    static const float firstSphereColor[4] = {.2, .8, .8, .8};
-    drawSphere(pQuadObj, state_1.position, firstSphereColor, sphereRadius);
-
-    // Second sphere elec charge.
-    // Get the current position of end effector 2.
-    DeviceDisplayStates state_2;
-    state_2.m_hHD = phantomId_2;
-    hdScheduleSynchronous(DeviceStateCallback, &state_2,
-                          HD_MIN_SCHEDULER_PRIORITY);
-
-    // Display one sphere to represent the haptic cursor and the dynamic 
-    // charge.
-    static const float secondSphereColor[4] = {.8, .2, .2, .8};
-    drawSphere(pQuadObj, state_2.position, secondSphereColor, sphereRadius);
-
-    hduVector3Dd forceVector = 400.0 * forceField(state_2.position-state_1.position);
+    // Get the latest state of all the end effectors, all from the same
+    // servo loop tick.  This never waits for the servo loop.
+    gDeviceGroup.update();
+    const hduDeviceGroup::Snapshot &snapshot = gDeviceGroup.getSnapshot();
+
+    // Display one sphere per device to represent the haptic cursor and
+    // the dynamic charge.
+    static const float sphereColors[2][4] = {
+        {.2, .8, .8, .8},
+        {.8, .2, .2, .8}
+    };
+    for (int i = 0; i < snapshot.nDevices; i++)
+    {
+        drawSphere(pQuadObj, snapshot.devices[i].position,
+                   sphereColors[i % 2], sphereRadius);
+    }
 
     glDisable( GL_COLOR_MATERIAL );
 
-    drawForceVector(pQuadObj, state_2.position, forceVector, sphereRadius*.1);
+    // Display the force each charge feels.
+    for (int i = 0; i < snapshot.nDevices; i++)
+    {
+        hduVector3Dd forceVector = 400.0 * snapshot.devices[i].force;
+        drawForceVector(pQuadObj, snapshot.devices[i].position, forceVector,
+                        sphereRadius*.1);
+    }
 
     gluDeleteQuadric(pQuadObj);
     glEnable(GL_LIGHTING);
@@ -154,8 +135,14 @@ void handleIdle()
 {
     glutPostRedisplay();
 
-    if (!hdWaitForCompletion(gSchedulerCallback, HD_WAIT_CHECK_STATUS))
+    if (!gDeviceGroup.isRunning())
     {
+        gDeviceGroup.update();
+        HDErrorInfo error = gDeviceGroup.getSnapshot().error;
+        if (HD_DEVICE_ERROR(error))
+        {
+            hduPrintError(stderr, &error, "Error during main scheduler callback");
+        }
         printf("The main scheduler callback has exited\n");
         printf("Press any key to quit.\n");
         getchar();
@@ -204,50 +191,25 @@ hduVector3Dd forceField(hduVector3Dd pos)
 }
 
 /******************************************************************************
- Main callback.  Retrieves position from both devices, calculates forces,
- and sets forces for both devices.
+ Force callback, called by the device group in the servo loop with the
+ position of every device.  Each pair of charges pushes the two apart, or
+ pulls them together, with equal and opposite forces.
 ******************************************************************************/
-HDCallbackCode HDCALLBACK DualCoulombCallback(void *data)
+void HDCALLBACK CoulombForceCallback(const hduDeviceGroup::Snapshot &snapshot,
+                                     hduVector3Dd *forces, void *pUserData)
 {
-    hduVector3Dd pos_1, pos_2;
-
-    hdBeginFrame(phantomId_1);
-    hdGetDoublev(HD_CURRENT_POSITION,pos_1);
-
-    hdBeginFrame(phantomId_2);
-    hdGetDoublev(HD_CURRENT_POSITION,pos_2);
-
-    hduVector3Dd pos_diff = pos_1 - pos_2;
-
-    hduVector3Dd forceVec = forceField(pos_diff);
-
-    hdMakeCurrentDevice(phantomId_1);
-    hdSetDoublev(HD_CURRENT_FORCE, forceVec);
-
-    // Flush forces on the first device.
-    hdEndFrame(phantomId_1);
-
-    // The second haptic device feels the opposing force.
-    forceVec = -1.0 * forceVec;
-
-    hdMakeCurrentDevice(phantomId_2);
-    hdSetDoublev(HD_CURRENT_FORCE, forceVec);
-    
-    // Flush forces on the second device.
-    hdEndFrame(phantomId_2);
-
-    HDErrorInfo error;
-    if (HD_DEVICE_ERROR(error = hdGetError()))
+    for (int i = 0; i < snapshot.nDevices; i++)
     {
-        hduPrintError(stderr, &error, "Error during scheduler callback");
-
-        if (hduIsSchedulerError(&error))
+        for (int j = i + 1; j < snapshot.nDevices; j++)
         {
-            return HD_CALLBACK_DONE;
+            hduVector3Dd pos_diff =
+                snapshot.devices[i].position - snapshot.devices[j].position;
+
+            hduVector3Dd forceVec = forceField(pos_diff);
+            forces[i] += forceVec;
+            forces[j] -= forceVec;
         }
     }
-
-    return HD_CALLBACK_CONTINUE;
 }
 
 /******************************************************************************
@@ -256,12 +218,11 @@ HDCallbackCode HDCALLBACK DualCoulombCallback(void *data)
 void DualCoulombForceField()
 {
     std::cout << "haptics callback" << std::endl;
-    gSchedulerCallback = hdScheduleAsynchronous(
-        DualCoulombCallback, 0, HD_DEFAULT_SCHEDULER_PRIORITY);
-
-    HDErrorInfo error;
-    if (HD_DEVICE_ERROR(error = hdGetError()))
+    gDeviceGroup.setForceCallback(CoulombForceCallback, 0);
+    if (!gDeviceGroup.start())
     {
+        gDeviceGroup.update();
+        HDErrorInfo error = gDeviceGroup.getSnapshot().error;
         hduPrintError(stderr, &error, "Failed to initialize haptic device");
         fprintf(stderr, "\nPress any key to quit.\n");
         getchar();
@@ -281,24 +242,25 @@ void exitHandler()
    
    if (!lastError.errorCode)
     {
+        gDeviceGroup.stop();
         hdStopScheduler();
-        hdUnschedule(gSchedulerCallback);
-    }
-
-    if (phantomId_1 != HD_INVALID_HANDLE)
-    {
-        hdDisableDevice(phantomId_1);
-        phantomId_1 = HD_INVALID_HANDLE;
     }
 
-    if (phantomId_2 != HD_INVALID_HANDLE)
+    for (int i = 0; i < numDevices; i++)
     {
-        hdDisableDevice(phantomId_2);
-        phantomId_2 = HD_INVALID_HANDLE;
+        if (phantomIds[i] != HD_INVALID_HANDLE)
+        {
+            hdDisableDevice(phantomIds[i]);
+            phantomIds[i] = HD_INVALID_HANDLE;
+        }
     }
 }
 /******************************************************************************
- Main entry point.
+ Main entry point.  Usage: CoulombForceDual [device name ...]
+
+ Each device named on the command line holds a charge.  With no names, the
+ default "PHANToM 1" and "PHANToM 2" configurations are used.  The names
+ are not passed on to GLUT.
 ******************************************************************************/
 int main(int argc, char* argv[])
 {
@@ -308,38 +270,46 @@ int main(int argc, char* argv[])
                                                                                    
     atexit(exitHandler);
 
-    // Initialize both devices.  These needs to be called before any actions 
-    // on the devices.
-
-    // First device.
-    phantomId_1 = hdInitDevice(DEVICE_NAME_1);
-    if (HD_DEVICE_ERROR(lastError = hdGetError()))
+    const char **deviceNames = kDefaultDeviceNames;
+    numDevices = kNumDefaultDevices;
+    if (argc > 1)
     {
-        hduPrintError(stderr, &error, "Failed to initialize first haptic device");
-        fprintf(stderr, "Make sure the configuration \"%s\" exists\n", DEVICE_NAME_1);
-        fprintf(stderr, "\nPress any key to quit.\n");
-        getch();
+        deviceNames = (const char **) &argv[1];
+        numDevices = argc - 1;
+    }
+    if (numDevices > hduDeviceGroup::kMaxDevices)
+    {
+        fprintf(stderr, "At most %d devices are supported\n",
+                hduDeviceGroup::kMaxDevices);
+        numDevices = 0;
         exit(-1);
     }
 
-    printf("1. Found device %s\n",hdGetString(HD_DEVICE_MODEL_TYPE));
-    hdEnable(HD_FORCE_OUTPUT);
-    hdEnable(HD_FORCE_RAMPING);
-
-    // Second device.
-    phantomId_2 = hdInitDevice(DEVICE_NAME_2);
-    if (HD_DEVICE_ERROR(lastError = hdGetError()))
+    // Initialize all devices.  These needs to be called before any actions 
+    // on the devices.
+    for (int i = 0; i < numDevices; i++)
     {
-        hduPrintError(stderr, &error, "Failed to initialize second haptic device");
-        fprintf(stderr, "Make sure the configuration \"%s\" exists\n", DEVICE_NAME_2);
-        fprintf(stderr, "\nPress any key to quit.\n");
-        getch();
-        exit(-1);
+        phantomIds[i] = HD_INVALID_HANDLE;
     }
 
-    printf("2. Found device %s\n",hdGetString(HD_DEVICE_MODEL_TYPE));
-    hdEnable(HD_FORCE_OUTPUT);
-    hdEnable(HD_FORCE_RAMPING);
+    for (int i = 0; i < numDevices; i++)
+    {
+        phantomIds[i] = hdInitDevice(deviceNames[i]);
+        if (HD_DEVICE_ERROR(lastError = hdGetError()))
+        {
+            hduPrintError(stderr, &lastError, "Failed to initialize haptic device");
+            fprintf(stderr, "Make sure the configuration \"%s\" exists\n", deviceNames[i]);
+            fprintf(stderr, "\nPress any key to quit.\n");
+            getch();
+            exit(-1);
+        }
+
+        printf("%d. Found device %s\n", i + 1, hdGetString(HD_DEVICE_MODEL_TYPE));
+        hdEnable(HD_FORCE_OUTPUT);
+        hdEnable(HD_FORCE_RAMPING);
+
+        gDeviceGroup.addDevice(phantomIds[i]);
+    }
 
     hdStartScheduler();
     if (HD_DEVICE_ERROR(error = hdGetError()))
@@ -351,7 +321,7 @@ int main(int argc, char* argv[])
     }
 
     // Initialize GLUT.
-    initGlut( argc, argv );         
+    initGlut( 1, argv );         
 
     // Get the workspace dimensions.
     HDdouble maxWorkspace[6];
@@ -363,7 +333,7 @@ int main(int argc, char* argv[])
     hduVector3Dd TRF(maxWorkspace[3], maxWorkspace[4], maxWorkspace[5]);
     initGraphics(LLB, TRF);
 
-    hdMakeCurrentDevice(phantomId_1);
+    hdMakeCurrentDevice(phantomIds[0]);
 
     // Application loop.
     DualCoulombForceField();
@@ -30,6 +30,9 @@ Description:
 #include "PlaneWithAxesConstraint.h"
 
 #include <cassert>
+#include <cfloat>
+#include <cmath>
+#include <vector>
 #include <algorithm>
 
 #include <HDU/hdu.h>
@@ -37,11 +40,13 @@ Description:
 #include <HDU/hduMath.h>
 #include <HDU/hduMatrix.h>
 #include <HDU/hduHapticDevice.h>
+#include <HDU/hduTransformInterpolator.h>
 
 #include <SnapConstraints/ISnapConstraintsAPI.h>
 #include <SnapConstraints/SnapConstraint.h>
 #include <SnapConstraints/PlaneConstraint.h>
 #include <SnapConstraints/StickToConstraint.h>
+#include <SnapConstraints/SnapIndex.h>
 
 #define CURSOR_SIZE_PIXELS  15
 
@@ -55,6 +60,45 @@ using namespace SnapConstraints;
 namespace
 {
 
+/*******************************************************************************
+ ViewApparentQuery
+
+ Searches the snap index for the point whose view apparent constraint is
+ closest to the device. The index holds points in world coordinates, while
+ the view apparent constraint is tested in local device coordinates, so
+ box distances are measured in world coordinates and converted to a lower
+ bound in device units.
+*******************************************************************************/
+class ViewApparentQuery : public SnapIndex::Query
+{
+public:
+    ViewApparentQuery(ViewApparentPointConstraint *pConstraint,
+                      const hduMatrix &parentTworld,
+                      const hduVector3Dd &devicePositionLC,
+                      const hduVector3Dd &cameraPosWC,
+                      int nExcludePoint);
+
+    virtual double getBoundsDistance(const hduVector3Dd &boundsMin,
+                                     const hduVector3Dd &boundsMax) const;
+
+    virtual double testConstraint(const SnapConstraint *pConstraint,
+                                  hduVector3Dd &proxyPt) const;
+
+private:
+    ViewApparentPointConstraint *m_pConstraint;
+    hduMatrix m_worldTparent;
+    hduVector3Dd m_devicePositionLC;
+    hduVector3Dd m_cameraPosWC;
+
+    /* Vector from the camera to the device in world coordinates. */
+    hduVector3Dd m_cameraToDeviceWC;
+
+    /* Upper bound on how much parentTworld stretches a vector. */
+    double m_maxScale;
+
+    int m_nExcludePoint;
+};
+
 /*******************************************************************************
  HapticDeviceManager
  
@@ -97,7 +141,6 @@ private:
     static HDCallbackCode HDCALLBACK endUpdateCallback(void *pUserData);
     static HDCallbackCode HDCALLBACK springManipulationCallback(void *pUserData);
     static HDCallbackCode HDCALLBACK frictionManipulationCallback(void *pUserData);    
-    static HDCallbackCode HDCALLBACK setDeviceTransformCallback(void *pUserData);
     static HDCallbackCode HDCALLBACK setConstraintCallback(void *pUserData);
     static HDCallbackCode HDCALLBACK clearConstraintCallback(void *pUserData);
 
@@ -147,9 +190,17 @@ private:
     ISnapConstraintsAPI *m_pSnapAPI;
     ViewApparentPointConstraint *m_pConstraint;
 
+    /* One point constraint per point in world coordinates, kept in a
+       spatial index for finding snap candidates. */
+    SnapIndex *m_pSnapIndex;
+    std::vector<PointConstraint> m_pointConstraints;
+
     hduVector3Dd m_effectForce;
 
+    /* The workspace transform is computed each frame in the graphics thread
+       and sampled each tick by the haptics thread, which owns the offset. */
     hduMatrix m_workspaceXform;
+    hduTransformInterpolator m_workspaceInterpolator;
     hduMatrix m_offsetXform;
 
     HDdouble m_cursorScale;
@@ -195,6 +246,7 @@ HapticDeviceManager::HapticDeviceManager() :
     m_nManipPoint(-1),
     m_pSnapAPI(0),
     m_pConstraint(0),
+    m_pSnapIndex(0),
     m_nCursorDisplayList(0)
 {
 }
@@ -256,6 +308,22 @@ void HapticDeviceManager::setup(IPointManager *pPointManager)
 
     m_pPointManager = pPointManager;
 
+    /* Index the points so that updateSnapping only needs to test the
+       points near the view ray through the device. The point constraints
+       carry their point index as user data. */
+    int nPoints = m_pPointManager->getNumPoints();
+    m_pointConstraints.resize(nPoints);
+    m_pSnapIndex = SnapIndex::create();
+    for (int i = 0; i < nPoints; i++)
+    {
+        PointConstraint &pointConstraint = m_pointConstraints[i];
+        pointConstraint.setPoint(m_pPointManager->getPointPosition(i));
+        pointConstraint.setAutoDelete(false);
+        pointConstraint.setSnapDistance(m_pConstraint->getSnapDistance());
+        pointConstraint.setUserData((void *) (long) i);
+        m_pSnapIndex->addConstraint(&pointConstraint);
+    }
+
     hdEnable(HD_FORCE_OUTPUT);
 
     m_hBeginUpdateCallback = hdScheduleAsynchronous(
@@ -307,6 +375,9 @@ void HapticDeviceManager::cleanup()
     ISnapConstraintsAPI::destroy(m_pSnapAPI);
     delete m_pConstraint;
 
+    SnapIndex::destroy(m_pSnapIndex);
+    m_pointConstraints.clear();
+
     glDeleteLists(m_nCursorDisplayList, 1);
 }
 
@@ -358,36 +429,14 @@ void HapticDeviceManager::updateSnapping()
     worldTparent.multVecMatrix(m_cameraPosWC, cameraPosLC);
     pLineConstraint->setStartPoint(cameraPosLC);
 
-    double minDist = m_pConstraint->getSnapDistance();
-    int nClosestPoint = -1;    
-
-    /* Search for the constraint that is closest to the device position. */
-    int nPoints = m_pPointManager->getNumPoints();
-    for (int i = 0; i < nPoints; i++)
-    {
-        /* Don't attempt to snap to the manipulated point. */
-        if (i == m_nManipPoint)
-            continue;
-
-        hduVector3Dd proxyPositionLC;        
-        double dist;
-
-        /* Compute position of the test point in device coordinates. */
-        hduVector3Dd pointPositionWC = m_pPointManager->getPointPosition(i);
-        hduVector3Dd pointPositionLC;
-        worldTparent.multVecMatrix(pointPositionWC, pointPositionLC);
-
-        pPointConstraint->setPoint(pointPositionLC);
-        pLineConstraint->setEndPoint(pointPositionLC);
-        
-        dist = m_pConstraint->testConstraint(devicePositionLC, proxyPositionLC);
-        
-        if (dist < minDist)
-        {
-            minDist = dist;
-            nClosestPoint = i;
-        }
-    }
+    /* Search for the constraint that is closest to the device position. 
+       Don't attempt to snap to the manipulated point. */
+    ViewApparentQuery query(m_pConstraint, parentTworld, devicePositionLC,
+                            m_cameraPosWC, m_nManipPoint);
+    hduVector3Dd proxyPositionLC;
+    SnapConstraint *pClosest = m_pSnapIndex->findClosestConstraint(
+        query, proxyPositionLC);
+    int nClosestPoint = pClosest ? (int) (long) pClosest->getUserData() : -1;
 
     /* Finally set the constraint based on the closest point. */
     if (nClosestPoint >= 0)
@@ -440,8 +489,9 @@ void HapticDeviceManager::updateWorkspace()
     hduMatrix eyeTworld = worldTeye.getInverse();
     eyeTworld.multVecMatrix(hduVector3Dd(0, 0, 0), m_cameraPosWC);
 
-    hdScheduleSynchronous(setDeviceTransformCallback, this,
-                          SYNCHRONIZE_STATE_PRIORITY);    
+    /* Hand the transform to the haptics thread without waiting for it, which
+       follows it smoothly between frames instead of in steps. */
+    m_workspaceInterpolator.push(m_workspaceXform);
 }
 
 /*******************************************************************************
@@ -546,9 +596,98 @@ void HapticDeviceManager::updateManipulation()
         }
 
         m_pPointManager->setPointPosition(m_nManipPoint, pointPositionWC);
+
+        PointConstraint &pointConstraint = m_pointConstraints[m_nManipPoint];
+        pointConstraint.setPoint(pointPositionWC);
+        m_pSnapIndex->moveConstraint(&pointConstraint);
     }
 }
 
+/*******************************************************************************
+ ViewApparentQuery Constructor
+*******************************************************************************/
+ViewApparentQuery::ViewApparentQuery(ViewApparentPointConstraint *pConstraint,
+                                     const hduMatrix &parentTworld,
+                                     const hduVector3Dd &devicePositionLC,
+                                     const hduVector3Dd &cameraPosWC,
+                                     int nExcludePoint) :
+    m_pConstraint(pConstraint),
+    m_worldTparent(parentTworld.getInverse()),
+    m_devicePositionLC(devicePositionLC),
+    m_cameraPosWC(cameraPosWC),
+    m_nExcludePoint(nExcludePoint)
+{
+    hduVector3Dd devicePositionWC;
+    parentTworld.multVecMatrix(devicePositionLC, devicePositionWC);
+    m_cameraToDeviceWC = devicePositionWC - cameraPosWC;
+
+    /* The Frobenius norm of the linear part bounds the largest stretch. */
+    double sumSqr = 0;
+    for (int i = 0; i < 3; i++)
+    {
+        for (int j = 0; j < 3; j++)
+        {
+            sumSqr += parentTworld(i, j) * parentTworld(i, j);
+        }
+    }
+    m_maxScale = sqrt(sumSqr);
+}
+
+/*******************************************************************************
+ The view apparent constraint is never closer to the device than the line
+ from the camera through the point. For a box, bound the points by a sphere
+ and find the smallest angle between the camera to device vector and any
+ line from the camera through the sphere.
+*******************************************************************************/
+double ViewApparentQuery::getBoundsDistance(const hduVector3Dd &boundsMin,
+                                            const hduVector3Dd &boundsMax) const
+{
+    hduVector3Dd center = 0.5 * (boundsMin + boundsMax);
+    double radius = 0.5 * (boundsMax - boundsMin).magnitude();
+
+    hduVector3Dd cameraToCenter = center - m_cameraPosWC;
+    double centerDist = cameraToCenter.magnitude();
+    double deviceDist = m_cameraToDeviceWC.magnitude();
+    if (centerDist <= radius || deviceDist == 0)
+    {
+        return 0;
+    }
+
+    /* Lines are unsigned, so the angle between them is at most 90 degrees. */
+    double cosAngle = fabs(dotProduct(cameraToCenter, m_cameraToDeviceWC)) /
+        (centerDist * deviceDist);
+    double angle = acos(hduMin(1.0, cosAngle)) - asin(radius / centerDist);
+    if (angle <= 0)
+    {
+        return 0;
+    }
+
+    return deviceDist * sin(angle) / m_maxScale;
+}
+
+/*******************************************************************************
+ Tests the view apparent constraint for one point in device coordinates.
+*******************************************************************************/
+double ViewApparentQuery::testConstraint(const SnapConstraint *pConstraint,
+                                         hduVector3Dd &proxyPt) const
+{
+    const PointConstraint *pPointConstraint = 
+        static_cast<const PointConstraint *>(pConstraint);
+    if ((int) (long) pPointConstraint->getUserData() == m_nExcludePoint)
+    {
+        return DBL_MAX;
+    }
+
+    /* Compute position of the test point in device coordinates. */
+    hduVector3Dd pointPositionLC;
+    m_worldTparent.multVecMatrix(pPointConstraint->getPoint(), pointPositionLC);
+
+    m_pConstraint->getPointConstraint()->setPoint(pointPositionLC);
+    m_pConstraint->getLineConstraint()->setEndPoint(pointPositionLC);
+
+    return m_pConstraint->testConstraint(m_devicePositionLC, proxyPt);
+}
+
 /*******************************************************************************
  Scheduler Callbacks
 
@@ -572,6 +711,16 @@ HDCallbackCode HDCALLBACK HapticDeviceManager::beginUpdateCallback(
     IHapticDevice::IHapticDeviceState *pLastState = 
         pThis->m_pHapticDeviceHT->getLastState();
 
+    /* Set the workspace transform for this tick, which the graphics thread
+       picks up with the rest of the state. */
+    hduMatrix workspaceXform;
+    if (pThis->m_workspaceInterpolator.sample(workspaceXform))
+    {
+        hduMatrix parentTworld(pThis->m_offsetXform);
+        parentTworld.multRight(workspaceXform);
+        pCurrentState->setParentCumulativeTransform(parentTworld);
+    }
+
     /* Get the position of the device. */
     hduVector3Dd devicePositionLC = pCurrentState->getPosition();
     
@@ -713,29 +862,6 @@ HDCallbackCode HDCALLBACK HapticDeviceManager::frictionManipulationCallback(
     return HD_CALLBACK_CONTINUE;
 }
 
-/******************************************************************************
- Scheduler callback to set the workspace transform both for use in the graphics
- thread and haptics thread.
-******************************************************************************/
-HDCallbackCode HDCALLBACK HapticDeviceManager::setDeviceTransformCallback(
-    void *pUserData)
-{
-    HapticDeviceManager *pThis = static_cast<HapticDeviceManager *>(pUserData);
-
-    IHapticDevice::IHapticDeviceState *pStateGT = 
-        pThis->m_pHapticDeviceGT->getCurrentState();
-    IHapticDevice::IHapticDeviceState *pStateHT = 
-        pThis->m_pHapticDeviceHT->getCurrentState();
-
-    hduMatrix parentTworld(pThis->m_offsetXform);    
-    parentTworld.multRight(pThis->m_workspaceXform);
-
-    pStateGT->setParentCumulativeTransform(parentTworld);
-    pStateHT->setParentCumulativeTransform(parentTworld);
-
-    return HD_CALLBACK_DONE;
-}
-
 /******************************************************************************
  Scheduler callback to set the current constraint
 ******************************************************************************/
@@ -870,8 +996,6 @@ void HapticDeviceManager::buttonDownCallbackHT(
         
         pThis->m_offsetXform = hduMatrix::createTranslation(
             snapPointLC - pState->getPosition());
-        hdScheduleSynchronous(setDeviceTransformCallback, pThis,
-                              SYNCHRONIZE_STATE_PRIORITY);    
         
         /* Clear the current constraint and allow for free manipulation. */
         pThis->m_pSnapAPI->clearConstraint();
@@ -923,8 +1047,6 @@ void HapticDeviceManager::buttonUpCallbackHT(
 
     /* Remove the offset transform */
     pThis->m_offsetXform.makeIdentity();
-    hdScheduleSynchronous(setDeviceTransformCallback, pThis,
-                          SYNCHRONIZE_STATE_PRIORITY);
 
     /* Set an anti-constraint at the current constraint device location
        This will ensure that the device isn't immediately snapped to something
@@ -18,6 +18,7 @@ coordinate generation (spheremap and planar projections) + more.
 #include <stdlib.h>
 #include <string.h>
 #include <assert.h>
+#include <limits.h>
 #include "GLM.h"
 
 #if defined(WIN32)
@@ -29,16 +30,16 @@ coordinate generation (spheremap and planar projections) + more.
 #define _getch getch
 #endif
 
-
-#define T(x) (model->triangles[(x)])
+#if defined(linux) || defined(__APPLE__)
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#define GLM_MMAP
+#endif
 
 
-/* _GLMnode: general purpose node */
-typedef struct _GLMnode {
-    GLuint index;
-    GLboolean averaged;
-    struct _GLMnode* next;
-} GLMnode;
+#define T(x) (model->triangles[(x)])
 
 
 /* glmMax: returns the maximum of two floats */
@@ -124,6 +125,43 @@ glmEqual(GLfloat* u, GLfloat* v, GLfloat epsilon)
     return GL_FALSE;
 }
 
+/* glmFree: free an array of a model, unless it lives in the cache file
+ * the model was mapped from
+ */
+static GLvoid
+glmFree(GLMmodel* model, GLvoid* p)
+{
+    char* begin = (char*)model->mapping;
+    
+    if (begin && (char*)p >= begin && (char*)p < begin + model->mappingsize)
+        return;
+    free(p);
+}
+
+/* glmWeldCell: the cell of the welding grid a coordinate falls in.
+ * Coordinates too far out for a cell number share the outermost cell,
+ * which leaves room for the neighbouring cells even where long is 32 bits.
+ */
+static long
+glmWeldCell(GLfloat x, double cellsize)
+{
+    double cell = floor(x / cellsize);
+    
+    if (cell > LONG_MAX / 2)
+        return LONG_MAX / 2;
+    if (cell < -(LONG_MAX / 2))
+        return -(LONG_MAX / 2);
+    return (long)cell;
+}
+
+/* glmWeldBucket: the bucket of the welding hash table for a cell */
+static GLuint
+glmWeldBucket(long cx, long cy, long cz, GLuint mask)
+{
+    return ((GLuint)cx * 73856093u ^ (GLuint)cy * 19349663u ^
+        (GLuint)cz * 83492791u) & mask;
+}
+
 /* glmWeldVectors: eliminate (weld) vectors that are within an
  * epsilon of each other.
  *
@@ -131,38 +169,86 @@ glmEqual(GLfloat* u, GLfloat* v, GLfloat epsilon)
  * numvectors - number of GLfloat[3]'s in vectors
  * epsilon     - maximum difference between vectors 
  *
+ * The copies kept so far are hashed by a grid of cells a little over
+ * epsilon on a side, so a vector only has to be compared with the
+ * copies in its own and the 26 neighboring cells.  Of those that
+ * match, the one copied first is used, as a search through every copy
+ * would.
  */
 GLfloat*
 glmWeldVectors(GLfloat* vectors, GLuint* numvectors, GLfloat epsilon)
 {
     GLfloat* copies;
     GLuint copied;
-    GLuint i, j;
+    GLuint i, j, k;
+    GLuint* buckets;
+    GLuint* next;
+    GLuint numbuckets, bucket;
+    double cellsize;
+    long cx = 0, cy = 0, cz = 0;
+    int dx, dy, dz;
     
     copies = (GLfloat*)malloc(sizeof(GLfloat) * 3 * (*numvectors + 1));
     memcpy(copies, vectors, (sizeof(GLfloat) * 3 * (*numvectors + 1)));
     
+    /* the slack covers rounding in glmEqual, so that vectors it finds
+    equal are never more than a cell apart */
+    cellsize = epsilon * 1.01;
+    
+    /* buckets and next hold copy indices; 0 ends a chain */
+    numbuckets = 16;
+    while (numbuckets < 2 * *numvectors)
+        numbuckets *= 2;
+    buckets = (GLuint*)calloc(numbuckets + *numvectors + 1, sizeof(GLuint));
+    next = buckets + numbuckets;
+    
     copied = 1;
     for (i = 1; i <= *numvectors; i++) {
-        for (j = 1; j <= copied; j++) {
-            if (glmEqual(&vectors[3 * i], &copies[3 * j], epsilon)) {
-                goto duplicate;
+        j = 0;
+        if (epsilon > 0) {
+            cx = glmWeldCell(vectors[3 * i + 0], cellsize);
+            cy = glmWeldCell(vectors[3 * i + 1], cellsize);
+            cz = glmWeldCell(vectors[3 * i + 2], cellsize);
+            
+            for (dx = -1; dx <= 1; dx++) {
+                for (dy = -1; dy <= 1; dy++) {
+                    for (dz = -1; dz <= 1; dz++) {
+                        bucket = glmWeldBucket(cx + dx, cy + dy, cz + dz,
+                            numbuckets - 1);
+                        for (k = buckets[bucket]; k; k = next[k]) {
+                            if ((j == 0 || k < j) &&
+                                glmEqual(&vectors[3 * i], &copies[3 * k],
+                                epsilon)) {
+                                j = k;
+                            }
+                        }
+                    }
+                }
             }
         }
         
-        /* must not be any duplicates -- add to the copies array */
-        copies[3 * copied + 0] = vectors[3 * i + 0];
-        copies[3 * copied + 1] = vectors[3 * i + 1];
-        copies[3 * copied + 2] = vectors[3 * i + 2];
-        j = copied;             /* pass this along for below */
-        copied++;
+        if (j == 0) {
+            /* must not be any duplicates -- add to the copies array */
+            copies[3 * copied + 0] = vectors[3 * i + 0];
+            copies[3 * copied + 1] = vectors[3 * i + 1];
+            copies[3 * copied + 2] = vectors[3 * i + 2];
+            j = copied;
+            copied++;
+            
+            if (epsilon > 0) {
+                bucket = glmWeldBucket(cx, cy, cz, numbuckets - 1);
+                next[j] = buckets[bucket];
+                buckets[bucket] = j;
+            }
+        }
         
-duplicate:
         /* set the first component of this vector to point at the correct
         index into the new copies array */
         vectors[3 * i + 0] = (GLfloat)j;
     }
     
+    free(buckets);
+    
     *numvectors = copied-1;
     return copies;
 }
@@ -960,7 +1046,7 @@ glmFacetNormals(GLMmodel* model)
     
     /* clobber any old facetnormals */
     if (model->facetnorms)
-        free(model->facetnorms);
+        glmFree(model, model->facetnorms);
     
     /* allocate memory for the new facet normals */
     model->numfacetnorms = model->numtriangles;
@@ -1008,14 +1094,14 @@ glmFacetNormals(GLMmodel* model)
 GLvoid
 glmVertexNormals(GLMmodel* model, GLfloat angle)
 {
-    GLMnode* node;
-    GLMnode* tail;
-    GLMnode** members;
-    GLfloat* normals;
+    GLuint* start;
+    GLuint* members;
+    GLboolean* averaged;
+    void* arena;
     GLuint numnormals;
     GLfloat average[3];
     GLfloat dot, cos_angle;
-    GLuint i, avg;
+    GLuint i, j, k, v, avg, first;
     
     assert(model);
     assert(model->facetnorms);
@@ -1025,63 +1111,77 @@ glmVertexNormals(GLMmodel* model, GLfloat angle)
     
     /* nuke any previous normals */
     if (model->normals)
-        free(model->normals);
+        glmFree(model, model->normals);
     
     /* allocate space for new normals */
     model->numnormals = model->numtriangles * 3; /* 3 normals per triangle */
     model->normals = (GLfloat*)malloc(sizeof(GLfloat)* 3* (model->numnormals+1));
     
-    /* allocate a structure that will hold a linked list of triangle
-    indices for each vertex */
-    members = (GLMnode**)malloc(sizeof(GLMnode*) * (model->numvertices + 1));
-    for (i = 1; i <= model->numvertices; i++)
-        members[i] = NULL;
-    
-    /* for every triangle, create a node for each vertex in it */
+    /* the triangles each vertex is in, packed one vertex after another:
+    those of vertex i are members[start[i]] to members[start[i+1]-1].
+    One allocation holds the offsets, the triangle indices and a flag for
+    every entry, whether its facet normal went into the average. */
+    arena = malloc(sizeof(GLuint) * (model->numvertices + 2) +
+        sizeof(GLuint) * 3 * model->numtriangles +
+        sizeof(GLboolean) * 3 * model->numtriangles);
+    start = (GLuint*)arena;
+    members = start + model->numvertices + 2;
+    averaged = (GLboolean*)(members + 3 * model->numtriangles);
+    
+    /* count the triangles of each vertex, then turn the counts into
+    offsets; start[i+1] is where the next triangle of vertex i goes */
+    memset(start, 0, sizeof(GLuint) * (model->numvertices + 2));
     for (i = 0; i < model->numtriangles; i++) {
-        node = (GLMnode*)malloc(sizeof(GLMnode));
-        node->index = i;
-        node->next  = members[T(i).vindices[0]];
-        members[T(i).vindices[0]] = node;
-        
-        node = (GLMnode*)malloc(sizeof(GLMnode));
-        node->index = i;
-        node->next  = members[T(i).vindices[1]];
-        members[T(i).vindices[1]] = node;
-        
-        node = (GLMnode*)malloc(sizeof(GLMnode));
-        node->index = i;
-        node->next  = members[T(i).vindices[2]];
-        members[T(i).vindices[2]] = node;
+        start[T(i).vindices[0] + 1]++;
+        start[T(i).vindices[1] + 1]++;
+        start[T(i).vindices[2] + 1]++;
     }
+    for (i = 1; i <= model->numvertices + 1; i++)
+        start[i] += start[i - 1];
+    
+    /* latest triangle first, as the lists this replaced had them; the
+    first triangle of a vertex decides which of the others are averaged
+    with it */
+    for (i = model->numtriangles; i-- > 0; ) {
+        members[start[T(i).vindices[0]]++] = i;
+        members[start[T(i).vindices[1]]++] = i;
+        members[start[T(i).vindices[2]]++] = i;
+    }
+    
+    /* filling moved every offset up to the next vertex's; move them back */
+    for (i = model->numvertices + 1; i > 0; i--)
+        start[i] = start[i - 1];
+    start[0] = 0;
     
     /* calculate the average normal for each vertex */
     numnormals = 1;
     for (i = 1; i <= model->numvertices; i++) {
     /* calculate an average normal for this vertex by averaging the
         facet normal of every triangle this vertex is in */
-        node = members[i];
-        if (!node)
+        if (start[i] == start[i + 1]) {
             fprintf(stderr, "glmVertexNormals(): vertex w/o a triangle\n");
+            continue;
+        }
+        first = members[start[i]];
         average[0] = 0.0; average[1] = 0.0; average[2] = 0.0;
         avg = 0;
-        while (node) {
+        for (j = start[i]; j < start[i + 1]; j++) {
         /* only average if the dot product of the angle between the two
         facet normals is greater than the cosine of the threshold
         angle -- or, said another way, the angle between the two
             facet normals is less than (or equal to) the threshold angle */
-            dot = glmDot(&model->facetnorms[3 * T(node->index).findex],
-                &model->facetnorms[3 * T(members[i]->index).findex]);
+            k = T(members[j]).findex;
+            dot = glmDot(&model->facetnorms[3 * k],
+                &model->facetnorms[3 * T(first).findex]);
             if (dot > cos_angle) {
-                node->averaged = GL_TRUE;
-                average[0] += model->facetnorms[3 * T(node->index).findex + 0];
-                average[1] += model->facetnorms[3 * T(node->index).findex + 1];
-                average[2] += model->facetnorms[3 * T(node->index).findex + 2];
+                averaged[j] = GL_TRUE;
+                average[0] += model->facetnorms[3 * k + 0];
+                average[1] += model->facetnorms[3 * k + 1];
+                average[2] += model->facetnorms[3 * k + 2];
                 avg = 1;            /* we averaged at least one normal! */
             } else {
-                node->averaged = GL_FALSE;
+                averaged[j] = GL_FALSE;
             }
-            node = node->next;
         }
         
         if (avg) {
@@ -1097,61 +1197,42 @@ glmVertexNormals(GLMmodel* model, GLfloat angle)
         }
         
         /* set the normal of this vertex in each triangle it is in */
-        node = members[i];
-        while (node) {
-            if (node->averaged) {
-                /* if this node was averaged, use the average normal */
-                if (T(node->index).vindices[0] == i)
-                    T(node->index).nindices[0] = avg;
-                else if (T(node->index).vindices[1] == i)
-                    T(node->index).nindices[1] = avg;
-                else if (T(node->index).vindices[2] == i)
-                    T(node->index).nindices[2] = avg;
+        for (j = start[i]; j < start[i + 1]; j++) {
+            k = members[j];
+            if (averaged[j]) {
+                /* if this triangle was averaged, use the average normal */
+                v = avg;
             } else {
-                /* if this node wasn't averaged, use the facet normal */
+                /* if this triangle wasn't averaged, use the facet normal */
                 model->normals[3 * numnormals + 0] = 
-                    model->facetnorms[3 * T(node->index).findex + 0];
+                    model->facetnorms[3 * T(k).findex + 0];
                 model->normals[3 * numnormals + 1] = 
-                    model->facetnorms[3 * T(node->index).findex + 1];
+                    model->facetnorms[3 * T(k).findex + 1];
                 model->normals[3 * numnormals + 2] = 
-                    model->facetnorms[3 * T(node->index).findex + 2];
-                if (T(node->index).vindices[0] == i)
-                    T(node->index).nindices[0] = numnormals;
-                else if (T(node->index).vindices[1] == i)
-                    T(node->index).nindices[1] = numnormals;
-                else if (T(node->index).vindices[2] == i)
-                    T(node->index).nindices[2] = numnormals;
+                    model->facetnorms[3 * T(k).findex + 2];
+                v = numnormals;
                 numnormals++;
             }
-            node = node->next;
+            if (T(k).vindices[0] == i)
+                T(k).nindices[0] = v;
+            else if (T(k).vindices[1] == i)
+                T(k).nindices[1] = v;
+            else if (T(k).vindices[2] == i)
+                T(k).nindices[2] = v;
         }
     }
     
     model->numnormals = numnormals - 1;
     
     /* free the member information */
-    for (i = 1; i <= model->numvertices; i++) {
-        node = members[i];
-        while (node) {
-            tail = node;
-            node = node->next;
-            free(tail);
-        }
-    }
-    free(members);
+    free(arena);
     
     /* pack the normals array (we previously allocated the maximum
     number of normals that could possibly be created (numtriangles *
     3), so get rid of some of them (usually alot unless none of the
     facet normals were averaged)) */
-    normals = model->normals;
-    model->normals = (GLfloat*)malloc(sizeof(GLfloat)* 3* (model->numnormals+1));
-    for (i = 1; i <= model->numnormals; i++) {
-        model->normals[3 * i + 0] = normals[3 * i + 0];
-        model->normals[3 * i + 1] = normals[3 * i + 1];
-        model->normals[3 * i + 2] = normals[3 * i + 2];
-    }
-    free(normals);
+    model->normals = (GLfloat*)realloc(model->normals,
+        sizeof(GLfloat)* 3* (model->numnormals+1));
 }
 
 
@@ -1172,7 +1253,7 @@ glmLinearTexture(GLMmodel* model)
     assert(model);
     
     if (model->texcoords)
-        free(model->texcoords);
+        glmFree(model, model->texcoords);
     model->numtexcoords = model->numvertices;
     model->texcoords=(GLfloat*)malloc(sizeof(GLfloat)*2*(model->numtexcoords+1));
     
@@ -1227,7 +1308,7 @@ glmSpheremapTexture(GLMmodel* model)
     assert(model->normals);
     
     if (model->texcoords)
-        free(model->texcoords);
+        glmFree(model, model->texcoords);
     model->numtexcoords = model->numnormals;
     model->texcoords=(GLfloat*)malloc(sizeof(GLfloat)*2*(model->numtexcoords+1));
     
@@ -1283,11 +1364,11 @@ glmDelete(GLMmodel* model)
     
     if (model->pathname)     free(model->pathname);
     if (model->mtllibname) free(model->mtllibname);
-    if (model->vertices)     free(model->vertices);
-    if (model->normals)  free(model->normals);
-    if (model->texcoords)  free(model->texcoords);
-    if (model->facetnorms) free(model->facetnorms);
-    if (model->triangles)  free(model->triangles);
+    if (model->vertices)     glmFree(model, model->vertices);
+    if (model->normals)  glmFree(model, model->normals);
+    if (model->texcoords)  glmFree(model, model->texcoords);
+    if (model->facetnorms) glmFree(model, model->facetnorms);
+    if (model->triangles)  glmFree(model, model->triangles);
     if (model->materials) {
         for (i = 0; i < model->nummaterials; i++)
             free(model->materials[i].name);
@@ -1297,10 +1378,15 @@ glmDelete(GLMmodel* model)
         group = model->groups;
         model->groups = model->groups->next;
         free(group->name);
-        free(group->triangles);
+        glmFree(model, group->triangles);
         free(group);
     }
     
+#if defined(GLM_MMAP)
+    if (model->mapping)
+        munmap(model->mapping, model->mappingsize);
+#endif
+    
     free(model);
 }
 
@@ -1311,7 +1397,7 @@ glmDelete(GLMmodel* model)
  * filename - name of the file containing the Wavefront .OBJ format data.  
  */
 GLMmodel* 
-glmReadOBJ(char* filename)
+glmReadOBJ(const char* filename)
 {
     GLMmodel* model;
     FILE* file;
@@ -1346,6 +1432,8 @@ glmReadOBJ(char* filename)
     model->position[0]   = 0.0;
     model->position[1]   = 0.0;
     model->position[2]   = 0.0;
+    model->mapping       = NULL;
+    model->mappingsize   = 0;
     
     /* make a first pass through the file to get a count of the number
     of vertices, normals, texcoords & triangles */
@@ -1749,7 +1837,7 @@ glmWeld(GLMmodel* model, GLfloat epsilon)
     }
     
     /* free space for old vertices */
-    free(vectors);
+    glmFree(model, vectors);
     
     /* allocate space for the new vertices */
     model->numvertices = numvectors;
@@ -1766,6 +1854,519 @@ glmWeld(GLMmodel* model, GLfloat epsilon)
     free(copies);
 }
 
+/* GLMcacheHeader: start of a cache file written by glmWriteCache.  The
+ * arrays follow at the byte offsets given, each aligned to 16 bytes and
+ * laid out as in a GLMmodel, element 0 included; an offset of 0 means
+ * the model has no such array.  Strings are offsets into a table of
+ * nul terminated strings.
+ */
+#define GLM_CACHE_MAGIC   0x434d4c47    /* "GLMC" */
+#define GLM_CACHE_VERSION 1
+#define GLM_CACHE_NONE    0xffffffff    /* no string */
+
+typedef struct _GLMcacheHeader {
+    GLuint magic;
+    GLuint version;
+    unsigned long long filesize;        /* size of the cache file */
+    unsigned long long sourcehash;      /* hash of the .OBJ file and tag */
+    
+    GLuint numvertices;
+    GLuint numnormals;
+    GLuint numtexcoords;
+    GLuint numfacetnorms;
+    GLuint numtriangles;
+    GLuint nummaterials;
+    GLuint numgroups;
+    GLfloat position[3];
+    GLuint pathname;
+    GLuint mtllibname;
+    
+    GLuint vertices;
+    GLuint normals;
+    GLuint texcoords;
+    GLuint facetnorms;
+    GLuint triangles;
+    GLuint materials;                   /* array of GLMcacheMaterial */
+    GLuint groups;                      /* array of GLMcacheGroup */
+    GLuint strings;
+    GLuint stringssize;
+} GLMcacheHeader;
+
+typedef struct _GLMcacheMaterial {
+    GLfloat diffuse[4];
+    GLfloat ambient[4];
+    GLfloat specular[4];
+    GLfloat emmissive[4];
+    GLfloat shininess;
+    GLuint  name;
+} GLMcacheMaterial;
+
+typedef struct _GLMcacheGroup {
+    GLuint name;
+    GLuint numtriangles;
+    GLuint material;
+    GLuint triangles;                   /* offset of the triangle indices */
+} GLMcacheGroup;
+
+#if defined(GLM_MMAP)
+
+/* glmCacheHash: hash of the contents of a file followed by a tag; FNV-1a,
+ * but taking the file 8 bytes at a time, since hashing large models one
+ * byte at a time would take longer than mapping their cache.  Returns
+ * GL_FALSE if the file can't be read.
+ */
+static GLboolean
+glmCacheHash(const char* filename, const char* tag, unsigned long long* hash)
+{
+    struct stat st;
+    unsigned char* data = NULL;
+    unsigned long long h = 14695981039346656037ULL;
+    unsigned long long word;
+    size_t i;
+    int fd;
+    
+    fd = open(filename, O_RDONLY);
+    if (fd == -1)
+        return GL_FALSE;
+    if (fstat(fd, &st) == -1) {
+        close(fd);
+        return GL_FALSE;
+    }
+    if (st.st_size > 0) {
+        data = (unsigned char*)mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE,
+            fd, 0);
+        if (data == MAP_FAILED) {
+            close(fd);
+            return GL_FALSE;
+        }
+    }
+    close(fd);
+    
+    for (i = 0; i + 8 <= (size_t)st.st_size; i += 8) {
+        memcpy(&word, data + i, 8);
+        h ^= word;
+        h *= 1099511628211ULL;
+    }
+    for (; i < (size_t)st.st_size; i++) {
+        h ^= data[i];
+        h *= 1099511628211ULL;
+    }
+    for (i = 0; tag[i]; i++) {
+        h ^= (unsigned char)tag[i];
+        h *= 1099511628211ULL;
+    }
+    
+    if (data)
+        munmap(data, st.st_size);
+    
+    *hash = h;
+    return GL_TRUE;
+}
+
+/* glmCachePlace: find room for size bytes after *end, aligned to 16
+ * bytes, and return its offset
+ */
+static unsigned long long
+glmCachePlace(unsigned long long* end, unsigned long long size)
+{
+    unsigned long long offset = (*end + 15) & ~15ULL;
+    
+    *end = offset + size;
+    return offset;
+}
+
+/* glmCacheString: append a string to the string table and return its
+ * offset
+ */
+static GLuint
+glmCacheString(char* strings, GLuint* size, char* s)
+{
+    GLuint offset = *size;
+    
+    if (!s)
+        return GLM_CACHE_NONE;
+    if (strings)
+        strcpy(strings + offset, s);
+    *size += strlen(s) + 1;
+    return offset;
+}
+
+/* glmCacheStrings: fill in the string table and every string offset;
+ * with strings NULL, only count its size
+ */
+static GLuint
+glmCacheStrings(GLMmodel* model, char* strings, GLMcacheHeader* header,
+                GLMcacheMaterial* materials, GLMcacheGroup* groups)
+{
+    GLMgroup* group;
+    GLuint size = 0;
+    GLuint i;
+    
+    header->pathname = glmCacheString(strings, &size, model->pathname);
+    header->mtllibname = glmCacheString(strings, &size, model->mtllibname);
+    for (i = 0; i < model->nummaterials; i++)
+        materials[i].name = glmCacheString(strings, &size,
+            model->materials[i].name);
+    for (group = model->groups, i = 0; group; group = group->next, i++)
+        groups[i].name = glmCacheString(strings, &size, group->name);
+    return size;
+}
+
+GLboolean
+glmWriteCache(GLMmodel* model, const char* cachename, const char* objname,
+              const char* tag)
+{
+    GLMcacheHeader header;
+    GLMcacheMaterial* materials;
+    GLMcacheGroup* groups;
+    GLMgroup* group;
+    unsigned long long end, grouptriangles;
+    char* strings;
+    char* tmpname;
+    FILE* file;
+    GLboolean ok;
+    GLuint i;
+    
+    assert(model);
+    
+    memset(&header, 0, sizeof(header));
+    header.magic = GLM_CACHE_MAGIC;
+    header.version = GLM_CACHE_VERSION;
+    if (!glmCacheHash(objname, tag, &header.sourcehash))
+        return GL_FALSE;
+    
+    header.numvertices = model->numvertices;
+    header.numnormals = model->normals ? model->numnormals : 0;
+    header.numtexcoords = model->texcoords ? model->numtexcoords : 0;
+    header.numfacetnorms = model->facetnorms ? model->numfacetnorms : 0;
+    header.numtriangles = model->numtriangles;
+    header.nummaterials = model->nummaterials;
+    header.numgroups = model->numgroups;
+    header.position[0] = model->position[0];
+    header.position[1] = model->position[1];
+    header.position[2] = model->position[2];
+    
+    materials = (GLMcacheMaterial*)calloc(model->nummaterials + 1,
+        sizeof(GLMcacheMaterial));
+    groups = (GLMcacheGroup*)calloc(model->numgroups + 1,
+        sizeof(GLMcacheGroup));
+    
+    /* lay out the file */
+    end = sizeof(header);
+    header.vertices = glmCachePlace(&end,
+        sizeof(GLfloat) * 3 * (model->numvertices + 1));
+    if (model->normals)
+        header.normals = glmCachePlace(&end,
+            sizeof(GLfloat) * 3 * (model->numnormals + 1));
+    if (model->texcoords)
+        header.texcoords = glmCachePlace(&end,
+            sizeof(GLfloat) * 2 * (model->numtexcoords + 1));
+    if (model->facetnorms)
+        header.facetnorms = glmCachePlace(&end,
+            sizeof(GLfloat) * 3 * (model->numfacetnorms + 1));
+    header.triangles = glmCachePlace(&end,
+        sizeof(GLMtriangle) * model->numtriangles);
+    header.materials = glmCachePlace(&end,
+        sizeof(GLMcacheMaterial) * model->nummaterials);
+    header.groups = glmCachePlace(&end,
+        sizeof(GLMcacheGroup) * model->numgroups);
+    for (group = model->groups, i = 0; group; group = group->next, i++) {
+        groups[i].numtriangles = group->numtriangles;
+        groups[i].material = group->material;
+        groups[i].triangles = glmCachePlace(&end,
+            sizeof(GLuint) * group->numtriangles);
+    }
+    header.stringssize = glmCacheStrings(model, NULL, &header, materials,
+        groups);
+    header.strings = glmCachePlace(&end, header.stringssize);
+    header.filesize = end;
+    
+    for (i = 0; i < model->nummaterials; i++) {
+        memcpy(materials[i].diffuse, model->materials[i].diffuse,
+            sizeof(materials[i].diffuse));
+        memcpy(materials[i].ambient, model->materials[i].ambient,
+            sizeof(materials[i].ambient));
+        memcpy(materials[i].specular, model->materials[i].specular,
+            sizeof(materials[i].specular));
+        memcpy(materials[i].emmissive, model->materials[i].emmissive,
+            sizeof(materials[i].emmissive));
+        materials[i].shininess = model->materials[i].shininess;
+    }
+    strings = (char*)malloc(header.stringssize + 1);
+    glmCacheStrings(model, strings, &header, materials, groups);
+    
+    /* offsets are 32 bits */
+    ok = end < GLM_CACHE_NONE;
+    
+    /* write to a temporary file and rename it, so that a cache is never
+    seen half written */
+    tmpname = (char*)malloc(strlen(cachename) + 5);
+    strcpy(tmpname, cachename);
+    strcat(tmpname, ".tmp");
+    
+    file = ok ? fopen(tmpname, "wb") : NULL;
+    ok = file != NULL;
+    
+#define GLM_CACHE_WRITE(offset, data, size) \
+    if (ok && (size) > 0) \
+        ok = fseek(file, (long)(offset), SEEK_SET) == 0 && \
+            fwrite((data), (size), 1, file) == 1
+    
+    GLM_CACHE_WRITE(0, &header, sizeof(header));
+    GLM_CACHE_WRITE(header.vertices, model->vertices,
+        sizeof(GLfloat) * 3 * (model->numvertices + 1));
+    if (model->normals) {
+        GLM_CACHE_WRITE(header.normals, model->normals,
+            sizeof(GLfloat) * 3 * (model->numnormals + 1));
+    }
+    if (model->texcoords) {
+        GLM_CACHE_WRITE(header.texcoords, model->texcoords,
+            sizeof(GLfloat) * 2 * (model->numtexcoords + 1));
+    }
+    if (model->facetnorms) {
+        GLM_CACHE_WRITE(header.facetnorms, model->facetnorms,
+            sizeof(GLfloat) * 3 * (model->numfacetnorms + 1));
+    }
+    GLM_CACHE_WRITE(header.triangles, model->triangles,
+        sizeof(GLMtriangle) * model->numtriangles);
+    GLM_CACHE_WRITE(header.materials, materials,
+        sizeof(GLMcacheMaterial) * model->nummaterials);
+    GLM_CACHE_WRITE(header.groups, groups,
+        sizeof(GLMcacheGroup) * model->numgroups);
+    for (group = model->groups, i = 0; group; group = group->next, i++) {
+        grouptriangles = groups[i].triangles;
+        GLM_CACHE_WRITE(grouptriangles, group->triangles,
+            sizeof(GLuint) * group->numtriangles);
+    }
+    GLM_CACHE_WRITE(header.strings, strings, header.stringssize);
+    
+#undef GLM_CACHE_WRITE
+    
+    /* the last array may be empty; make the file its full size */
+    if (ok)
+        ok = fflush(file) == 0 && ftruncate(fileno(file), end) == 0;
+    if (file)
+        ok = (fclose(file) == 0) && ok;
+    if (ok)
+        ok = rename(tmpname, cachename) == 0;
+    if (!ok && file)
+        remove(tmpname);
+    
+    free(tmpname);
+    free(strings);
+    free(groups);
+    free(materials);
+    return ok;
+}
+
+/* glmCacheFits: whether an array of size bytes at offset lies within a
+ * cache of filesize bytes
+ */
+static GLboolean
+glmCacheFits(unsigned long long offset, unsigned long long size,
+             unsigned long long filesize)
+{
+    return offset % 4 == 0 && offset <= filesize && size <= filesize - offset;
+}
+
+/* glmCacheIndicesFit: whether count indices, stride GLuints apart, are
+ * all below end
+ */
+static GLboolean
+glmCacheIndicesFit(const GLuint* indices, size_t stride, GLuint count,
+                   unsigned long long end)
+{
+    GLuint i;
+    
+    for (i = 0; i < count; i++) {
+        if (indices[i * stride] >= end)
+            return GL_FALSE;
+    }
+    return GL_TRUE;
+}
+
+GLMmodel*
+glmReadCache(const char* cachename, const char* objname, const char* tag)
+{
+    GLMmodel* model;
+    GLMgroup* group;
+    GLMgroup** tail;
+    GLMcacheHeader* header;
+    GLMcacheMaterial* materials;
+    GLMcacheGroup* groups;
+    GLMtriangle* triangles;
+    unsigned long long hash;
+    struct stat st;
+    size_t stride;
+    char* data;
+    char* strings;
+    GLuint i;
+    int fd;
+    
+    /* map the cache */
+    fd = open(cachename, O_RDONLY);
+    if (fd == -1)
+        return NULL;
+    if (fstat(fd, &st) == -1 || (size_t)st.st_size < sizeof(GLMcacheHeader)) {
+        close(fd);
+        return NULL;
+    }
+    data = (char*)mmap(NULL, st.st_size, PROT_READ | PROT_WRITE, MAP_PRIVATE,
+        fd, 0);
+    close(fd);
+    if (data == MAP_FAILED)
+        return NULL;
+    
+    /* check that it is whole and up to date */
+    header = (GLMcacheHeader*)data;
+    materials = (GLMcacheMaterial*)(data + header->materials);
+    groups = (GLMcacheGroup*)(data + header->groups);
+    strings = data + header->strings;
+    
+    if (header->magic != GLM_CACHE_MAGIC ||
+        header->version != GLM_CACHE_VERSION ||
+        header->filesize != (unsigned long long)st.st_size ||
+        !glmCacheHash(objname, tag, &hash) || hash != header->sourcehash)
+        goto invalid;
+    
+    if (!glmCacheFits(header->vertices,
+            sizeof(GLfloat) * 3 * (header->numvertices + 1ULL), st.st_size) ||
+        !glmCacheFits(header->normals,
+            sizeof(GLfloat) * 3 * (header->numnormals + 1ULL), st.st_size) ||
+        !glmCacheFits(header->texcoords,
+            sizeof(GLfloat) * 2 * (header->numtexcoords + 1ULL), st.st_size) ||
+        !glmCacheFits(header->facetnorms,
+            sizeof(GLfloat) * 3 * (header->numfacetnorms + 1ULL), st.st_size) ||
+        !glmCacheFits(header->triangles,
+            sizeof(GLMtriangle) * (unsigned long long)header->numtriangles,
+            st.st_size) ||
+        !glmCacheFits(header->materials,
+            sizeof(GLMcacheMaterial) * (unsigned long long)header->nummaterials,
+            st.st_size) ||
+        !glmCacheFits(header->groups,
+            sizeof(GLMcacheGroup) * (unsigned long long)header->numgroups,
+            st.st_size) ||
+        !glmCacheFits(header->strings, header->stringssize, st.st_size) ||
+        header->stringssize == 0 || strings[header->stringssize - 1] != '\0')
+        goto invalid;
+    
+    for (i = 0; i < header->numgroups; i++) {
+        if (!glmCacheFits(groups[i].triangles,
+                sizeof(GLuint) * (unsigned long long)groups[i].numtriangles,
+                st.st_size) ||
+            groups[i].name >= header->stringssize ||
+            groups[i].material >=
+                (header->nummaterials ? header->nummaterials : 1))
+            goto invalid;
+        if (!glmCacheIndicesFit((GLuint*)(data + groups[i].triangles), 1,
+                groups[i].numtriangles, header->numtriangles))
+            goto invalid;
+    }
+    for (i = 0; i < header->nummaterials; i++) {
+        if (materials[i].name >= header->stringssize)
+            goto invalid;
+    }
+    
+    /* the indices that glmDraw follows; those into an array the model
+    does not have are never followed, and may be anything */
+    triangles = (GLMtriangle*)(data + header->triangles);
+    stride = sizeof(GLMtriangle) / sizeof(GLuint);
+    for (i = 0; i < 3; i++) {
+        if (!glmCacheIndicesFit(&triangles->vindices[i], stride,
+                header->numtriangles, header->numvertices + 1ULL) ||
+            (header->normals &&
+             !glmCacheIndicesFit(&triangles->nindices[i], stride,
+                header->numtriangles, header->numnormals + 1ULL)) ||
+            (header->texcoords &&
+             !glmCacheIndicesFit(&triangles->tindices[i], stride,
+                header->numtriangles, header->numtexcoords + 1ULL)))
+            goto invalid;
+    }
+    if (header->facetnorms &&
+        !glmCacheIndicesFit(&triangles->findex, stride,
+            header->numtriangles, header->numfacetnorms + 1ULL))
+        goto invalid;
+    
+    /* the arrays stay in the mapping; only the strings, materials and
+    groups, which glmDelete frees one by one, are copied out */
+    model = (GLMmodel*)malloc(sizeof(GLMmodel));
+    model->pathname = header->pathname < header->stringssize ?
+        strdup(strings + header->pathname) : NULL;
+    model->mtllibname = header->mtllibname < header->stringssize ?
+        strdup(strings + header->mtllibname) : NULL;
+    model->numvertices = header->numvertices;
+    model->vertices = (GLfloat*)(data + header->vertices);
+    model->numnormals = header->numnormals;
+    model->normals = header->normals ?
+        (GLfloat*)(data + header->normals) : NULL;
+    model->numtexcoords = header->numtexcoords;
+    model->texcoords = header->texcoords ?
+        (GLfloat*)(data + header->texcoords) : NULL;
+    model->numfacetnorms = header->numfacetnorms;
+    model->facetnorms = header->facetnorms ?
+        (GLfloat*)(data + header->facetnorms) : NULL;
+    model->numtriangles = header->numtriangles;
+    model->triangles = (GLMtriangle*)(data + header->triangles);
+    model->position[0] = header->position[0];
+    model->position[1] = header->position[1];
+    model->position[2] = header->position[2];
+    model->mapping = data;
+    model->mappingsize = st.st_size;
+    
+    model->nummaterials = header->nummaterials;
+    model->materials = (GLMmaterial*)malloc(sizeof(GLMmaterial) *
+        (header->nummaterials + 1));
+    for (i = 0; i < header->nummaterials; i++) {
+        model->materials[i].name = strdup(strings + materials[i].name);
+        memcpy(model->materials[i].diffuse, materials[i].diffuse,
+            sizeof(materials[i].diffuse));
+        memcpy(model->materials[i].ambient, materials[i].ambient,
+            sizeof(materials[i].ambient));
+        memcpy(model->materials[i].specular, materials[i].specular,
+            sizeof(materials[i].specular));
+        memcpy(model->materials[i].emmissive, materials[i].emmissive,
+            sizeof(materials[i].emmissive));
+        model->materials[i].shininess = materials[i].shininess;
+    }
+    
+    model->numgroups = header->numgroups;
+    model->groups = NULL;
+    tail = &model->groups;
+    for (i = 0; i < header->numgroups; i++) {
+        group = (GLMgroup*)malloc(sizeof(GLMgroup));
+        group->name = strdup(strings + groups[i].name);
+        group->numtriangles = groups[i].numtriangles;
+        group->triangles = (GLuint*)(data + groups[i].triangles);
+        group->material = groups[i].material;
+        group->next = NULL;
+        *tail = group;
+        tail = &group->next;
+    }
+    
+    return model;
+    
+invalid:
+    munmap(data, st.st_size);
+    return NULL;
+}
+
+#else
+
+GLboolean
+glmWriteCache(GLMmodel* model, const char* cachename, const char* objname,
+              const char* tag)
+{
+    return GL_FALSE;
+}
+
+GLMmodel*
+glmReadCache(const char* cachename, const char* objname, const char* tag)
+{
+    return NULL;
+}
+
+#endif /* GLM_MMAP */
+
 /* glmReadPPM: read a PPM raw (type P6) file.  The PPM file has a header
  * that should look something like:
  *
@@ -19,6 +19,8 @@
 #include <GL/glut.h>
 #endif
 
+#include <stddef.h>
+
 
 #ifndef M_PI
 #define M_PI 3.14159265f
@@ -92,6 +94,9 @@ typedef struct _GLMmodel {
 
   GLfloat position[3];          /* position of the model */
 
+  void*    mapping;             /* cache file the arrays live in, if any */
+  size_t   mappingsize;         /* size of the mapping in bytes */
+
 } GLMmodel;
 
 
@@ -195,7 +200,7 @@ glmDelete(GLMmodel* model);
  * filename - name of the file containing the Wavefront .OBJ format data.  
  */
 GLMmodel* 
-glmReadOBJ(char* filename);
+glmReadOBJ(const char* filename);
 
 /* glmWriteOBJ: Writes a model description in Wavefront .OBJ format to
  * a file.
@@ -251,6 +256,37 @@ glmList(GLMmodel* model, GLuint mode);
 GLvoid
 glmWeld(GLMmodel* model, GLfloat epsilon);
 
+/* glmWriteCache: Writes a model to a binary cache file, from which
+ * glmReadCache can map it back without parsing.  Returns GL_FALSE if
+ * the cache could not be written.
+ *
+ * model     - initialized GLMmodel structure
+ * cachename - name of the cache file to write
+ * objname   - name of the .OBJ file the model was read from; the cache
+ *             records a hash of its contents
+ * tag       - describes what was done to the model after reading it,
+ *             e.g. "unitize, normals 90"
+ */
+GLboolean
+glmWriteCache(GLMmodel* model, const char* cachename, const char* objname,
+              const char* tag);
+
+/* glmReadCache: Maps a model written by glmWriteCache.  The arrays of
+ * the model point into the mapping; they are copied on write, so the
+ * model can be changed like any other.  Returns NULL if the cache does
+ * not exist, is damaged, or was written from a different .OBJ file or
+ * with a different tag.  Damage is detected as far as it could make
+ * glmDraw read outside the model: offsets, strings and the indices of
+ * the triangles, groups and materials are checked, vertex data is not.
+ * Free the model with glmDelete().
+ *
+ * cachename - name of the cache file to read
+ * objname   - name of the .OBJ file the cache must have been written from
+ * tag       - as passed to glmWriteCache
+ */
+GLMmodel*
+glmReadCache(const char* cachename, const char* objname, const char* tag);
+
 /* glmReadPPM: read a PPM raw (type P6) file.  The PPM file has a header
  * that should look something like:
  *
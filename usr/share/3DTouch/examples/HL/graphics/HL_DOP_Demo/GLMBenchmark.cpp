@@ -0,0 +1,339 @@
+/*****************************************************************************
+
+Copyright (c) 2004 SensAble Technologies, Inc. All rights reserved.
+
+OpenHaptics(TM) toolkit. The material embodied in this software and use of
+this software is subject to the terms and conditions of the clickthrough
+Development License Agreement.
+
+For questions, comments or bug reports, go to forums at:
+    http://dsc.sensable.com
+
+Module Name:
+
+  GLMBenchmark.cpp
+
+Description:
+
+  Times loading synthetic OBJ meshes of increasing size with GLM: reading,
+  welding and generating normals, and mapping the result back from a
+  cache.  For the smaller meshes, also runs the welding and vertex normals
+  GLM used to have, which search through every copy and build lists of
+  nodes, and checks that the results match.
+  Usage: GLMBenchmark [largest number of triangles]
+
+******************************************************************************/
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "GLM.h"
+
+#define T(x) (model->triangles[(x)])
+
+static const GLfloat kWeldEpsilon = 0.00001f;
+static const GLfloat kSmoothingAngle = 90.0f;
+static char kCacheTag[] = "weld, normals 90";
+static char kOtherTag[] = "weld, normals 45";
+
+/* Largest mesh the old welding is run on; it takes minutes beyond. */
+static const long kMaxReferenceTriangles = 20000;
+
+static double getTime(void)
+{
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return now.tv_sec + now.tv_nsec * 1e-9;
+}
+
+/*******************************************************************************
+ The welding and vertex normals GLM used to have.  The welding is as it was
+ meant to be: the old loop also compared against the slot the next copy
+ would go in, which still held an unwelded vector, and could leave a vertex
+ pointing at whatever copy later took that slot.
+*******************************************************************************/
+static GLboolean equalReference(GLfloat* u, GLfloat* v, GLfloat epsilon)
+{
+    return fabs(u[0] - v[0]) < epsilon &&
+           fabs(u[1] - v[1]) < epsilon &&
+           fabs(u[2] - v[2]) < epsilon;
+}
+
+static void weldReference(GLMmodel* model, GLfloat epsilon)
+{
+    GLfloat* vectors = model->vertices;
+    GLuint numvectors = model->numvertices;
+    GLfloat* copies = (GLfloat*)malloc(sizeof(GLfloat) * 3 * (numvectors + 1));
+    memcpy(copies, vectors, sizeof(GLfloat) * 3 * (numvectors + 1));
+
+    GLuint copied = 1;
+    for (GLuint i = 1; i <= numvectors; i++) {
+        GLuint j;
+        for (j = 1; j < copied; j++) {
+            if (equalReference(&vectors[3 * i], &copies[3 * j], epsilon))
+                break;
+        }
+        if (j == copied) {
+            memcpy(&copies[3 * copied], &vectors[3 * i], sizeof(GLfloat) * 3);
+            j = copied;
+            copied++;
+        }
+        vectors[3 * i] = (GLfloat)j;
+    }
+
+    for (GLuint i = 0; i < model->numtriangles; i++) {
+        for (int k = 0; k < 3; k++)
+            T(i).vindices[k] = (GLuint)vectors[3 * T(i).vindices[k]];
+    }
+
+    free(vectors);
+    model->numvertices = copied - 1;
+    model->vertices = copies;
+}
+
+struct Node {
+    GLuint index;
+    GLboolean averaged;
+    Node* next;
+};
+
+static void vertexNormalsReference(GLMmodel* model, GLfloat angle)
+{
+    GLfloat cos_angle = cos(angle * M_PI / 180.0);
+
+    free(model->normals);
+    model->normals = (GLfloat*)malloc(sizeof(GLfloat) * 3 *
+        (model->numtriangles * 3 + 1));
+
+    Node** members = (Node**)malloc(sizeof(Node*) * (model->numvertices + 1));
+    for (GLuint i = 1; i <= model->numvertices; i++)
+        members[i] = NULL;
+
+    for (GLuint i = 0; i < model->numtriangles; i++) {
+        for (int k = 0; k < 3; k++) {
+            Node* node = (Node*)malloc(sizeof(Node));
+            node->index = i;
+            node->next = members[T(i).vindices[k]];
+            members[T(i).vindices[k]] = node;
+        }
+    }
+
+    GLuint numnormals = 1;
+    for (GLuint i = 1; i <= model->numvertices; i++) {
+        GLfloat average[3] = { 0, 0, 0 };
+        GLuint avg = 0;
+        GLfloat* first = members[i] ?
+            &model->facetnorms[3 * T(members[i]->index).findex] : NULL;
+
+        for (Node* node = members[i]; node; node = node->next) {
+            GLfloat* n = &model->facetnorms[3 * T(node->index).findex];
+            GLfloat dot = n[0] * first[0] + n[1] * first[1] + n[2] * first[2];
+            node->averaged = dot > cos_angle;
+            if (node->averaged) {
+                average[0] += n[0];
+                average[1] += n[1];
+                average[2] += n[2];
+                avg = 1;
+            }
+        }
+
+        if (avg) {
+            GLfloat l = (GLfloat)sqrt(average[0] * average[0] +
+                average[1] * average[1] + average[2] * average[2]);
+            for (int k = 0; k < 3; k++)
+                model->normals[3 * numnormals + k] = average[k] / l;
+            avg = numnormals;
+            numnormals++;
+        }
+
+        for (Node* node = members[i]; node; node = node->next) {
+            GLuint n = avg;
+            if (!node->averaged) {
+                memcpy(&model->normals[3 * numnormals],
+                    &model->facetnorms[3 * T(node->index).findex],
+                    sizeof(GLfloat) * 3);
+                n = numnormals;
+                numnormals++;
+            }
+            for (int k = 0; k < 3; k++) {
+                if (T(node->index).vindices[k] == i) {
+                    T(node->index).nindices[k] = n;
+                    break;
+                }
+            }
+        }
+    }
+    model->numnormals = numnormals - 1;
+
+    for (GLuint i = 1; i <= model->numvertices; i++) {
+        while (members[i]) {
+            Node* next = members[i]->next;
+            free(members[i]);
+            members[i] = next;
+        }
+    }
+    free(members);
+}
+
+/*******************************************************************************
+ A rippled sheet written as separate triangles, each with its own three
+ vertices, as exporters often write them; welding finds the shared ones.
+*******************************************************************************/
+static void writeMesh(const char* filename, long numtriangles)
+{
+    int side = (int)ceil(sqrt(numtriangles / 2.0));
+    FILE* file = fopen(filename, "w");
+
+    long written = 0;
+    for (int i = 0; i < side && written < numtriangles; i++) {
+        for (int j = 0; j < side && written < numtriangles; j++) {
+            float corners[4][3];
+            for (int c = 0; c < 4; c++) {
+                float x = 2.0f * (i + (c & 1)) / side - 1;
+                float y = 2.0f * (j + (c >> 1)) / side - 1;
+                corners[c][0] = x;
+                corners[c][1] = y;
+                corners[c][2] = 0.1f * sinf(5 * x) * cosf(5 * y);
+            }
+
+            static const int tris[2][3] = { { 0, 1, 3 }, { 0, 3, 2 } };
+            for (int t = 0; t < 2 && written < numtriangles; t++) {
+                for (int k = 0; k < 3; k++) {
+                    const float* p = corners[tris[t][k]];
+                    fprintf(file, "v %f %f %f\n", p[0], p[1], p[2]);
+                }
+                fprintf(file, "f -3 -2 -1\n");
+                written++;
+            }
+        }
+    }
+
+    fclose(file);
+}
+
+/* Compares what welding and normals produce; slot 0 of the arrays and the
+   texture coordinate indices of a mesh without any are left unset. */
+static bool sameModel(const GLMmodel* a, const GLMmodel* b)
+{
+    if (a->numvertices != b->numvertices ||
+        a->numnormals != b->numnormals ||
+        a->numtriangles != b->numtriangles)
+        return false;
+
+    if (memcmp(&a->vertices[3], &b->vertices[3],
+               sizeof(GLfloat) * 3 * a->numvertices) != 0 ||
+        memcmp(&a->normals[3], &b->normals[3],
+               sizeof(GLfloat) * 3 * a->numnormals) != 0)
+        return false;
+
+    for (GLuint i = 0; i < a->numtriangles; i++) {
+        const GLMtriangle* ta = &a->triangles[i];
+        const GLMtriangle* tb = &b->triangles[i];
+        if (memcmp(ta->vindices, tb->vindices, sizeof(ta->vindices)) != 0 ||
+            memcmp(ta->nindices, tb->nindices, sizeof(ta->nindices)) != 0 ||
+            ta->findex != tb->findex)
+            return false;
+    }
+    return true;
+}
+
+static void benchmark(char* filename, char* cachename, long numtriangles)
+{
+    writeMesh(filename, numtriangles);
+
+    double t0 = getTime();
+    GLMmodel* model = glmReadOBJ(filename);
+    double t1 = getTime();
+    GLuint numread = model->numvertices;
+    glmWeld(model, kWeldEpsilon);
+    double t2 = getTime();
+    glmFacetNormals(model);
+    double t3 = getTime();
+    glmVertexNormals(model, kSmoothingAngle);
+    double t4 = getTime();
+    double loadtime = t4 - t0;
+
+    printf("%8ld triangles %8u -> %7u vertices  read %8.1f ms  "
+           "weld %8.1f ms  facet %6.1f ms  vertex normals %7.1f ms",
+           numtriangles, numread, model->numvertices, (t1 - t0) * 1e3,
+           (t2 - t1) * 1e3, (t3 - t2) * 1e3, (t4 - t3) * 1e3);
+
+    if (numtriangles <= kMaxReferenceTriangles) {
+        GLMmodel* reference = glmReadOBJ(filename);
+        t0 = getTime();
+        weldReference(reference, kWeldEpsilon);
+        t1 = getTime();
+        glmFacetNormals(reference);
+        t2 = getTime();
+        vertexNormalsReference(reference, kSmoothingAngle);
+        t3 = getTime();
+
+        printf("\n%8s old: weld %8.1f ms  vertex normals %7.1f ms  %s",
+               "", (t1 - t0) * 1e3, (t3 - t2) * 1e3,
+               sameModel(model, reference) ? "same" : "DIFFERENT");
+        glmDelete(reference);
+    }
+    printf("\n");
+
+    /* a mapped model must match, and can be changed like any other */
+    t0 = getTime();
+    GLboolean written = glmWriteCache(model, cachename, filename, kCacheTag);
+    t1 = getTime();
+    GLMmodel* cached = glmReadCache(cachename, filename, kCacheTag);
+    t2 = getTime();
+
+    bool ok = written && cached && sameModel(model, cached) &&
+        glmReadCache(cachename, filename, kOtherTag) == NULL;
+    if (cached) {
+        glmFacetNormals(cached);
+        glmVertexNormals(cached, kSmoothingAngle);
+        ok = ok && sameModel(model, cached);
+        glmDelete(cached);
+    }
+
+    printf("%8s cache: write %8.1f ms  read %8.3f ms (%.0fx)  %s\n", "",
+           (t1 - t0) * 1e3, (t2 - t1) * 1e3, loadtime / (t2 - t1),
+           ok ? "same" : "DIFFERENT");
+
+    glmDelete(model);
+}
+
+/*******************************************************************************
+ main
+*******************************************************************************/
+int main(int argc, char* argv[])
+{
+    long maxtriangles = argc > 1 ? atol(argv[1]) : 1000000;
+    if (maxtriangles <= 0) {
+        fprintf(stderr, "Usage: %s [largest number of triangles]\n", argv[0]);
+        return -1;
+    }
+
+    char filename[] = "/tmp/GLMBenchmarkXXXXXX";
+    int fd = mkstemp(filename);
+    if (fd == -1) {
+        perror("mkstemp");
+        return -1;
+    }
+    close(fd);
+
+    char cachename[sizeof(filename) + 6];
+    strcpy(cachename, filename);
+    strcat(cachename, ".cache");
+
+    for (long n = 1000; ; n *= 10) {
+        benchmark(filename, cachename, n < maxtriangles ? n : maxtriangles);
+        if (n >= maxtriangles)
+            break;
+    }
+
+    unlink(filename);
+    unlink(cachename);
+    return 0;
+}
+
+/******************************************************************************/
@@ -0,0 +1,208 @@
+/*****************************************************************************
+
+Copyright (c) 2009 SensAble Technologies, Inc. All rights reserved.
+
+OpenHaptics(TM) toolkit. The material embodied in this software and use of
+this software is subject to the terms and conditions of the clickthrough
+Development License Agreement.
+
+For questions, comments or bug reports, go to forums at:
+    http://dsc.sensable.com
+
+Module Name:
+
+  HeightField.cpp
+
+Description:
+
+A height map converted from a TGA image for sampling in the servo loop.
+
+******************************************************************************/
+
+#include <math.h>
+#include <stdlib.h>
+
+#include "HeightField.h"
+
+/* texel (x, y) of a level */
+#define TEXEL(l, x, y) (&(l)->texels[4 * ((y) * (l)->width + (x))])
+
+/* wraps a texel coordinate into 0 to size - 1 */
+static int
+hfWrap(int i, int size)
+{
+    if (i >= 0 && i < size)
+        return i;
+    i %= size;
+    return i < 0 ? i + size : i;
+}
+
+/* hfAllocLevel: Allocates the texels of a level. */
+static void
+hfAllocLevel(hfLevel* level, int width, int height)
+{
+    level->width = width;
+    level->height = height;
+    level->texels = (float*)calloc(4 * width * height, sizeof(float));
+}
+
+/* hfSlopes: Fills in the slopes of a level from its heights, by central
+ * differences scaled to units of texture coordinate.
+ */
+static void
+hfSlopes(hfLevel* level)
+{
+    int w = level->width;
+    int h = level->height;
+    float su = w / 2.0f;
+    float sv = h / 2.0f;
+
+    for (int y = 0; y < h; y++) {
+        int ym = hfWrap(y - 1, h);
+        int yp = hfWrap(y + 1, h);
+        for (int x = 0; x < w; x++) {
+            int xm = hfWrap(x - 1, w);
+            int xp = hfWrap(x + 1, w);
+            float* t = TEXEL(level, x, y);
+            t[1] = (TEXEL(level, xp, y)[0] - TEXEL(level, xm, y)[0]) * su;
+            t[2] = (TEXEL(level, x, yp)[0] - TEXEL(level, x, ym)[0]) * sv;
+        }
+    }
+}
+
+/* hfSampleLevel: Bilinear sample of the height and slopes of one level. */
+static void
+hfSampleLevel(const hfLevel* level, float u, float v, float sample[3])
+{
+    float x = u * level->width - 0.5f;
+    float y = v * level->height - 0.5f;
+    float fx = floorf(x);
+    float fy = floorf(y);
+    float tx = x - fx;
+    float ty = y - fy;
+
+    int x0 = hfWrap((int)fx, level->width);
+    int y0 = hfWrap((int)fy, level->height);
+    int x1 = x0 + 1 == level->width ? 0 : x0 + 1;
+    int y1 = y0 + 1 == level->height ? 0 : y0 + 1;
+
+    const float* t00 = TEXEL(level, x0, y0);
+    const float* t10 = TEXEL(level, x1, y0);
+    const float* t01 = TEXEL(level, x0, y1);
+    const float* t11 = TEXEL(level, x1, y1);
+
+    for (int k = 0; k < 3; k++) {
+        float a = t00[k] + (t10[k] - t00[k]) * tx;
+        float b = t01[k] + (t11[k] - t01[k]) * tx;
+        sample[k] = a + (b - a) * ty;
+    }
+}
+
+HeightField*
+hfCreate(tgaInfo* info)
+{
+    if (!info || info->status != TGA_OK || info->pixelDepth < 8)
+        return NULL;
+
+    HeightField* field = (HeightField*)malloc(sizeof(HeightField));
+
+    /* halve each side, rounding down, until a single texel is left */
+    int w = info->width;
+    int h = info->height;
+    field->numlevels = 1;
+    while (w > 1 || h > 1) {
+        w = w > 1 ? w / 2 : 1;
+        h = h > 1 ? h / 2 : 1;
+        field->numlevels++;
+    }
+    field->levels = (hfLevel*)malloc(sizeof(hfLevel) * field->numlevels);
+
+    /* level 0 is the first channel of the image */
+    hfLevel* level = &field->levels[0];
+    int bytes = info->pixelDepth / 8;
+    hfAllocLevel(level, info->width, info->height);
+    for (int y = 0; y < level->height; y++) {
+        for (int x = 0; x < level->width; x++) {
+            int pixel = (y * level->width + x) * bytes;
+            TEXEL(level, x, y)[0] = info->imageData[pixel] / 255.0f;
+        }
+    }
+    hfSlopes(level);
+
+    /* each further level averages 2x2 texels of the one before; the last
+       row or column of an odd sized level is averaged into the one before */
+    for (int i = 1; i < field->numlevels; i++) {
+        const hfLevel* parent = &field->levels[i - 1];
+        level = &field->levels[i];
+        hfAllocLevel(level, parent->width > 1 ? parent->width / 2 : 1,
+                     parent->height > 1 ? parent->height / 2 : 1);
+
+        for (int y = 0; y < level->height; y++) {
+            int y0 = 2 * y;
+            int y1 = y == level->height - 1 ? parent->height : 2 * y + 2;
+            for (int x = 0; x < level->width; x++) {
+                int x0 = 2 * x;
+                int x1 = x == level->width - 1 ? parent->width : 2 * x + 2;
+
+                float sum = 0;
+                for (int py = y0; py < y1; py++) {
+                    for (int px = x0; px < x1; px++)
+                        sum += TEXEL(parent, px, py)[0];
+                }
+                TEXEL(level, x, y)[0] = sum / ((x1 - x0) * (y1 - y0));
+            }
+        }
+        hfSlopes(level);
+    }
+
+    return field;
+}
+
+void
+hfDelete(HeightField* field)
+{
+    if (!field)
+        return;
+
+    for (int i = 0; i < field->numlevels; i++)
+        free(field->levels[i].texels);
+    free(field->levels);
+    free(field);
+}
+
+float
+hfLevelFor(const HeightField* field, float texelsu, float texelsv,
+           float mintexel)
+{
+    float texels = (texelsu > texelsv ? texelsu : texelsv) * mintexel;
+    if (texels <= 1.0f)
+        return 0.0f;
+
+    float level = logf(texels) / logf(2.0f);
+    float top = (float)(field->numlevels - 1);
+    return level < top ? level : top;
+}
+
+void
+hfSample(const HeightField* field, float u, float v, float level,
+         float sample[3])
+{
+    if (level <= 0.0f) {
+        hfSampleLevel(&field->levels[0], u, v, sample);
+        return;
+    }
+
+    int top = field->numlevels - 1;
+    int i = (int)level;
+    if (i >= top) {
+        hfSampleLevel(&field->levels[top], u, v, sample);
+        return;
+    }
+
+    float coarse[3];
+    float t = level - i;
+    hfSampleLevel(&field->levels[i], u, v, sample);
+    hfSampleLevel(&field->levels[i + 1], u, v, coarse);
+    for (int k = 0; k < 3; k++)
+        sample[k] += (coarse[k] - sample[k]) * t;
+}
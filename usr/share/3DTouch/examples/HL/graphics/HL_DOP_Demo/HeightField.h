@@ -0,0 +1,94 @@
+/*****************************************************************************
+
+Copyright (c) 2009 SensAble Technologies, Inc. All rights reserved.
+
+OpenHaptics(TM) toolkit. The material embodied in this software and use of
+this software is subject to the terms and conditions of the clickthrough
+Development License Agreement.
+
+For questions, comments or bug reports, go to forums at:
+    http://dsc.sensable.com
+
+Module Name:
+
+  HeightField.h
+
+Description:
+
+A height map converted from a TGA image for sampling in the servo loop.
+The image is converted once into a pyramid of float levels, each half the
+size of the one before, and each texel stores its height together with the
+slope of the height along u and v.  A sample is then a few multiplies and
+eight texel reads, with no conversion and no finite differences.
+
+******************************************************************************/
+
+#ifndef _HEIGHTFIELD_H_
+#define _HEIGHTFIELD_H_
+
+#if defined(__APPLE__) || defined(MACOSX)
+#include <GLUT/glut.h>
+#else
+#include <GL/glut.h>
+#endif
+
+#include "tga.h"
+
+/* hfLevel: One level of the pyramid.  Texel (x, y) is at
+ * texels[4 * (y * width + x)] and holds the height, its slope along u and
+ * its slope along v, and one unused float.  The slopes are per unit of
+ * texture coordinate, so they have the same scale on every level.
+ */
+typedef struct {
+    int width;
+    int height;
+    float* texels;
+} hfLevel;
+
+/* HeightField: A height map with heights from 0 to 1.  levels[0] has the
+ * size of the image, and levels[numlevels - 1] is a single texel.
+ */
+typedef struct {
+    int numlevels;
+    hfLevel* levels;
+} HeightField;
+
+/* hfCreate: Converts the first channel of each pixel of a loaded TGA image
+ * into a height field, as the displacement mapping read it.  Returns NULL
+ * if the image was not loaded.  Free the height field with hfDelete().
+ *
+ * info - image loaded with tgaLoad
+ */
+HeightField* hfCreate(tgaInfo* info);
+
+/* hfDelete: Frees a height field created with hfCreate.
+ */
+void hfDelete(HeightField* field);
+
+/* hfLevelFor: Returns the level at which a texel covers at least the given
+ * distance on a surface, for sampling detail no finer than the device can
+ * render.  Fractional levels blend the two levels around them.
+ *
+ * field    - height field to sample
+ * texelsu  - level 0 texels along u per unit of distance
+ * texelsv  - level 0 texels along v per unit of distance
+ * mintexel - smallest texel wanted, in the same units of distance
+ */
+float hfLevelFor(const HeightField* field, float texelsu, float texelsv,
+                 float mintexel);
+
+/* hfSample: Samples the height and its slopes at texture coordinates
+ * (u, v), repeating the map outside 0 to 1 as the texture does.
+ * Interpolates bilinearly within a level and linearly between levels.
+ * Only reads the height field, so it may be called from the servo loop
+ * while other threads sample it too.
+ *
+ * field  - height field to sample
+ * u, v   - texture coordinates
+ * level  - level to sample, clamped to those there are
+ * sample - receives the height, dh/du and dh/dv
+ */
+void hfSample(const HeightField* field, float u, float v, float level,
+              float sample[3]);
+
+#endif
@@ -0,0 +1,247 @@
+/*****************************************************************************
+
+Copyright (c) 2009 SensAble Technologies, Inc. All rights reserved.
+
+OpenHaptics(TM) toolkit. The material embodied in this software and use of
+this software is subject to the terms and conditions of the clickthrough
+Development License Agreement.
+
+For questions, comments or bug reports, go to forums at:
+    http://dsc.sensable.com
+
+Module Name:
+
+  HeightFieldBenchmark.cpp
+
+Description:
+
+  Times one servo loop sample of the height map: the height and its slopes
+  at a texture coordinate.  Compares the height field against sampling the
+  TGA pixels directly as the displacement mapping did, which takes five
+  interpolations for the height and its slopes, and checks that they agree.
+  Usage: HeightFieldBenchmark [image.tga]
+
+******************************************************************************/
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+#include "HeightField.h"
+
+static const int kNumSamples = 1000000;
+static const int kSyntheticSize = 1024;
+
+static tgaInfo* info;
+
+static double getTime(void)
+{
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return now.tv_sec + now.tv_nsec * 1e-9;
+}
+
+/*******************************************************************************
+ Sampling the image as the displacement mapping did.
+*******************************************************************************/
+static float getPixel(int x, int y, int z)
+{
+    unsigned int bytes_per_pixel = info->pixelDepth / 8;
+    int pixelValue = ((z * info->height + y) * info->width + x) *
+        bytes_per_pixel;
+    return info->imageData[pixelValue];
+}
+
+static float trilinearInterp(float x, float y, float z)
+{
+    float px = x * info->width  - 0.5f;
+    float py = y * info->height - 0.5f;
+    float pz = z * info->pixelDepth - 0.5f;
+
+    if (px < 0) px = 0;
+    if (py < 0) py = 0;
+    if (pz < 0) pz = 0;
+
+    float fx = floor(px);
+    float fy = floor(py);
+    float fz = floor(pz);
+    float cx = ceil(px);
+    float cy = ceil(py);
+    float cz = ceil(pz);
+
+    if (cx >= info->width) cx--;
+    if (cy >= info->height) cy--;
+    if (cz >= info->pixelDepth) cz--;
+
+    float xd = px - fx;
+    float yd = py - fy;
+    float zd = pz - fz;
+    float fff = getPixel((int)fx, (int)fy, (int)fz);
+    float ffc = getPixel((int)fx, (int)fy, (int)cz);
+    float fcf = getPixel((int)fx, (int)cy, (int)fz);
+    float fcc = getPixel((int)fx, (int)cy, (int)cz);
+    float cff = getPixel((int)cx, (int)fy, (int)fz);
+    float cfc = getPixel((int)cx, (int)fy, (int)cz);
+    float ccf = getPixel((int)cx, (int)cy, (int)fz);
+    float ccc = getPixel((int)cx, (int)cy, (int)cz);
+    float i1 = fff * (1-zd) + ffc * zd;
+    float i2 = fcf * (1-zd) + fcc * zd;
+    float j1 = cff * (1-zd) + cfc * zd;
+    float j2 = ccf * (1-zd) + ccc * zd;
+    float w1 = i1 * (1-yd) + i2 * yd;
+    float w2 = j1 * (1-yd) + j2 * yd;
+    return w1 * (1-xd) + w2 * xd;
+}
+
+/* Height from 0 to 1 and its slopes, by central differences one texel
+   apart, as the servo loop would have to without precomputed slopes. */
+static void sampleImage(float u, float v, float sample[3])
+{
+    float du = 1.0f / info->width;
+    float dv = 1.0f / info->height;
+
+    sample[0] = trilinearInterp(u, v, 0) / 255;
+    sample[1] = (trilinearInterp(u + du, v, 0) -
+                 trilinearInterp(u - du, v, 0)) / (255 * 2 * du);
+    sample[2] = (trilinearInterp(u, v + dv, 0) -
+                 trilinearInterp(u, v - dv, 0)) / (255 * 2 * dv);
+}
+
+/*******************************************************************************
+ A greyscale image of overlapping ripples, for when no image is given.
+*******************************************************************************/
+static tgaInfo* makeImage(int size)
+{
+    tgaInfo* image = (tgaInfo*)calloc(1, sizeof(tgaInfo));
+    image->status = TGA_OK;
+    image->type = 3;
+    image->pixelDepth = 8;
+    image->width = size;
+    image->height = size;
+    image->imageData = (unsigned char*)malloc(size * size);
+
+    for (int y = 0; y < size; y++) {
+        for (int x = 0; x < size; x++) {
+            float u = (float)x / size;
+            float v = (float)y / size;
+            float h = 0.5f + 0.25f * sinf(40 * u) * cosf(30 * v) +
+                0.25f * sinf(170 * (u + v));
+            image->imageData[y * size + x] = (unsigned char)(h * 255);
+        }
+    }
+    return image;
+}
+
+/*******************************************************************************
+ Times every way of sampling at the given points.
+*******************************************************************************/
+static void benchmark(const char* name, HeightField* field, const float* uv)
+{
+    float sample[3];
+    float sum = 0;
+
+    printf("%s\n", name);
+
+    double t0 = getTime();
+    for (int i = 0; i < kNumSamples; i++) {
+        sum += trilinearInterp(uv[2 * i], uv[2 * i + 1], 0);
+    }
+    double t1 = getTime();
+    printf("  image height             %7.1f ns\n",
+           (t1 - t0) / kNumSamples * 1e9);
+
+    t0 = getTime();
+    for (int i = 0; i < kNumSamples; i++) {
+        sampleImage(uv[2 * i], uv[2 * i + 1], sample);
+        sum += sample[0] + sample[1] + sample[2];
+    }
+    t1 = getTime();
+    double imageTime = (t1 - t0) / kNumSamples;
+    printf("  image height and slopes  %7.1f ns\n", imageTime * 1e9);
+
+    static const float kLevels[] = { 0.0f, 2.5f };
+    for (int l = 0; l < 2; l++) {
+        t0 = getTime();
+        for (int i = 0; i < kNumSamples; i++) {
+            hfSample(field, uv[2 * i], uv[2 * i + 1], kLevels[l], sample);
+            sum += sample[0] + sample[1] + sample[2];
+        }
+        t1 = getTime();
+        printf("  height field, level %.1f %7.1f ns (%.1fx)\n", kLevels[l],
+               (t1 - t0) / kNumSamples * 1e9,
+               imageTime / ((t1 - t0) / kNumSamples));
+    }
+
+    if (sum == -1)
+        printf("\n");
+}
+
+/*******************************************************************************
+ main
+*******************************************************************************/
+int main(int argc, char* argv[])
+{
+    if (argc > 1) {
+        info = tgaLoad(argv[1]);
+        if (info->status != TGA_OK) {
+            fprintf(stderr, "Usage: %s [image.tga]\n", argv[0]);
+            return -1;
+        }
+    } else {
+        info = makeImage(kSyntheticSize);
+    }
+
+    double t0 = getTime();
+    HeightField* field = hfCreate(info);
+    double t1 = getTime();
+    printf("%d x %d image, %d levels, converted in %.1f ms\n",
+           info->width, info->height, field->numlevels, (t1 - t0) * 1e3);
+
+    /* points away from the border, where the image is clamped and the
+       height field repeats */
+    float* uv = (float*)malloc(sizeof(float) * 2 * kNumSamples);
+    for (int i = 0; i < 2 * kNumSamples; i++)
+        uv[i] = 0.01f + 0.98f * (rand() / (float)RAND_MAX);
+    benchmark("scattered points", field, uv);
+
+    /* a stroke across the surface, about a texel per servo loop tick, as
+       the device samples it */
+    float* stroke = (float*)malloc(sizeof(float) * 2 * kNumSamples);
+    for (int i = 0; i < kNumSamples; i++) {
+        float angle = i / (float)info->width;
+        float radius = 0.3f + 0.15f * sinf(angle * 0.07f);
+        stroke[2 * i] = 0.5f + radius * cosf(angle);
+        stroke[2 * i + 1] = 0.5f + radius * sinf(angle);
+    }
+    benchmark("stroke", field, stroke);
+
+    /* level 0 is the image: heights and slopes agree but for rounding */
+    float sample[3];
+    float maxHeight = 0;
+    float maxSlope = 0;
+    float maxError[2] = { 0, 0 };
+    for (int i = 0; i < 10000; i++) {
+        float expected[3];
+        sampleImage(uv[2 * i], uv[2 * i + 1], expected);
+        hfSample(field, uv[2 * i], uv[2 * i + 1], 0.0f, sample);
+
+        maxHeight = fmaxf(maxHeight, fabsf(expected[0]));
+        maxSlope = fmaxf(maxSlope, fmaxf(fabsf(expected[1]),
+                                         fabsf(expected[2])));
+        maxError[0] = fmaxf(maxError[0], fabsf(sample[0] - expected[0]));
+        maxError[1] = fmaxf(maxError[1], fmaxf(
+            fabsf(sample[1] - expected[1]), fabsf(sample[2] - expected[2])));
+    }
+    bool same = maxError[0] <= 1e-4f * maxHeight &&
+                maxError[1] <= 1e-3f * maxSlope;
+    printf("  level 0 against image: height error %.2g, slope error %.2g  "
+           "%s\n", maxError[0], maxError[1], same ? "same" : "DIFFERENT");
+
+    free(uv);
+    free(stroke);
+    hfDelete(field);
+    return 0;
+}
+
+/******************************************************************************/
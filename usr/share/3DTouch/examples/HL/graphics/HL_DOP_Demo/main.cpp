@@ -14,8 +14,10 @@ main.cpp
 Description:
 This example demonstrates the new Depth of Penetration Feature in HLAPI.
 This demo also contains special code for loading a 3d OBJ model and haptically
-height mapping a texture on top of it. This is a simple haptic displacement
-mapping technique.
+height mapping a texture on top of it. The height map is felt by force
+shading: in the servo loop, the force of the contact is tilted by the slope
+of the height map at the texture coordinates of the device position, so the
+bumps are felt on the plain model at 1 kHz.
 
 This example also shows how to integrate HDAPI and HLAPI using hdCallbacks
 according to the information given on page 6-38 of OpenHaptics Programmers
@@ -34,6 +36,8 @@ for best performance.
 #include <math.h>
 #include <assert.h>
 #include <stack>
+#include <string>
+#include <vector>
 
 #if defined(WIN32)
 #include <conio.h>
@@ -56,10 +60,13 @@ for best performance.
 #include <HDU/hduError.h>
 #include <HDU/hduMath.h>
 #include <HDU/hduBoundBox.h>
+#include <HDU/hduSpatialIndex.h>
+#include <HDU/hduTripleBuffer.h>
 
 #include <HLU/hlu.h>
 #include "GLM.h"
 #include "tga.h"
+#include "HeightField.h"
 
 //File Names
 char *model1Path("/examples/models/hiResPlane2.obj");
@@ -70,6 +77,34 @@ char *texture1Path("/examples/textures/Spine3.tga");
 tgaInfo *info;
 static float bumpScale = 3.0;
 
+// Height map felt on the model, and the smallest bump felt, in mm.
+HeightField *heightField = NULL;
+static const double kMinBumpSize = 0.5;
+
+// Below this force, in N, the contact is too light to shade.
+static const double kMinShadedForce = 0.01;
+
+// Centroids of the triangles of the model, for finding the touched one.
+hduKdTree triangleTree;
+static const int kTriangleCandidates = 8;
+
+// Maps device positions near the point of contact to texture coordinates.
+// Set by the graphics thread for the touched triangle, read in the servo loop.
+struct BumpContact
+{
+    bool active;
+    hduVector3Dd origin;        // Point of contact, workspace coordinates
+    double uv[2];               // Texture coordinates at origin
+    hduVector3Dd gradU;         // Change of u and v per mm
+    hduVector3Dd gradV;
+    double depth;               // Bump height in mm for height 1
+    float level;                // Height field level to sample
+
+    BumpContact() : active(false), depth(0), level(0) {}
+};
+
+hduTripleBuffer<BumpContact> bumpContact;
+
 /* Mouse Movement */
 static int oldMouseX,oldMouseY;
 static int currentMouseX,currentMouseY;
@@ -98,7 +133,6 @@ HLuint gPointId;
 
 //Display list for model
 GLuint objList;
-GLuint bumpList;
 GLuint toolObjList;
 
 hduMatrix m_viewTworld;
@@ -133,6 +167,10 @@ void HandleKeyboard(unsigned char key, int x, int y);
 void initGL();
 void initOBJModel();
 void initToolOBJModel();
+GLMmodel* readOBJModel(const char *path, const char *tag,
+                       void (*prepare)(GLMmodel *model));
+void prepareOBJModel(GLMmodel *model);
+void prepareToolOBJModel(GLMmodel *model);
 void initHL();
 
 void initScene();
@@ -143,9 +181,11 @@ void updateWorkspace();
 double DetermineFPS(void);
 void DrawBitmapString(GLfloat x, GLfloat y, void *font, char *format,...);
 int pixelLoadFromImage(char *filename, int normals);
-float trilinearInterp(float x, float y, float z);
-float getPixel(int x, int y, int z);
-void drawGLMbump();
+void initTriangleTree();
+double closestPointOnTriangle(const hduVector3Dd &p, const hduVector3Dd v[3],
+                              double bary[3]);
+void updateBumpContact();
+bool shadeBumpForce(hduVector3Dd &force);
 bool buildTGATexture(TextureImage *texture, char *filename);
 
 void HLCALLBACK hlTouchCB(HLenum event, HLuint object,
@@ -224,6 +264,10 @@ HDCallbackCode HDCALLBACK hdEndCB(void *data)
 
         hdSetDoublev(HD_CURRENT_FORCE, force*forceScaler);
     }
+    else if (shadeBumpForce(force))
+    {
+        hdSetDoublev(HD_CURRENT_FORCE, force*forceScaler);
+    }
 
 // calling hdEndFrame decrements the frame counter.
 // when the beginFrame counter reaches 0, forces are rendered.
@@ -475,6 +519,8 @@ void initScene()
         printf("Texture Loading successful \n\n");
     }
 
+    heightField = hfCreate(info);
+
     initOBJModel();
     initToolOBJModel();
     initGL();
@@ -525,6 +571,51 @@ void initGL()
 }
 
 
+/*******************************************************************************
+ Reads an OBJ model and prepares it, or maps the cache of a model prepared
+ the same way from the same file, written next to it on an earlier run.
+ The tag names what prepare does; change it whenever prepare changes.
+*******************************************************************************/
+GLMmodel* readOBJModel(const char *path, const char *tag,
+                       void (*prepare)(GLMmodel *model))
+{
+    std::string cachePath = std::string(path) + ".cache";
+
+    GLMmodel *model = glmReadCache(cachePath.c_str(), path, tag);
+    if (model)
+        return model;
+
+    model = glmReadOBJ(path);
+
+    if (!model)
+    {
+        printf("OBJ file does not exist \n");
+        exit(0);
+    }
+
+    prepare(model);
+
+    if (!glmWriteCache(model, cachePath.c_str(), path, tag))
+        std::cout<<"Could not write "<<cachePath<<std::endl;
+
+    return model;
+}
+
+void prepareOBJModel(GLMmodel *model)
+{
+    glmUnitize(model);
+    glmFacetNormals(model);
+    glmVertexNormals(model, 90.0);
+}
+
+void prepareToolOBJModel(GLMmodel *model)
+{
+    glmUnitize(model);
+    glmScale(model, 0.250);
+    glmFacetNormals(model);
+    glmVertexNormals(model, 90.0);
+}
+
 /*******************************************************************************
  Initialize the OBJ Model and create display list.
 *******************************************************************************/
@@ -532,17 +623,8 @@ void initOBJModel()
 {
     if (!objmodel)
     {
-        objmodel = glmReadOBJ(model1Path);
-
-        if (!objmodel)
-        {
-            printf("OBJ file does not exist \n");
-            exit(0);
-        }
-
-        glmUnitize(objmodel);
-        glmFacetNormals(objmodel);
-        glmVertexNormals(objmodel, 90.0);
+        objmodel = readOBJModel(model1Path, "unitize, normals 90",
+                                prepareOBJModel);
     }
 
 //Create display for the OBJ model
@@ -551,13 +633,29 @@ void initOBJModel()
     glmDraw(objmodel, GLM_SMOOTH | GLM_TEXTURE );
     glEndList();
 
-//Create the display list for the modified
-// displacement mapped OBJ Model
-    bumpList = glGenLists(1);
-    glNewList( bumpList, GL_COMPILE );
-    drawGLMbump();
+    initTriangleTree();
+}
 
-    glEndList();
+
+/*******************************************************************************
+ Indexes the triangles of the OBJ model by their centroids.
+*******************************************************************************/
+void initTriangleTree()
+{
+    std::vector<hduVector3Dd> centroids(objmodel->numtriangles);
+
+    for (int i = 0; i < objmodel->numtriangles; i++)
+    {
+        GLMtriangle *triangle = &objmodel->triangles[i];
+        for (int k = 0; k < 3; k++)
+        {
+            GLfloat *v = &objmodel->vertices[3 * triangle->vindices[k]];
+            centroids[i] += hduVector3Dd(v[0], v[1], v[2]) / 3.0;
+        }
+    }
+
+    if (!centroids.empty())
+        triangleTree.build(&centroids[0], (int) centroids.size());
 }
 
 
@@ -569,18 +667,9 @@ void initToolOBJModel()
 {
     if (!toolObjmodel)
     {
-        toolObjmodel = glmReadOBJ(model2Path);
-
-        if (!toolObjmodel)
-        {
-            printf("OBJ file does not exist \n");
-            exit(0);
-        }
-
-        glmUnitize(toolObjmodel);
-        glmScale(toolObjmodel, 0.250);
-        glmFacetNormals(toolObjmodel);
-        glmVertexNormals(toolObjmodel, 90.0);
+        toolObjmodel = readOBJModel(model2Path,
+                                    "unitize, scale 0.25, normals 90",
+                                    prepareToolOBJModel);
     }
 
     toolObjList = glGenLists(1);
@@ -662,6 +751,8 @@ void exitHandler()
     {
         hdDisableDevice(ghHD);
     }
+
+    hfDelete(heightField);
 }
 
 
@@ -718,8 +809,6 @@ void drawSceneGraphics()
     glEnable(GL_TEXTURE_2D);
     glPushMatrix();
     glCallList(objList);                      //Displays regular OBJ model
-
-//	glCallList(bumpList); //Displays displacement mapped OBJ model
     glPopMatrix();
 
 //Uncomment to see the Entry Point
@@ -763,9 +852,9 @@ void drawSceneHaptics()
     hlHinti(HL_SHAPE_FEEDBACK_BUFFER_VERTICES, objmodel->numvertices);
     hlBeginShape(HL_SHAPE_FEEDBACK_BUFFER, gShapeId);
 
-// Render haptic shape
+// Render haptic shape. The bumps are felt through force shading.
     glPushMatrix();
-    glCallList(bumpList);
+    glCallList(objList);
     glPopMatrix();
 
 // End the shape.
@@ -801,6 +890,8 @@ void drawSceneHaptics()
 
 // End the haptic frame.
     hlEndFrame();
+
+    updateBumpContact();
 }
 
 
@@ -988,133 +1079,224 @@ int pixelLoadFromImage(char *filename, int normals)
 
 
 /*******************************************************************************
- This is a simple trilinear interpolation function. Here the texture coordinates
- of the model are interpolated and mapped to the right pixel values from the image
-data loaded before.
+ Finds the point of a triangle closest to p as barycentric coordinates, and
+ returns its squared distance to p.
 *******************************************************************************/
-float trilinearInterp(float x, float y, float z)
+double closestPointOnTriangle(const hduVector3Dd &p, const hduVector3Dd v[3],
+                              double bary[3])
 {
-    float px = x * info->width  - 0.5f;
-    float py = y * info->height - 0.5f;
-    float pz = z * info->pixelDepth - 0.5f;
-
-    if( px < 0 ) px = 0;
-    if( py < 0 ) py = 0;
-    if( pz < 0 ) pz = 0;
-
-    float fx = floor( px );
-    float fy = floor( py );
-    float fz = floor( pz );
-    float cx = ceil( px );
-    float cy = ceil( py );
-    float cz = ceil( pz );
-
-    if( cx >= info->width ) cx--;
-    if( cy >= info->height) cy--;
-    if( cz >= info->pixelDepth ) cz--;
-
-    float xd = px - fx;
-    float yd = py - fy;
-    float zd = pz - fz; 
-    float fff = getPixel( (int)fx, (int)fy, (int)fz ); 
-    float ffc = getPixel( (int)fx, (int)fy, (int)cz ); 
-    float fcf = getPixel( (int)fx, (int)cy, (int)fz ); 
-    float fcc = getPixel( (int)fx, (int)cy, (int)cz ); 
-    float cff = getPixel( (int)cx, (int)fy, (int)fz );
-    float cfc = getPixel( (int)cx, (int)fy, (int)cz );
-    float ccf = getPixel( (int)cx, (int)cy, (int)fz );
-    float ccc = getPixel( (int)cx, (int)cy, (int)cz );
-    float i1 = fff * (1-zd) + ffc * zd;
-    float i2 = fcf * (1-zd) + fcc * zd;
-    float j1 = cff * (1-zd) + cfc * zd;
-    float j2 = ccf * (1-zd) + ccc * zd;
-    float w1 = i1 * (1-yd) + i2 * yd;
-    float w2 = j1 * (1-yd) + j2 * yd;
-    float v = w1 * (1-xd) + w2 * xd;
-
-    return v;
-}
+    hduVector3Dd ab = v[1] - v[0];
+    hduVector3Dd ac = v[2] - v[0];
 
+    hduVector3Dd ap = p - v[0];
+    double d1 = ab.dotProduct(ap);
+    double d2 = ac.dotProduct(ap);
 
-/******************************************************************************
-  Get the correct pixel value from the image pixel data loaded before
- ******************************************************************************/
-float getPixel(int x, int y, int z)
-{
-    unsigned int byte_rem = info->pixelDepth % 8;
-    unsigned int bytes_per_pixel = info->pixelDepth / 8;
-    float magicNum;
+    hduVector3Dd bp = p - v[1];
+    double d3 = ab.dotProduct(bp);
+    double d4 = ac.dotProduct(bp);
+
+    hduVector3Dd cp = p - v[2];
+    double d5 = ab.dotProduct(cp);
+    double d6 = ac.dotProduct(cp);
 
-    int pixelValue = ( ( z * info->height + y ) * info->width + x ) * bytes_per_pixel ;
+    double va = d3 * d6 - d5 * d4;
+    double vb = d5 * d2 - d1 * d6;
+    double vc = d1 * d4 - d3 * d2;
+
+    if (d1 <= 0 && d2 <= 0)
+    {
+        bary[0] = 1; bary[1] = 0; bary[2] = 0;
+    }
+    else if (d3 >= 0 && d4 <= d3)
+    {
+        bary[0] = 0; bary[1] = 1; bary[2] = 0;
+    }
+    else if (d6 >= 0 && d5 <= d6)
+    {
+        bary[0] = 0; bary[1] = 0; bary[2] = 1;
+    }
+    else if (vc <= 0 && d1 >= 0 && d3 <= 0)
+    {
+        double t = d1 / (d1 - d3);
+        bary[0] = 1 - t; bary[1] = t; bary[2] = 0;
+    }
+    else if (vb <= 0 && d2 >= 0 && d6 <= 0)
+    {
+        double t = d2 / (d2 - d6);
+        bary[0] = 1 - t; bary[1] = 0; bary[2] = t;
+    }
+    else if (va <= 0 && d4 >= d3 && d5 >= d6)
+    {
+        double t = (d4 - d3) / ((d4 - d3) + (d5 - d6));
+        bary[0] = 0; bary[1] = 1 - t; bary[2] = t;
+    }
+    else
+    {
+        double sum = va + vb + vc;
+        bary[1] = vb / sum;
+        bary[2] = vc / sum;
+        bary[0] = 1 - bary[1] - bary[2];
+    }
 
-    magicNum = info->imageData[pixelValue ];
-    return magicNum;
+    hduVector3Dd closest = bary[0] * v[0] + bary[1] * v[1] + bary[2] * v[2];
+    return p.distanceSqr(closest);
 }
 
 
 /*******************************************************************************
-  The obj model is modified by extruding the surface along the direction of
-  normals based on the height map (bumpValue) generated by the texture image.
+ Finds the triangle the proxy touches and hands the servo loop a mapping from
+ device positions around the point of contact to texture coordinates.  The
+ mapping is linear over the touched triangle, and is followed past its edges
+ until the next graphics frame finds the next triangle.
 *******************************************************************************/
-void drawGLMbump()
+void updateBumpContact()
 {
-    static GLMtriangle* trianglE;
-    static float bumpValue1,bumpValue2, bumpValue3;
-    hduVector3Dd verts;
+    BumpContact &contact = bumpContact.getWriteBuffer();
+    contact.active = false;
 
-    glBegin(GL_TRIANGLES);
+    HLboolean touching = HL_FALSE;
+    hlGetShapeBooleanv(gShapeId, HL_PROXY_IS_TOUCHING, &touching);
 
-    for (int i = 0; i < objmodel->numtriangles; i++)
+    if (touching && heightField && objmodel->numtexcoords > 0)
     {
-        trianglE = (&objmodel->triangles[i]);
-        glNormal3fv(&objmodel->normals[3 * trianglE->nindices[0]]);
-
-        bumpValue1 = trilinearInterp(objmodel->texcoords[2 * trianglE->tindices[0]+0], objmodel->texcoords[2 * trianglE->tindices[0]+1], 0.0);
-
-        bumpValue1 = bumpValue1/(info->width * bumpScale);
-
-        glTexCoord2fv(&objmodel->texcoords[2 * trianglE->tindices[0]]);
-
-        verts[0] = objmodel->vertices[3 * trianglE->vindices[0]+0] + bumpValue1 * objmodel->normals[3 * trianglE->nindices[0] + 0];
-
-        verts[1] = objmodel->vertices[3 * trianglE->vindices[0]+1] + bumpValue1 * objmodel->normals[3 * trianglE->nindices[0] + 1];
-
-        verts[2] = objmodel->vertices[3 * trianglE->vindices[0]+2] + bumpValue1 * objmodel->normals[3 * trianglE->nindices[0] + 2];
-
-        glVertex3f(verts[0], verts[1], verts[2]);
-        glNormal3fv(&objmodel->normals[3 * trianglE->nindices[1]]);
-
-        bumpValue2 = trilinearInterp(objmodel->texcoords[2 * trianglE->tindices[1]+0], objmodel->texcoords[2 * trianglE->tindices[1]+1], 0.0);
-
-        bumpValue2 = bumpValue2/(info->width * bumpScale);
-
-        glTexCoord2fv(&objmodel->texcoords[2 * trianglE->tindices[1]]);
-
-        verts[0] = objmodel->vertices[3 * trianglE->vindices[1]+0] + bumpValue2 * objmodel->normals[3 * trianglE->nindices[1] + 0];
-
-        verts[1] = objmodel->vertices[3 * trianglE->vindices[1]+1] + bumpValue2 * objmodel->normals[3 * trianglE->nindices[1] + 1];
+        static std::vector<int> candidates;
+        hduVector3Dd proxy;
+        hlGetDoublev(HL_PROXY_POSITION, proxy);
+        triangleTree.findKNearest(proxy, kTriangleCandidates, candidates);
+
+// The nearest centroid need not be on the nearest triangle, so check the
+// triangles of the few nearest centroids.
+        GLMtriangle *touched = NULL;
+        hduVector3Dd verts[3];
+        double bary[3];
+        double nearest = 0;
+
+        for (size_t i = 0; i < candidates.size(); i++)
+        {
+            GLMtriangle *triangle = &objmodel->triangles[candidates[i]];
+            hduVector3Dd v[3];
+            double b[3];
+
+            for (int k = 0; k < 3; k++)
+            {
+                GLfloat *p = &objmodel->vertices[3 * triangle->vindices[k]];
+                v[k].set(p[0], p[1], p[2]);
+            }
+
+            double dist = closestPointOnTriangle(proxy, v, b);
+            if (!touched || dist < nearest)
+            {
+                touched = triangle;
+                nearest = dist;
+                for (int k = 0; k < 3; k++)
+                {
+                    verts[k] = v[k];
+                    bary[k] = b[k];
+                }
+            }
+        }
 
-        verts[2] = objmodel->vertices[3 * trianglE->vindices[1]+2] + bumpValue2 * objmodel->normals[3 * trianglE->nindices[1] + 2];
+        if (touched)
+        {
+// The servo loop works in workspace coordinates.
+            hduMatrix worldTview;
+            hduMatrix viewTtouch;
+            hduMatrix touchTworkspace;
+            hlGetDoublev(HL_MODELVIEW_MATRIX, worldTview);
+            hlGetDoublev(HL_VIEWTOUCH_MATRIX, viewTtouch);
+            hlGetDoublev(HL_TOUCHWORKSPACE_MATRIX, touchTworkspace);
+            hduMatrix worldTworkspace = worldTview * viewTtouch * touchTworkspace;
+
+            hduVector3Dd w[3];
+            GLfloat *t[3];
+            contact.origin.set(0, 0, 0);
+            contact.uv[0] = contact.uv[1] = 0;
+
+            for (int k = 0; k < 3; k++)
+            {
+                worldTworkspace.multVecMatrix(verts[k], w[k]);
+                t[k] = &objmodel->texcoords[2 * touched->tindices[k]];
+                contact.origin += bary[k] * w[k];
+                contact.uv[0] += bary[k] * t[k][0];
+                contact.uv[1] += bary[k] * t[k][1];
+            }
+
+// Gradients of u and v in the plane of the triangle: gradU = a e1 + b e2
+// with gradU . e1 and gradU . e2 the change of u along the edges.
+            hduVector3Dd e1 = w[1] - w[0];
+            hduVector3Dd e2 = w[2] - w[0];
+            double g11 = e1.dotProduct(e1);
+            double g12 = e1.dotProduct(e2);
+            double g22 = e2.dotProduct(e2);
+            double det = g11 * g22 - g12 * g12;
+
+            if (det > 1e-9 * g11 * g22)
+            {
+                double du1 = t[1][0] - t[0][0];
+                double du2 = t[2][0] - t[0][0];
+                double dv1 = t[1][1] - t[0][1];
+                double dv2 = t[2][1] - t[0][1];
+
+                contact.gradU = ((g22 * du1 - g12 * du2) / det) * e1 +
+                                ((g11 * du2 - g12 * du1) / det) * e2;
+                contact.gradV = ((g22 * dv1 - g12 * dv2) / det) * e1 +
+                                ((g11 * dv2 - g12 * dv1) / det) * e2;
+
+// Same height as the displacement mapping used: pixel / (width * bumpScale)
+// in model units, scaled to mm.
+                double scale = e1.magnitude() /
+                               (verts[1] - verts[0]).magnitude();
+                contact.depth = 255.0 / (info->width * bumpScale) * scale;
+
+                contact.level = hfLevelFor(heightField,
+                    heightField->levels[0].width * contact.gradU.magnitude(),
+                    heightField->levels[0].height * contact.gradV.magnitude(),
+                    kMinBumpSize);
+                contact.active = true;
+            }
+        }
+    }
 
-        glVertex3f(verts[0], verts[1], verts[2]);
-        glNormal3fv(&objmodel->normals[3 * trianglE->nindices[2]]);
+    bumpContact.publish();
+}
 
-        bumpValue3 = trilinearInterp(objmodel->texcoords[2 * trianglE->tindices[2]+0], objmodel->texcoords[2 * trianglE->tindices[2]+1], 0.0);
 
-        bumpValue3 = bumpValue3 /(info->width * bumpScale);
+/*******************************************************************************
+ Called from the servo loop.  Tilts the contact force against the slope of
+ the height map at the device position, keeping its size, so that the plain
+ surface pushes back as the bumpy one would.  Returns false, leaving the
+ force as it is, if the proxy is not touching the model.
+*******************************************************************************/
+bool shadeBumpForce(hduVector3Dd &force)
+{
+    bumpContact.update();
+    const BumpContact &contact = bumpContact.getReadBuffer();
 
-        glTexCoord2fv(&objmodel->texcoords[2 * trianglE->tindices[2]]);
+    double magnitude = force.magnitude();
+    if (!contact.active || magnitude < kMinShadedForce)
+        return false;
 
-        verts[0] = objmodel->vertices[3 * trianglE->vindices[2]+0] + bumpValue3 * objmodel->normals[3 * trianglE->nindices[2] + 0];
+    hduVector3Dd position;
+    hdGetDoublev(HD_CURRENT_POSITION, position);
+    hduVector3Dd offset = position - contact.origin;
 
-        verts[1] = objmodel->vertices[3 * trianglE->vindices[2]+1] + bumpValue3 * objmodel->normals[3 * trianglE->nindices[2] + 1];
+    float sample[3];
+    hfSample(heightField,
+             (float) (contact.uv[0] + contact.gradU.dotProduct(offset)),
+             (float) (contact.uv[1] + contact.gradV.dotProduct(offset)),
+             contact.level, sample);
 
-        verts[2] = objmodel->vertices[3 * trianglE->vindices[2]+2] + bumpValue3 * objmodel->normals[3 * trianglE->nindices[2] + 2];
+    hduVector3Dd normal = force / magnitude;
+    hduVector3Dd slope = contact.depth *
+        (sample[1] * contact.gradU + sample[2] * contact.gradV);
+    slope -= slope.dotProduct(normal) * normal;
 
-        glVertex3f(verts[0], verts[1], verts[2]);
-    }
+    normal -= slope;
+    normal.normalize();
+    force = magnitude * normal;
 
-    glEnd();
+    return true;
 }
 
 
@@ -18,6 +18,9 @@ Description:
   This example demonstrates basic haptic rendering of a shape
   using two haptic devices.  It will not run unless you have
   more than one haptic device installed on your computer.
+  An hduDeviceGroup reads the buttons of every device in one
+  servo loop tick, and a cursor turns purple while a button
+  of its device is down.
 
 ******************************************************************************/
 
@@ -38,17 +41,22 @@ Description:
 #include <HL/hl.h>
 #include <HDU/hduMatrix.h>
 #include <HDU/hduError.h>
+#include <HDU/hduDeviceGroup.h>
 
 #include <HLU/hlu.h>
 
-static HHD hHD1 = HD_INVALID_HANDLE;
-static HHD hHD2 = HD_INVALID_HANDLE;
-static HHLRC hHLRC1 = 0;
-static HHLRC hHLRC2 = 0;
+// the devices to render with; add names for more of them
+static const char *kDeviceNames[] = { "PHANToM 1", "PHANToM 2" };
+static const int kNumDevices = sizeof(kDeviceNames) / sizeof(kDeviceNames[0]);
 
-// shape id for shape we will render haptically
-HLuint sphereShapeId1;
-HLuint sphereShapeId2;
+static HHD hHDs[kNumDevices];
+static HHLRC hHLRCs[kNumDevices];
+
+// shape id for shape we will render haptically, one per context
+HLuint sphereShapeIds[kNumDevices];
+
+// reads the state of every device in one servo loop callback
+static hduDeviceGroup gDeviceGroup;
 
 #define CURSOR_SIZE_PIXELS 20
 static double gCursorScale;
@@ -68,7 +76,7 @@ void initHL(HHD hHD, HHLRC &hHLRC, HLuint &shapeId);
 void initScene();
 void drawSceneHaptics(HLuint shapeId);
 void drawSceneGraphics();
-void drawCursor(HLfloat color);
+void drawCursor(HLfloat color, HDint buttons);
 void updateWorkspace();
 
 /*******************************************************************************
@@ -107,11 +115,11 @@ int main(int argc, char *argv[])
 *******************************************************************************/
 void glutDisplay()
 {   
-    hlMakeCurrent(hHLRC1);
-    drawSceneHaptics(sphereShapeId1);
-
-    hlMakeCurrent(hHLRC2);
-    drawSceneHaptics(sphereShapeId2);
+    for (int i = 0; i < kNumDevices; i++)
+    {
+        hlMakeCurrent(hHLRCs[i]);
+        drawSceneHaptics(sphereShapeIds[i]);
+    }
 
     drawSceneGraphics();
 
@@ -149,10 +157,11 @@ void glutReshape(int width, int height)
               0, 0, 0,
               0, 1, 0);
     
-    hlMakeCurrent(hHLRC1);
-    updateWorkspace();
-    hlMakeCurrent(hHLRC2);
-    updateWorkspace();    
+    for (int i = 0; i < kNumDevices; i++)
+    {
+        hlMakeCurrent(hHLRCs[i]);
+        updateWorkspace();
+    }
 }
 
 /*******************************************************************************
@@ -185,12 +194,34 @@ void initScene()
     // Initialize HDAPI first, so that the device instances exist in the system
     // All device instances need to exist before starting the scheduler,
     // which gets started automatically by the first created context
-    initHD("PHANToM 1", hHD1);
-    initHD("PHANToM 2", hHD2);
+    for (int i = 0; i < kNumDevices; i++)
+    {
+        hHDs[i] = HD_INVALID_HANDLE;
+    }
+
+    for (int i = 0; i < kNumDevices; i++)
+    {
+        initHD(kDeviceNames[i], hHDs[i]);
+        gDeviceGroup.addDevice(hHDs[i]);
+    }
 
     // Initialize the contexts and give each one a handle to a device instance
-    initHL(hHD1, hHLRC1, sphereShapeId1);
-    initHL(hHD2, hHLRC2, sphereShapeId2);
+    for (int i = 0; i < kNumDevices; i++)
+    {
+        initHL(hHDs[i], hHLRCs[i], sphereShapeIds[i]);
+    }
+
+    // Start reading the devices.  The group sets no forces, so it leaves
+    // force rendering to the contexts, whose frames nest inside its own.
+    if (!gDeviceGroup.start())
+    {
+        gDeviceGroup.update();
+        HDErrorInfo error = gDeviceGroup.getSnapshot().error;
+        hduPrintError(stderr, &error, "Failed to schedule the device group");
+        fprintf(stderr, "Press any key to exit");
+        getchar();
+        exit(-1);
+    }
 }
 
 /*******************************************************************************
@@ -269,32 +300,37 @@ void initHL(HHD hHD, HHLRC &hHLRC, HLuint &shapeId)
 *******************************************************************************/
 void exitHandler()
 {
-    // deallocate the sphere shape id we reserved in in initHL
-    hlDeleteShapes(sphereShapeId1, 1);
-    hlDeleteShapes(sphereShapeId2, 1);
-
-    // free up the haptic rendering context
-    hlMakeCurrent(NULL);
+    // stop reading the devices before they go away
+    gDeviceGroup.stop();
 
-    if (hHLRC1 != NULL)
+    // deallocate the sphere shape ids we reserved in in initHL
+    for (int i = 0; i < kNumDevices; i++)
     {
-        hlDeleteContext(hHLRC1);
+        if (hHLRCs[i] != NULL)
+        {
+            hlMakeCurrent(hHLRCs[i]);
+            hlDeleteShapes(sphereShapeIds[i], 1);
+        }
     }
 
-    if (hHLRC2 != NULL)
-    {
-        hlDeleteContext(hHLRC2);
-    }
+    // free up the haptic rendering contexts
+    hlMakeCurrent(NULL);
 
-    // free up the haptic device
-    if (hHD1 != HD_INVALID_HANDLE)
+    for (int i = 0; i < kNumDevices; i++)
     {
-        hdDisableDevice(hHD1);
+        if (hHLRCs[i] != NULL)
+        {
+            hlDeleteContext(hHLRCs[i]);
+        }
     }
 
-    if (hHD2 != HD_INVALID_HANDLE)
+    // free up the haptic devices
+    for (int i = 0; i < kNumDevices; i++)
     {
-        hdDisableDevice(hHD2);
+        if (hHDs[i] != HD_INVALID_HANDLE)
+        {
+            hdDisableDevice(hHDs[i]);
+        }
     }
 }
 
@@ -331,11 +367,17 @@ void drawSceneGraphics()
 {
     glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);           
 
+    // get the buttons of all the devices, as of the same servo loop tick
+    gDeviceGroup.update();
+    const hduDeviceGroup::Snapshot &snapshot = gDeviceGroup.getSnapshot();
+
     // draw 3D cursor at haptic device position
-    hlMakeCurrent(hHLRC1);
-    drawCursor(0.5);
-    hlMakeCurrent(hHLRC2);
-    drawCursor(1.0);
+    for (int i = 0; i < kNumDevices; i++)
+    {
+        HDint buttons = i < snapshot.nDevices ? snapshot.devices[i].buttons : 0;
+        hlMakeCurrent(hHLRCs[i]);
+        drawCursor((HLfloat) (i + 1) / kNumDevices, buttons);
+    }
 
     // draw a sphere using OpenGL
     glutSolidSphere(0.5, 32, 32);
@@ -372,7 +414,7 @@ void drawSceneHaptics(HLuint shapeId)
  Draw a 3D cursor for the haptic device using the current local transform,
  the workspace to world transform and the screen coordinate scale.
 *******************************************************************************/
-void drawCursor(HLfloat color)
+void drawCursor(HLfloat color, HDint buttons)
 {
     static const double kCursorRadius = 0.5;
     static const double kCursorHeight = 1.5;
@@ -408,7 +450,7 @@ void drawCursor(HLfloat color)
     glScaled(gCursorScale, gCursorScale, gCursorScale);
 
     glEnable(GL_COLOR_MATERIAL);
-    glColor3f(0.0, color, 1.0);
+    glColor3f(buttons ? 1.0 : 0.0, color, 1.0);
 
     glCallList(gCursorDisplayList);
 
@@ -0,0 +1,94 @@
+/*****************************************************************************
+
+Copyright (c) 2004 SensAble Technologies, Inc. All rights reserved.
+
+OpenHaptics(TM) toolkit. The material embodied in this software and use of
+this software is subject to the terms and conditions of the clickthrough
+Development License Agreement.
+
+For questions, comments or bug reports, go to forums at:
+    http://dsc.sensable.com
+
+Module Name:
+
+  BlockSparseMatrix.cpp
+
+Description:
+
+  Sparse symmetric matrix of 3x3 blocks, for the derivatives of the forces
+  between particles.
+
+*******************************************************************************/
+
+#include "BlockSparseMatrix.h"
+#include <assert.h>
+#include <algorithm>
+
+BlockSparseMatrix::BlockSparseMatrix() :
+    mNumBlocks(0)
+{
+}
+
+void BlockSparseMatrix::setPattern(int numBlocks, int numPairs,
+                                   const int *rows, const int *cols)
+{
+    mNumBlocks = numBlocks;
+    mRows.assign(rows, rows + numPairs);
+    mCols.assign(cols, cols + numPairs);
+    mDiagonal.resize(9 * numBlocks);
+    mPairs.resize(9 * numPairs);
+
+    for (int k = 0; k < numPairs; k++)
+    {
+        assert(rows[k] >= 0 && rows[k] < numBlocks);
+        assert(cols[k] >= 0 && cols[k] < numBlocks);
+        assert(rows[k] != cols[k]);
+    }
+
+    zero();
+}
+
+void BlockSparseMatrix::zero(void)
+{
+    std::fill(mDiagonal.begin(), mDiagonal.end(), 0.0);
+    std::fill(mPairs.begin(), mPairs.end(), 0.0);
+}
+
+void BlockSparseMatrix::multiply(const double *x, double *y) const
+{
+    assert(x != y);
+
+    for (int i = 0; i < mNumBlocks; i++)
+    {
+        const double *d = &mDiagonal[9 * i];
+        const double *xi = x + 3 * i;
+        double *yi = y + 3 * i;
+
+        yi[0] = d[0] * xi[0] + d[1] * xi[1] + d[2] * xi[2];
+        yi[1] = d[3] * xi[0] + d[4] * xi[1] + d[5] * xi[2];
+        yi[2] = d[6] * xi[0] + d[7] * xi[1] + d[8] * xi[2];
+    }
+
+    const int numPairs = mRows.size();
+
+    for (int k = 0; k < numPairs; k++)
+    {
+        const double *m = &mPairs[9 * k];
+        const double *xr = x + 3 * mRows[k];
+        const double *xc = x + 3 * mCols[k];
+        double *yr = y + 3 * mRows[k];
+        double *yc = y + 3 * mCols[k];
+
+        /* the block at (row, col) ... */
+        yr[0] += m[0] * xc[0] + m[1] * xc[1] + m[2] * xc[2];
+        yr[1] += m[3] * xc[0] + m[4] * xc[1] + m[5] * xc[2];
+        yr[2] += m[6] * xc[0] + m[7] * xc[1] + m[8] * xc[2];
+
+        /* ... and its transpose at (col, row) */
+        yc[0] += m[0] * xr[0] + m[3] * xr[1] + m[6] * xr[2];
+        yc[1] += m[1] * xr[0] + m[4] * xr[1] + m[7] * xr[2];
+        yc[2] += m[2] * xr[0] + m[5] * xr[1] + m[8] * xr[2];
+    }
+}
+
+/******************************************************************************/
@@ -0,0 +1,83 @@
+/*****************************************************************************
+
+Copyright (c) 2004 SensAble Technologies, Inc. All rights reserved.
+
+OpenHaptics(TM) toolkit. The material embodied in this software and use of
+this software is subject to the terms and conditions of the clickthrough
+Development License Agreement.
+
+For questions, comments or bug reports, go to forums at:
+    http://dsc.sensable.com
+
+Module Name:
+
+  BlockSparseMatrix.h
+
+Description:
+
+  Sparse symmetric matrix of 3x3 blocks, for the derivatives of the forces
+  between particles.
+
+*******************************************************************************/
+
+#ifndef BlockSparseMatrix_H_
+#define BlockSparseMatrix_H_
+
+#if _MSC_VER > 1000
+#pragma once
+#endif // _MSC_VER > 1000
+
+#include <vector>
+
+/* A block on the diagonal for every particle, and one block for each pair
+   of particles that a force couples, such as the two ends of a spring.  A
+   pair's block stands for both (row, col) and its transpose at (col, row),
+   which is what makes the matrix symmetric.  The same pair may be listed
+   more than once; the blocks add.
+
+   The pairs are set once, when the system is built, and the blocks are
+   refilled every step.  Blocks are row major, 9 doubles each. */
+class BlockSparseMatrix
+{
+public:
+    BlockSparseMatrix();
+
+    /* Pair k couples particles rows[k] and cols[k]; the blocks are zeroed. */
+    void setPattern(int numBlocks, int numPairs, const int *rows,
+                    const int *cols);
+
+    int getNumBlocks(void) const { return mNumBlocks; }
+    int getNumPairs(void) const { return mRows.size(); }
+    int getPairRow(int k) const { return mRows[k]; }
+    int getPairCol(int k) const { return mCols[k]; }
+
+    void zero(void);
+
+    double *getDiagonal(int i) { return &mDiagonal[9 * i]; }
+    const double *getDiagonal(int i) const { return &mDiagonal[9 * i]; }
+    double *getPair(int k) { return &mPairs[9 * k]; }
+    const double *getPair(int k) const { return &mPairs[9 * k]; }
+
+    /* y = A x, where x and y hold 3 values per block and y is not x. */
+    void multiply(const double *x, double *y) const;
+
+private:
+    int mNumBlocks;
+    std::vector<int> mRows;
+    std::vector<int> mCols;
+    std::vector<double> mDiagonal;
+    std::vector<double> mPairs;
+};
+
+/* Adds s * m to the 3x3 block b. */
+inline void addScaledBlock(double *b, double s, const double *m)
+{
+    for (int i = 0; i < 9; i++)
+    {
+        b[i] += s * m[i];
+    }
+}
+
+#endif // BlockSparseMatrix_H_
+
+/*****************************************************************************/
@@ -34,6 +34,13 @@ public:
     virtual void ApplyConstraint(ParticleListT &particles) = 0;
     virtual void Draw(ParticleListT &particles) = 0;
     virtual void FlexToSystem(ParticleListT &particles) = 0;
+
+    /* For the implicit solver: adds the derivatives of the constraint's
+       forces, as SpringTable::AddJacobians does.  Constraints whose forces
+       don't depend on the particles' state needn't. */
+    virtual void AddJacobians(ParticleListT &particles,
+                              BlockSparseMatrix &dfdx,
+                              BlockSparseMatrix &dfdv) {}
 };
 
 #endif // Constraint_H_
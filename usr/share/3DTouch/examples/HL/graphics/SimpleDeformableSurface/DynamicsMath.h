@@ -57,6 +57,61 @@ public:
     }
 };
 
+/* result = x + a * y, in a single pass without temporaries.
+   result may be x or y.  Resizes result only if needed, so it does
+   not allocate once result has the right size.  The ODE solvers use
+   these instead of the operators below, which allocate a new vector
+   per operation. */
+inline void addScaled(nvectord& result, const nvectord& x,
+                      double a, const nvectord& y)
+{
+    const int size = x.size();
+
+    assert(size == y.size());
+
+    result.resize(size);
+    if (size == 0)
+        return;
+
+    double *r = &result[0];
+    const double *px = &x[0];
+    const double *py = &y[0];
+
+    for (int i = 0; i < size; i++)
+    {
+        r[i] = px[i] + a * py[i];
+    }
+}
+
+/* result = x + a1 * y1 + a2 * y2 + a3 * y3 + a4 * y4, in a single pass. */
+inline void addScaled(nvectord& result, const nvectord& x,
+                      double a1, const nvectord& y1,
+                      double a2, const nvectord& y2,
+                      double a3, const nvectord& y3,
+                      double a4, const nvectord& y4)
+{
+    const int size = x.size();
+
+    assert(size == y1.size() && size == y2.size() &&
+           size == y3.size() && size == y4.size());
+
+    result.resize(size);
+    if (size == 0)
+        return;
+
+    double *r = &result[0];
+    const double *px = &x[0];
+    const double *py1 = &y1[0];
+    const double *py2 = &y2[0];
+    const double *py3 = &y3[0];
+    const double *py4 = &y4[0];
+
+    for (int i = 0; i < size; i++)
+    {
+        r[i] = px[i] + a1 * py1[i] + a2 * py2[i] + a3 * py3[i] + a4 * py4[i];
+    }
+}
+
 inline nvectord operator*(const nvectord& v1, const nvectord& v2)
 {
     const int size = v1.size();
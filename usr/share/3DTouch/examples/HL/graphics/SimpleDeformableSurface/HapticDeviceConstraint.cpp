@@ -38,10 +38,8 @@ void HapticDeviceConstraint::ApplyConstraint(ParticleListT &particles)
     if (!mState)    // don't apply if not active
         return;
         
-    Particle *p1 = particles[mParticle];
-        
-    if (!p1->fixed)
-        p1->f += mForce;
+    if (!particles.IsFixed(mParticle))
+        particles.f[mParticle] += mForce;
 }
 
 void HapticDeviceConstraint::Draw(ParticleListT &particles)
@@ -52,12 +50,12 @@ void HapticDeviceConstraint::Draw(ParticleListT &particles)
     float c[] = { .5, 0, 1 };
     glColor3fv(c);
 
-    Particle *p1 = particles[mParticle];
+    const hduVector3Dd &x = particles.x[mParticle];
 
     glBegin(GL_LINES);
         
-    glVertex3dv(p1->x);
-    glVertex3dv(p1->x + mForce);
+    glVertex3dv(x);
+    glVertex3dv(x + mForce);
         
     glEnd();
 }
@@ -0,0 +1,382 @@
+/*****************************************************************************
+
+Copyright (c) 2004 SensAble Technologies, Inc. All rights reserved.
+
+OpenHaptics(TM) toolkit. The material embodied in this software and use of
+this software is subject to the terms and conditions of the clickthrough
+Development License Agreement.
+
+For questions, comments or bug reports, go to forums at:
+    http://dsc.sensable.com
+
+Module Name:
+
+  ImplicitSolverBenchmark.cpp
+
+Description:
+
+  Drops a stiff cloth, hung by two corners, with OdeSolverRungeKutta4 and
+  with OdeSolverImplicitEuler at a range of step sizes.  Prints for each
+  whether it stayed stable, how far it ended from a run with very small
+  steps, and what a second of simulated time cost.
+  Usage: ImplicitSolverBenchmark [particles along each side] [ks]
+
+*******************************************************************************/
+
+#include "OdeSolver.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <math.h>
+#include <time.h>
+
+/* Number of values per particle: position and velocity. */
+static const int kStateSize = 6;
+
+static const double kClothSize = 1;
+static const double kClothMass = 1;
+static const double kDamping = 0.5;
+static const double kDrag = 0.01;
+static const double kGravity = 9.8;
+
+/* Simulated time per run. */
+static const double kDuration = 1;
+
+/* A run is unstable once a spring is stretched this far past its rest
+   length, or anything is no longer a number. */
+static const double kMaxStrain = 1;
+
+static const double kReferenceStep = 0.0001;
+
+struct Cloth
+{
+    int n;
+    double ks;
+    double kd;
+    double invMass;
+    std::vector<int> particle1;
+    std::vector<int> particle2;
+    std::vector<double> restLength;
+};
+
+static double getTime()
+{
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return now.tv_sec + now.tv_nsec * 1e-9;
+}
+
+static bool isPinned(const Cloth &cloth, int i)
+{
+    return i == 0 || i == cloth.n - 1;
+}
+
+static void addSpring(Cloth &cloth, const nvectord &x, int a, int b)
+{
+    double d[3];
+    for (int j = 0; j < 3; j++)
+    {
+        d[j] = x[kStateSize * a + j] - x[kStateSize * b + j];
+    }
+
+    cloth.particle1.push_back(a);
+    cloth.particle2.push_back(b);
+    cloth.restLength.push_back(sqrt(d[0] * d[0] + d[1] * d[1] + d[2] * d[2]));
+}
+
+/* A horizontal n x n sheet, with springs along the rows, the columns and
+   both diagonals, as Surface builds it. */
+static void makeCloth(Cloth &cloth, nvectord &x, int n, double ks)
+{
+    cloth.n = n;
+    cloth.ks = ks;
+    cloth.kd = kDamping;
+    cloth.invMass = n * n / kClothMass;
+
+    x.assign(kStateSize * n * n, 0);
+    double spacing = kClothSize / (n - 1);
+    for (int i = 0; i < n; i++)
+    {
+        for (int k = 0; k < n; k++)
+        {
+            x[kStateSize * (i * n + k)] = k * spacing;
+            x[kStateSize * (i * n + k) + 2] = i * spacing;
+        }
+    }
+
+    for (int i = 0; i < n; i++)
+    {
+        for (int k = 0; k < n; k++)
+        {
+            int p = i * n + k;
+            if (k + 1 < n)
+                addSpring(cloth, x, p, p + 1);
+            if (i + 1 < n)
+                addSpring(cloth, x, p, p + n);
+            if (i + 1 < n && k + 1 < n)
+            {
+                addSpring(cloth, x, p, p + n + 1);
+                addSpring(cloth, x, p + 1, p + n);
+            }
+        }
+    }
+}
+
+static bool clothDxDt(double t, nvectord &x, nvectord &xdot, void *userData)
+{
+    const Cloth &cloth = *static_cast<const Cloth *>(userData);
+    const int numParticles = cloth.n * cloth.n;
+    const int numSprings = cloth.particle1.size();
+
+    for (int i = 0; i < numParticles; i++)
+    {
+        double *xd = &xdot[kStateSize * i];
+        const double *v = &x[kStateSize * i + 3];
+
+        xd[0] = v[0];
+        xd[1] = v[1];
+        xd[2] = v[2];
+
+        /* the forces, for now */
+        xd[3] = -kDrag * v[0];
+        xd[4] = -kDrag * v[1] - kGravity / cloth.invMass;
+        xd[5] = -kDrag * v[2];
+    }
+
+    for (int s = 0; s < numSprings; s++)
+    {
+        const double *xa = &x[kStateSize * cloth.particle1[s]];
+        const double *xb = &x[kStateSize * cloth.particle2[s]];
+        double d[3], dv[3];
+        for (int j = 0; j < 3; j++)
+        {
+            d[j] = xa[j] - xb[j];
+            dv[j] = xa[3 + j] - xb[3 + j];
+        }
+
+        double dist = sqrt(d[0] * d[0] + d[1] * d[1] + d[2] * d[2]);
+        double scale = -(cloth.ks * (dist - cloth.restLength[s]) +
+                         cloth.kd * (d[0] * dv[0] + d[1] * dv[1] +
+                                     d[2] * dv[2]) / dist) / dist;
+
+        double *fa = &xdot[kStateSize * cloth.particle1[s] + 3];
+        double *fb = &xdot[kStateSize * cloth.particle2[s] + 3];
+        for (int j = 0; j < 3; j++)
+        {
+            fa[j] += scale * d[j];
+            fb[j] -= scale * d[j];
+        }
+    }
+
+    for (int i = 0; i < numParticles; i++)
+    {
+        double invMass = isPinned(cloth, i) ? 0 : cloth.invMass;
+        for (int j = 3; j < 6; j++)
+        {
+            xdot[kStateSize * i + j] *= invMass;
+        }
+    }
+
+    return false;
+}
+
+/* The same derivatives as SpringTable::AddJacobians. */
+static void clothJacobians(double t, nvectord &x, BlockSparseMatrix &dfdx,
+                           BlockSparseMatrix &dfdv, nvectord &invMass,
+                           void *userData)
+{
+    const Cloth &cloth = *static_cast<const Cloth *>(userData);
+    const int numParticles = cloth.n * cloth.n;
+    const int numSprings = cloth.particle1.size();
+
+    for (int s = 0; s < numSprings; s++)
+    {
+        int a = cloth.particle1[s];
+        int b = cloth.particle2[s];
+        double d[3];
+        for (int j = 0; j < 3; j++)
+        {
+            d[j] = x[kStateSize * a + j] - x[kStateSize * b + j];
+        }
+
+        double dist = sqrt(d[0] * d[0] + d[1] * d[1] + d[2] * d[2]);
+        double slack = fmax(0, 1 - cloth.restLength[s] / dist);
+
+        double kx[9], kv[9];
+        for (int i = 0; i < 3; i++)
+        {
+            for (int j = 0; j < 3; j++)
+            {
+                double nn = d[i] * d[j] / (dist * dist);
+                kx[3 * i + j] = -cloth.ks * (nn + slack * ((i == j) - nn));
+                kv[3 * i + j] = -cloth.kd * nn;
+            }
+        }
+
+        addScaledBlock(dfdx.getDiagonal(a), 1, kx);
+        addScaledBlock(dfdx.getDiagonal(b), 1, kx);
+        addScaledBlock(dfdx.getPair(s), -1, kx);
+        addScaledBlock(dfdv.getDiagonal(a), 1, kv);
+        addScaledBlock(dfdv.getDiagonal(b), 1, kv);
+        addScaledBlock(dfdv.getPair(s), -1, kv);
+    }
+
+    for (int i = 0; i < numParticles; i++)
+    {
+        double *jv = dfdv.getDiagonal(i);
+        jv[0] -= kDrag;
+        jv[4] -= kDrag;
+        jv[8] -= kDrag;
+
+        invMass[i] = isPinned(cloth, i) ? 0 : cloth.invMass;
+    }
+}
+
+static bool isStable(const Cloth &cloth, const nvectord &x)
+{
+    const int numSprings = cloth.particle1.size();
+
+    for (int s = 0; s < numSprings; s++)
+    {
+        const double *xa = &x[kStateSize * cloth.particle1[s]];
+        const double *xb = &x[kStateSize * cloth.particle2[s]];
+        double dist = sqrt((xa[0] - xb[0]) * (xa[0] - xb[0]) +
+                           (xa[1] - xb[1]) * (xa[1] - xb[1]) +
+                           (xa[2] - xb[2]) * (xa[2] - xb[2]));
+
+        /* also false for NaN */
+        if (!(dist <= (1 + kMaxStrain) * cloth.restLength[s]))
+            return false;
+    }
+    return true;
+}
+
+struct RunResult
+{
+    bool stable;
+    double seconds;         // wall time
+    double iterations;      // per step, for the implicit solver
+};
+
+/* Steps the cloth from x for kDuration with steps of h. */
+static RunResult run(IOdeSolver &solver, Cloth &cloth, nvectord &x, double h)
+{
+    OdeSolverImplicitEuler *implicitSolver =
+        dynamic_cast<OdeSolverImplicitEuler *>(&solver);
+
+    solver.setSize(x.size());
+    if (implicitSolver != NULL)
+    {
+        implicitSolver->setPattern(cloth.particle1.size(),
+                                   &cloth.particle1[0], &cloth.particle2[0]);
+    }
+
+    RunResult result = { true, 0, 0 };
+    nvectord x0(x.size());
+    int nSteps = (int) (kDuration / h + 0.5);
+    long iterations = 0;
+
+    double start = getTime();
+    for (int step = 0; step < nSteps; step++)
+    {
+        x0 = x;
+        solver.solve(x0, x, step * h, (step + 1) * h, clothDxDt, &cloth);
+        if (implicitSolver != NULL)
+            iterations += implicitSolver->getIterations();
+
+        if (!isStable(cloth, x))
+        {
+            result.stable = false;
+            break;
+        }
+    }
+    result.seconds = getTime() - start;
+    result.iterations = (double) iterations / nSteps;
+
+    return result;
+}
+
+static double maxDistance(const nvectord &x1, const nvectord &x2)
+{
+    double maxDist = 0;
+    for (unsigned int i = 0; i < x1.size(); i += kStateSize)
+    {
+        double d = sqrt((x1[i] - x2[i]) * (x1[i] - x2[i]) +
+                        (x1[i + 1] - x2[i + 1]) * (x1[i + 1] - x2[i + 1]) +
+                        (x1[i + 2] - x2[i + 2]) * (x1[i + 2] - x2[i + 2]));
+        maxDist = fmax(maxDist, d);
+    }
+    return maxDist;
+}
+
+int main(int argc, char *argv[])
+{
+    int n = argc > 1 ? atoi(argv[1]) : 20;
+    double ks = argc > 2 ? atof(argv[2]) : 2000;
+    if (n < 2 || ks <= 0)
+    {
+        fprintf(stderr, "Usage: %s [particles along each side] [ks]\n",
+                argv[0]);
+        return -1;
+    }
+
+    Cloth cloth;
+    nvectord xStart;
+    makeCloth(cloth, xStart, n, ks);
+
+    printf("%d x %d particles, %d springs, ks %g, %g s simulated\n",
+           n, n, (int) cloth.particle1.size(), ks, kDuration);
+
+    OdeSolverRungeKutta4 rungeKutta4;
+    OdeSolverImplicitEuler implicitEuler(clothJacobians);
+
+    nvectord reference = xStart;
+    run(rungeKutta4, cloth, reference, kReferenceStep);
+
+    const double steps[] = { 0.0005, 0.001, 0.002, 0.004, 0.008, 0.016,
+                             0.032 };
+    const int nStepSizes = sizeof(steps) / sizeof(steps[0]);
+
+    IOdeSolver *solvers[2] = { &rungeKutta4, &implicitEuler };
+    const char *names[2] = { "RungeKutta4", "ImplicitEuler" };
+    double bestStep[2] = { 0, 0 };
+    double bestCost[2] = { 0, 0 };
+
+    printf("%-14s %8s %8s %14s %14s %10s\n", "solver", "step ms", "stable",
+           "ms/sim second", "error", "CG its");
+
+    for (int s = 0; s < 2; s++)
+    {
+        for (int i = 0; i < nStepSizes; i++)
+        {
+            nvectord x = xStart;
+            RunResult result = run(*solvers[s], cloth, x, steps[i]);
+            double cost = result.seconds / kDuration * 1e3;
+
+            if (result.stable)
+            {
+                printf("%-14s %8.1f %8s %14.2f %14.2e %10.1f\n", names[s],
+                       steps[i] * 1e3, "yes", cost,
+                       maxDistance(x, reference), result.iterations);
+                bestStep[s] = steps[i];
+                bestCost[s] = cost;
+            }
+            else
+            {
+                printf("%-14s %8.1f %8s\n", names[s], steps[i] * 1e3, "no");
+            }
+        }
+    }
+
+    if (bestStep[0] > 0 && bestStep[1] > 0)
+    {
+        printf("largest stable step: RungeKutta4 %.1f ms, ImplicitEuler "
+               "%.1f ms (%.0fx), costing %.2f and %.2f ms per simulated "
+               "second\n", bestStep[0] * 1e3, bestStep[1] * 1e3,
+               bestStep[1] / bestStep[0], bestCost[0], bestCost[1]);
+    }
+
+    return 0;
+}
+
+/******************************************************************************/
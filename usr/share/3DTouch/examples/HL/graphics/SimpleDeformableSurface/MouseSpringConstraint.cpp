@@ -21,6 +21,7 @@ Description:
 *******************************************************************************/
 
 #include "MouseSpringConstraint.h"
+#include <HDU/hduMath.h>
 
 MouseSpringConstraint::MouseSpringConstraint() :
     mParticle(0),
@@ -61,17 +62,52 @@ void MouseSpringConstraint::ApplyConstraint(ParticleListT &particles)
     if (!mState)    // don't apply if not active
         return;
         
-    Particle *p1 = particles[mParticle];
-        
-    hduVector3Dd qdiff = p1->x - mPosition;
-    hduVector3Dd vdiff = p1->v; // FIXME: shouldn't we subtract the mouse velocity?
+    if (particles.IsFixed(mParticle))
+        return;
+
+    hduVector3Dd qdiff = particles.x[mParticle] - mPosition;
+    hduVector3Dd vdiff = particles.v[mParticle]; // FIXME: shouldn't we subtract the mouse velocity?
         
     double dist = qdiff.magnitude();
         
     hduVector3Dd force = - ((ks * (dist - mLength)) + (kd * qdiff.dotProduct(vdiff) / dist)) * (qdiff / dist);
 
-    if (!p1->fixed)
-        p1->f += force;
+    particles.f[mParticle] += force;
+}
+
+// As for a spring between particles (see SpringTable), but the other end
+// is the mouse, which the solver can't move, so only the diagonal changes.
+void MouseSpringConstraint::AddJacobians(ParticleListT &particles,
+                                         BlockSparseMatrix &dfdx,
+                                         BlockSparseMatrix &dfdv)
+{
+    if (!mState)    // don't apply if not active
+        return;
+        
+    if (particles.IsFixed(mParticle))
+        return;
+
+    hduVector3Dd qdiff = particles.x[mParticle] - mPosition;
+    double dist = qdiff.magnitude();
+    if (dist == 0)
+        return;
+
+    hduVector3Dd n = qdiff / dist;
+    double slack = hduMax(1 - mLength / dist, 0.0);
+
+    double *jx = dfdx.getDiagonal(mParticle);
+    double *jv = dfdv.getDiagonal(mParticle);
+
+    for (int i = 0; i < 3; i++)
+    {
+        for (int j = 0; j < 3; j++)
+        {
+            double nn = n[i] * n[j];
+            double identity = (i == j) ? 1 : 0;
+            jx[3 * i + j] -= ks * (nn + slack * (identity - nn));
+            jv[3 * i + j] -= kd * nn;
+        }
+    }
 }
 
 void MouseSpringConstraint::Draw(ParticleListT &particles)
@@ -82,11 +118,9 @@ void MouseSpringConstraint::Draw(ParticleListT &particles)
     float c[] = { .5, 0, 1 };
     glColor3fv(c);
 
-    Particle *p1 = particles[mParticle];
-
     glBegin(GL_LINES);
         
-    glVertex3dv(p1->x);
+    glVertex3dv(particles.x[mParticle]);
     glVertex3dv(mPosition);
         
     glEnd();
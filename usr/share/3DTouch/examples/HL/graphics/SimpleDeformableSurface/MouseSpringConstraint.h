@@ -44,6 +44,10 @@ public:
 
 	virtual void FlexToSystem(ParticleListT &particles) { }
 
+	virtual void AddJacobians(ParticleListT &particles,
+							  BlockSparseMatrix &dfdx,
+							  BlockSparseMatrix &dfdv);
+
 	void SetState(bool inState) { mState = inState; }
 	void SetPosition(hduVector3Dd inPosition) { mPosition = inPosition; }
 	void SetParticle(int inParticle) { mParticle = inParticle; }
@@ -42,10 +42,8 @@ NailConstraint::~NailConstraint()
 
 void NailConstraint::ApplyConstraint(ParticleListT &particles)
 {
-    Particle *p1 = particles[mParticle];
-        
-    p1->fixed = true;
-    p1->f = hduVector3Dd(0,0,0);
+    // FlexToSystem fixed the particle; clear the force the springs left on it
+    particles.f[mParticle] = hduVector3Dd(0,0,0);
 }
 
 void NailConstraint::Draw(ParticleListT &particles)
@@ -56,17 +54,17 @@ void NailConstraint::Draw(ParticleListT &particles)
     hduVector3Dd left(-0.25, 0.25, 2);
     hduVector3Dd right(0.25, 0.25, 2);
 
-    Particle *p1 = particles[mParticle];
+    const hduVector3Dd &x = particles.x[mParticle];
 
     glBegin(GL_LINES);
-    hduVector3Dd v = p1->x + left;
+    hduVector3Dd v = x + left;
     glVertex3dv(v);
-    v = p1->x - left;
+    v = x - left;
     glVertex3dv(v);
         
-    v = p1->x + right;
+    v = x + right;
     glVertex3dv(v);
-    v = p1->x - right;
+    v = x - right;
     glVertex3dv(v);
         
     glEnd();
@@ -74,9 +72,8 @@ void NailConstraint::Draw(ParticleListT &particles)
 
 void NailConstraint::FlexToSystem(ParticleListT &particles)
 {
-    Particle *p1 = particles[mParticle];
-
-    mPosition = p1->x;
+    mPosition = particles.x[mParticle];
+    particles.SetFixed(mParticle, true);
 }
 
 /******************************************************************************/
@@ -21,6 +21,7 @@ Description:
 
 #include "OdeSolver.h"
 #include <assert.h>
+#include <math.h>
 
 OdeSolverEuler::OdeSolverEuler()
 {
@@ -45,7 +46,7 @@ void OdeSolverEuler::solve(nvectord &x0, nvectord &xFinal, double t0, double t1,
     // Euler's method
     restartRequired = dxdt(t0, x0, fStart, userData);
     assert(!restartRequired);
-    xFinal = x0 + h * fStart;
+    addScaled(xFinal, x0, h, fStart);
 }
 
 OdeSolverMidpoint::OdeSolverMidpoint()
@@ -62,6 +63,7 @@ void OdeSolverMidpoint::setSize(int vecSize)
 {
     fStart.resize(vecSize);
     fMid.resize(vecSize);
+    xMid.resize(vecSize);
 }
 
 void OdeSolverMidpoint::solve(nvectord &x0, nvectord &xFinal, double t0, double t1, 
@@ -75,10 +77,10 @@ void OdeSolverMidpoint::solve(nvectord &x0, nvectord &xFinal, double t0, double
     // we evaluate f = dxdt at t0 and at the midpoint
     dxdt(t0, x0, fStart, userData);
 
-    nvectord temp = x0 + h/2 * fStart;
-    dxdt(t0 + h/2, temp, fMid, userData);
+    addScaled(xMid, x0, h/2, fStart);
+    dxdt(t0 + h/2, xMid, fMid, userData);
 
-    xFinal = x0 + h * fMid;
+    addScaled(xFinal, x0, h, fMid);
 }
 
 OdeSolverRungeKutta4::OdeSolverRungeKutta4()
@@ -95,6 +97,7 @@ void OdeSolverRungeKutta4::setSize(int vecSize)
     k2.resize(vecSize);
     k3.resize(vecSize);
     k4.resize(vecSize);
+    xTemp.resize(vecSize);
 }
 
 void OdeSolverRungeKutta4::solve(nvectord &x0, nvectord &xFinal, double t0, double t1, DerivFunc dxdt, void *userData)
@@ -102,22 +105,257 @@ void OdeSolverRungeKutta4::solve(nvectord &x0, nvectord &xFinal, double t0, doub
     // Given x0 at t0, find xFinal at t1 using the derivative function dxdt.
     bool restartRequired = false;
     double h = t1 - t0;
-    nvectord temp;
         
-    // Runge-Kutta of order 4.
+    // Runge-Kutta of order 4.  The k's are left unscaled by h and the
+    // scaling is folded into the sums.
     dxdt(t0, x0, k1, userData);
-    k1 *= h;
-    temp = x0 + k1 * (double)0.5;
-    dxdt(t0 + h * (double)0.5, temp, k2, userData);
-    k2 *= h;
-    temp = x0 + k2 * (double)0.5;
-    dxdt(t0 + h * (double)0.5, temp, k3, userData);
-    k3 *= h;
-    temp = x0 + k3;
-    dxdt(t0 + h, temp, k4, userData);
-    k4 *= h;
-
-    xFinal = x0 + k1 / (double)6 + k2 / (double)3 + k3 / (double)3 + k4 / (double)6;
+    addScaled(xTemp, x0, h * 0.5, k1);
+    dxdt(t0 + h * 0.5, xTemp, k2, userData);
+    addScaled(xTemp, x0, h * 0.5, k2);
+    dxdt(t0 + h * 0.5, xTemp, k3, userData);
+    addScaled(xTemp, x0, h, k3);
+    dxdt(t0 + h, xTemp, k4, userData);
+
+    addScaled(xFinal, x0, h / 6, k1, h / 3, k2, h / 3, k3, h / 6, k4);
+}
+
+static const double kDefaultTolerance = 1e-4;
+static const int kDefaultMaxIterations = 50;
+
+static double dot(const nvectord &a, const nvectord &b)
+{
+    const int size = a.size();
+    double sum = 0;
+
+    for (int i = 0; i < size; i++)
+    {
+        sum += a[i] * b[i];
+    }
+    return sum;
+}
+
+/* inv = m^-1 for a 3x3 block m; false if m is singular. */
+static bool invertBlock(const double *m, double *inv)
+{
+    inv[0] = m[4] * m[8] - m[5] * m[7];
+    inv[1] = m[2] * m[7] - m[1] * m[8];
+    inv[2] = m[1] * m[5] - m[2] * m[4];
+    inv[3] = m[5] * m[6] - m[3] * m[8];
+    inv[4] = m[0] * m[8] - m[2] * m[6];
+    inv[5] = m[2] * m[3] - m[0] * m[5];
+    inv[6] = m[3] * m[7] - m[4] * m[6];
+    inv[7] = m[1] * m[6] - m[0] * m[7];
+    inv[8] = m[0] * m[4] - m[1] * m[3];
+
+    double det = m[0] * inv[0] + m[1] * inv[3] + m[2] * inv[6];
+    if (det == 0)
+        return false;
+
+    for (int i = 0; i < 9; i++)
+    {
+        inv[i] /= det;
+    }
+    return true;
+}
+
+OdeSolverImplicitEuler::OdeSolverImplicitEuler(JacobianFunc jacobianFunc) :
+    jacobianFunc(jacobianFunc),
+    tolerance(kDefaultTolerance),
+    maxIterations(kDefaultMaxIterations),
+    iterations(0)
+{
+    assert(jacobianFunc != NULL);
+}
+
+OdeSolverImplicitEuler::~OdeSolverImplicitEuler()
+{
+}
+
+void OdeSolverImplicitEuler::setSize(int vecSize)
+{
+    assert(vecSize % 6 == 0);
+    const int numParticles = vecSize / 6;
+
+    fStart.resize(vecSize);
+    invMass.resize(numParticles);
+    precond.resize(9 * numParticles);
+    v0.resize(3 * numParticles);
+    rhs.resize(3 * numParticles);
+    dv.assign(3 * numParticles, 0);
+    r.resize(3 * numParticles);
+    z.resize(3 * numParticles);
+    p.resize(3 * numParticles);
+    q.resize(3 * numParticles);
+
+    setPattern(0, NULL, NULL);
+}
+
+void OdeSolverImplicitEuler::setPattern(int numPairs, const int *rows,
+                                        const int *cols)
+{
+    const int numParticles = invMass.size();
+
+    dfdx.setPattern(numParticles, numPairs, rows, cols);
+    dfdv.setPattern(numParticles, numPairs, rows, cols);
+    system.setPattern(numParticles, numPairs, rows, cols);
+}
+
+/* Particles held in place take no part in the solve. */
+void OdeSolverImplicitEuler::filter(nvectord &v)
+{
+    const int numParticles = invMass.size();
+
+    for (int i = 0; i < numParticles; i++)
+    {
+        if (invMass[i] == 0)
+        {
+            v[3 * i] = v[3 * i + 1] = v[3 * i + 2] = 0;
+        }
+    }
+}
+
+void OdeSolverImplicitEuler::solve(nvectord &x0, nvectord &xFinal, double t0, double t1, 
+                                   DerivFunc dxdt, void *userData)
+{
+    // Given x0 at t0, find xFinal at t1 using the derivative function dxdt
+    // and the force derivatives from jacobianFunc.
+    double h = t1 - t0;
+    const int numParticles = invMass.size();
+    const int numPairs = system.getNumPairs();
+
+    assert((int) x0.size() == 6 * numParticles);
+
+    if (numParticles == 0)
+    {
+        xFinal = x0;
+        return;
+    }
+
+    dxdt(t0, x0, fStart, userData);
+
+    dfdx.zero();
+    dfdv.zero();
+    jacobianFunc(t0, x0, dfdx, dfdv, invMass, userData);
+
+    for (int i = 0; i < numParticles; i++)
+    {
+        for (int j = 0; j < 3; j++)
+        {
+            v0[3 * i + j] = x0[6 * i + 3 + j];
+        }
+    }
+
+    // rhs = h (f + h df/dx v), with f = M xdot
+    dfdx.multiply(&v0[0], &rhs[0]);
+
+    for (int i = 0; i < numParticles; i++)
+    {
+        double mass = invMass[i] != 0 ? 1 / invMass[i] : 0;
+
+        for (int j = 0; j < 3; j++)
+        {
+            rhs[3 * i + j] = h * (mass * fStart[6 * i + 3 + j] +
+                                  h * rhs[3 * i + j]);
+        }
+    }
+    filter(rhs);
+
+    // system = M - h df/dv - h^2 df/dx, over the same pattern
+    for (int i = 0; i < numParticles; i++)
+    {
+        double *s = system.getDiagonal(i);
+        double *inv = &precond[9 * i];
+
+        if (invMass[i] == 0)
+        {
+            // filtered out; any invertible block will do
+            for (int j = 0; j < 9; j++)
+            {
+                s[j] = inv[j] = (j % 4 == 0) ? 1 : 0;
+            }
+            continue;
+        }
+
+        for (int j = 0; j < 9; j++)
+        {
+            s[j] = (j % 4 == 0) ? 1 / invMass[i] : 0;
+        }
+        addScaledBlock(s, -h, dfdv.getDiagonal(i));
+        addScaledBlock(s, -h * h, dfdx.getDiagonal(i));
+
+        bool invertible = invertBlock(s, inv);
+        assert(invertible);
+    }
+
+    for (int k = 0; k < numPairs; k++)
+    {
+        double *s = system.getPair(k);
+        for (int j = 0; j < 9; j++)
+        {
+            s[j] = 0;
+        }
+        addScaledBlock(s, -h, dfdv.getPair(k));
+        addScaledBlock(s, -h * h, dfdx.getPair(k));
+    }
+
+    // Preconditioned conjugate gradients, keeping the particles held in
+    // place out of every vector
+    filter(dv);
+    system.multiply(&dv[0], &q[0]);
+    for (int i = 0; i < 3 * numParticles; i++)
+    {
+        r[i] = rhs[i] - q[i];
+    }
+    filter(r);
+
+    double rhsNormSqr = dot(rhs, rhs);
+    double stopSqr = tolerance * tolerance * rhsNormSqr;
+    double rz = 0;
+
+    for (iterations = 0; iterations < maxIterations; iterations++)
+    {
+        if (dot(r, r) <= stopSqr)
+            break;
+
+        for (int i = 0; i < numParticles; i++)
+        {
+            const double *m = &precond[9 * i];
+            const double *ri = &r[3 * i];
+            double *zi = &z[3 * i];
+
+            zi[0] = m[0] * ri[0] + m[1] * ri[1] + m[2] * ri[2];
+            zi[1] = m[3] * ri[0] + m[4] * ri[1] + m[5] * ri[2];
+            zi[2] = m[6] * ri[0] + m[7] * ri[1] + m[8] * ri[2];
+        }
+
+        double rzPrev = rz;
+        rz = dot(r, z);
+
+        if (iterations == 0)
+            p = z;
+        else
+            addScaled(p, z, rz / rzPrev, p);
+
+        system.multiply(&p[0], &q[0]);
+        filter(q);
+
+        double alpha = rz / dot(p, q);
+        addScaled(dv, dv, alpha, p);
+        addScaled(r, r, -alpha, q);
+    }
+
+    // v1 = v0 + dv, x1 = x0 + h v1
+    xFinal.resize(x0.size());
+
+    for (int i = 0; i < numParticles; i++)
+    {
+        for (int j = 0; j < 3; j++)
+        {
+            double v1 = v0[3 * i + j] + dv[3 * i + j];
+            xFinal[6 * i + j] = x0[6 * i + j] + h * v1;
+            xFinal[6 * i + 3 + j] = v1;
+        }
+    }
 }
 
 /******************************************************************************/
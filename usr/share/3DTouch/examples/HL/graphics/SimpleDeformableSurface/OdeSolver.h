@@ -28,6 +28,7 @@ Description:
 
 #include <vector>
 #include "DynamicsMath.h"
+#include "BlockSparseMatrix.h"
 
 /* The derivative function takes x at time time and determines xdot = d/dt x(t)
    So, if  x = { position, velocity }
@@ -85,6 +86,7 @@ private:
     /* vectors used by the ode solver; avoid continuously re-allocating. */
     nvectord fStart;
     nvectord fMid;
+    nvectord xMid;
 };
 
 class OdeSolverRungeKutta4 : public IOdeSolver
@@ -99,6 +101,76 @@ public:
 private:
     /* vectors used by the ode solver; avoid continuously re-allocating. */
     nvectord k1, k2, k3, k4;
+    nvectord xTemp;
+};
+
+/* Implicit solvers also need the derivatives of the forces.  They are for
+   systems of particles only, with x = { position, velocity } and
+   xdot = { velocity, force / mass } for each particle in turn.
+
+   The Jacobian function evaluates at x the derivatives of the forces with
+   respect to the positions and to the velocities, adding them to dfdx and
+   dfdv, which come zeroed and with the pattern given to the solver.  It
+   also gives the inverse mass of every particle, 0 for particles held in
+   place.  Both derivatives must be symmetric and negative semidefinite, as
+   those of springs and dampers are. */
+typedef void (*JacobianFunc)(double t, nvectord &x, BlockSparseMatrix &dfdx,
+                             BlockSparseMatrix &dfdv, nvectord &invMass,
+                             void *userData);
+
+/* Backward Euler, linearized once per step as in Baraff and Witkin,
+   "Large Steps in Cloth Simulation":
+
+       (M - h df/dv - h^2 df/dx) dv = h (f + h df/dx v)
+
+   solved for the change in velocity dv by conjugate gradients,
+   preconditioned by the inverse diagonal blocks, and started from the last
+   step's dv.  Unlike the explicit solvers it stays stable for stiff springs
+   at any step size, at the cost of some artificial damping, so it can take
+   steps many times longer. */
+class OdeSolverImplicitEuler : public IOdeSolver
+{
+public:
+    OdeSolverImplicitEuler(JacobianFunc jacobianFunc);
+    virtual ~OdeSolverImplicitEuler();
+        
+    /* Clears the pattern; set it again after. */
+    virtual void setSize(int vecSize);
+    virtual void solve(nvectord &x0, nvectord &xFinal, double t0, double t1, DerivFunc dxdt, void *userData);
+
+    /* The pairs of particles whose forces couple them, as for
+       BlockSparseMatrix::setPattern.  Kept for every step until the next
+       setSize. */
+    void setPattern(int numPairs, const int *rows, const int *cols);
+
+    /* The solve stops once the residual is this fraction of the right
+       hand side, or after the maximum number of iterations. */
+    void setTolerance(double inTolerance) { tolerance = inTolerance; }
+    void setMaxIterations(int inMaxIterations) { maxIterations = inMaxIterations; }
+
+    /* Iterations taken by the last solve. */
+    int getIterations(void) const { return iterations; }
+
+private:
+    void filter(nvectord &v);
+
+    JacobianFunc jacobianFunc;
+    double tolerance;
+    int maxIterations;
+    int iterations;
+
+    /* vectors and matrices used by the ode solver; avoid continuously
+       re-allocating. */
+    nvectord fStart;
+    nvectord invMass;
+    BlockSparseMatrix dfdx;
+    BlockSparseMatrix dfdv;
+    BlockSparseMatrix system;
+    nvectord precond;   // inverse diagonal blocks of system
+    nvectord v0;        // velocities, without the positions
+    nvectord rhs;
+    nvectord dv;        // the last solution, to start the next from
+    nvectord r, z, p, q;
 };
 
 #endif // OdeSolver_H_
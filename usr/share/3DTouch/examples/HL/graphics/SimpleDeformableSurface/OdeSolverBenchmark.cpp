@@ -0,0 +1,286 @@
+/*****************************************************************************
+
+Copyright (c) 2004 SensAble Technologies, Inc. All rights reserved.
+
+OpenHaptics(TM) toolkit. The material embodied in this software and use of
+this software is subject to the terms and conditions of the clickthrough
+Development License Agreement.
+
+For questions, comments or bug reports, go to forums at:
+    http://dsc.sensable.com
+
+Module Name:
+
+  OdeSolverBenchmark.cpp
+
+Description:
+
+  Times one step of each ODE solver for a particle state, and counts the
+  heap allocations made per step.  The old operator based formulation of
+  each step is timed for comparison, and both are checked to agree.
+  Usage: OdeSolverBenchmark [number of particles]
+
+*******************************************************************************/
+
+#include "OdeSolver.h"
+
+#include <assert.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <math.h>
+#include <time.h>
+#include <new>
+
+/* Number of values per particle: position and velocity. */
+static const int kStateSize = 6;
+
+/* Minimum time spent timing each solver. */
+static const double kMinSeconds = 0.5;
+
+static const double kTimeStep = 0.001;
+
+/* Heap allocations so far. */
+static unsigned long gAllocations = 0;
+
+void *operator new(size_t size)
+{
+    gAllocations++;
+    void *p = malloc(size ? size : 1);
+    if (!p)
+        throw std::bad_alloc();
+    return p;
+}
+
+void operator delete(void *p) throw()
+{
+    free(p);
+}
+
+void operator delete(void *p, size_t) throw()
+{
+    free(p);
+}
+
+static double getTime()
+{
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return now.tv_sec + now.tv_nsec * 1e-9;
+}
+
+/* Damped springs pulling every particle to the origin. */
+static bool springDxDt(double t, nvectord &x, nvectord &xdot, void *userData)
+{
+    const double ks = 10;
+    const double kd = 0.5;
+    const int size = x.size();
+
+    for (int i = 0; i < size; i += kStateSize)
+    {
+        for (int j = 0; j < 3; j++)
+        {
+            xdot[i + j] = x[i + 3 + j];
+            xdot[i + 3 + j] = -ks * x[i + j] - kd * x[i + 3 + j];
+        }
+    }
+
+    return false;
+}
+
+/* The solver steps as they were written before addScaled, for
+   comparison. */
+class OperatorSolverEuler : public IOdeSolver
+{
+public:
+    virtual void setSize(int vecSize)
+    {
+        fStart.resize(vecSize);
+    }
+
+    virtual void solve(nvectord &x0, nvectord &xFinal, double t0, double t1,
+                       DerivFunc dxdt, void *userData)
+    {
+        double h = t1 - t0;
+        dxdt(t0, x0, fStart, userData);
+        xFinal = x0 + h * fStart;
+    }
+
+private:
+    nvectord fStart;
+};
+
+class OperatorSolverMidpoint : public IOdeSolver
+{
+public:
+    virtual void setSize(int vecSize)
+    {
+        fStart.resize(vecSize);
+        fMid.resize(vecSize);
+    }
+
+    virtual void solve(nvectord &x0, nvectord &xFinal, double t0, double t1,
+                       DerivFunc dxdt, void *userData)
+    {
+        double h = t1 - t0;
+        dxdt(t0, x0, fStart, userData);
+        nvectord temp = x0 + h/2 * fStart;
+        dxdt(t0 + h/2, temp, fMid, userData);
+        xFinal = x0 + h * fMid;
+    }
+
+private:
+    nvectord fStart;
+    nvectord fMid;
+};
+
+class OperatorSolverRungeKutta4 : public IOdeSolver
+{
+public:
+    virtual void setSize(int vecSize)
+    {
+        k1.resize(vecSize);
+        k2.resize(vecSize);
+        k3.resize(vecSize);
+        k4.resize(vecSize);
+    }
+
+    virtual void solve(nvectord &x0, nvectord &xFinal, double t0, double t1,
+                       DerivFunc dxdt, void *userData)
+    {
+        double h = t1 - t0;
+        nvectord temp;
+
+        dxdt(t0, x0, k1, userData);
+        k1 *= h;
+        temp = x0 + k1 * (double)0.5;
+        dxdt(t0 + h * (double)0.5, temp, k2, userData);
+        k2 *= h;
+        temp = x0 + k2 * (double)0.5;
+        dxdt(t0 + h * (double)0.5, temp, k3, userData);
+        k3 *= h;
+        temp = x0 + k3;
+        dxdt(t0 + h, temp, k4, userData);
+        k4 *= h;
+
+        xFinal = x0 + k1 / (double)6 + k2 / (double)3 + k3 / (double)3 + k4 / (double)6;
+    }
+
+private:
+    nvectord k1, k2, k3, k4;
+};
+
+static void initState(nvectord &x, int size)
+{
+    srand(1);
+    x.resize(size);
+    for (int i = 0; i < size; i++)
+    {
+        x[i] = (double)rand() / RAND_MAX - 0.5;
+    }
+}
+
+/* Runs solver until kMinSeconds have passed and prints the time and
+   allocations per step. */
+static void benchmark(const char *name, IOdeSolver &solver, int nParticles)
+{
+    const int size = nParticles * kStateSize;
+    nvectord x0(size);
+    nvectord xFinal;
+
+    initState(xFinal, size);
+    solver.setSize(size);
+
+    /* one step first, so that any lazily sized vectors are in place */
+    double t = 0;
+    x0 = xFinal;
+    solver.solve(x0, xFinal, t, t + kTimeStep, springDxDt, 0);
+    t += kTimeStep;
+
+    unsigned long nSteps = 0;
+    unsigned long allocationsBefore = gAllocations;
+    double start = getTime();
+    double elapsed;
+    do
+    {
+        for (int i = 0; i < size; i++)
+        {
+            x0[i] = xFinal[i];
+        }
+        solver.solve(x0, xFinal, t, t + kTimeStep, springDxDt, 0);
+        t += kTimeStep;
+        nSteps++;
+        elapsed = getTime() - start;
+    } while (elapsed < kMinSeconds || nSteps < 1000);
+    unsigned long allocations = gAllocations - allocationsBefore;
+
+    printf("%-24s %9.2f us/step %6.2f allocations/step\n",
+           name, elapsed / nSteps * 1e6, (double)allocations / nSteps);
+}
+
+/* Steps both solvers from the same state and returns the largest
+   difference between them. */
+static double compare(IOdeSolver &solver1, IOdeSolver &solver2, int size)
+{
+    const int kSteps = 100;
+    nvectord x1, x2;
+    nvectord xFinal1, xFinal2;
+
+    initState(xFinal1, size);
+    xFinal2 = xFinal1;
+    solver1.setSize(size);
+    solver2.setSize(size);
+
+    for (int step = 0; step < kSteps; step++)
+    {
+        double t = step * kTimeStep;
+        x1 = xFinal1;
+        x2 = xFinal2;
+        solver1.solve(x1, xFinal1, t, t + kTimeStep, springDxDt, 0);
+        solver2.solve(x2, xFinal2, t, t + kTimeStep, springDxDt, 0);
+    }
+
+    double maxDiff = 0;
+    for (int i = 0; i < size; i++)
+    {
+        maxDiff = fmax(maxDiff, fabs(xFinal1[i] - xFinal2[i]));
+    }
+    return maxDiff;
+}
+
+int main(int argc, char *argv[])
+{
+    int nParticles = argc > 1 ? atoi(argv[1]) : 10000;
+    if (nParticles <= 0)
+    {
+        fprintf(stderr, "Usage: %s [number of particles]\n", argv[0]);
+        return -1;
+    }
+
+    printf("%d particles, %d doubles of state\n",
+           nParticles, nParticles * kStateSize);
+
+    OdeSolverEuler euler;
+    OperatorSolverEuler operatorEuler;
+    OdeSolverMidpoint midpoint;
+    OperatorSolverMidpoint operatorMidpoint;
+    OdeSolverRungeKutta4 rungeKutta4;
+    OperatorSolverRungeKutta4 operatorRungeKutta4;
+
+    benchmark("Euler", euler, nParticles);
+    benchmark("Euler (operators)", operatorEuler, nParticles);
+    benchmark("Midpoint", midpoint, nParticles);
+    benchmark("Midpoint (operators)", operatorMidpoint, nParticles);
+    benchmark("RungeKutta4", rungeKutta4, nParticles);
+    benchmark("RungeKutta4 (operators)", operatorRungeKutta4, nParticles);
+
+    const int size = nParticles * kStateSize;
+    printf("largest difference from the operators after 100 steps: "
+           "Euler %.1e, Midpoint %.1e, RungeKutta4 %.1e\n",
+           compare(euler, operatorEuler, size),
+           compare(midpoint, operatorMidpoint, size),
+           compare(rungeKutta4, operatorRungeKutta4, size));
+
+    return 0;
+}
+
+/******************************************************************************/
@@ -15,7 +15,7 @@ Module Name:
 
 Description:
 
-  Particle with position, velocity, mass.
+  The particles of a system, stored as parallel arrays.
 
 *******************************************************************************/
 
@@ -31,23 +31,53 @@ Description:
 
 #include "Particle.h"
 
-static const double kDefaultMass = 1;
-double Particle::mass = kDefaultMass;
+int ParticleArrays::Add(const hduVector3Dd &inX, double inMass)
+{
+    assert(inMass > 0);
+
+    x.push_back(inX);
+    v.push_back(hduVector3Dd(0, 0, 0));
+    f.push_back(hduVector3Dd(0, 0, 0));
+    mass.push_back(inMass);
+    invMass.push_back(1 / inMass);
+
+    return x.size() - 1;
+}
 
-void Particle::BeginDraw(void)
+void ParticleArrays::Clear(void)
 {
-    float c[] = { 1.0, 0, 0 };
-    glColor3fv(c);
-    glBegin(GL_POINTS);
+    x.clear();
+    v.clear();
+    f.clear();
+    mass.clear();
+    invMass.clear();
+}
+
+void ParticleArrays::SetMass(int i, double inMass)
+{
+    assert(inMass > 0);
+
+    bool fixed = IsFixed(i);
+    mass[i] = inMass;
+    invMass[i] = fixed ? 0 : 1 / inMass;
 }
 
-void Particle::Draw(void)
+void ParticleArrays::SetFixed(int i, bool inFixed)
 {
-    glVertex3dv(&x[0]);
+    invMass[i] = inFixed ? 0 : 1 / mass[i];
 }
 
-void Particle::EndDraw(void)
+void ParticleArrays::Draw(void) const
 {
+    float c[] = { 1.0, 0, 0 };
+    glColor3fv(c);
+    glBegin(GL_POINTS);
+
+    for (unsigned int i = 0; i < x.size(); i++)
+    {
+        glVertex3dv(&x[i][0]);
+    }
+
     glEnd();
 }
 
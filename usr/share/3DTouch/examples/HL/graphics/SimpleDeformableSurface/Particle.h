@@ -15,7 +15,8 @@ Module Name:
 
 Description:
 
-  Particle with position, velocity, mass.
+  The particles of a system: position, velocity, force and mass of each,
+  stored as parallel arrays.
 
 *******************************************************************************/
 
@@ -33,43 +34,36 @@ Description:
 #endif
 
 #include <iostream>
+#include <vector>
 #include "DynamicsMath.h"
 
-class Particle
+/* Particle i is x[i], v[i], f[i] and so on.  Keeping each quantity in one
+   contiguous array lets the force passes stream through memory instead of
+   chasing a pointer per particle. */
+class ParticleArrays
 {
 public:
-    hduVector3Dd x;
-    hduVector3Dd v;
-    hduVector3Dd f;
-
-    static double mass;
-    bool fixed;
-        
-    Particle() :
-        x(0, 0, 0),
-        v(0, 0, 0),
-        f(0, 0, 0),
-        fixed(false)
-    {
-    }
-
-    Particle(double inMass) :
-        x(0, 0, 0),
-        v(0, 0, 0),
-        f(0, 0, 0),
-        fixed(false)
-    {
-        mass = inMass;  // note: static, so affects all particles
-    }
-
-    static void BeginDraw(void);
-    void Draw(void);
-    static void EndDraw(void);
-
-    static void SetMass(double inMass) { mass = inMass; }
+    std::vector<hduVector3Dd> x;    // positions
+    std::vector<hduVector3Dd> v;    // velocities
+    std::vector<hduVector3Dd> f;    // forces, accumulated every evaluation
+    std::vector<double> mass;
+    std::vector<double> invMass;    // 1 / mass, or 0 for a fixed particle
+
+    unsigned int size(void) const { return x.size(); }
+
+    /* Returns the index of the new particle. */
+    int Add(const hduVector3Dd &inX, double inMass);
+    void Clear(void);
+
+    void SetMass(int i, double inMass);
+
+    /* A fixed particle keeps its mass but no force moves it. */
+    void SetFixed(int i, bool inFixed);
+    bool IsFixed(int i) const { return invMass[i] == 0; }
+
+    void Draw(void) const;
 };
 
 #endif // Particle_H_
 
 /*****************************************************************************/
-
@@ -23,6 +23,7 @@ Description:
 #endif
 
 #include <assert.h>
+#include <algorithm>
 #include <HDU/hduMath.h>
 #include "SpringConstraint.h"
 #include "DynamicsMath.h"
@@ -48,12 +49,22 @@ static const double kGravityDef = -9.8f;
 static const double kMaxVelocity = 10;
 static const double kMaxAcceleration = 100;
 
+static const double kDefaultParticleMass = 1;
+
+// Coloring the springs only pays when the spring pass can use several cores.
+#if defined(_OPENMP)
+static const bool kColorSprings = true;
+#else
+static const bool kColorSprings = false;
+#endif
+
 ParticleSystem::ParticleSystem()
 {
     restitution = .5;
     drag = .01f;
     gravity = 9.8f; //*5;
     t = 0;
+    particleMass = kDefaultParticleMass;
         
     mouseSpring = NULL;
     hapticDeviceConstraint = NULL;
@@ -62,6 +73,9 @@ ParticleSystem::ParticleSystem()
 
     //odeSolver = new OdeSolverEuler();
     odeSolver = new OdeSolverRungeKutta4();
+    implicitSolver = NULL;
+
+    particleGridStale = true;
 }
 
 ParticleSystem::~ParticleSystem()
@@ -70,34 +84,17 @@ ParticleSystem::~ParticleSystem()
     delete odeSolver;
 }
 
-// Adds a new particle with position (x, y, z) and returns a reference to the
-// particle.
-// If there is no space left for a new particle, a reference to the last
-// particle is returned, but no new particle is created.
-Particle& ParticleSystem::AddParticle(double x, double y, double z, double inMass)
+// Adds a new particle with position (x, y, z) and returns its index.
+// A mass of 0 means the mass set by SetParticleMass.
+int ParticleSystem::AddParticle(double x, double y, double z, double inMass)
 {
     assert(design);
         
-    Particle* part;
     if (inMass == 0)
-        part = new Particle();
-    else
-        part = new Particle(inMass);
-        
-    part->x[0] = x;
-    part->x[1] = y;
-    part->x[2] = z;
-        
-    particles.push_back(part);
-        
-    return *part;
-}
+        inMass = particleMass;
 
-void ParticleSystem::AddParticle(Particle* p)
-{
-    assert(design);
-        
-    particles.push_back(p);
+    particleGridStale = true;
+    return particles.Add(hduVector3Dd(x, y, z), inMass);
 }
 
 void ParticleSystem::AddConstraint(Constraint* c)
@@ -126,7 +123,7 @@ SpringConstraint* ParticleSystem::AddSpringConstraint(int p1, int p2)
     // rely on FlexToSystem to fix the constraint
     SpringConstraint* sc = new SpringConstraint(p1, p2);
         
-    AddConstraint(sc);
+    springs.push_back(sc);
         
     return sc;
 }
@@ -137,7 +134,7 @@ SpringConstraint* ParticleSystem::AddSpringConstraint(int p1, int p2, float leng
         
     SpringConstraint* sc = new SpringConstraint(p1, p2, length);
         
-    AddConstraint(sc);
+    springs.push_back(sc);
         
     return sc;
 }
@@ -146,7 +143,11 @@ void ParticleSystem::DeleteConstraint(Constraint* c)
 {
     assert(c != NULL);
         
-    constraints.remove(c);
+    SpringConstraint* sc = dynamic_cast<SpringConstraint*>(c);
+    if (sc != NULL)
+        springs.remove(sc);
+    else
+        constraints.remove(c);
         
     delete c;
 }
@@ -176,57 +177,33 @@ void ParticleSystem::AddHapticDeviceConstraint(void)
 // Find the particle nearest to 3D position
 int ParticleSystem::GetClosestParticle(const hduVector3Dd& pos)
 {
-    int closestPart = -1;
-    double closestDist, currDist;   
-        
-    typedef ParticleListT::const_iterator LI; // constant because not modifying list
-    LI pi;
-    int i;
-        
-    for (pi = particles.begin(), i = 0; pi != particles.end(); ++pi, i++)
-    {
-        Particle& p = **pi;
-        assert(&p != NULL);
-                
-        currDist = pos.distanceSqr(p.x);                
-        if (closestPart == -1 || (currDist < closestDist))
-        {
-            closestDist = currDist;
-            closestPart = i;
-        }
-    }
-        
-    return closestPart;
+    RefreshParticleGrid();
+    return particleGrid.findNearest(pos);
 }
 
 // Find the particle nearest to x, y
 int ParticleSystem::GetClosestParticle(int x, int y)
 {
+    if (useDepthForMouseZ)
+    {
+        hduVector3Dd mousePos;
+        UnProjectUtilities::GetMousePosition(x, y, mousePos);
+
+        RefreshParticleGrid();
+        return particleGrid.findNearest(mousePos, kClosenessThreshold);
+    }
+
     int closestPart = -1;
     double closestDist, currDist;   
 
-    hduVector3Dd mousePos;
     hduVector3Dd mouseNear, mouseFar;
+    UnProjectUtilities::GetMouseRay(x, y, mouseNear, mouseFar);
 
-    if (useDepthForMouseZ)
-        UnProjectUtilities::GetMousePosition(x, y, mousePos);
-    else
-        UnProjectUtilities::GetMouseRay(x, y, mouseNear, mouseFar);
-
-        
-    typedef ParticleListT::const_iterator LI; // constant because not modifying list
-    LI pi;
-    int i;
-        
-    for (pi = particles.begin(), i = 0; pi != particles.end(); ++pi, i++)
+    for (unsigned int i = 0; i < particles.size(); i++)
     {
-        Particle& p = **pi;
-        assert(&p != NULL);
-                
-        if (useDepthForMouseZ)
-            currDist = p.x.distance(mousePos);
-        else
-            currDist = UnProjectUtilities::GetDistanceFromLine(p.x, mouseNear, mouseFar);
+        const hduVector3Dd &x = particles.x[i];
+
+        currDist = UnProjectUtilities::GetDistanceFromLine(x, mouseNear, mouseFar);
                 
         if (closestPart == -1 || (currDist < closestDist))
         {
@@ -235,12 +212,30 @@ int ParticleSystem::GetClosestParticle(int x, int y)
         }
     }
         
-    if (closestDist < kClosenessThreshold)
+    if (closestPart != -1 && closestDist < kClosenessThreshold)
         return closestPart;
     else
         return -1;
 }
 
+// Brings the grid up to date with the particles, if they have moved or been
+// added or removed since it was last used.  A particle that stays in its
+// cell costs a comparison.
+void ParticleSystem::RefreshParticleGrid(void)
+{
+    if (particleGrid.getNumPoints() != (int) particles.size())
+    {
+        particleGrid.setPoints(particles.x.empty() ? NULL : &particles.x[0],
+                               particles.size());
+    }
+    else if (particleGridStale && particles.size() > 0)
+    {
+        particleGrid.updatePoints(&particles.x[0]);
+    }
+
+    particleGridStale = false;
+}
+
 void ParticleSystem::ActivateMouseSpring(int x, int y)
 {
     assert(!design);
@@ -256,7 +251,7 @@ void ParticleSystem::ActivateMouseSpring(int x, int y)
         hduVector3Dd mouseNear, mouseFar;
         UnProjectUtilities::GetMouseRay(x, y, mouseNear, mouseFar);
                 
-        hduVector3Dd particlePos = particles[closestPart]->x;
+        hduVector3Dd particlePos = particles.x[closestPart];
 //      hduVector3Dd projection = dot(particlePos - mouseNear, mouseFar - mouseNear);
                 
         hduVector3Dd mouseProjected = UnProjectUtilities::GetLineIntersectPlaneZ(mouseNear, mouseFar, particlePos[2]);
@@ -279,7 +274,7 @@ void ParticleSystem::MouseMove(int x, int y)
     hduVector3Dd mouseNear, mouseFar;
     UnProjectUtilities::GetMouseRay(x, y, mouseNear, mouseFar);
         
-    hduVector3Dd particlePos = particles[mouseSpring->GetParticle()]->x;
+    hduVector3Dd particlePos = particles.x[mouseSpring->GetParticle()];
     hduVector3Dd mouseProjected = UnProjectUtilities::GetLineIntersectPlaneZ(mouseNear, mouseFar, particlePos[2]);
 
     mouseSpring->SetPosition(mouseProjected);
@@ -288,27 +283,62 @@ void ParticleSystem::MouseMove(int x, int y)
 
 void ParticleSystem::ActivateHapticDeviceConstraint(void)
 {
-    assert(hapticDeviceConstraint != NULL);
-    hapticDeviceConstraint->SetForce(hduVector3Dd(0,0,0));
-    hapticDeviceConstraint->SetState(true);
+    hapticDeviceInput.active = true;
+    hapticDeviceInput.force = hduVector3Dd(0,0,0);
+
+    hapticDeviceBuffer.getWriteBuffer() = hapticDeviceInput;
+    hapticDeviceBuffer.publish();
 }
 
 void ParticleSystem::DeactivateHapticDeviceConstraint(void)
 {
-    assert(hapticDeviceConstraint != NULL);
-    hapticDeviceConstraint->SetState(false);
+    hapticDeviceInput.active = false;
+
+    hapticDeviceBuffer.getWriteBuffer() = hapticDeviceInput;
+    hapticDeviceBuffer.publish();
 }
 
 
 void ParticleSystem::HapticDeviceMove(const hduVector3Dd& pos,
                                       const hduVector3Dd& force)
 {
-    assert(hapticDeviceConstraint != NULL);
+    hapticDeviceInput.position = pos;
+    hapticDeviceInput.force = force;
+
+    hapticDeviceBuffer.getWriteBuffer() = hapticDeviceInput;
+    hapticDeviceBuffer.publish();
+}
+
+// Applies the latest input from the haptic device to its constraint.
+void ParticleSystem::ApplyHapticDeviceInput(void)
+{
+    if (!hapticDeviceBuffer.update() || hapticDeviceConstraint == NULL)
+        return;
 
-    int closestParticle = GetClosestParticle(pos);
+    const HapticDeviceInput& input = hapticDeviceBuffer.getReadBuffer();
 
-    hapticDeviceConstraint->SetParticle(closestParticle);
-    hapticDeviceConstraint->SetForce(force);
+    hapticDeviceConstraint->SetState(input.active);
+    if (input.active)
+    {
+        hapticDeviceConstraint->SetParticle(GetClosestParticle(input.position));
+        hapticDeviceConstraint->SetForce(input.force);
+    }
+}
+
+bool ParticleSystem::FetchPositions(void)
+{
+    return positionBuffer.update();
+}
+
+const PositionListT& ParticleSystem::GetPositions(void) const
+{
+    return positionBuffer.getReadBuffer();
+}
+
+void ParticleSystem::PublishPositions(void)
+{
+    positionBuffer.getWriteBuffer() = particles.x;
+    positionBuffer.publish();
 }
 
 
@@ -346,16 +376,16 @@ void ParticleSystem::FinishConstructingSystem(void)
     x0.resize(particles.size() * kStateSize);
     xFinal.resize(particles.size() * kStateSize);
         
-        // clear any velocities
+        // clear any velocities, and free any particles whose nails have
+        // gone; the nails left will fix theirs again
     for (unsigned int i = 0; i < particles.size(); i++)
     {
-        particles[i]->v = hduVector3Dd(0,0,0);
+        particles.v[i] = hduVector3Dd(0,0,0);
+        particles.SetFixed(i, false);
     }
 
     ParticlesStateToArray(&xFinal[0]);
 
-    odeSolver->setSize(particles.size() * kStateSize);
-
     typedef ConstraintListT::const_iterator LI; // constant because not modifying list
     LI ci;
 
@@ -366,8 +396,21 @@ void ParticleSystem::FinishConstructingSystem(void)
                 
         c.FlexToSystem(particles);
     }
+
+    SpringListT::const_iterator si;
+
+    for (si = springs.begin(); si != springs.end(); ++si)
+    {
+        (*si)->FlexToSystem(particles);
+    }
+
+    springTable.Build(springs, particles.size(), kColorSprings);
+
+    SizeOdeSolver();
         
     design = false;
+
+    PublishPositions();
 }
 
 void ParticleSystem::ClearSystem(void)
@@ -391,24 +434,20 @@ void ParticleSystem::ClearSystem(void)
     mouseSpring = NULL;
     hapticDeviceConstraint = NULL;
 
-    typedef ParticleListT::iterator PLI; // constant because not modifying list
-        
-    PLI pi;
-
-    while (particles.size() > 0)
+    while (springs.size() > 0)
     {
-        pi = particles.begin();
-                
-        Particle& p = **pi;
-        assert(&p != NULL);
-                
-        delete *pi;
-
-        particles.erase(pi);
+        delete springs.front();
+        springs.pop_front();
     }
+
+    springTable.Clear();
+    particles.Clear();
+    particleGridStale = true;
         
     assert(particles.size() == 0);
     assert(constraints.size() == 0);
+
+    PublishPositions();
 }
 
 void ParticleSystem::Draw(void)
@@ -425,19 +464,21 @@ void ParticleSystem::Draw(void)
         c.Draw(particles);
     }
 
-    Particle::BeginDraw();
-        
-    for (unsigned int i = 0; i < particles.size(); i++)
+    SpringListT::const_iterator si;
+
+    for (si = springs.begin(); si != springs.end(); ++si)
     {
-        particles[i]->Draw();
+        (*si)->Draw(particles);
     }
-        
-    Particle::EndDraw();
-        
+
+    particles.Draw();
+
 }
 
 void ParticleSystem::AdvanceSimulation(double tPrev, double tCurr)
 {
+    ApplyHapticDeviceInput();
+
     // copy xFinal back to x0
     for(unsigned int i=0; i<kStateSize * particles.size(); i++)
     {
@@ -449,6 +490,45 @@ void ParticleSystem::AdvanceSimulation(double tPrev, double tCurr)
         
     // copy d/dt X(tNext) into state variables
     ParticlesArrayToState(&xFinal[0]);
+    particleGridStale = true;
+
+    PublishPositions();
+}
+
+// The pattern of the force derivatives is that of the springs, and stays
+// until the system is changed.
+void ParticleSystem::SizeOdeSolver(void)
+{
+    odeSolver->setSize(particles.size() * kStateSize);
+
+    if (implicitSolver != NULL)
+    {
+        implicitSolver->setPattern(springTable.GetNumSprings(),
+                                   springTable.GetParticles1(),
+                                   springTable.GetParticles2());
+    }
+}
+
+void ParticleSystem::SetImplicit(bool inImplicit)
+{
+    if (inImplicit == IsImplicit())
+        return;
+
+    delete odeSolver;
+
+    if (inImplicit)
+    {
+        implicitSolver = new OdeSolverImplicitEuler(Jacobians);
+        odeSolver = implicitSolver;
+    }
+    else
+    {
+        implicitSolver = NULL;
+        odeSolver = new OdeSolverRungeKutta4();
+    }
+
+    if (!design)
+        SizeOdeSolver();
 }
 
 bool ParticleSystem::DxDt(double t, nvectord &x, nvectord &xdot, void *userData)
@@ -473,77 +553,104 @@ bool ParticleSystem::DxDt(double t, nvectord &x, nvectord &xdot, void *userData)
     return false;
 }
 
-void ParticleSystem::ParticlesStateToArray(double *dst)
+void ParticleSystem::Jacobians(double t, nvectord &x, BlockSparseMatrix &dfdx,
+                               BlockSparseMatrix &dfdv, nvectord &invMass,
+                               void *userData)
 {
-    typedef ParticleListT::const_iterator LI; // constant because not modifying list
-        
-    LI pi;
+    ParticleSystem *pThis = static_cast<ParticleSystem *>(userData);
+    assert(pThis);
 
-    for (pi = particles.begin(); pi != particles.end(); ++pi)
+    ParticleListT &particles = pThis->particles;
+
+    pThis->ParticlesArrayToState(&x[0]);
+
+    pThis->springTable.AddJacobians(particles,
+                                    SpringConstraint::GetSpringConstant(),
+                                    SpringConstraint::GetSpringDampingConstant(),
+                                    dfdx, dfdv);
+
+    typedef ConstraintListT::const_iterator LI; // constant because not modifying list
+        
+    LI ci;
+        
+    for (ci = pThis->constraints.begin(); ci != pThis->constraints.end(); ++ci)
     {
-        Particle& p = **pi;
-        assert(&p != NULL);
+        (*ci)->AddJacobians(particles, dfdx, dfdv);
+    }
 
-        *(dst++) = p.x[0];
-        *(dst++) = p.x[1];
-        *(dst++) = p.x[2];
-        *(dst++) = p.v[0];
-        *(dst++) = p.v[1];
-        *(dst++) = p.v[2];
+    // drag
+    for (unsigned int i = 0; i < particles.size(); i++)
+    {
+        double *jv = dfdv.getDiagonal(i);
+        jv[0] -= pThis->drag;
+        jv[4] -= pThis->drag;
+        jv[8] -= pThis->drag;
     }
+
+    invMass.assign(particles.invMass.begin(), particles.invMass.end());
 }
 
-void ParticleSystem::ParticlesArrayToState(double *dst)
+void ParticleSystem::ParticlesStateToArray(double *dst)
 {
-    ParticleListT::const_iterator pi; // constant because not modifying list
-
-    for (pi = particles.begin(); pi != particles.end(); ++pi)
+    for (unsigned int i = 0; i < particles.size(); i++)
     {
-        Particle& p = **pi;
-        assert(&p != NULL);
-                
-        p.x[0] = *(dst++);
-        p.x[1] = *(dst++);
-        p.x[2] = *(dst++);
-        p.v[0] = *(dst++);
-        p.v[1] = *(dst++);
-        p.v[2] = *(dst++);
+        const hduVector3Dd &x = particles.x[i];
+        const hduVector3Dd &v = particles.v[i];
+
+        *(dst++) = x[0];
+        *(dst++) = x[1];
+        *(dst++) = x[2];
+        *(dst++) = v[0];
+        *(dst++) = v[1];
+        *(dst++) = v[2];
     }
 }
 
-void ParticleSystem::ClearForces(void)
+void ParticleSystem::ParticlesArrayToState(double *dst)
 {
     for (unsigned int i = 0; i < particles.size(); i++)
     {
-        particles[i]->f = hduVector3Dd(0,0,0);
+        hduVector3Dd &x = particles.x[i];
+        hduVector3Dd &v = particles.v[i];
+
+        x[0] = *(dst++);
+        x[1] = *(dst++);
+        x[2] = *(dst++);
+        v[0] = *(dst++);
+        v[1] = *(dst++);
+        v[2] = *(dst++);
     }
 }
 
-void ParticleSystem::ApplyRegularForces(void)
+void ParticleSystem::ClearForces(void)
 {
-    Particle *p;
+    std::fill(particles.f.begin(), particles.f.end(), hduVector3Dd(0,0,0));
+}
 
+void ParticleSystem::ApplyRegularForces(void)
+{
     for (unsigned int i = 0; i < particles.size(); i++)
     {
-        p = particles[i];
-        p->f[1] -= gravity * p->mass;
-        //p->f -= p->v * drag;
+        particles.f[i][1] -= gravity * particles.mass[i];
+        //particles.f[i] -= particles.v[i] * drag;
     }
 }
 
 void ParticleSystem::ApplyDragForces(void)
 {
-    Particle *p;
-
     for (unsigned int i = 0; i < particles.size(); i++)
     {
-        p = particles[i];
-        p->f -= p->v * drag;
+        particles.f[i] -= particles.v[i] * drag;
     }
 }
 
+// The springs go first, all in one pass, so that the other constraints
+// (nails in particular) see their forces.
 void ParticleSystem::ApplyConstraintForces(void)
 {
+    springTable.ApplyForces(particles, SpringConstraint::GetSpringConstant(),
+                            SpringConstraint::GetSpringDampingConstant());
+
     typedef ConstraintListT::const_iterator LI; // constant because not modifying list
         
     LI ci;
@@ -561,22 +668,18 @@ void ParticleSystem::ApplyConstraintForces(void)
 // For each particle, make sure the max v and f aren't exceeded
 void ParticleSystem::LimitStateChanges(void)
 {
-    ParticleListT::const_iterator pi; // constant because not modifying list
     double vMag;
-    double fMag;
+    double aMag;
         
-    for (pi = particles.begin(); pi != particles.end(); ++pi)
+    for (unsigned int i = 0; i < particles.size(); i++)
     {
-        Particle& p = **pi;
-        assert(&p != NULL);
-
-        vMag = norm(p.v);
+        vMag = particles.v[i].magnitude();
         if (vMag > kMaxVelocity)
-            p.v *= kMaxVelocity / vMag;
+            particles.v[i] *= kMaxVelocity / vMag;
 
-        fMag = norm(p.f);
-        if (fMag > kMaxAcceleration * p.mass)
-            p.f *= kMaxAcceleration * p.mass / fMag;
+        aMag = particles.f[i].magnitude() * particles.invMass[i];
+        if (aMag > kMaxAcceleration)
+            particles.f[i] *= kMaxAcceleration / aMag;
     }
 }
 #endif
@@ -586,60 +689,64 @@ void ParticleSystem::LimitStateChanges(void)
 // reducing the size of the time step taken
 void ParticleSystem::LimitStateChanges(void)
 {
-    ParticleListT::const_iterator pi; // constant because not modifying list
     double vMag, vBiggest = 0;
-    double fMag, fBiggest = 0;
-
-    // take advantage of the fact that all particles have the same mass
-    double maxForce = kMaxAcceleration * Particle::mass;
+    double aMag, aBiggest = 0;
 
-    for (pi = particles.begin(); pi != particles.end(); ++pi)
+    // limit the acceleration, since the masses may differ; fixed particles
+    // don't accelerate whatever their force
+    for (unsigned int i = 0; i < particles.size(); i++)
     {
-        Particle& p = **pi;
-        assert(&p != NULL);
-
-        vMag = p.v.magnitude();
+        vMag = particles.v[i].magnitude();
         vBiggest = hduMax(vMag, vBiggest);
 
-        fMag = p.f.magnitude();
-        fBiggest = hduMax(fMag, fBiggest);
+        aMag = particles.f[i].magnitude() * particles.invMass[i];
+        aBiggest = hduMax(aMag, aBiggest);
     }
 
     if (vBiggest > kMaxVelocity)
     {
-        for (pi = particles.begin(); pi != particles.end(); ++pi)
+        for (unsigned int i = 0; i < particles.size(); i++)
         {
-            (*pi)->v *= kMaxVelocity / vBiggest;
+            particles.v[i] *= kMaxVelocity / vBiggest;
         }
     }
 
-    if (fBiggest > maxForce)
+    if (aBiggest > kMaxAcceleration)
     {
-        for (pi = particles.begin(); pi != particles.end(); ++pi)
+        for (unsigned int i = 0; i < particles.size(); i++)
         {
-            (*pi)->f *= maxForce / fBiggest;
+            particles.f[i] *= kMaxAcceleration / aBiggest;
         }
     }
 }
 
 void ParticleSystem::DdtParticlesStateToArray(double *xdot)
 {
-    ParticleListT::const_iterator pi; // constant because not modifying list
-
-    for (pi = particles.begin(); pi != particles.end(); ++pi)
+    for (unsigned int i = 0; i < particles.size(); i++)
     {
-        Particle& p = **pi;
-        assert(&p != NULL);
-
-        int i;
+        const hduVector3Dd &v = particles.v[i];
+        const hduVector3Dd &f = particles.f[i];
+        double invMass = particles.invMass[i];
 
         // copy d/dt x(t) = v(t) into xdot
-        for(i=0; i<3; i++)
-            *(xdot++) = p.v[i];
+        *(xdot++) = v[0];
+        *(xdot++) = v[1];
+        *(xdot++) = v[2];
 
         // copy d/dt v(t) = f(t) / m into xdot
-        for(i=0; i<3; i++)
-            *(xdot++) = p.f[i] / p.mass;
+        *(xdot++) = f[0] * invMass;
+        *(xdot++) = f[1] * invMass;
+        *(xdot++) = f[2] * invMass;
+    }
+}
+
+void ParticleSystem::SetParticleMass(double inMass)
+{
+    particleMass = inMass;
+
+    for (unsigned int i = 0; i < particles.size(); i++)
+    {
+        particles.SetMass(i, inMass);
     }
 }
 
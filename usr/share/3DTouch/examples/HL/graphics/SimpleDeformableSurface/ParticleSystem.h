@@ -31,8 +31,11 @@ Description:
 #include <iostream>
 #include "DynamicsMath.h"
 #include "Particle.h"
+#include "SpringTable.h"
 #include "OdeSolver.h"
 #include <HD/hd.h>
+#include <HDU/hduSpatialIndex.h>
+#include <HDU/hduTripleBuffer.h>
 
 class Constraint;
 class NailConstraint;
@@ -40,8 +43,19 @@ class SpringConstraint;
 class MouseSpringConstraint;
 class HapticDeviceConstraint;
 
-typedef std::vector<Particle*> ParticleListT;
+typedef ParticleArrays ParticleListT;
 typedef std::list<Constraint*> ConstraintListT;
+typedef std::vector<hduVector3Dd> PositionListT;
+
+/* What the haptic device is doing to the system, as last reported. */
+struct HapticDeviceInput
+{
+    HapticDeviceInput() : active(false) {}
+
+    bool active;
+    hduVector3Dd position;
+    hduVector3Dd force;
+};
 
 const double kClosenessThreshold = 100; // limit for particle selection with mouse
 const int kDim = 3; // dimensions of the system
@@ -52,9 +66,8 @@ public:
     ParticleSystem();
     ~ParticleSystem();
 
-    Particle& AddParticle(double x = 0, double y = 0, double z = 0, 
-                          double inMass = 0);
-    void AddParticle(Particle* p);
+    int AddParticle(double x = 0, double y = 0, double z = 0, 
+                    double inMass = 0);
 
     void AddConstraint(Constraint* c);
     NailConstraint* AddNailConstraint(int p);
@@ -72,6 +85,8 @@ public:
     void DeactivateMouseSpring(void);
     void MouseMove(int x, int y);
         
+    /* These may be called while the system is being advanced on another
+       thread; they take effect at the start of the next step. */
     void ActivateHapticDeviceConstraint(void);
 
     void DeactivateHapticDeviceConstraint(void);
@@ -79,6 +94,12 @@ public:
     void HapticDeviceMove(const hduVector3Dd& pos,
                           const hduVector3Dd& force);
 
+    /* Particle positions as of the last step, for the thread that draws
+       them.  FetchPositions returns true if they have changed since the
+       last fetch. */
+    bool FetchPositions(void);
+    const PositionListT& GetPositions(void) const;
+
     /* For switching modes (design/simulation). */
     void StartConstructingSystem(void);
     void FinishConstructingSystem(void);
@@ -87,13 +108,23 @@ public:
     void Draw(void);
     void AdvanceSimulation(double tPrev, double tCurr);
 
+    /* Steps with OdeSolverImplicitEuler rather than OdeSolverRungeKutta4,
+       which allows much longer steps for stiff springs. */
+    void SetImplicit(bool inImplicit);
+    bool IsImplicit(void) { return implicitSolver != NULL; }
+
     void SetSpringConstant(double inKS);
     void SetSpringDampingConstant(double inKD);
     double GetSpringConstant(void);
     double GetSpringDampingConstant(void);
 
+    /* Mass of every particle, and of those added from now on. */
+    void SetParticleMass(double inMass);
+    double GetParticleMass(void) { return particleMass; }
+
     ParticleListT particles;
-    ConstraintListT constraints;
+    ConstraintListT constraints;    // all but the springs
+    SpringListT springs;
         
     float t;                // simulation clock
         
@@ -119,12 +150,32 @@ private:
     void ParticlesStateToArray(double *dst);
     void ParticlesArrayToState(double *dst);
     static bool DxDt(double t, nvectord &x, nvectord &xdot, void *userData);
+    static void Jacobians(double t, nvectord &x, BlockSparseMatrix &dfdx,
+                          BlockSparseMatrix &dfdv, nvectord &invMass,
+                          void *userData);
+    void SizeOdeSolver(void);
     void LimitStateChanges(void);
     void DdtParticlesStateToArray(double *xdot);
     void ClearForces(void);
     void ApplyRegularForces(void);
     void ApplyDragForces(void);
     void ApplyConstraintForces(void);
+    void ApplyHapticDeviceInput(void);
+    void PublishPositions(void);
+    void RefreshParticleGrid(void);
+
+    hduTripleBuffer<PositionListT> positionBuffer;
+
+    hduTripleBuffer<HapticDeviceInput> hapticDeviceBuffer;
+    HapticDeviceInput hapticDeviceInput; // last input published
+
+    SpringTable springTable;    // springs, packed by FinishConstructingSystem
+    double particleMass;
+
+    OdeSolverImplicitEuler *implicitSolver; // odeSolver, if implicit
+
+    hduHashGrid particleGrid;   // particles.x, for GetClosestParticle
+    bool particleGridStale;     // particles have moved since last refresh
 };
 
 #endif // ParticleSystem_H_
@@ -47,26 +47,21 @@ SpringConstraint::~SpringConstraint()
 {
 }
 
+// ParticleSystem applies its springs all at once through a SpringTable;
+// this is for a spring on its own.
 void SpringConstraint::ApplyConstraint(ParticleListT &particles)
 {
-    Particle *p1 = particles[mParticle1];
-    Particle *p2 = particles[mParticle2];
-        
-    // TODO: this function could be optimized
-    hduVector3Dd qdiff = p1->x - p2->x;
-    hduVector3Dd vdiff = p1->v - p2->v;
+    hduVector3Dd qdiff = particles.x[mParticle1] - particles.x[mParticle2];
+    hduVector3Dd vdiff = particles.v[mParticle1] - particles.v[mParticle2];
         
     double dist = qdiff.magnitude();
         
     hduVector3Dd force = - ((ks * (dist - mLength)) + 
                             (kd * qdiff.dotProduct(vdiff) / dist)) * (qdiff / dist);
 
-    // FIXME: += and -= don't currently work here
-    if (!p1->fixed)
-        p1->f += force;
-
-    if (!p2->fixed)
-        p2->f -= force;
+    // no force moves a fixed particle, so there's no need to check
+    particles.f[mParticle1] += force;
+    particles.f[mParticle2] -= force;
 }
 
 void SpringConstraint::Draw(ParticleListT &particles)
@@ -76,13 +71,10 @@ void SpringConstraint::Draw(ParticleListT &particles)
     float c[] = { 0, 0, 1 };
     glColor3fv(c);
 
-    Particle *p1 = particles[mParticle1];
-    Particle *p2 = particles[mParticle2];
-
     glBegin(GL_LINES);
         
-    glVertex3dv(p1->x);
-    glVertex3dv(p2->x);
+    glVertex3dv(particles.x[mParticle1]);
+    glVertex3dv(particles.x[mParticle2]);
         
     glEnd();
 }
@@ -91,10 +83,7 @@ void SpringConstraint::FlexToSystem(ParticleListT &particles)
 {
     if (mHasFixedLength) return;
 
-    Particle *p1 = particles[mParticle1];
-    Particle *p2 = particles[mParticle2];
-
-    mLength = (p1->x - p2->x).magnitude();
+    mLength = (particles.x[mParticle1] - particles.x[mParticle2]).magnitude();
 }
 
 /******************************************************************************/
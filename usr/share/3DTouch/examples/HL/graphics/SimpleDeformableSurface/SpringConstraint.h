@@ -40,6 +40,9 @@ public:
     virtual void FlexToSystem(ParticleListT &particles);
         
     void SetParticle(int inParticle) { mParticle2 = inParticle; }
+    int GetParticle1(void) const { return mParticle1; }
+    int GetParticle2(void) const { return mParticle2; }
+    double GetLength(void) const { return mLength; }
     bool ParticlesAreValid(void) 
     { 
         return (mParticle1 != mParticle2) && 
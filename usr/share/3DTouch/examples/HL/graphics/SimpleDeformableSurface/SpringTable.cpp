@@ -0,0 +1,254 @@
+/*****************************************************************************
+
+Copyright (c) 2004 SensAble Technologies, Inc. All rights reserved.
+
+OpenHaptics(TM) toolkit. The material embodied in this software and use of
+this software is subject to the terms and conditions of the clickthrough
+Development License Agreement.
+
+For questions, comments or bug reports, go to forums at:
+    http://dsc.sensable.com
+
+Module Name:
+
+  SpringTable.cpp
+
+Description:
+
+  The springs of a particle system packed into arrays.
+
+*******************************************************************************/
+
+#include <assert.h>
+#include <math.h>
+#include "SpringTable.h"
+#include "SpringConstraint.h"
+
+/* Below this many springs a group isn't worth handing to other cores. */
+static const int kMinParallelSprings = 2048;
+
+/* Spring forces for the springs begin up to end.  Damped Hooke's law, as in
+   SpringConstraint::ApplyConstraint, with the division by the length folded
+   into one scale factor. */
+static void applySpringForces(int begin, int end,
+                              const int *particle1, const int *particle2,
+                              const double *restLength,
+                              const hduVector3Dd *x, const hduVector3Dd *v,
+                              hduVector3Dd *f, double ks, double kd)
+{
+#if defined(_OPENMP)
+#pragma omp parallel for if (end - begin >= kMinParallelSprings)
+#endif
+    for (int s = begin; s < end; s++)
+    {
+        int a = particle1[s];
+        int b = particle2[s];
+
+        double dx = x[a][0] - x[b][0];
+        double dy = x[a][1] - x[b][1];
+        double dz = x[a][2] - x[b][2];
+        double dvx = v[a][0] - v[b][0];
+        double dvy = v[a][1] - v[b][1];
+        double dvz = v[a][2] - v[b][2];
+
+        double dist = sqrt(dx * dx + dy * dy + dz * dz);
+        double distInv = 1 / dist;
+        double scale = -(ks * (dist - restLength[s]) +
+                         kd * (dx * dvx + dy * dvy + dz * dvz) * distInv) *
+            distInv;
+
+        f[a][0] += scale * dx;
+        f[a][1] += scale * dy;
+        f[a][2] += scale * dz;
+        f[b][0] -= scale * dx;
+        f[b][1] -= scale * dy;
+        f[b][2] -= scale * dz;
+    }
+}
+
+/* Derivatives of the spring forces for the springs begin up to end.  With
+   d = x[a] - x[b] and n = d / |d|, the force on a changes with x[a] by
+
+       Kx = -ks (n n^T + max(0, 1 - rest / |d|) (I - n n^T))
+
+   and with v[a] by Kv = -kd n n^T, leaving out the smaller change of the
+   damping with position.  The force on b changes the other way, so Kx and
+   Kv go on the diagonal for both particles and negated in the pair. */
+static void addSpringJacobians(int begin, int end,
+                               const int *particle1, const int *particle2,
+                               const double *restLength,
+                               const hduVector3Dd *x,
+                               BlockSparseMatrix &dfdx,
+                               BlockSparseMatrix &dfdv,
+                               double ks, double kd)
+{
+#if defined(_OPENMP)
+#pragma omp parallel for if (end - begin >= kMinParallelSprings)
+#endif
+    for (int s = begin; s < end; s++)
+    {
+        int a = particle1[s];
+        int b = particle2[s];
+
+        double d[3] = { x[a][0] - x[b][0], x[a][1] - x[b][1],
+                        x[a][2] - x[b][2] };
+        double dist = sqrt(d[0] * d[0] + d[1] * d[1] + d[2] * d[2]);
+        if (dist == 0)
+            continue;
+
+        double n[3] = { d[0] / dist, d[1] / dist, d[2] / dist };
+        double slack = 1 - restLength[s] / dist;
+        if (slack < 0)
+            slack = 0;
+
+        double kx[9], kv[9];
+        for (int i = 0; i < 3; i++)
+        {
+            for (int j = 0; j < 3; j++)
+            {
+                double nn = n[i] * n[j];
+                double identity = (i == j) ? 1 : 0;
+                kx[3 * i + j] = -ks * (nn + slack * (identity - nn));
+                kv[3 * i + j] = -kd * nn;
+            }
+        }
+
+        addScaledBlock(dfdx.getDiagonal(a), 1, kx);
+        addScaledBlock(dfdx.getDiagonal(b), 1, kx);
+        addScaledBlock(dfdx.getPair(s), -1, kx);
+        addScaledBlock(dfdv.getDiagonal(a), 1, kv);
+        addScaledBlock(dfdv.getDiagonal(b), 1, kv);
+        addScaledBlock(dfdv.getPair(s), -1, kv);
+    }
+}
+
+SpringTable::SpringTable()
+{
+    Clear();
+}
+
+void SpringTable::Build(const SpringListT &springs, unsigned int numParticles,
+                        bool colored)
+{
+    int numSprings = springs.size();
+
+    particle1.resize(numSprings);
+    particle2.resize(numSprings);
+    restLength.resize(numSprings);
+    colorStart.assign(1, 0);
+
+    if (numSprings == 0)
+        return;
+
+    /* Greedy coloring: each spring takes the lowest color neither of its
+       particles has yet.  A grid of springs needs only a handful. */
+    std::vector<int> colors(numSprings, 0);
+    std::vector<std::vector<bool> > particleHasColor;
+    std::vector<int> colorCount;
+
+    SpringListT::const_iterator si;
+    int s;
+
+    for (si = springs.begin(), s = 0; si != springs.end(); ++si, s++)
+    {
+        int a = (*si)->GetParticle1();
+        int b = (*si)->GetParticle2();
+        int c = 0;
+
+        if (colored)
+        {
+            while (c < (int) colorCount.size() &&
+                   (particleHasColor[c][a] || particleHasColor[c][b]))
+            {
+                c++;
+            }
+
+            if (c == (int) colorCount.size())
+            {
+                particleHasColor.push_back(std::vector<bool>(numParticles));
+                colorCount.push_back(0);
+            }
+
+            particleHasColor[c][a] = true;
+            particleHasColor[c][b] = true;
+        }
+        else if (colorCount.empty())
+        {
+            colorCount.push_back(0);
+        }
+
+        colors[s] = c;
+        colorCount[c]++;
+    }
+
+    /* Order the springs by color, keeping their order within a color. */
+    for (unsigned int c = 0; c < colorCount.size(); c++)
+    {
+        colorStart.push_back(colorStart.back() + colorCount[c]);
+    }
+
+    std::vector<unsigned int> next(colorStart.begin(), colorStart.end() - 1);
+
+    for (si = springs.begin(), s = 0; si != springs.end(); ++si, s++)
+    {
+        int i = next[colors[s]]++;
+        particle1[i] = (*si)->GetParticle1();
+        particle2[i] = (*si)->GetParticle2();
+        restLength[i] = (*si)->GetLength();
+    }
+}
+
+void SpringTable::Clear(void)
+{
+    particle1.clear();
+    particle2.clear();
+    restLength.clear();
+    colorStart.assign(1, 0);
+}
+
+void SpringTable::ApplyForces(ParticleArrays &particles, double ks,
+                              double kd) const
+{
+    if (particle1.empty())
+        return;
+
+    for (unsigned int c = 0; c < GetNumColors(); c++)
+    {
+        applySpringForces(colorStart[c], colorStart[c + 1],
+                          &particle1[0], &particle2[0], &restLength[0],
+                          &particles.x[0], &particles.v[0], &particles.f[0],
+                          ks, kd);
+    }
+}
+
+const int *SpringTable::GetParticles1(void) const
+{
+    return particle1.empty() ? NULL : &particle1[0];
+}
+
+const int *SpringTable::GetParticles2(void) const
+{
+    return particle2.empty() ? NULL : &particle2[0];
+}
+
+void SpringTable::AddJacobians(const ParticleArrays &particles, double ks,
+                               double kd, BlockSparseMatrix &dfdx,
+                               BlockSparseMatrix &dfdv) const
+{
+    if (particle1.empty())
+        return;
+
+    assert(dfdx.getNumPairs() == (int) GetNumSprings());
+    assert(dfdv.getNumPairs() == (int) GetNumSprings());
+
+    /* the colors keep the springs of a group off each other's diagonal
+       blocks, as they do for the forces */
+    for (unsigned int c = 0; c < GetNumColors(); c++)
+    {
+        addSpringJacobians(colorStart[c], colorStart[c + 1],
+                           &particle1[0], &particle2[0], &restLength[0],
+                           &particles.x[0], dfdx, dfdv, ks, kd);
+    }
+}
+
+/******************************************************************************/
@@ -0,0 +1,84 @@
+/*****************************************************************************
+
+Copyright (c) 2004 SensAble Technologies, Inc. All rights reserved.
+
+OpenHaptics(TM) toolkit. The material embodied in this software and use of
+this software is subject to the terms and conditions of the clickthrough
+Development License Agreement.
+
+For questions, comments or bug reports, go to forums at:
+    http://dsc.sensable.com
+
+Module Name:
+
+  SpringTable.h
+
+Description:
+
+  The springs of a particle system packed into arrays, so that all spring
+  forces are applied by one loop instead of a virtual call per spring.
+
+*******************************************************************************/
+
+#ifndef SpringTable_H_
+#define SpringTable_H_
+
+#if _MSC_VER > 1000
+#pragma once
+#endif // _MSC_VER > 1000
+
+#include <list>
+#include <vector>
+#include "Particle.h"
+#include "BlockSparseMatrix.h"
+
+class SpringConstraint;
+
+typedef std::list<SpringConstraint*> SpringListT;
+
+/* Built from the SpringConstraints once the system is constructed; they stay
+   the springs' design time representation.
+
+   When colored, the springs are grouped so that no two springs in a group
+   share a particle.  The springs of a group may then add their forces from
+   several threads at once without atomics; the groups are done one after
+   the other.  Compiled with OpenMP, the groups are split across cores. */
+class SpringTable
+{
+public:
+    SpringTable();
+
+    void Build(const SpringListT &springs, unsigned int numParticles,
+               bool colored);
+    void Clear(void);
+
+    unsigned int GetNumSprings(void) const { return particle1.size(); }
+    unsigned int GetNumColors(void) const { return colorStart.size() - 1; }
+
+    /* Adds the force of every spring to both its particles. */
+    void ApplyForces(ParticleArrays &particles, double ks, double kd) const;
+
+    /* The particles of every spring, in table order.  Spring s is pair s of
+       the pattern that AddJacobians fills. */
+    const int *GetParticles1(void) const;
+    const int *GetParticles2(void) const;
+
+    /* Adds the derivatives of the spring forces with respect to the
+       positions and the velocities.  Springs squeezed shorter than their
+       rest length count as slack sideways, which keeps dfdx negative
+       semidefinite as the implicit solver needs. */
+    void AddJacobians(const ParticleArrays &particles, double ks, double kd,
+                      BlockSparseMatrix &dfdx, BlockSparseMatrix &dfdv) const;
+
+private:
+    std::vector<int> particle1;
+    std::vector<int> particle2;
+    std::vector<double> restLength;
+
+    /* The springs of color c are colorStart[c] up to colorStart[c + 1]. */
+    std::vector<unsigned int> colorStart;
+};
+
+#endif // SpringTable_H_
+
+/*****************************************************************************/
@@ -86,6 +86,9 @@ void Surface::ConstructSurface(const int inSurfaceParticles, const double inSurf
 
 void Surface::DrawSurface(void)
 {
+    if (!HasSurfacePositions())
+        return;
+
     glMaterialfv(GL_FRONT, GL_SPECULAR, matSpecular);
     glMaterialfv(GL_FRONT, GL_SHININESS, matShininess);
     glMaterialfv(GL_FRONT, GL_DIFFUSE, matDiffuse);
@@ -111,10 +114,37 @@ void Surface::DrawSurface(void)
 
 }
 
+//
+// Copy the particle positions into the haptic shape.  The shape keeps its
+// own copy since HL queries it from the haptic thread.
+//
+void Surface::UpdateHapticShape(SurfaceShape &shape)
+{
+    if (!HasSurfacePositions())
+        return;
+
+    hduVector3Dd *positions = shape.BeginUpdate(surfaceParticlesX, surfaceParticlesZ);
+    if (positions == NULL)
+        return;
+
+    for (int i=0; i<surfaceParticlesX; i++)
+    {
+        for (int k=0; k<surfaceParticlesZ; k++)
+        {
+            *positions++ = GetSurfacePosition(i, k);
+        }
+    }
+
+    shape.EndUpdate();
+}
+
 void Surface::DrawSurfaceNormals(void)
 {
     hduVector3Dd normVertex;
         
+    if (!HasSurfacePositions())
+        return;
+
     glColor3f( 0.0, 0.0, 1.0);
     glBegin(GL_LINES);
 
@@ -222,14 +252,17 @@ void Surface::CalculateSurfaceVertexNormal(hduVector3Dd &normVertex, int i, int
     normVertex = normAccum / normAccum.magnitude();
 }
 
-Particle *Surface::GetSurfaceParticle(int i, int k)
+// The positions last published by the particle system, which may still be
+// those of a system since cleared or rebuilt at another size.
+bool Surface::HasSurfacePositions(void)
 {
-    return ps->particles[i*surfaceParticlesZ + k];
+    return ps->GetPositions().size() ==
+        (unsigned int) (surfaceParticlesX * surfaceParticlesZ);
 }
 
 const hduVector3Dd& Surface::GetSurfacePosition(int i, int k)
 {
-    return ps->particles[i*surfaceParticlesZ + k]->x;
+    return ps->GetPositions()[i*surfaceParticlesZ + k];
 }
 
 void Surface::SetSpecularColor(GLfloat r, GLfloat g, GLfloat b, GLfloat a)
@@ -266,7 +299,7 @@ void Surface::SetMassProportion(double inMass)
     massProportion = inMass;
     int hangingParticles = (surfaceParticlesX - 2);
     if (hangingParticles > 0)
-        Particle::SetMass(massProportion / hangingParticles);
+        ps->SetParticleMass(massProportion / hangingParticles);
 }
 
 /******************************************************************************/
@@ -27,6 +27,7 @@ Description:
 #endif // _MSC_VER > 1000
 
 #include "ParticleSystem.h"
+#include "SurfaceShape.h"
 
 class Surface  
 {
@@ -39,6 +40,7 @@ public:
                           const double inSurfaceSize);
     void DrawSurface(void);
     void DrawSurfaceNormals(void);
+    void UpdateHapticShape(SurfaceShape &shape);
     void InvalidateVertexCache(void);
     void SetSpecularColor(GLfloat r, GLfloat g, GLfloat b, GLfloat a);
     void SetAmbientColor(GLfloat r, GLfloat g, GLfloat b, GLfloat a);
@@ -71,7 +73,7 @@ private:
                          const hduVector3Dd &v2, const hduVector3Dd &v3);
     const hduVector3Dd& GetSurfaceVertexNormal(int i, int k);
     void CalculateSurfaceVertexNormal(hduVector3Dd &normVertex, int i, int k);
-    Particle *GetSurfaceParticle(int i, int j);
+    bool HasSurfacePositions(void);
     const hduVector3Dd& GetSurfacePosition(int i, int j);
 };
 
@@ -0,0 +1,527 @@
+/*****************************************************************************
+
+Copyright (c) 2004 SensAble Technologies, Inc. All rights reserved.
+
+OpenHaptics(TM) toolkit. The material embodied in this software and use of
+this software is subject to the terms and conditions of the clickthrough
+Development License Agreement.
+
+For questions, comments or bug reports, go to forums at:
+    http://dsc.sensable.com
+
+Module Name:
+
+  SurfaceShape.cpp
+
+Description:
+
+  Haptic representation of the deformable surface as an HL callback shape.
+
+*******************************************************************************/
+
+#include "SurfaceShape.h"
+
+#include <assert.h>
+#include <math.h>
+
+namespace
+{
+
+// grid cells per leaf, at most
+const int kLeafCells = 4;
+
+// deep enough for any grid that fits in memory
+const int kMaxStackDepth = 64;
+
+//
+// Slab test of the segment start + t * dir, 0 <= t <= tMax, against box.
+//
+bool segmentHitsBox(const hduVector3Dd &start, const hduVector3Dd &dir,
+                    double tMax, const hduBoundBox3Dd &box)
+{
+    if (box.isEmpty())
+        return false;
+
+    double tNear = 0;
+    double tFar = tMax;
+
+    for (int axis = 0; axis < 3; axis++)
+    {
+        if (dir[axis] == 0)
+        {
+            if (start[axis] < box.lo()[axis] || start[axis] > box.hi()[axis])
+                return false;
+            continue;
+        }
+
+        double t0 = (box.lo()[axis] - start[axis]) / dir[axis];
+        double t1 = (box.hi()[axis] - start[axis]) / dir[axis];
+        if (t0 > t1)
+        {
+            double temp = t0;
+            t0 = t1;
+            t1 = temp;
+        }
+
+        if (t0 > tNear)
+            tNear = t0;
+        if (t1 < tFar)
+            tFar = t1;
+        if (tNear > tFar)
+            return false;
+    }
+
+    return true;
+}
+
+double boxDistanceSquared(const hduVector3Dd &p, const hduBoundBox3Dd &box)
+{
+    double distSq = 0;
+
+    for (int axis = 0; axis < 3; axis++)
+    {
+        double d = 0;
+        if (p[axis] < box.lo()[axis])
+            d = box.lo()[axis] - p[axis];
+        else if (p[axis] > box.hi()[axis])
+            d = p[axis] - box.hi()[axis];
+        distSq += d * d;
+    }
+
+    return distSq;
+}
+
+//
+// Moller-Trumbore.  Hits from either side; t is along dir.
+//
+bool segmentHitsTriangle(const hduVector3Dd &start, const hduVector3Dd &dir,
+                         double tMax, const hduVector3Dd &v0,
+                         const hduVector3Dd &v1, const hduVector3Dd &v2,
+                         double &t)
+{
+    hduVector3Dd e1 = v1 - v0;
+    hduVector3Dd e2 = v2 - v0;
+    hduVector3Dd p = dir.crossProduct(e2);
+
+    double det = e1.dotProduct(p);
+    if (fabs(det) < 1e-12)
+        return false;
+    double detInv = 1 / det;
+
+    hduVector3Dd s = start - v0;
+    double u = s.dotProduct(p) * detInv;
+    if (u < 0 || u > 1)
+        return false;
+
+    hduVector3Dd q = s.crossProduct(e1);
+    double v = dir.dotProduct(q) * detInv;
+    if (v < 0 || u + v > 1)
+        return false;
+
+    t = e2.dotProduct(q) * detInv;
+    return t >= 0 && t <= tMax;
+}
+
+//
+// Closest point on triangle abc to p, by Voronoi region of the triangle.
+//
+hduVector3Dd closestPointOnTriangle(const hduVector3Dd &p,
+                                    const hduVector3Dd &a,
+                                    const hduVector3Dd &b,
+                                    const hduVector3Dd &c)
+{
+    hduVector3Dd ab = b - a;
+    hduVector3Dd ac = c - a;
+    hduVector3Dd ap = p - a;
+
+    double d1 = ab.dotProduct(ap);
+    double d2 = ac.dotProduct(ap);
+    if (d1 <= 0 && d2 <= 0)
+        return a;
+
+    hduVector3Dd bp = p - b;
+    double d3 = ab.dotProduct(bp);
+    double d4 = ac.dotProduct(bp);
+    if (d3 >= 0 && d4 <= d3)
+        return b;
+
+    double vc = d1 * d4 - d3 * d2;
+    if (vc <= 0 && d1 >= 0 && d3 <= 0)
+        return a + ab * (d1 / (d1 - d3));
+
+    hduVector3Dd cp = p - c;
+    double d5 = ab.dotProduct(cp);
+    double d6 = ac.dotProduct(cp);
+    if (d6 >= 0 && d5 <= d6)
+        return c;
+
+    double vb = d5 * d2 - d1 * d6;
+    if (vb <= 0 && d2 >= 0 && d6 <= 0)
+        return a + ac * (d2 / (d2 - d6));
+
+    double va = d3 * d6 - d5 * d4;
+    if (va <= 0 && (d4 - d3) >= 0 && (d5 - d6) >= 0)
+        return b + (c - b) * ((d4 - d3) / ((d4 - d3) + (d5 - d6)));
+
+    double denom = 1 / (va + vb + vc);
+    return a + ab * (vb * denom) + ac * (vc * denom);
+}
+
+} // anonymous namespace
+
+SurfaceShape::SurfaceShape() :
+    front(0),
+    frontValid(false),
+    particlesX(0),
+    particlesZ(0)
+{
+    pthread_mutex_init(&lock, NULL);
+}
+
+SurfaceShape::~SurfaceShape()
+{
+    pthread_mutex_destroy(&lock);
+}
+
+int SurfaceShape::BuildNode(int i0, int k0, int i1, int k1)
+{
+    int index = nodes.size();
+
+    Node node;
+    node.i0 = i0;
+    node.k0 = k0;
+    node.i1 = i1;
+    node.k1 = k1;
+    node.left = -1;
+    node.right = -1;
+    nodes.push_back(node);
+
+    if ((i1 - i0) * (k1 - k0) <= kLeafCells)
+        return index;
+
+    // split the longer side of the block of cells in half
+    int left, right;
+    if (i1 - i0 >= k1 - k0)
+    {
+        int iMid = (i0 + i1) / 2;
+        left = BuildNode(i0, k0, iMid, k1);
+        right = BuildNode(iMid, k0, i1, k1);
+    }
+    else
+    {
+        int kMid = (k0 + k1) / 2;
+        left = BuildNode(i0, k0, i1, kMid);
+        right = BuildNode(i0, kMid, i1, k1);
+    }
+
+    nodes[index].left = left;
+    nodes[index].right = right;
+    return index;
+}
+
+hduVector3Dd *SurfaceShape::BeginUpdate(int inParticlesX, int inParticlesZ)
+{
+    if (inParticlesX != particlesX || inParticlesZ != particlesZ)
+    {
+        pthread_mutex_lock(&lock);
+
+        particlesX = inParticlesX;
+        particlesZ = inParticlesZ;
+
+        nodes.clear();
+        if (particlesX > 1 && particlesZ > 1)
+            BuildNode(0, 0, particlesX - 1, particlesZ - 1);
+
+        for (int s = 0; s < 2; s++)
+        {
+            snapshots[s].positions.resize(particlesX * particlesZ);
+            snapshots[s].bounds.resize(nodes.size());
+        }
+        frontValid = false;
+
+        pthread_mutex_unlock(&lock);
+    }
+
+    Snapshot &back = snapshots[1 - front];
+    return back.positions.empty() ? NULL : &back.positions[0];
+}
+
+void SurfaceShape::EndUpdate(void)
+{
+    Refit(snapshots[1 - front]);
+
+    pthread_mutex_lock(&lock);
+    front = 1 - front;
+    frontValid = true;
+    pthread_mutex_unlock(&lock);
+}
+
+void SurfaceShape::Refit(Snapshot &snapshot)
+{
+    for (int n = nodes.size() - 1; n >= 0; n--)
+    {
+        const Node &node = nodes[n];
+        hduBoundBox3Dd &bounds = snapshot.bounds[n];
+
+        if (node.left >= 0)
+        {
+            bounds = snapshot.bounds[node.left];
+            bounds.Union(snapshot.bounds[node.right]);
+            continue;
+        }
+
+        // a block of cells touches the particles on its corners too
+        bounds.setIsEmpty();
+        for (int i = node.i0; i <= node.i1; i++)
+        {
+            for (int k = node.k0; k <= node.k1; k++)
+            {
+                bounds.Union(snapshot.positions[i * particlesZ + k]);
+            }
+        }
+    }
+}
+
+//
+// Triangle t (0 or 1) of cell (i, k), wound as DrawSurface's triangle
+// strips are, so front faces match the graphics.
+//
+void SurfaceShape::GetTriangle(const Snapshot &snapshot, int i, int k, int t,
+                               hduVector3Dd &v0, hduVector3Dd &v1,
+                               hduVector3Dd &v2)
+{
+    const hduVector3Dd *row0 = &snapshot.positions[i * particlesZ];
+    const hduVector3Dd *row1 = row0 + particlesZ;
+
+    if (t == 0)
+    {
+        v0 = row0[k];
+        v1 = row1[k];
+        v2 = row0[k + 1];
+    }
+    else
+    {
+        v0 = row1[k];
+        v1 = row1[k + 1];
+        v2 = row0[k + 1];
+    }
+}
+
+bool SurfaceShape::IntersectSegment(const hduVector3Dd &start,
+                                    const hduVector3Dd &end,
+                                    hduVector3Dd &point,
+                                    hduVector3Dd &normal,
+                                    bool &isFrontFace)
+{
+    pthread_mutex_lock(&lock);
+
+    if (!frontValid || nodes.empty())
+    {
+        pthread_mutex_unlock(&lock);
+        return false;
+    }
+
+    const Snapshot &snapshot = snapshots[front];
+    hduVector3Dd dir = end - start;
+    double tBest = 1;
+    bool found = false;
+    hduVector3Dd v0, v1, v2;
+
+    int stack[kMaxStackDepth];
+    int depth = 0;
+    stack[depth++] = 0;
+
+    while (depth > 0)
+    {
+        int n = stack[--depth];
+        const Node &node = nodes[n];
+
+        // only hits closer than the best so far are of interest
+        if (!segmentHitsBox(start, dir, tBest, snapshot.bounds[n]))
+            continue;
+
+        if (node.left >= 0)
+        {
+            assert(depth + 2 <= kMaxStackDepth);
+            stack[depth++] = node.right;
+            stack[depth++] = node.left;
+            continue;
+        }
+
+        for (int i = node.i0; i < node.i1; i++)
+        {
+            for (int k = node.k0; k < node.k1; k++)
+            {
+                for (int t = 0; t < 2; t++)
+                {
+                    double tHit;
+                    GetTriangle(snapshot, i, k, t, v0, v1, v2);
+                    if (segmentHitsTriangle(start, dir, tBest,
+                                            v0, v1, v2, tHit))
+                    {
+                        tBest = tHit;
+                        normal = (v1 - v0).crossProduct(v2 - v0);
+                        found = true;
+                    }
+                }
+            }
+        }
+    }
+
+    pthread_mutex_unlock(&lock);
+
+    if (!found)
+        return false;
+
+    point = start + dir * tBest;
+    normal.normalize();
+
+    // moving against the front normal means coming from the front
+    isFrontFace = dir.dotProduct(normal) < 0;
+    if (!isFrontFace)
+        normal = -normal;
+
+    return true;
+}
+
+bool SurfaceShape::FindClosestPoint(const hduVector3Dd &query,
+                                    hduVector3Dd &point,
+                                    hduVector3Dd &normal)
+{
+    pthread_mutex_lock(&lock);
+
+    if (!frontValid || nodes.empty())
+    {
+        pthread_mutex_unlock(&lock);
+        return false;
+    }
+
+    const Snapshot &snapshot = snapshots[front];
+    double bestDistSq = HUGE_VAL;
+    hduVector3Dd v0, v1, v2;
+
+    int stack[kMaxStackDepth];
+    int depth = 0;
+    stack[depth++] = 0;
+
+    while (depth > 0)
+    {
+        int n = stack[--depth];
+        const Node &node = nodes[n];
+
+        if (boxDistanceSquared(query, snapshot.bounds[n]) >= bestDistSq)
+            continue;
+
+        if (node.left >= 0)
+        {
+            // visit the nearer child first so that it tightens bestDistSq
+            double leftDistSq =
+                boxDistanceSquared(query, snapshot.bounds[node.left]);
+            double rightDistSq =
+                boxDistanceSquared(query, snapshot.bounds[node.right]);
+
+            assert(depth + 2 <= kMaxStackDepth);
+            if (leftDistSq < rightDistSq)
+            {
+                stack[depth++] = node.right;
+                stack[depth++] = node.left;
+            }
+            else
+            {
+                stack[depth++] = node.left;
+                stack[depth++] = node.right;
+            }
+            continue;
+        }
+
+        for (int i = node.i0; i < node.i1; i++)
+        {
+            for (int k = node.k0; k < node.k1; k++)
+            {
+                for (int t = 0; t < 2; t++)
+                {
+                    GetTriangle(snapshot, i, k, t, v0, v1, v2);
+                    hduVector3Dd closest =
+                        closestPointOnTriangle(query, v0, v1, v2);
+                    double distSq = (closest - query).dotProduct(closest - query);
+                    if (distSq < bestDistSq)
+                    {
+                        bestDistSq = distSq;
+                        point = closest;
+                        normal = (v1 - v0).crossProduct(v2 - v0);
+                    }
+                }
+            }
+        }
+    }
+
+    pthread_mutex_unlock(&lock);
+
+    normal.normalize();
+    return true;
+}
+
+/******************************************************************************
+ SurfaceShape::IntersectSurface
+ Intersects the line segment from startPt to endPt with the surface.
+******************************************************************************/
+HLboolean HLCALLBACK SurfaceShape::IntersectSurface(
+    const HLdouble startPt[3],
+    const HLdouble endPt[3],
+    HLdouble intersectionPt[3],
+    HLdouble intersectionNormal[3],
+    HLenum *face,
+    void *userdata)
+{
+    SurfaceShape *pThis = static_cast<SurfaceShape *>(userdata);
+
+    hduVector3Dd point, normal;
+    bool isFrontFace;
+    if (!pThis->IntersectSegment(hduVector3Dd(startPt), hduVector3Dd(endPt),
+                                 point, normal, isFrontFace))
+    {
+        return HL_FALSE;
+    }
+
+    *face = isFrontFace ? HL_FRONT : HL_BACK;
+    for (int i = 0; i < 3; i++)
+    {
+        intersectionPt[i] = point[i];
+        intersectionNormal[i] = normal[i];
+    }
+
+    return HL_TRUE;
+}
+
+/******************************************************************************
+ SurfaceShape::ClosestSurfaceFeatures
+ Returns the plane of the triangle closest to queryPt as the local feature.
+******************************************************************************/
+HLboolean HLCALLBACK SurfaceShape::ClosestSurfaceFeatures(
+    const HLdouble queryPt[3],
+    const HLdouble targetPt[3],
+    HLgeom *geom,
+    HLdouble closestPt[3],
+    void *userdata)
+{
+    SurfaceShape *pThis = static_cast<SurfaceShape *>(userdata);
+
+    hduVector3Dd point, normal;
+    if (!pThis->FindClosestPoint(hduVector3Dd(queryPt), point, normal))
+        return HL_FALSE;
+
+    // the device is pushed through the surface, so face the plane away
+    // from it, towards the proxy
+    if (normal.dotProduct(hduVector3Dd(targetPt) - point) > 0)
+        normal = -normal;
+
+    hlLocalFeature2dv(geom, HL_LOCAL_FEATURE_PLANE, normal, point);
+    for (int i = 0; i < 3; i++)
+    {
+        closestPt[i] = point[i];
+    }
+
+    return HL_TRUE;
+}
+
+/******************************************************************************/
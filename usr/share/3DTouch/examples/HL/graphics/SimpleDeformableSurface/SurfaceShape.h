@@ -0,0 +1,118 @@
+/*****************************************************************************
+
+Copyright (c) 2004 SensAble Technologies, Inc. All rights reserved.
+
+OpenHaptics(TM) toolkit. The material embodied in this software and use of
+this software is subject to the terms and conditions of the clickthrough
+Development License Agreement.
+
+For questions, comments or bug reports, go to forums at:
+    http://dsc.sensable.com
+
+Module Name:
+
+  SurfaceShape.h
+
+Description:
+
+  Haptic representation of the deformable surface as an HL callback shape.
+  The grid triangles are kept in a bounding volume hierarchy that is refit,
+  not rebuilt, as the particles move, so that a query only visits the part
+  of the surface near the proxy.
+
+*******************************************************************************/
+
+#ifndef SurfaceShape_H_
+#define SurfaceShape_H_
+
+#if _MSC_VER > 1000
+#pragma once
+#endif // _MSC_VER > 1000
+
+#include <vector>
+#include <pthread.h>
+#include "DynamicsMath.h"
+#include <HDU/hduBoundBox.h>
+#include <HL/hl.h>
+
+class SurfaceShape
+{
+public:
+    SurfaceShape();
+    virtual ~SurfaceShape();
+
+    // Returns the positions to fill in for the next update, one for each
+    // particle of an inParticlesX by inParticlesZ grid, indexed by
+    // i * inParticlesZ + k.  The hierarchy is rebuilt if the grid size
+    // changed since the last update.
+    hduVector3Dd *BeginUpdate(int inParticlesX, int inParticlesZ);
+
+    // Refits the hierarchy to the positions and makes them the ones seen
+    // by the queries.  Safe to call while the haptic thread is querying.
+    void EndUpdate(void);
+
+    // Finds the intersection of the segment closest to start.  The normal
+    // faces the side the segment starts on.
+    bool IntersectSegment(const hduVector3Dd &start, const hduVector3Dd &end,
+                          hduVector3Dd &point, hduVector3Dd &normal,
+                          bool &isFrontFace);
+
+    // Finds the closest point on the surface and the front facing normal
+    // of the triangle it lies on.
+    bool FindClosestPoint(const hduVector3Dd &query, hduVector3Dd &point,
+                          hduVector3Dd &normal);
+
+    // Callbacks for HL_SHAPE_INTERSECT_LS and HL_SHAPE_CLOSEST_FEATURES,
+    // with the SurfaceShape as userdata.
+    static HLboolean HLCALLBACK IntersectSurface(
+        const HLdouble startPt[3],
+        const HLdouble endPt[3],
+        HLdouble intersectionPt[3],
+        HLdouble intersectionNormal[3],
+        HLenum *face,
+        void *userdata);
+
+    static HLboolean HLCALLBACK ClosestSurfaceFeatures(
+        const HLdouble queryPt[3],
+        const HLdouble targetPt[3],
+        HLgeom *geom,
+        HLdouble closestPt[3],
+        void *userdata);
+
+private:
+    // Covers the grid cells [i0, i1) x [k0, k1).  Children always come
+    // after their parent, so bounds can be refit in one backward pass.
+    struct Node
+    {
+        int i0, k0;
+        int i1, k1;
+        int left, right; // -1 for leaves
+    };
+
+    struct Snapshot
+    {
+        std::vector<hduVector3Dd> positions;
+        std::vector<hduBoundBox3Dd> bounds; // one per node
+    };
+
+    std::vector<Node> nodes;
+
+    // The queries read snapshots[front] while the next update is written
+    // to the other one.  lock guards front and frontValid.
+    Snapshot snapshots[2];
+    int front;
+    bool frontValid;
+    pthread_mutex_t lock;
+
+    int particlesX;
+    int particlesZ;
+
+    int BuildNode(int i0, int k0, int i1, int k1);
+    void Refit(Snapshot &snapshot);
+    void GetTriangle(const Snapshot &snapshot, int i, int k, int t,
+                     hduVector3Dd &v0, hduVector3Dd &v1, hduVector3Dd &v2);
+};
+
+#endif // SurfaceShape_H_
+
+/******************************************************************************/
@@ -0,0 +1,265 @@
+/*****************************************************************************
+
+Copyright (c) 2004 SensAble Technologies, Inc. All rights reserved.
+
+OpenHaptics(TM) toolkit. The material embodied in this software and use of
+this software is subject to the terms and conditions of the clickthrough
+Development License Agreement.
+
+For questions, comments or bug reports, go to forums at:
+    http://dsc.sensable.com
+
+Module Name:
+
+  SurfaceShapeBenchmark.cpp
+
+Description:
+
+  Times the haptic queries of SurfaceShape on a rippled grid against a scan
+  of every triangle, and checks that both find the same answers.  Also times
+  the per frame update that copies the positions and refits the hierarchy.
+  Usage: SurfaceShapeBenchmark [particles along each side]
+
+*******************************************************************************/
+
+#include "SurfaceShape.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <math.h>
+#include <time.h>
+
+/* Minimum time spent timing each loop. */
+static const double kMinSeconds = 0.5;
+
+static const double kSurfaceSize = 10;
+
+static const int kNumQueries = 1000;
+
+static double getTime()
+{
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return now.tv_sec + now.tv_nsec * 1e-9;
+}
+
+static double randomRange(double lo, double hi)
+{
+    return lo + (hi - lo) * rand() / RAND_MAX;
+}
+
+/* Fills positions with a grid rippled by phase, as the surface looks while
+   it is being pushed. */
+static void rippleGrid(hduVector3Dd *positions, int n, double phase)
+{
+    double spacing = kSurfaceSize / (n - 1);
+    for (int i = 0; i < n; i++)
+    {
+        for (int k = 0; k < n; k++)
+        {
+            double x = -kSurfaceSize / 2 + i * spacing;
+            double z = -kSurfaceSize / 2 + k * spacing;
+            double y = 0.5 * sin(x + phase) * cos(0.7 * z);
+            positions[i * n + k].set(x, y, z);
+        }
+    }
+}
+
+/* The grid triangles in the order SurfaceShape winds them. */
+static void getTriangle(const hduVector3Dd *positions, int n, int i, int k,
+                        int t, hduVector3Dd v[3])
+{
+    const hduVector3Dd *row0 = positions + i * n;
+    const hduVector3Dd *row1 = row0 + n;
+    if (t == 0)
+    {
+        v[0] = row0[k]; v[1] = row1[k]; v[2] = row0[k + 1];
+    }
+    else
+    {
+        v[0] = row1[k]; v[1] = row1[k + 1]; v[2] = row0[k + 1];
+    }
+}
+
+/* Scan of every triangle for the segment hit closest to start. */
+static bool scanIntersect(const hduVector3Dd *positions, int n,
+                          const hduVector3Dd &start, const hduVector3Dd &end,
+                          hduVector3Dd &point)
+{
+    hduVector3Dd dir = end - start;
+    double tBest = 2;
+    hduVector3Dd v[3];
+
+    for (int i = 0; i < n - 1; i++)
+    {
+        for (int k = 0; k < n - 1; k++)
+        {
+            for (int t = 0; t < 2; t++)
+            {
+                getTriangle(positions, n, i, k, t, v);
+                hduVector3Dd e1 = v[1] - v[0];
+                hduVector3Dd e2 = v[2] - v[0];
+                hduVector3Dd p = dir.crossProduct(e2);
+                double det = e1.dotProduct(p);
+                if (fabs(det) < 1e-12)
+                    continue;
+                hduVector3Dd s = start - v[0];
+                double u = s.dotProduct(p) / det;
+                hduVector3Dd q = s.crossProduct(e1);
+                double w = dir.dotProduct(q) / det;
+                double tHit = e2.dotProduct(q) / det;
+                if (u >= 0 && w >= 0 && u + w <= 1 &&
+                    tHit >= 0 && tHit <= 1 && tHit < tBest)
+                {
+                    tBest = tHit;
+                }
+            }
+        }
+    }
+
+    point = start + dir * tBest;
+    return tBest <= 1;
+}
+
+/* Scan of every vertex; a bound on the distance to the surface that needs
+   no triangle code, good enough to time the scan against. */
+static double scanClosestVertex(const hduVector3Dd *positions, int n,
+                                const hduVector3Dd &query)
+{
+    double best = HUGE_VAL;
+    for (int i = 0; i < n * n; i++)
+    {
+        hduVector3Dd d = positions[i] - query;
+        double distSq = d.dotProduct(d);
+        if (distSq < best)
+            best = distSq;
+    }
+    return sqrt(best);
+}
+
+int main(int argc, char *argv[])
+{
+    int n = argc > 1 ? atoi(argv[1]) : 200;
+    if (n < 2)
+    {
+        fprintf(stderr, "Usage: %s [particles along each side]\n", argv[0]);
+        return -1;
+    }
+
+    printf("%d x %d particles, %d triangles\n", n, n, 2 * (n - 1) * (n - 1));
+
+    SurfaceShape shape;
+    hduVector3Dd *positions = shape.BeginUpdate(n, n);
+    rippleGrid(positions, n, 0);
+    shape.EndUpdate();
+
+    hduVector3Dd *grid = new hduVector3Dd[n * n];
+    rippleGrid(grid, n, 0);
+
+    /* Short segments across the surface, as from the proxy to the device. */
+    hduVector3Dd *starts = new hduVector3Dd[kNumQueries];
+    hduVector3Dd *ends = new hduVector3Dd[kNumQueries];
+    srand(1);
+    for (int q = 0; q < kNumQueries; q++)
+    {
+        starts[q].set(randomRange(-4, 4), randomRange(0.3, 1),
+                      randomRange(-4, 4));
+        ends[q] = starts[q] + hduVector3Dd(randomRange(-0.2, 0.2), -1.5,
+                                           randomRange(-0.2, 0.2));
+    }
+
+    /* Check the answers first. */
+    int nHits = 0;
+    double maxError = 0;
+    for (int q = 0; q < kNumQueries; q++)
+    {
+        hduVector3Dd point, normal, scanPoint;
+        bool isFrontFace;
+        bool hit = shape.IntersectSegment(starts[q], ends[q], point, normal,
+                                          isFrontFace);
+        bool scanHit = scanIntersect(grid, n, starts[q], ends[q], scanPoint);
+        if (hit != scanHit)
+        {
+            fprintf(stderr, "query %d: hit %d, scan hit %d\n", q, hit, scanHit);
+            return -1;
+        }
+        if (hit)
+        {
+            nHits++;
+            maxError = fmax(maxError, (point - scanPoint).magnitude());
+        }
+
+        shape.FindClosestPoint(starts[q], point, normal);
+        double distance = (point - starts[q]).magnitude();
+        double vertexDistance = scanClosestVertex(grid, n, starts[q]);
+        if (distance > vertexDistance + 1e-9)
+        {
+            fprintf(stderr, "query %d: closest point %g beyond vertex %g\n",
+                    q, distance, vertexDistance);
+            return -1;
+        }
+    }
+    printf("%d of %d segments hit, largest difference from the scan %.1e\n",
+           nHits, kNumQueries, maxError);
+
+    /* Updates, as done once per graphics frame. */
+    long nRuns = 0;
+    double start = getTime();
+    double elapsed;
+    do
+    {
+        positions = shape.BeginUpdate(n, n);
+        rippleGrid(positions, n, 0.01 * nRuns);
+        shape.EndUpdate();
+        nRuns++;
+        elapsed = getTime() - start;
+    } while (elapsed < kMinSeconds);
+    printf("%-28s %10.2f us\n", "update (ripple and refit)",
+           elapsed / nRuns * 1e6);
+
+    positions = shape.BeginUpdate(n, n);
+    rippleGrid(positions, n, 0);
+    shape.EndUpdate();
+
+    /* Queries, as done by the haptic thread. */
+    const char *names[4] = { "intersect segment", "intersect segment (scan)",
+                             "closest point", "closest vertex (scan)" };
+    for (int test = 0; test < 4; test++)
+    {
+        long nQueries = 0;
+        start = getTime();
+        do
+        {
+            int q = nQueries % kNumQueries;
+            hduVector3Dd point, normal;
+            bool isFrontFace;
+            switch (test)
+            {
+                case 0:
+                    shape.IntersectSegment(starts[q], ends[q], point, normal,
+                                           isFrontFace);
+                    break;
+                case 1:
+                    scanIntersect(grid, n, starts[q], ends[q], point);
+                    break;
+                case 2:
+                    shape.FindClosestPoint(starts[q], point, normal);
+                    break;
+                case 3:
+                    scanClosestVertex(grid, n, starts[q]);
+                    break;
+            }
+            nQueries++;
+            elapsed = getTime() - start;
+        } while (elapsed < kMinSeconds);
+        printf("%-28s %10.2f us\n", names[test], elapsed / nQueries * 1e6);
+    }
+
+    delete [] starts;
+    delete [] ends;
+    delete [] grid;
+
+    return 0;
+}
+
+/******************************************************************************/
@@ -37,7 +37,7 @@ Description:
  	Draws a string using a bitmap font.  See GLUT documentation for the names
  	of fonts.
  */
-void DrawBitmapString(GLfloat x, GLfloat y, void *font, char *format,...)
+void DrawBitmapString(GLfloat x, GLfloat y, void *font, const char *format,...)
 {
 	int len, i;
 	va_list args;
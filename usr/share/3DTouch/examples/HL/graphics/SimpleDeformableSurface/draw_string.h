@@ -25,6 +25,6 @@ Description:
 #pragma once
 #endif // _MSC_VER > 1000
 
-void DrawBitmapString(GLfloat x, GLfloat y, void *font, char *format,...);
+void DrawBitmapString(GLfloat x, GLfloat y, void *font, const char *format,...);
 
 #endif // !defined(_DRAW_STRING_H_)
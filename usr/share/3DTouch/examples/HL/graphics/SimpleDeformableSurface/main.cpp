@@ -38,6 +38,7 @@ and may be protected by other U.S. patents or foreign patents. Other patents pen
 #include <HL/hl.h>
 #include <HDU/hdu.h>
 #include <HDU/hduError.h>
+#include <HDU/hduSimulationRunner.h>
 #include <HLU/hlu.h>
 
 #include "draw_string.h"
@@ -49,7 +50,8 @@ and may be protected by other U.S. patents or foreign patents. Other patents pen
 #include "Surface.h"
 #include "UnProjectUtilities.h"
 
-const int kMaxStepSizeMs = 33;
+const double kSimulationRate = 1000; // steps per second
+const double kImplicitSimulationRate = 100; // steps per second, stepping implicitly
 
 // default window dimensions
 const int kWindowWidthDefault = 640;
@@ -63,7 +65,6 @@ int		mMouseDownY = 0;	// mouse down coord
 
 bool	mUseFixedTimeStep = false;
 double	mManualTimeStep = 0.033;	// time to increment by when stepping manually
-double mTimeStep = 0;	// size of last time step (in seconds)
 bool	mPause = false;	// pause the simulation
 
 bool	mDesign = true;	// in design mode or simulation mode
@@ -83,6 +84,7 @@ const double kSurfaceSize = 10;
 int mSurfaceParticles = kSurfaceParticlesDef; // num particles in x and z direction making mSurface grid
 
 HLuint mSurfaceShapeId;
+SurfaceShape mSurfaceShape;
 HHD hHD = HD_INVALID_HANDLE;
 HHLRC hHLRC = NULL;
 double mCursorScale;
@@ -102,6 +104,7 @@ bool mDrawSurface = true;
 bool mDrawSystem = false;
 
 ParticleSystem mPS;	// the particle system
+hduSimulationRunner mRunner;	// advances mPS on its own thread
 
 // keep track of constraint while adding it
 SpringConstraint* mCurrSpringConstraint = NULL;
@@ -117,8 +120,8 @@ void Display(void);
 void RedrawCursor(void);
 void UpdateHapticMapping(void);
 void Idle(void);
-void AdvanceTime(double t);
-double GetTime(void);
+void StepSimulation(double t, double dt, void *userData);
+double GetSimulationRate(void);
 
 void HandleMouseButton(int button, int state, int x, int y);
 void HandleMouseMotion(int x, int y);
@@ -160,6 +163,10 @@ int main(int argc, char **argv)
 	ConstructSurface(mSurfaceParticles);
 	mPause = false;
 
+	// start the simulation; from here on mPS is only changed inside edits
+	mRunner.setRate(kSimulationRate);
+	mRunner.start(StepSimulation, NULL);
+
 	// create pulldown menus
 	CreateMenus();
 
@@ -175,6 +182,8 @@ int main(int argc, char **argv)
 
 void ConstructSurface(const int mSurfaceParticles)
 {
+	mRunner.beginEdit();
+
 	if (!mDesign)
 	{
 		mDesign = true;
@@ -184,6 +193,9 @@ void ConstructSurface(const int mSurfaceParticles)
 	mSurface.ConstructSurface(mSurfaceParticles, kSurfaceSize);
 
 	mDesign = false;
+	mRunner.setPaused(mPause);
+
+	mRunner.endEdit();
 }
 
 void InitDisplay(void)
@@ -289,6 +301,9 @@ void InitHL()
 *******************************************************************************/
 void exitHandler()
 {
+    // stop stepping before anything goes away
+    mRunner.stop();
+
     // free up the haptic rendering context
     hlMakeCurrent(NULL);
     if (hHLRC != NULL)
@@ -325,6 +340,7 @@ void CreateMenus(void)
 	glutAddMenuEntry("Pause (space)", ' ');
 	glutAddMenuEntry("Manual Advance (m)", 'm');
 	glutAddMenuEntry("Use Fixed Time Step (x)", 'x');
+	glutAddMenuEntry("Toggle Implicit Integration (e)", 'e');
 	glutAddMenuEntry("-", 0);
 
 /*	// Uncomment for interactive design of the system
@@ -349,6 +365,8 @@ void CreateMenus(void)
 	glutAddMenuEntry("Surface Resolution: 15", '4');
 	glutAddMenuEntry("Surface Resolution: 20", '5');
 	glutAddMenuEntry("Surface Resolution: 25", '6');
+	glutAddMenuEntry("Surface Resolution: 100", '!');
+	glutAddMenuEntry("Surface Resolution: 200", '@');
 	glutAddMenuEntry("-", 0);
 
 	glutAddMenuEntry("Toggle Show Information (i)", 'i');
@@ -369,6 +387,8 @@ void CreateMenus(void)
 // Handle menu commands
 void HandleMenuCommand(int option)
 {
+	mRunner.beginEdit();
+
 	switch(option)
 	{
 		case 'de':
@@ -532,6 +552,16 @@ void HandleMenuCommand(int option)
 			ConstructSurface(mSurfaceParticles);
 			break;
 		
+		case '!':
+			mSurfaceParticles = 100;
+			ConstructSurface(mSurfaceParticles);
+			break;
+		
+		case '@':
+			mSurfaceParticles = 200;
+			ConstructSurface(mSurfaceParticles);
+			break;
+		
 		case 'n':
 			mDrawNormals = !mDrawNormals;
 			break;
@@ -553,11 +583,17 @@ void HandleMenuCommand(int option)
 
 		case 'm':
 			if (mPause)
-				AdvanceTime(mManualTimeStep);
+				mRunner.advance(mManualTimeStep);
 			break;
 
 		case 'x':
 			mUseFixedTimeStep = !mUseFixedTimeStep;
+			mRunner.setRate(GetSimulationRate());
+			break;
+
+		case 'e':
+			mPS.SetImplicit(!mPS.IsImplicit());
+			mRunner.setRate(GetSimulationRate());
 			break;
 			
 		case ' ':
@@ -572,6 +608,11 @@ void HandleMenuCommand(int option)
 			//printf("Invalid menu choice: %c", option);
 			break;
 	}
+
+	// never step a system that is being designed
+	mRunner.setPaused(mPause || mDesign);
+
+	mRunner.endEdit();
 }
 
 void materialsTest(void)
@@ -830,6 +871,8 @@ void HandleMouseButton(int button, int state, int x, int y)
 {
 	int part;	// index of a particle
 	
+	mRunner.beginEdit();
+
 	if (mDesign)
 	{
 		if (button == GLUT_LEFT_BUTTON)
@@ -911,11 +954,15 @@ void HandleMouseButton(int button, int state, int x, int y)
 			}
 		}    
 	}
+
+	mRunner.endEdit();
 }
 
 // mouse motion callback
 void  HandleMouseMotion(int x, int y)
 {
+	mRunner.beginEdit();
+
 	if(!mDesign)
 	{
 		mPS.MouseMove(x, y);
@@ -927,6 +974,8 @@ void  HandleMouseMotion(int x, int y)
 			mCurrSpringConstraint->SetParticle(mPS.GetClosestParticle(x,y));
 		}
 	}
+
+	mRunner.endEdit();
 }
 
 /*
@@ -995,6 +1044,10 @@ void Display(void)
 
     hlCheckEvents();
 
+	// pick up the particle positions from the last simulation step
+	if (mPS.FetchPositions())
+		mSurface.InvalidateVertexCache();
+
 	/* clear the display */
 	//glClear(GL_COLOR_BUFFER_BIT);
 	glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
@@ -1004,17 +1057,26 @@ void Display(void)
 	if (mDrawSurface)
 		mSurface.DrawSurface();
 
-    // draw the haptic surface
+    // hand the current particle positions to the haptic surface, which HL
+    // queries directly instead of re-capturing the triangles every frame
+    mSurface.UpdateHapticShape(mSurfaceShape);
     hlHintb(HL_SHAPE_DYNAMIC_SURFACE_CHANGE, HL_TRUE);
     hlTouchableFace(HL_BACK);
-    hlBeginShape(HL_SHAPE_FEEDBACK_BUFFER, mSurfaceShapeId);
-        mSurface.DrawSurface();
+    hlBeginShape(HL_SHAPE_CALLBACK, mSurfaceShapeId);
+    hlCallback(HL_SHAPE_INTERSECT_LS, 
+        (HLcallbackProc) SurfaceShape::IntersectSurface, (void *) &mSurfaceShape);
+    hlCallback(HL_SHAPE_CLOSEST_FEATURES, 
+        (HLcallbackProc) SurfaceShape::ClosestSurfaceFeatures, (void *) &mSurfaceShape);
     hlEndShape();
 	
 	glDisable(GL_LIGHTING);
 
 	if (mDrawSystem)
+	{
+		mRunner.beginEdit();
 		mPS.Draw();
+		mRunner.endEdit();
+	}
 
 	if (mDrawNormals)
 		mSurface.DrawSurfaceNormals();
@@ -1068,9 +1130,13 @@ void DisplayInfo(void)
 		std::string stepLabel;
 		
 		if (mUseFixedTimeStep)
-			DrawBitmapString(mWindW - 24 * 9, 20 + (textRowDown) * 15, GLUT_BITMAP_9_BY_15, "Fixed Step (sec): %1.3f" , mTimeStep);
+			DrawBitmapString(mWindW - 24 * 9, 20 + (textRowDown++) * 15, GLUT_BITMAP_9_BY_15, "Fixed Step (sec): %1.3f" , 1 / mRunner.getRate());
 		else
-			DrawBitmapString(mWindW - 18 * 9, 20 + (textRowDown) * 15, GLUT_BITMAP_9_BY_15, "Step (sec): %1.3f" , mTimeStep);
+			DrawBitmapString(mWindW - 18 * 9, 20 + (textRowDown++) * 15, GLUT_BITMAP_9_BY_15, "Step (sec): %1.3f" , 1 / mRunner.getRate());
+
+		DrawBitmapString(mWindW - 20 * 9, 20 + (textRowDown++) * 15, GLUT_BITMAP_9_BY_15, "Steps/sec: %7.1f", mRunner.getStepRate());
+		DrawBitmapString(mWindW - 20 * 9, 20 + (textRowDown++) * 15, GLUT_BITMAP_9_BY_15, "Overruns: %8lu", mRunner.getOverruns());
+		DrawBitmapString(mWindW - 20 * 9, 20 + (textRowDown) * 15, GLUT_BITMAP_9_BY_15, "%20s", mPS.IsImplicit() ? "Implicit Euler" : "Runge-Kutta 4");
 
 		DrawBitmapString(5, mWindH - 10 - (textRowUp) * 15, GLUT_BITMAP_9_BY_15, "%s", mSurfaceConditionsName.c_str());
 
@@ -1198,48 +1264,22 @@ void DoViewingTransformation(void)
 
 void Idle(void)
 {
-	if (!mPause && !mDesign)
-	{
-		double t;
-
-		if (mUseFixedTimeStep)
-			t = mManualTimeStep;
-		else
-			t = GetTime();
-		
-		AdvanceTime(t);
-	}
-
+	// the simulation runs on its own thread; just keep the frames coming
 	glutPostRedisplay();
 }
 
-void AdvanceTime(double dt)
+void StepSimulation(double t, double dt, void *userData)
 {
-	static double prevTime = 0;
-	double currTime = prevTime + dt;
-
-	mPS.AdvanceSimulation(prevTime, currTime);
-	mSurface.InvalidateVertexCache();
-
-	mTimeStep = dt;
+	mPS.AdvanceSimulation(t, t + dt);
 }
 
-double GetTime(void)
+// The implicit solver stays stable at ten times the step.
+double GetSimulationRate(void)
 {
-	unsigned int	timeMs;
-	unsigned int	timeSinceLastMs;
-	static unsigned int timeOldMs = 0;
-	
-	timeMs = glutGet(GLUT_ELAPSED_TIME);
-	timeSinceLastMs = timeMs - timeOldMs;
-	timeOldMs = timeMs;
-	
-	if (timeSinceLastMs > kMaxStepSizeMs)
-	{
-		timeSinceLastMs = kMaxStepSizeMs;
-	}
+	if (mUseFixedTimeStep)
+		return 1 / mManualTimeStep;
 
-	return (double)timeSinceLastMs/ 1000;
+	return mPS.IsImplicit() ? kImplicitSimulationRate : kSimulationRate;
 }
 
 /*
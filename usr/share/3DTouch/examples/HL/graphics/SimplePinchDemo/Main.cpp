@@ -29,8 +29,9 @@ const int kMaxStepSizeMs = 10;
 double	mManualTimeStep = 0.01;
 double mTimeStep = 0;	// size of last time step (in seconds)
 
-//Cloth complexity.
-const int gridSize=25;
+//Cloth complexity.  May be given on the command line.
+int gridSize=25;
+const int kMinGridSize=3;
 
 //2 arrays of mass
 int numMass;
@@ -58,9 +59,25 @@ float dampFactor=0.9f;
 int numSprings;
 Spring * springs=NULL;
 
+//Force on each mass, summed spring by spring every step
+hduVector3Df * massForce=NULL;
+
+//The masses around each mass, that the device pushes along with it.  The
+//neighbors of mass i are neighbors[neighborStart[i]] up to
+//neighbors[neighborStart[i+1]].
+int * neighborStart=NULL;
+int * neighbors=NULL;
+
 int main(int argc, char **argv)
 {
 	glutInit(&argc, argv);
+
+	if (argc > 1)
+	{
+		gridSize = atoi(argv[1]);
+		if (gridSize < kMinGridSize)
+			gridSize = kMinGridSize;
+	}
     
     glutInitDisplayMode(GLUT_DOUBLE | GLUT_RGB | GLUT_DEPTH);
 
@@ -300,6 +317,15 @@ void exitHandler()
 		delete [] springs;
 
      springs=NULL;
+
+	delete [] massForce;
+	massForce=NULL;
+
+	delete [] neighborStart;
+	neighborStart=NULL;
+
+	delete [] neighbors;
+	neighbors=NULL;
 	
 
 	
@@ -497,8 +523,11 @@ void initCloth()
 	mass1=new Mass[numMass+1];
 	mass2=new Mass[numMass+1];
 	springs=new Spring[numSprings+1];
+	massForce=new hduVector3Df[numMass];
+	neighborStart=new int[numMass+1];
+	neighbors=new int[numMass*9];
 
-	if(!mass1 || !mass2 || !springs)
+	if(!mass1 || !mass2 || !springs || !massForce || !neighborStart || !neighbors)
 	{
 	printf("Unable to allocate space");
 	exit(0);
@@ -519,6 +548,7 @@ void setupCloth()
 {
 	initAllMass();
 	initAllSprings();
+	initNeighbors();
 }
 void initAllMass()
 {
@@ -651,6 +681,29 @@ void initAllSprings()
 		}
 	}
 }
+void initNeighbors()
+{
+	//The 3x3 block of masses around each one, clipped at the edges
+	int count=0;
+
+	for(int i=0; i<gridSize; ++i)
+	{
+		for(int j=0; j<gridSize; ++j)
+		{
+			neighborStart[i*gridSize+j]=count;
+
+			for(int ni=i-1; ni<=i+1; ++ni)
+			{
+				for(int nj=j-1; nj<=j+1; ++nj)
+				{
+					if(ni>=0 && ni<gridSize && nj>=0 && nj<gridSize)
+						neighbors[count++]=ni*gridSize+nj;
+				}
+			}
+		}
+	}
+	neighborStart[numMass]=count;
+}
 void updatePhysics(double tPrev, double tCurr)
 {
 	//set currentTime and timePassed
@@ -661,19 +714,43 @@ void updatePhysics(double tPrev, double tCurr)
 
 	//Update the physics 
 
-	//Calculate the tensions in the springs
+	//Start every mass with gravity
+	for(int i=0; i<numMass; ++i)
+		massForce[i]=gravity;
+
+	//Calculate the tension in each spring and pull both its masses
+	//together by it, in one pass over the springs
 	for(int i=0; i<numSprings; ++i)
 	{
-		hduVector3Dd tempLength = (currentMass[springs[i].imass1].position-
-			currentMass[springs[i].imass2].position);
+		Spring & spring=springs[i];
+
+		hduVector3Df tensionDirection=currentMass[spring.imass2].position-
+			currentMass[spring.imass1].position;
+
+		float springLength=tensionDirection.magnitude();
 
-		float springLength=tempLength.magnitude();
+		float extension=springLength-spring.naturalLength;
 
-		float extension=springLength-springs[i].naturalLength;
+		spring.tension=spring.springConstant*extension/spring.naturalLength;
 
-		springs[i].tension=springs[i].springConstant*extension/springs[i].naturalLength;
+		tensionDirection/=springLength;
+
+		massForce[spring.imass1]+=spring.tension*tensionDirection;
+		massForce[spring.imass2]-=spring.tension*tensionDirection;
 	}
 
+	//The device pushes the touched mass and those around it
+	if (touchedCloth || movingOnCloth)
+	{
+		hduVector3Df currentForce;
+		hdGetFloatv(HD_CURRENT_FORCE, currentForce);
+
+		//The touch callbacks may change massTouched meanwhile
+		int touched=massTouched;
+
+		for(int k=neighborStart[touched]; k<neighborStart[touched+1]; ++k)
+			massForce[neighbors[k]]-=currentForce;
+	}
 
 	for(int i=0; i<numMass; ++i)
 	{
@@ -685,53 +762,13 @@ void updatePhysics(double tPrev, double tCurr)
 		//the new values
 		if(currentMass[i].fixed)
 		{
-			nextMass[i].position=nextMass[i].position;
+			nextMass[i].position=currentMass[i].position;
 			nextMass[i].velocity.set(0.0,0.0,0.0);
 		}
 		else
 		{
-			hduVector3Df currentForce;
-			hdGetFloatv(HD_CURRENT_FORCE, currentForce);
-			//Calculate the force on this mass
-			if (touchedCloth || movingOnCloth)
-			{
-				if (i == massTouched || i == massTouched-1 || i == massTouched+1 
-					|| i ==(massTouched-gridSize) || i ==(massTouched-gridSize)+1 ||i ==(massTouched-gridSize)-1
-					|| i ==(massTouched+gridSize) || i ==(massTouched+gridSize)+1 || i ==(massTouched+gridSize)-1)
-					force = -currentForce + gravity ;
-				else
-					force = gravity;
-			}
-			else
-				force = gravity;
-
-			//Loop through springs
-			for(int j=0; j<numSprings; ++j)
-			{
-				//If this mass is "imass1" for this spring, add the tension to the force
-				if(springs[j].imass1==i)
-				{
-					hduVector3Df tensionDirection=	currentMass[springs[j].imass2].position-
-						currentMass[i].position;
-					tensionDirection.normalize();
-
-					force+=springs[j].tension*tensionDirection;
-				}
-
-				//Similarly if the mass is "imass2"
-				if(springs[j].imass2==i)
-				{
-					hduVector3Df tensionDirection=	currentMass[springs[j].imass1].position-
-						currentMass[i].position;
-					tensionDirection.normalize();
-
-					force+=springs[j].tension*tensionDirection;
-				}
-			}
-
-
 			//Calculate the acceleration
-			hduVector3Df acceleration=force/currentMass[i].mass;
+			hduVector3Df acceleration=massForce[i]/currentMass[i].mass;
 
 			//Update velocity
 			nextMass[i].velocity=currentMass[i].velocity+acceleration*
@@ -740,9 +777,10 @@ void updatePhysics(double tPrev, double tCurr)
 			//Damp the velocity
 			nextMass[i].velocity*=dampFactor;
 
-			//Calculate new position
+			//Calculate new position from the new velocity (semi-implicit
+			//Euler); averaging in the old velocity is unstable at these steps
 			nextMass[i].position=currentMass[i].position+
-				(nextMass[i].velocity+currentMass[i].velocity)*(float)timePassed/2;
+				nextMass[i].velocity*(float)timePassed;
 
 		}
 	}
@@ -750,7 +788,7 @@ void updatePhysics(double tPrev, double tCurr)
 	//Swap the currentMass and newMass pointers
 	Mass * temp=currentMass;
 	currentMass=nextMass;
-	nextMass=currentMass;
+	nextMass=temp;
 
 	//Update the normals of the surface
 	updateNormals();
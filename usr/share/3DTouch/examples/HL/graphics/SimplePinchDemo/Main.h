@@ -75,6 +75,7 @@ void initCloth();
 void setupCloth();
 void initAllMass();
 void initAllSprings();
+void initNeighbors();
 void updatePhysics(double tPrev, double tCurr);
 void updateNormals();
 void drawCloth();
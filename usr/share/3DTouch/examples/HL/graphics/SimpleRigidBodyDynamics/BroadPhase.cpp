@@ -0,0 +1,212 @@
+/*****************************************************************************
+
+Copyright (c) 2004 SensAble Technologies, Inc. All rights reserved.
+
+OpenHaptics(TM) toolkit. The material embodied in this software and use of
+this software is subject to the terms and conditions of the clickthrough
+Development License Agreement.
+
+For questions, comments or bug reports, go to forums at:
+    http://dsc.sensable.com
+
+Module Name:
+
+  BroadPhase.cpp
+
+Description:
+
+  Sweep and prune broad phase.
+
+*******************************************************************************/
+
+#include "SimpleRigidBodyDynamicsAfx.h"
+#include "BroadPhase.h"
+#include "RigidBody.h"
+
+#include <algorithm>
+
+namespace
+{
+
+// How much more spread out along another axis the boxes must be before the
+// sweep switches to it.  Every switch costs a full re-sort.
+const double kAxisSwitchRatio = 1.2;
+
+bool pairLess(const BodyPair &p0, const BodyPair &p1)
+{
+    if (p0.rbA->getId() != p1.rbA->getId())
+        return p0.rbA->getId() < p1.rbA->getId();
+    return p0.rbB->getId() < p1.rbB->getId();
+}
+
+bool overlaps(const hduBoundBox3Dd &b0, const hduBoundBox3Dd &b1, int axis)
+{
+    return b0.lo()[axis] <= b1.hi()[axis] && b1.lo()[axis] <= b0.hi()[axis];
+}
+
+} // anonymous namespace
+
+//////////////////////////////////////////////////////////////////////
+// Construction/Destruction
+//////////////////////////////////////////////////////////////////////
+
+BroadPhase::BroadPhase() :
+    mAxis(0),
+    mMargin(0)
+{
+}
+
+BroadPhase::~BroadPhase()
+{
+}
+
+void BroadPhase::addBody(RigidBody *rb)
+{
+    assert(rb != NULL);
+
+    // new entries go at the end; the next sort moves them into place
+    Entry entry;
+    entry.rb = rb;
+    mEntries.push_back(entry);
+}
+
+void BroadPhase::removeBody(RigidBody *rb)
+{
+    EntryListT::iterator ei;
+
+    for (ei = mEntries.begin(); ei != mEntries.end(); ++ei)
+    {
+        if (ei->rb == rb)
+        {
+            mEntries.erase(ei);
+            return;
+        }
+    }
+}
+
+void BroadPhase::clear(void)
+{
+    mEntries.clear();
+}
+
+void BroadPhase::updateBounds(void)
+{
+    EntryListT::iterator ei;
+    hduVector3Dd margin(mMargin, mMargin, mMargin);
+
+    for (ei = mEntries.begin(); ei != mEntries.end(); ++ei)
+    {
+        ei->rb->getWorldBounds(ei->bounds);
+        ei->bounds.rLo() -= margin;
+        ei->bounds.rHi() += margin;
+    }
+}
+
+//
+// Sweep along the axis in which the box centers are spread out the most,
+// so that as few boxes as possible overlap along it.  Scenes spread about
+// equally along two axes would flip between them, re-sorting from scratch
+// each time, so the axis only changes once another is clearly better.
+//
+void BroadPhase::chooseAxis(void)
+{
+    if (mEntries.size() < 2)
+        return;
+
+    hduVector3Dd sum(0,0,0);
+    hduVector3Dd sumSq(0,0,0);
+    EntryListT::const_iterator ci;
+
+    for (ci = mEntries.begin(); ci != mEntries.end(); ++ci)
+    {
+        hduVector3Dd center = 0.5 * (ci->bounds.lo() + ci->bounds.hi());
+        sum += center;
+        sumSq += center * center;
+    }
+
+    // variance times the number of entries
+    hduVector3Dd spread = sumSq - sum * sum / mEntries.size();
+
+    int best = 0;
+    if (spread[1] > spread[best])
+        best = 1;
+    if (spread[2] > spread[best])
+        best = 2;
+
+    if (spread[best] > kAxisSwitchRatio * spread[mAxis])
+        mAxis = best;
+}
+
+//
+// Insertion sort on the lower bounds.  Linear when the order from the
+// previous call still (nearly) holds.
+//
+void BroadPhase::sortEntries(void)
+{
+    for (size_t i = 1; i < mEntries.size(); i++)
+    {
+        double lo = mEntries[i].bounds.lo()[mAxis];
+        if (mEntries[i - 1].bounds.lo()[mAxis] <= lo)
+            continue;
+
+        Entry entry = mEntries[i];
+        size_t j = i;
+        while (j > 0 && mEntries[j - 1].bounds.lo()[mAxis] > lo)
+        {
+            mEntries[j] = mEntries[j - 1];
+            j--;
+        }
+        mEntries[j] = entry;
+    }
+}
+
+void BroadPhase::findPairs(BodyPairListT &pairs)
+{
+    pairs.clear();
+
+    updateBounds();
+    chooseAxis();
+    sortEntries();
+
+    int axis1 = (mAxis + 1) % 3;
+    int axis2 = (mAxis + 2) % 3;
+
+    for (size_t i = 0; i < mEntries.size(); i++)
+    {
+        const Entry &entryI = mEntries[i];
+        double hi = entryI.bounds.hi()[mAxis];
+
+        // every later entry starts at or after entryI along the axis, so
+        // stop at the first one that starts past its end
+        for (size_t j = i + 1; j < mEntries.size(); j++)
+        {
+            const Entry &entryJ = mEntries[j];
+            if (entryJ.bounds.lo()[mAxis] > hi)
+                break;
+
+            if (entryI.rb->massInv == 0 && entryJ.rb->massInv == 0)
+                continue;
+
+            if (!overlaps(entryI.bounds, entryJ.bounds, axis1) ||
+                !overlaps(entryI.bounds, entryJ.bounds, axis2))
+                continue;
+
+            BodyPair pair;
+            if (entryI.rb->getId() < entryJ.rb->getId())
+            {
+                pair.rbA = entryI.rb;
+                pair.rbB = entryJ.rb;
+            }
+            else
+            {
+                pair.rbA = entryJ.rb;
+                pair.rbB = entryI.rb;
+            }
+            pairs.push_back(pair);
+        }
+    }
+
+    std::sort(pairs.begin(), pairs.end(), pairLess);
+}
+
+/******************************************************************************/
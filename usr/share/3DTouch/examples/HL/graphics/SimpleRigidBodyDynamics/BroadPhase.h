@@ -0,0 +1,86 @@
+/*****************************************************************************
+
+Copyright (c) 2004 SensAble Technologies, Inc. All rights reserved.
+
+OpenHaptics(TM) toolkit. The material embodied in this software and use of
+this software is subject to the terms and conditions of the clickthrough
+Development License Agreement.
+
+For questions, comments or bug reports, go to forums at:
+    http://dsc.sensable.com
+
+Module Name:
+
+  BroadPhase.h
+
+Description:
+
+  Sweep and prune broad phase.  Finds the pairs of bodies whose axis aligned
+  bounding boxes overlap, so that only those need to be handed to the
+  separating plane search.
+
+*******************************************************************************/
+
+#if !defined(AFX_BROADPHASE_H__5E0C2B7A_8D41_4F63_9A1E_2C6B7D3F9A10__INCLUDED_)
+#define AFX_BROADPHASE_H__5E0C2B7A_8D41_4F63_9A1E_2C6B7D3F9A10__INCLUDED_
+
+#if _MSC_VER > 1000
+#pragma once
+#endif // _MSC_VER > 1000
+
+#include <vector>
+#include "DynamicsMath.h"
+#include <HDU/hduBoundBox.h>
+
+class RigidBody;
+
+// rbA has the lower id of the two bodies
+struct BodyPair
+{
+    RigidBody *rbA;
+    RigidBody *rbB;
+};
+
+typedef std::vector<BodyPair> BodyPairListT;
+
+class BroadPhase
+{
+public:
+    BroadPhase();
+    virtual ~BroadPhase();
+
+    void addBody(RigidBody *rb);
+    void removeBody(RigidBody *rb);
+    void clear(void);
+
+    // bounding boxes are grown by margin on every side
+    double getMargin(void) { return mMargin; }
+    void setMargin(double margin) { mMargin = margin; }
+
+    // Find all pairs of bodies whose bounding boxes overlap, in order of
+    // the ids of rbA then rbB.  Pairs of fixed bodies are left out.
+    // Bounds are taken from the world space vertices of the bodies.
+    void findPairs(BodyPairListT &pairs);
+
+private:
+    struct Entry
+    {
+        RigidBody *rb;
+        hduBoundBox3Dd bounds;
+    };
+    typedef std::vector<Entry> EntryListT;
+
+    // Sorted by the lower bound along mAxis.  The order is kept between
+    // calls; bodies move little per step, so re-sorting is close to linear.
+    EntryListT mEntries;
+    int mAxis;
+    double mMargin;
+
+    void updateBounds(void);
+    void chooseAxis(void);
+    void sortEntries(void);
+};
+
+#endif // !defined(AFX_BROADPHASE_H__5E0C2B7A_8D41_4F63_9A1E_2C6B7D3F9A10__INCLUDED_)
+
+/******************************************************************************/
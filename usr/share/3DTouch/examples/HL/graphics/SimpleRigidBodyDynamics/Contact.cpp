@@ -30,7 +30,13 @@ Contact::Contact() :
     a(0),
     b(0),
     p(0,0,0),
-    n(0,0,0)
+    n(0,0,0),
+    dist(0),
+    jn(0),
+    ra(0,0,0),
+    rb(0,0,0),
+    massNormal(0),
+    bias(0)
 {
 }
 
@@ -38,55 +44,83 @@ Contact::~Contact()
 {
 }
 
-// Return true if bodies are in colliding contact.  The
-// parameter 'kCollidingThreshold' is a small numerical tolerance
-// used for deciding if bodies are colliding.
-ECollidingState Contact::colliding(void)
+void Contact::prepare(double coefficientOfRestitution, double restingVelocity,
+                      double penetrationSlop, double penetrationRecovery)
 {
+    ra = p - a->x;
+    rb = p - b->x;
+
+    // We'll calculate the denominator in four parts.
+    double          term1 = a->massInv;
+    double          term2 = b->massInv;
+    double          term3 = n.dotProduct((a->Iinv * ra.crossProduct(n)).crossProduct(ra));
+    double          term4 = n.dotProduct((b->Iinv * rb.crossProduct(n)).crossProduct(rb));
+    massNormal = 1.0 / (term1 + term2 + term3 + term4);
+
+    // Bounce only off real collisions, so that resting bodies, which
+    // gravity starts toward each other every step, stay at rest.
     hduVector3Dd    padot = a->pointVelocity(p);
     hduVector3Dd    pbdot = b->pointVelocity(p);
     double          vrel = n.dotProduct(padot - pbdot);
 
-    if (vrel > kCollidingThreshold)         // moving apart
-        return collidingState_Separating;
-    if (vrel > -kCollidingThreshold)        // resting contact
-        return collidingState_RestingContact;
-    else // vrel < -kCollidingThreshold
-        return collidingState_Colliding;
+    bias = 0;
+    if (vrel < -restingVelocity)
+        bias = -coefficientOfRestitution * vrel;
+
+    double penetration = -dist - penetrationSlop;
+    if (penetration > 0 && penetrationRecovery * penetration > bias)
+        bias = penetrationRecovery * penetration;
+}
+
+void Contact::warmStart(void)
+{
+    applyImpulse(jn);
 }
 
-// Compute and apply the impulse for the collision.
-void Contact::doCollision(double coefficientOfRestitution)
+double Contact::solve(void)
 {
     hduVector3Dd    padot = a->pointVelocity(p);
     hduVector3Dd    pbdot = b->pointVelocity(p);
-    hduVector3Dd    ra = p - a->x;
-    hduVector3Dd    rb = p - b->x;
     double          vrel = n.dotProduct(padot - pbdot);
-    double          numerator = -(1 + coefficientOfRestitution) * vrel;
-        
-    // We'll calculate the denominator in four parts.
-    double          term1 = a->massInv;
-    double          term2 = b->massInv;
-    double          term3 = n.dotProduct((a->Iinv * ra.crossProduct(n)).crossProduct(ra));
-    double          term4 = n.dotProduct((b->Iinv * rb.crossProduct(n)).crossProduct(rb));
-        
-    // Compute the impulse magnitude.
-    double          j = numerator / (term1 + term2 + term3 + term4);
+
+    // The contact can only push, so clamp the total rather than the
+    // change, which lets later iterations take back what earlier ones
+    // overshot.
+    double jnOld = jn;
+    jn += massNormal * (bias - vrel);
+    if (jn < 0)
+        jn = 0;
+
+    double j = jn - jnOld;
+    applyImpulse(j);
+    return j;
+}
+
+// Apply an impulse of magnitude j along the normal to the bodies.
+// Fixed bodies are left alone, so that contacts with the same wall can be
+// solved at once on different threads.
+void Contact::applyImpulse(double j)
+{
     hduVector3Dd    force = j * n;
 
-    // Apply the impulse to the bodies.
-    a->P += force;
-    b->P -= force;
-    a->L += ra.crossProduct(force);
-    b->L -= rb.crossProduct(force);
+    if (a->massInv != 0)
+    {
+        a->P += force;
+        a->L += ra.crossProduct(force);
+
+        // Recompute auxiliary variables.
+        a->v = a->P * a->massInv;
+        a->omega = a->Iinv * a->L;
+    }
 
-    // Recompute auxiliary variables.
-    a->v = a->P * a->massInv;
-    b->v = b->P * b->massInv;
+    if (b->massInv != 0)
+    {
+        b->P -= force;
+        b->L -= rb.crossProduct(force);
 
-    a->omega = a->Iinv * a->L;
-    b->omega = b->Iinv * b->L;
+        b->v = b->P * b->massInv;
+        b->omega = b->Iinv * b->L;
+    }
 }
 
 /******************************************************************************/
@@ -32,29 +32,45 @@ Description:
 #include "DynamicsMath.h"
 #include "RigidBody.h"
 
-const double kCollidingThreshold = 0.01;
-
-enum ECollidingState
-{
-    collidingState_Unknown,
-    collidingState_Separating,
-    collidingState_RestingContact,
-    collidingState_Colliding
-};
-
+// A contact is solved as an impulse along the normal that keeps the bodies
+// from approaching at the contact point.  The impulse accumulates over the
+// iterations of the solver and is kept for the next step, which starts
+// from it (warm starting).
 class Contact  
 {
 public:
     Contact();
     virtual ~Contact();
 
-    ECollidingState colliding(void);
-    void doCollision(double coefficientOfRestitution);
+    // Sets up the contact for solving: the effective mass along the normal,
+    // and the approach velocity the solver aims for, which bounces off
+    // contacts approaching faster than restingVelocity and pushes apart
+    // penetrating ones.
+    void prepare(double coefficientOfRestitution, double restingVelocity,
+                 double penetrationSlop, double penetrationRecovery);
+
+    // Applies the accumulated impulse carried over from the last step.
+    void warmStart(void);
+
+    // One Gauss-Seidel iteration: corrects the accumulated impulse toward
+    // the target velocity, keeping it pushing.  Returns the change.
+    double solve(void);
 
     RigidBody       *a;     // body containing vertex
     RigidBody       *b;     // body containing face
     hduVector3Dd    p;      // world-space vectex location
     hduVector3Dd    n;      // outwards pointing normal of face
+    double          dist;   // distance of p from the face; negative is penetration
+
+    double          jn;     // accumulated normal impulse
+
+private:
+    void applyImpulse(double j);
+
+    hduVector3Dd    ra;     // p relative to the centers of mass
+    hduVector3Dd    rb;
+    double          massNormal;     // effective mass along n
+    double          bias;           // target separating velocity
 };
 
 #endif // !defined(AFX_CONTACT_H__0B4B12A3_37FD_4829_A63C_19AA1B012716__INCLUDED_)
@@ -15,13 +15,13 @@ Module Name:
 
 Description:
 
-  List of contacts between rigid bodies.
+  Contacts between rigid bodies, stored by value in one flat array.
 
 *******************************************************************************/
-#include <list>
+#include <vector>
 
 class Contact;
 
-typedef std::list<Contact*> ContactListT;
+typedef std::vector<Contact> ContactListT;
 
 /******************************************************************************/
@@ -33,6 +33,8 @@ DynEdge::DynEdge(RigidBody *rb, int i, int j) :
     assert(rb);
     vertices[0] = i;
     vertices[1] = j;
+    mFaceNormals[0] = -1;
+    mFaceNormals[1] = -1;
 }
 
 DynEdge::~DynEdge()
@@ -50,6 +52,16 @@ hduVector3Dd *DynEdge::getSecondVertex(void)
     return mBody->getVertex(vertices[1]);
 }
 
+bool DynEdge::getFaceNormals(hduVector3Dd &n0, hduVector3Dd &n1)
+{
+    if (mFaceNormals[1] < 0)
+        return false;
+
+    n0 = *mBody->getNormal(mFaceNormals[0]);
+    n1 = *mBody->getNormal(mFaceNormals[1]);
+    return true;
+}
+
 hduVector3Dd *DynEdge::getNonColinearVertex(void)
 {
     // assume the body has more than 2 vertices
@@ -38,10 +38,17 @@ public:
     hduVector3Dd *getFirstVertex(void);
     hduVector3Dd *getSecondVertex(void);
     hduVector3Dd *getNonColinearVertex(void);
+
+    // The normals of the two faces the edge joins, which bound the arc of
+    // the edge on the Gauss map.  An edge that doesn't join two faces has
+    // no arc, and returns false.
+    void setFace(int i, int normalIndex) { mFaceNormals[i] = normalIndex; }
+    bool getFaceNormals(hduVector3Dd &n0, hduVector3Dd &n1);
     
 private:
     RigidBody *mBody;
     int vertices[2];
+    int mFaceNormals[2];    // normal indices of the faces joined
 };
 
 #endif // !defined(AFX_DYNEDGE_H__E5FDFB10_CB09_4017_A1F4_FA04AA3BDDA9__INCLUDED_)
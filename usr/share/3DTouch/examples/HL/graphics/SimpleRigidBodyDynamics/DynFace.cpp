@@ -45,6 +45,20 @@ DynFace::~DynFace()
 {
 }
 
+// Return true if vertices i and j are next to each other around the face
+bool DynFace::hasEdge(int i, int j)
+{
+    int numVerts = vertices.size();
+    for (int k = 0; k < numVerts; k++)
+    {
+        int l = (k + 1) % numVerts;
+        if ((vertices[k] == i && vertices[l] == j) ||
+            (vertices[k] == j && vertices[l] == i))
+            return true;
+    }
+    return false;
+}
+
 void DynFace::calculateNormal(hduVector3Dd *normal)
 {
 #ifdef _DEBUG
@@ -45,8 +45,10 @@ public:
     int getNumVertices(void) { return vertices.size(); }
 
     void setNormalIndex(int n) { normalIndex = n; }
+    int getNormalIndex(void) { return normalIndex; }
     void addVertexIndex(int i) { vertices.push_back(i); }
         
+    bool hasEdge(int i, int j);
     void calculateNormal(hduVector3Dd *normal);
     void draw(void);
 
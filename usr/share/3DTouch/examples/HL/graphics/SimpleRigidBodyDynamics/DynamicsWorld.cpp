@@ -33,6 +33,35 @@ static const double kMouseContactThreshold = 0.1;
 
 static const double kCoefficientOfRestitutionDef = 0.7;
 
+// Contacts approaching slower than this don't bounce.  It is above the
+// speed gravity gives a body in a step, so that resting bodies stay put.
+static const double kRestingVelocity = 0.1;
+
+// Penetration deeper than the slop is pushed apart at this rate (1/s).
+static const double kPenetrationRecovery = 20;
+
+// Sweeps of the contact solver over all contacts per step.
+static const int kSolverIterationsDef = 10;
+
+// The solver stops early once no impulse changes by more than this.
+static const double kSolverTolerance = 1e-6;
+
+// A contact carries its impulse over from the last step only if its normal
+// has turned by less than this (cosine of the angle).
+static const double kWarmStartNormalCos = 0.95;
+
+// An island falls asleep once all its bodies have been slower than these
+// for kTimeToSleep seconds.  Resting bodies gain less speed than this from
+// gravity over a step.
+static const double kSleepVelocity = 0.05;
+static const double kSleepAngularVelocity = 0.05;
+static const double kTimeToSleep = 0.5;
+
+// Items of the parallel loops handed out at a time; bodies and pairs are
+// quick to do, islands may take long.
+static const int kBodyGrain = 16;
+static const int kPairGrain = 4;
+
 // the number of values (double) needed to store the state for one body
 static const int kStateSize = 13;
 
@@ -41,6 +70,9 @@ static const double kGravityDef = -9.8;
 static const double kDragLinear = 0.1;
 static const double kDragAngular = 0.1;
 
+// simulation force per newton on the haptic device
+static const double kDeviceForceToSimForce = 10;
+
 void HLCALLBACK OnHapticDeviceButtonDown(HLenum event, HLuint object, 
                                      HLenum thread, HLcache *cache, 
                                      void *userdata);
@@ -49,20 +81,31 @@ void HLCALLBACK OnHapticDeviceButtonUp(HLenum event, HLuint object,
                                      void *userdata);
 
 extern int nHapticDeviceDOFInput;
-extern int nHapticDeviceDOFOutput;
 
 //////////////////////////////////////////////////////////////////////
 // Construction/Destruction
 //////////////////////////////////////////////////////////////////////
 
 DynamicsWorld::DynamicsWorld() :
+    mSleepEnabled(true),
+    mStepTime(0),
+    mStepX(NULL),
+    mStepXdot(NULL),
+    mStepImpulses(false),
     mDrawWitnesses(false),
     mGravity(kGravityDef),
+    mSolverIterations(kSolverIterationsDef),
     mouseSpringBody(NULL),
     mouseSpringPos(0,0,0),
     hapticMode(TOUCH_OBJECTS),
-    hapticControlObject(HL_OBJECT_ANY)
+    hapticControlObject(HL_OBJECT_ANY),
+    mCouplingBody(HL_OBJECT_ANY)
 {
+    // bodies closer than the contact threshold must reach the narrow phase
+    mBroadPhase.setMargin(kContactThreshold);
+
+    mThreadPool.start(ThreadPool::getNumProcessors());
+
     // handler for button up event
     hlAddEventCallback(HL_EVENT_1BUTTONUP, HL_OBJECT_ANY, HL_CLIENT_THREAD, 
                        OnHapticDeviceButtonUp, this);
@@ -86,28 +129,18 @@ DynamicsWorld::~DynamicsWorld()
 
 void DynamicsWorld::arrayToBodies(nvectord &x)
 {
-    BodyListT::const_iterator ci; // constant because not modifying list
-    int i = 0;
-
-    for (ci = mBodies.begin(); ci != mBodies.end(); ++ci)
-    {
-        RigidBody& rb = *((*ci).second);
-        assert(&rb != NULL);
-                
-        rb.arrayToState(&x[i * kStateSize]);
-
-        i++;
-    }
+    mStepX = &x;
+    mThreadPool.parallelFor(mBodyArray.size(), arrayToBodyTask, this, kBodyGrain);
 
     //
     // Update any dependent values
     //
         
-    WitnessListT::const_iterator ciW;
+    WitnessMapT::const_iterator ciW;
         
     for (ciW = mWitnesses.begin(); ciW != mWitnesses.end(); ++ciW)
     {
-        Witness *w = *ciW;
+        Witness *w = (*ciW).second;
         assert(w != NULL);
                 
         w->updateFromBodies();
@@ -116,18 +149,17 @@ void DynamicsWorld::arrayToBodies(nvectord &x)
 
 void DynamicsWorld::bodiesToArray(nvectord &x)
 {
-    BodyListT::const_iterator ci; // constant because not modifying list
-    int i = 0;
+    for (unsigned int i = 0; i < mBodyArray.size(); i++)
+        mBodyArray[i]->stateToArray(&x[i * kStateSize]);
+}
 
-    for (ci = mBodies.begin(); ci != mBodies.end(); ++ci)
-    {
-        RigidBody& rb = *((*ci).second);
-        assert(&rb != NULL);
-                
-        rb.stateToArray(&x[i * kStateSize]);
+// Bodies asleep keep the state they went to sleep in.
+void DynamicsWorld::arrayToBodyTask(int i, void *userData)
+{
+    DynamicsWorld *pThis = static_cast<DynamicsWorld *>(userData);
 
-        i++;
-    }
+    if (!pThis->mAsleep[i])
+        pThis->mBodyArray[i]->arrayToState(&(*pThis->mStepX)[i * kStateSize]);
 }
 
 //
@@ -186,122 +218,64 @@ void DynamicsWorld::computeForceAndTorque(double t, RigidBody *rb)
 
 void DynamicsWorld::addHapticDeviceForce(RigidBody* rb)
 {
-    if (hapticMode == TOUCH_OBJECTS)
+    const HapticInput& input = mHapticInputBuffer.getReadBuffer();
+
+    if (input.mode == TOUCH_OBJECTS)
     {
         // if we are in contact with the object, and it is
         // not a wall (with massInv == 0), then apply a force
         // opposite the force applied to the haptic device for
         // this shape
-        HLboolean isTouching;
-        hlGetShapeBooleanv(rb->getId(), HL_PROXY_IS_TOUCHING, &isTouching);
-        if (isTouching && rb->massInv != 0)
+        if (rb->massInv == 0)
+            return;
+
+        for (unsigned int i = 0; i < input.touches.size(); i++)
         {
-            hduVector3Dd force;
-            hlGetShapeDoublev(rb->getId(), HL_REACTION_FORCE, force);
-            hduVector3Dd contactPos;
-            hlGetDoublev(HL_PROXY_POSITION, contactPos);
-            const double deviceForceToSimForceScale = 10;
-            rb->applyForceAtPoint(-deviceForceToSimForceScale * force, contactPos);
+            if (input.touches[i].id == rb->getId())
+            {
+                rb->applyForceAtPoint(
+                    -kDeviceForceToSimForce * input.touches[i].force,
+                    input.proxyPosition);
+            }
         }
     }
-    else
+    else if (rb->getId() == input.controlObject)
     {
-        // control object mode, apply spring force and torque to
-        // the object to move it to the haptic device position
-        if (rb->getId() == hapticControlObject)
-        {
-            // linear spring force between haptic device and body
-            hduVector3Dd devicePos;
-            hlGetDoublev(HL_DEVICE_POSITION, devicePos);
-            devicePos += hapticControlObjectOffset;
-            const double ks = 100;
-            const double kd = 5;
-            const double xbase = .2;
-
-            // A realistic system would look at the penetratino
-            // distance or reaction force into the object as a measure
-            // of how much force to apply.  Since we don't do any real collision
-            // detection here, just subtract by some arbitrary amount to
-            // keep smaller objects stable.
-            hduVector3Dd xdiff = devicePos - rb->x;
-            if (xdiff.magnitude() < xbase)
-                xdiff = hduVector3Dd(0,0,0);
-            else
-            {
-                xdiff -= xdiff/xdiff.magnitude()*xbase;
-            }
-
-            hduVector3Dd addForce = ks*xdiff;
-            rb->force += addForce;
-            double xdiffsq = xdiff.dotProduct(xdiff);
-
-            if (xdiffsq > 0.000001)
-            {
-                hduVector3Dd dampForce = 
-                    kd * xdiff.dotProduct(rb->v)/xdiffsq * xdiff;
-                if (dampForce.magnitude() < addForce.magnitude())
-                    rb->force -= dampForce;
-            }
-
-            if (nHapticDeviceDOFInput == 6)
-            {
-
-                // spring torque between device and body
-                // only if we actually get 6DOF input from the device
-                hduQuaternion deviceRot;
-                hlGetDoublev(HL_DEVICE_ROTATION, deviceRot);
-                deviceRot.normalize();
-                rb->q.normalize();
-
-                // find rotation that takes body orientation to device orientation
-                hduQuaternion delta = deviceRot * hapticControlObjectRotOffset 
-                    * rb->q.inverse();
-
-                // convert to torque - quaternion represents rotation
-                // of angle theta about axis w is [cos(theta/2), w*sin(theta/2)]
-                // multiplying 2 * delta.s * delta.v gives: 
-                //      2*cos(theta/2)*sin(theta/2)*w
-                // and using sinA*sinB formula 
-                //      2*cos(theta/2)*sin(theta/2) = sin(theta)
-                // so we end up with 
-                //      2 * delta.s * delta.v = sin(theta)*w
-                // which is desired torque
-                hduVector3Dd torque = ( 2 *delta.s()) * delta.v();
-                double ksang = 3;
-                double kdang = 2;
-                if (nHapticDeviceDOFOutput == 6)
-                {
-                    // for 6DOF want less damping since users resistance
-                    // to torque naturally damps and extra damping adds drag
-                    ksang = 15;
-                    kdang = 0.1;
-                }
-                hduVector3Dd addTorque = ksang*torque;
-                
-                rb->torque += addTorque;
-                double torquesq = torque.dotProduct(torque);
+        // the servo loop steps its copy of the body under everything
+        // but the device between steps
+        mExternalForce = rb->force;
+        mExternalTorque = rb->torque;
+    }
 
-                if (torquesq > 0.000001)
-                {
-                    hduVector3Dd dampForce = torque.dotProduct(rb->omega)/torquesq * torque;
-                    hduVector3Dd dampTorque = kdang * dampForce;
-                    if (dampTorque.magnitude() < addTorque.magnitude())
-                    {
-                        rb->torque -= dampTorque;
-                    }
-                }
-            }
-        }
+    // the coupling impulses, including any sent just before the device
+    // let go of the body
+    if (rb->getId() == mCouplingBody)
+    {
+        rb->force += mCouplingForce;
+        rb->torque += mCouplingTorque;
     }
 }
 
+//
+// Each stage of a step is a loop over bodies, pairs or islands whose items
+// only write what belongs to them, spread over the thread pool.  Whatever
+// is shared, the contacts and the islands, is put together between the
+// loops on this thread in a fixed order, so a step comes out the same
+// however many threads it is spread over.
+//
 bool DynamicsWorld::dxdt(double t, nvectord &x, nvectord &xdot, void *userData)
 {
     DynamicsWorld *pThis = static_cast<DynamicsWorld *>(userData);
     assert(pThis);
-        
-    // Put data in x[] into mBodies
-    pThis->arrayToBodies(x);
+
+    pThis->mStepTime = t;
+    pThis->mStepX = &x;
+    pThis->mStepXdot = &xdot;
+    int numBodies = pThis->mBodyArray.size();
+
+    // Put data in x[] into mBodies; the witnesses are updated as their
+    // pairs are checked
+    pThis->mThreadPool.parallelFor(numBodies, arrayToBodyTask, pThis, kBodyGrain);
         
     bool interPenetration;
     pThis->findAllContacts(interPenetration);
@@ -312,27 +286,34 @@ bool DynamicsWorld::dxdt(double t, nvectord &x, nvectord &xdot, void *userData)
     assert(!interPenetration);
 #endif
 
-    if (pThis->findAllCollisions())
-    {
-        pThis->bodiesToArray(x);
-        //return true;
-    }
+    pThis->findIslands();
 
-    BodyListT::const_iterator ci; // constant because not modifying list
-    int i = 0;
+    // the impulses are written back to x[] with the derivatives
+    pThis->mStepImpulses = pThis->findAllCollisions();
 
-    for (ci = pThis->mBodies.begin(); ci != pThis->mBodies.end(); ++ci)
-    {
-        RigidBody& rb = *((*ci).second);
-        assert(&rb != NULL);
-                
-        pThis->computeForceAndTorque(t, &rb);
-        pThis->ddtStateToArray(&rb, &xdot[i * kStateSize]);
+    pThis->mThreadPool.parallelFor(numBodies, derivativeTask, pThis, kBodyGrain);
+
+    return false;
+}
+
+void DynamicsWorld::derivativeTask(int i, void *userData)
+{
+    DynamicsWorld *pThis = static_cast<DynamicsWorld *>(userData);
+    RigidBody& rb = *pThis->mBodyArray[i];
+    double *xdot = &(*pThis->mStepXdot)[i * kStateSize];
 
-        i++;
+    if (pThis->mAsleep[i])
+    {
+        for (int k = 0; k < kStateSize; k++)
+            xdot[k] = 0;
+        return;
     }
 
-    return false;
+    if (pThis->mStepImpulses)
+        rb.stateToArray(&(*pThis->mStepX)[i * kStateSize]);
+
+    pThis->computeForceAndTorque(pThis->mStepTime, &rb);
+    pThis->ddtStateToArray(&rb, xdot);
 }
 
 void DynamicsWorld::ddtStateToArray(RigidBody *rb, double *xdot)
@@ -360,6 +341,21 @@ void DynamicsWorld::ddtStateToArray(RigidBody *rb, double *xdot)
 
 void DynamicsWorld::advanceSimulation(double tPrev, double tCurr)
 {
+    // pick up the latest haptic device input, if any; otherwise the last
+    // one still applies
+    mHapticInputBuffer.update();
+    const HapticInput& input = mHapticInputBuffer.getReadBuffer();
+
+    hduVector3Dd impulse;
+    hduVector3Dd angularImpulse;
+    mCoupling.fetchImpulse(mCouplingBody, impulse, angularImpulse);
+    mCouplingForce = impulse / (tCurr - tPrev);
+    mCouplingTorque = angularImpulse / (tCurr - tPrev);
+    mExternalForce.set(0, 0, 0);
+    mExternalTorque.set(0, 0, 0);
+
+    wakeDisturbedBodies();
+
     // copy xFinal back to x0
     for(unsigned int i=0; i<kStateSize * mBodies.size(); i++)
         x0[i] = xFinal[i];
@@ -369,10 +365,38 @@ void DynamicsWorld::advanceSimulation(double tPrev, double tCurr)
         
     // copy d/dt X(tNext) into state variables
     arrayToBodies(xFinal);
+
+    updateSleep(tCurr - tPrev);
+
+    publishState();
+
+    if (input.mode == CONTROL_OBJECT)
+    {
+        BodyListT::const_iterator ci = mBodies.find(input.controlObject);
+        if (ci != mBodies.end())
+            mCoupling.publishBody(*(*ci).second, mExternalForce, mExternalTorque);
+    }
 }
 
 void DynamicsWorld::initSimulation(void)
 {
+    // number the bodies in the order of their states
+    BodyListT::const_iterator ci; // constant because not modifying list
+
+    mBodyArray.clear();
+    for (ci = mBodies.begin(); ci != mBodies.end(); ++ci)
+    {
+        RigidBody *rb = (*ci).second;
+        rb->index = mBodyArray.size();
+        mBodyArray.push_back(rb);
+    }
+
+    // everything starts awake
+    mAsleep.assign(mBodies.size(), 0);
+    mSleepTime.assign(mBodies.size(), 0);
+    mIslands.clear();
+    mBodyIsland.assign(mBodies.size(), -1);
+
     int vecSize = kStateSize * mBodies.size();
     x0.resize(vecSize);     
     xFinal.resize(vecSize); 
@@ -385,29 +409,123 @@ void DynamicsWorld::initSimulation(void)
     // arrayToBodies will calculate derived quantities
     arrayToBodies(xFinal);
 
-    // create the list of witnesses using empty witnesses
-    unsigned int bodyPairsCount = mBodies.size() * (mBodies.size() - 1) / 2 ; 
-    while(mWitnesses.size() < bodyPairsCount)
-        mWitnesses.push_back(new Witness());
-    while(mWitnesses.size() > bodyPairsCount)
+    // witnesses are created by findAllContacts as pairs of bodies come
+    // close to each other
+
+    publishState();
+}
+
+void DynamicsWorld::publishState(void)
+{
+    WorldState& state = mStateBuffer.getWriteBuffer();
+
+    state.bodies.resize(mBodies.size());
+    state.numPairs = mPairs.size();
+    state.numContacts = mContacts.size();
+    state.numIslands = mIslands.size();
+    state.numAsleep = 0;
+    for (unsigned int j = 0; j < mAsleep.size(); j++)
+        state.numAsleep += mAsleep[j];
+
+    BodyListT::const_iterator ci; // constant because not modifying list
+    int i = 0;
+
+    for (ci = mBodies.begin(); ci != mBodies.end(); ++ci)
     {
-        delete *mWitnesses.end();
-        mWitnesses.erase(mWitnesses.end());
+        const RigidBody& rb = *((*ci).second);
+        BodyState& bs = state.bodies[i++];
+
+        bs.id = rb.getId();
+        bs.x = rb.x;
+        bs.q = rb.q;
+        bs.R = rb.R;
+    }
+
+    mStateBuffer.publish();
+}
+
+bool DynamicsWorld::fetchState(void)
+{
+    mStateBuffer.update();
+
+    // bodies added since the last initSimulation aren't published yet
+    return mStateBuffer.getReadBuffer().bodies.size() == mBodies.size();
+}
+
+//
+// Called once a frame on the client thread, after hlCheckEvents so that
+// button presses are already reflected in the haptic mode.
+//
+void DynamicsWorld::updateHapticInput(void)
+{
+    HapticInput& input = mHapticInputBuffer.getWriteBuffer();
+
+    input.mode = hapticMode;
+    input.controlObject = hapticControlObject;
+
+    hlGetDoublev(HL_PROXY_POSITION, input.proxyPosition);
+
+    input.touches.clear();
+    if (hapticMode == TOUCH_OBJECTS)
+    {
+        BodyListT::const_iterator ci; // constant because not modifying list
+
+        for (ci = mBodies.begin(); ci != mBodies.end(); ++ci)
+        {
+            HLuint id = (*ci).first;
+            HLboolean isTouching;
+            hlGetShapeBooleanv(id, HL_PROXY_IS_TOUCHING, &isTouching);
+            if (isTouching)
+            {
+                HapticTouch touch;
+                touch.id = id;
+                hlGetShapeDoublev(id, HL_REACTION_FORCE, touch.force);
+                input.touches.push_back(touch);
+            }
+        }
+    }
+
+    mHapticInputBuffer.publish();
+
+    // couple the device to the controlled body, or let go of it
+    if (hapticMode == CONTROL_OBJECT)
+    {
+        if (!mCoupling.isActive())
+        {
+            mCoupling.start(hapticControlObject, hapticControlObjectOffset,
+                            hapticControlObjectRotOffset,
+                            nHapticDeviceDOFInput == 6,
+                            kDeviceForceToSimForce);
+        }
+        else
+        {
+            mCoupling.update();
+        }
+    }
+    else
+    {
+        mCoupling.stop();
     }
 }
 
 void DynamicsWorld::drawWorld()
 {
+    const WorldState& state = mStateBuffer.getReadBuffer();
     BodyListT::const_iterator ci; // constant because not modifying list
+    int i = 0;
 
     for (ci = mBodies.begin(); ci != mBodies.end(); ++ci)
     {
         RigidBody& rb = *((*ci).second);
         assert(&rb != NULL);
-                
-        rb.draw();
+
+        const BodyState& bs = state.bodies[i++];
+        rb.draw(bs.x, bs.R);
     }
-        
+}
+
+void DynamicsWorld::drawDebug()
+{
     if (mouseSpringBody)
     {
         glColor3f(0.5f, 0.5f, 0.7f);
@@ -422,12 +540,12 @@ void DynamicsWorld::drawWorld()
     if (!mDrawWitnesses)
         return;
 
-    WitnessListT::const_iterator ciW; // constant because not modifying list
+    WitnessMapT::const_iterator ciW; // constant because not modifying list
         
     glDisable(GL_LIGHTING);
     for (ciW = mWitnesses.begin(); ciW != mWitnesses.end(); ++ciW)
     {
-        Witness& witness = **ciW;
+        Witness& witness = *(*ciW).second;
         assert(&witness != NULL);
                 
         witness.draw();
@@ -439,14 +557,17 @@ void DynamicsWorld::drawWorld()
 
 void DynamicsWorld::drawWorldHaptics()
 {
+    const WorldState& state = mStateBuffer.getReadBuffer();
     BodyListT::const_iterator ci; // constant because not modifying list
+    int i = 0;
 
     for (ci = mBodies.begin(); ci != mBodies.end(); ++ci)
     {
         RigidBody& rb = *((*ci).second);
         assert(&rb != NULL);
                 
-        rb.drawHaptics();
+        const BodyState& bs = state.bodies[i++];
+        rb.drawHaptics(bs.x, bs.R);
     }
 }
 
@@ -454,12 +575,14 @@ void DynamicsWorld::addWall(hduVector3Dd v0, hduVector3Dd v1, hduVector3Dd v2, h
 {
     RigidBody *rb = new RigidBodyWall(v0, v1, v2, v3, name);
     mBodies.insert(BodyListT::value_type(rb->getId(), rb));
+    mBroadPhase.addBody(rb);
 }
 
 void DynamicsWorld::addBox(hduVector3Dd pos, hduQuaternion angle, hduVector3Dd size, hduVector3Dd vel, hduVector3Dd angularVel, const char *name)
 {
     RigidBody *rb = new RigidBodyBox(pos, angle, size, vel, angularVel, name);
     mBodies.insert(BodyListT::value_type(rb->getId(), rb));
+    mBroadPhase.addBody(rb);
 
     // add a callback to handle button down while touching this shape
     hlAddEventCallback(HL_EVENT_1BUTTONDOWN, rb->getId(), HL_COLLISION_THREAD, 
@@ -468,134 +591,539 @@ void DynamicsWorld::addBox(hduVector3Dd pos, hduQuaternion angle, hduVector3Dd s
                        OnHapticDeviceButtonDown, this);
 }
 
+//
+// Remove a body and the witnesses and contacts that refer to it.
+// As after adding bodies, call initSimulation before advancing the
+// simulation again.
+//
+void DynamicsWorld::removeBody(HLuint id)
+{
+    BodyListT::iterator i = mBodies.find(id);
+    if (i == mBodies.end())
+        return;
+
+    RigidBody *rb = (*i).second;
+    assert(rb != NULL);
+
+    if (dynamic_cast<RigidBodyBox *>(rb) != NULL)
+    {
+        hlRemoveEventCallback(HL_EVENT_1BUTTONDOWN, id, HL_COLLISION_THREAD, 
+                              OnHapticDeviceButtonDown);
+        hlRemoveEventCallback(HL_EVENT_1BUTTONDOWN, id, HL_CLIENT_THREAD, 
+                              OnHapticDeviceButtonDown);
+    }
+
+    if (rb == mouseSpringBody)
+        mouseSpringBody = NULL;
+
+    if (hapticControlObject == id)
+    {
+        hapticMode = TOUCH_OBJECTS;
+        hapticControlObject = HL_OBJECT_ANY;
+        hlEnable(HL_PROXY_RESOLUTION);
+    }
+
+    deleteContacts();
+    deleteWitnesses(rb);
+    mBroadPhase.removeBody(rb);
+    mPairs.clear();
+
+    mBodies.erase(i);
+    delete rb;
+}
+
+//
+// Solve the contacts for impulses that stop the bodies approaching at any of
+// them, by projected Gauss-Seidel: each sweep corrects the impulse of one
+// contact at a time given the others, and keeps it pushing.  Resting
+// contacts are solved together with colliding ones, so a stack of bodies
+// holds up under gravity.  Each contact starts from its impulse of the last
+// step, which for a resting stack is close to the answer, and the number of
+// sweeps is capped, so a step takes time in proportion to the number of
+// contacts however the stack is built.
+//
+// Contacts of different islands share no moving body, so the islands are
+// solved each on its own, in parallel, and the islands asleep not at all.
+//
 // returns true if a discontinuity occured
 bool DynamicsWorld::findAllCollisions(void)
 {
-    bool hadCollisionInLoop;
-    bool hadDiscontinuity = false;
-    ECollidingState collidingState;
-        
-    do {
-        hadCollisionInLoop = false;
-                
-        ContactListT::const_iterator ci; // constant because not modifying list
+    if (mContacts.empty())
+        return false;
+
+    matchContacts();
+
+    mThreadPool.parallelFor(mIslands.size(), solveIslandTask, this);
+
+    // Tell the solver if any impulse changed the velocities
+    IslandListT::const_iterator ci;
+
+    for (ci = mIslands.begin(); ci != mIslands.end(); ++ci)
+    {
+        if ((*ci).awake && (*ci).hadImpulse)
+            return true;
+    }
+
+    return false;
+}
+
+void DynamicsWorld::solveIslandTask(int i, void *userData)
+{
+    DynamicsWorld *pThis = static_cast<DynamicsWorld *>(userData);
+    Island& island = pThis->mIslands[i];
+
+    island.hadImpulse = false;
+    if (!island.awake || island.numContacts == 0)
+        return;
+
+    ContactListT& contacts = pThis->mContacts;
+    const int *first = &pThis->mIslandContacts[island.firstContact];
+    const int *last = first + island.numContacts;
+    const int *ci;
+
+    for (ci = first; ci != last; ++ci)
+    {
+        contacts[*ci].prepare(kCoefficientOfRestitutionDef, kRestingVelocity,
+                              kContactThreshold, kPenetrationRecovery);
+    }
 
-        for (ci = mContacts.begin(); ci != mContacts.end(); ++ci)
+    for (ci = first; ci != last; ++ci)
+    {
+        if (contacts[*ci].jn > 0)
+            contacts[*ci].warmStart();
+    }
+
+    for (int iteration = 0; iteration < pThis->mSolverIterations; iteration++)
+    {
+        double maxChange = 0;
+
+        for (ci = first; ci != last; ++ci)
         {
-            Contact& c = **ci;
-            assert(&c != NULL);
-                        
-            collidingState = c.colliding();
-            if (collidingState == collidingState_Colliding)
-            {
-                c.doCollision(kCoefficientOfRestitutionDef);
-                hadCollisionInLoop = true;
+            double change = fabs(contacts[*ci].solve());
+            if (change > maxChange)
+                maxChange = change;
+        }
 
-                                // Tell the solver we had a collision
-                hadDiscontinuity = true;
-            }
-            else if (collidingState == collidingState_RestingContact)
-            {
-                // FIXME: deal with resting contact intelligently
-                //c.doCollision(kCoefficientOfRestitutionDef);
+        if (maxChange < kSolverTolerance)
+            break;
+    }
 
-                // Tell the solver we had a collision
-                //hadDiscontinuity = true;
-            }
+    for (ci = first; ci != last; ++ci)
+    {
+        if (contacts[*ci].jn > 0)
+        {
+            island.hadImpulse = true;
+            break;
+        }
+    }
+}
+
+//
+// Carry the impulse of each contact over from the contact between the same
+// pair of bodies in the last step; the islands apply it as they are solved.
+// Both arrays are in the order of the pairs, with at most one contact per
+// pair, so they are matched by walking them together.
+//
+void DynamicsWorld::matchContacts(void)
+{
+    ContactListT::iterator ci;
+    ContactListT::const_iterator ciPrev = mPrevContacts.begin();
+
+    for (ci = mContacts.begin(); ci != mContacts.end(); ++ci)
+    {
+        Contact& c = *ci;
+        BodyIdPairT key = getContactKey(c);
+
+        while (ciPrev != mPrevContacts.end() && getContactKey(*ciPrev) < key)
+            ++ciPrev;
+
+        c.jn = 0;
+        if (ciPrev != mPrevContacts.end() && getContactKey(*ciPrev) == key &&
+            (*ciPrev).a == c.a &&
+            (*ciPrev).n.dotProduct(c.n) > kWarmStartNormalCos)
+        {
+            c.jn = (*ciPrev).jn;
         }
-    } while (hadCollisionInLoop == true);
+    }
+}
 
-    return hadDiscontinuity;
+BodyIdPairT DynamicsWorld::getContactKey(const Contact& c)
+{
+    HLuint idA = c.a->getId();
+    HLuint idB = c.b->getId();
+    return idA < idB ? BodyIdPairT(idA, idB) : BodyIdPairT(idB, idA);
 }
 
 //
-// For each body-body pair A-B, try to find a separating plane
-// If no such plane is found, conact or penetration has occured
+// For each body-body pair A-B whose bounding boxes overlap, try to find a
+// separating plane.  If no such plane is found, conact or penetration has
+// occured
+//
+// The witnesses are looked up here, and the pairs checked in parallel, each
+// into a slot of its own.  Contacts are then gathered in the order of the
+// pairs.
 //
 void DynamicsWorld::findAllContacts(bool &interPenetration)
 {
-    ESeparationState separationState;
+    // keep the contacts of the last solve for warm starting, and reuse the
+    // storage of the ones before
+    mPrevContacts.swap(mContacts);
+    mContacts.clear();
 
-    // clear the list of contacts
-    deleteContacts();
+    mBroadPhase.findPairs(mPairs);
+
+    int numPairs = mPairs.size();
+    mPairWitnesses.resize(numPairs);
+    mPairStates.resize(numPairs);
+    mPairContacts.resize(numPairs);
 
-    BodyListT::const_iterator ciA; // constant because not modifying list
-    BodyListT::const_iterator ciB; // constant because not modifying list
-    WitnessListT::const_iterator ciW; // constant because not modifying list
+    // Both mPairs and mWitnesses are ordered by body ids, so the witness
+    // for each pair is found by walking the two together.  Witnesses of
+    // pairs that have moved apart are dropped along the way.
+    WitnessMapT::iterator iW = mWitnesses.begin();
+    ContactListT::const_iterator ciPrev = mPrevContacts.begin();
+
+    for (int k = 0; k < numPairs; k++)
+    {
+        RigidBody& rbA = *mPairs[k].rbA;
+        assert(&rbA != NULL);
+                        
+        RigidBody& rbB = *mPairs[k].rbB;
+        assert(&rbB != NULL);
+                        
+        assert(&rbA != &rbB);
+        assert(rbA.massInv != 0 || rbB.massInv != 0);
+
+        BodyIdPairT key(rbA.getId(), rbB.getId());
+        while (iW != mWitnesses.end() && (*iW).first < key)
+        {
+            delete (*iW).second;
+            mWitnesses.erase(iW++);
+        }
+        if (iW == mWitnesses.end() || key < (*iW).first)
+        {
+            iW = mWitnesses.insert(iW, WitnessMapT::value_type(key, new Witness()));
+        }
+
+        mPairWitnesses[k] = (*iW).second;
+        assert(mPairWitnesses[k] != NULL);
+        ++iW;
+
+        // Bodies asleep haven't moved, so neither has a contact between
+        // them or with a fixed body; keep it from the last step
+        mPairStates[k] = separationState_Unknown;
+        if (!isAwake(&rbA) && !isAwake(&rbB))
+        {
+            while (ciPrev != mPrevContacts.end() && getContactKey(*ciPrev) < key)
+                ++ciPrev;
+
+            if (ciPrev != mPrevContacts.end() && getContactKey(*ciPrev) == key)
+                mPairContacts[k] = *ciPrev;
+            else
+                mPairContacts[k] = Contact();
+            mPairStates[k] = -1;
+        }
+    }
+
+    // drop the witnesses of the remaining pairs that have moved apart
+    while (iW != mWitnesses.end())
+    {
+        delete (*iW).second;
+        mWitnesses.erase(iW++);
+    }
+
+    mThreadPool.parallelFor(numPairs, narrowPhaseTask, this, kPairGrain);
+
+    interPenetration = false;
+
+    for (int k = 0; k < numPairs; k++)
+    {
+        if (mPairContacts[k].a != NULL)
+            mContacts.push_back(mPairContacts[k]);
+
+        if (mPairStates[k] == separationState_Penetration)
+            interPenetration = true;
+    }
+}
+
+void DynamicsWorld::narrowPhaseTask(int i, void *userData)
+{
+    DynamicsWorld *pThis = static_cast<DynamicsWorld *>(userData);
+
+    if (pThis->mPairStates[i] < 0)
+        return;
+
+    RigidBody& rbA = *pThis->mPairs[i].rbA;
+    RigidBody& rbB = *pThis->mPairs[i].rbB;
+    Witness& witness = *pThis->mPairWitnesses[i];
+    Contact& contact = pThis->mPairContacts[i];
+
+    contact = Contact();
+    witness.updateFromBodies();
 
     // FIXME: we should keep old witnesses around incase a penetration occurs
     // and then only save the new witnesses to the old witness cache if we
     // have no penetrations (only contacts and separations)
-    Witness newWitness;
 
-    interPenetration = false;
+    // use a copy of the witness
+    Witness newWitness = witness;
 
-    ciW = mWitnesses.begin();
-
-    for (ciA = mBodies.begin(); ciA != mBodies.end(); ++ciA)
-    {       
-        // start ciB on the body after ciA
-        ciB = ciA;
-        for (++ciB; ciB != mBodies.end(); ++ciB)
-        {
-            RigidBody& rbA = *((*ciA).second);
-            assert(&rbA != NULL);
-                        
-            RigidBody& rbB = *((*ciB).second);
-            assert(&rbB != NULL);
-                        
-            assert(&rbA != &rbB);
-                        
-            if (rbA.massInv != 0 || rbB.massInv != 0)
-            {
-                Witness& witness = **ciW;
-                assert(&witness != NULL);
-                                
-                // use a copy of the witness
-                newWitness = witness;
-
-                // This will find a separating plane if one exists.
-                separationState = findSeparatingPlane(rbA, rbB, newWitness);
-                switch (separationState)
-                {
-                    case separationState_Separation:
-                        // If we have separation, no action is neccessary
-                        break;
-
-                    case separationState_Contact:
-                        // We have contact between rbA and rbB
-                        newWitness.createContacts(mContacts);
-                        break;
-
-                    case separationState_Penetration:
-                        // TODO: implement accurate contact finding
-                        // If penetration occurs, we need to stop checking for
-                        // penetrations, and try to back up in time to find when
-                        // the contact originally occured
-
-                        // For now, we will simply treat penetrations as contacts
+    // This will find a separating plane if one exists.
+    ESeparationState separationState = pThis->findSeparatingPlane(rbA, rbB, newWitness);
+    switch (separationState)
+    {
+        case separationState_Separation:
+            // If we have separation, no action is neccessary
+            break;
+
+        case separationState_Contact:
+            // We have contact between rbA and rbB
+            newWitness.createContact(contact);
+            break;
+
+        case separationState_Penetration:
+            // TODO: implement accurate contact finding
+            // If penetration occurs, we need to stop checking for
+            // penetrations, and try to back up in time to find when
+            // the contact originally occured
+
+            // For now, we will simply treat penetrations as contacts
 #ifdef AVOID_PENETRATION
-                        assert(false);
+            assert(false);
 #else
-                        newWitness.createContacts(mContacts);
+            newWitness.createContact(contact);
 #endif
-                        interPenetration = true;
-                        break;
+            break;
 
-                    default:
-                        assert(false);
-                }
-                                
-                // copy the new witness back to the cache
-                witness = newWitness;
-            }
+        default:
+            assert(false);
+    }
+
+    pThis->mPairStates[i] = separationState;
+
+    // copy the new witness back to the cache
+    witness = newWitness;
+}
+
+//
+// Put the moving bodies that touch each other into islands, by union-find
+// over the contacts, and wake the islands with any body awake.  Each island
+// is numbered, and its bodies and contacts listed, in order of the bodies
+// and of the contacts, so that islands are the same from step to step
+// however the pairs were checked.
+//
+void DynamicsWorld::findIslands(void)
+{
+    int numBodies = mBodyArray.size();
+    int i;
 
-            // Go to the witness for the next body-body pair
-            ciW++;
+    mIslandParent.resize(numBodies);
+    for (i = 0; i < numBodies; i++)
+        mIslandParent[i] = i;
+
+    ContactListT::const_iterator ci;
+
+    for (ci = mContacts.begin(); ci != mContacts.end(); ++ci)
+    {
+        if ((*ci).a->massInv == 0 || (*ci).b->massInv == 0)
+            continue;
+
+        // the root of each island is its lowest body
+        int rootA = findIslandRoot((*ci).a->index);
+        int rootB = findIslandRoot((*ci).b->index);
+        if (rootA < rootB)
+            mIslandParent[rootB] = rootA;
+        else if (rootB < rootA)
+            mIslandParent[rootA] = rootB;
+    }
+
+    mIslands.clear();
+    mBodyIsland.assign(numBodies, -1);
+
+    for (i = 0; i < numBodies; i++)
+    {
+        if (mBodyArray[i]->massInv == 0)
+            continue;
+
+        int root = findIslandRoot(i);
+        if (root == i)
+        {
+            Island island = { 0, 0, 0, 0, false, false };
+            mBodyIsland[i] = mIslands.size();
+            mIslands.push_back(island);
+        }
+        else
+        {
+            mBodyIsland[i] = mBodyIsland[root];
+        }
+
+        Island& island = mIslands[mBodyIsland[i]];
+        island.numBodies++;
+        if (!mAsleep[i])
+            island.awake = true;
+    }
+
+    // a contact belongs to the island of its moving body, or bodies
+    for (ci = mContacts.begin(); ci != mContacts.end(); ++ci)
+    {
+        const RigidBody *rb = (*ci).a->massInv != 0 ? (*ci).a : (*ci).b;
+        mIslands[mBodyIsland[rb->index]].numContacts++;
+    }
+
+    int firstBody = 0;
+    int firstContact = 0;
+    IslandListT::iterator iI;
+
+    for (iI = mIslands.begin(); iI != mIslands.end(); ++iI)
+    {
+        Island& island = *iI;
+        island.firstBody = firstBody;
+        island.firstContact = firstContact;
+        firstBody += island.numBodies;
+        firstContact += island.numContacts;
+        island.numBodies = 0;
+        island.numContacts = 0;
+    }
+
+    mIslandBodies.resize(firstBody);
+    mIslandContacts.resize(firstContact);
+
+    for (i = 0; i < numBodies; i++)
+    {
+        if (mBodyIsland[i] < 0)
+            continue;
+
+        Island& island = mIslands[mBodyIsland[i]];
+        mIslandBodies[island.firstBody + island.numBodies++] = i;
+
+        if (island.awake)
+            wakeBody(i);
+    }
+
+    for (i = 0; i < (int) mContacts.size(); i++)
+    {
+        const Contact& c = mContacts[i];
+        const RigidBody *rb = c.a->massInv != 0 ? c.a : c.b;
+        Island& island = mIslands[mBodyIsland[rb->index]];
+        mIslandContacts[island.firstContact + island.numContacts++] = i;
+    }
+}
+
+int DynamicsWorld::findIslandRoot(int i)
+{
+    while (mIslandParent[i] != i)
+    {
+        mIslandParent[i] = mIslandParent[mIslandParent[i]];
+        i = mIslandParent[i];
+    }
+    return i;
+}
+
+void DynamicsWorld::wakeBody(int index)
+{
+    if (mAsleep[index])
+    {
+        mAsleep[index] = 0;
+        mSleepTime[index] = 0;
+    }
+}
+
+//
+// Bodies pushed by the mouse or the haptic device are kept awake, and their
+// islands with them.
+//
+void DynamicsWorld::wakeDisturbedBodies(void)
+{
+    const HapticInput& input = mHapticInputBuffer.getReadBuffer();
+
+    if (mouseSpringBody)
+        disturbBody(mouseSpringBody->getId());
+
+    disturbBody(mCouplingBody);
+
+    if (input.mode == CONTROL_OBJECT)
+        disturbBody(input.controlObject);
+
+    for (unsigned int i = 0; i < input.touches.size(); i++)
+        disturbBody(input.touches[i].id);
+}
+
+void DynamicsWorld::disturbBody(HLuint id)
+{
+    BodyListT::const_iterator ci = mBodies.find(id);
+    if (ci == mBodies.end() || (*ci).second->index < 0)
+        return;
+
+    int index = (*ci).second->index;
+    mAsleep[index] = 0;
+    mSleepTime[index] = 0;
+}
+
+//
+// Put to sleep the islands whose bodies have all been nearly still for a
+// while, stopping them dead.  Called after a step, with the islands it found.
+//
+void DynamicsWorld::updateSleep(double dt)
+{
+    if (!mSleepEnabled)
+        return;
+
+    IslandListT::const_iterator ci;
+
+    for (ci = mIslands.begin(); ci != mIslands.end(); ++ci)
+    {
+        const Island& island = *ci;
+        if (!island.awake)
+            continue;
+
+        const int *first = &mIslandBodies[island.firstBody];
+        const int *last = first + island.numBodies;
+        const int *bi;
+        bool still = true;
+
+        for (bi = first; bi != last; ++bi)
+        {
+            const RigidBody& rb = *mBodyArray[*bi];
+
+            if (rb.v.magnitude() < kSleepVelocity &&
+                rb.omega.magnitude() < kSleepAngularVelocity)
+                mSleepTime[*bi] += dt;
+            else
+                mSleepTime[*bi] = 0;
+
+            if (mSleepTime[*bi] < kTimeToSleep)
+                still = false;
+        }
+
+        if (!still)
+            continue;
+
+        for (bi = first; bi != last; ++bi)
+        {
+            RigidBody& rb = *mBodyArray[*bi];
+
+            rb.P.set(0, 0, 0);
+            rb.L.set(0, 0, 0);
+            rb.v.set(0, 0, 0);
+            rb.omega.set(0, 0, 0);
+            rb.stateToArray(&xFinal[*bi * kStateSize]);
+
+            mAsleep[*bi] = 1;
         }
     }
 }
 
+void DynamicsWorld::setSleepEnabled(bool s)
+{
+    mSleepEnabled = s;
+
+    if (!mSleepEnabled)
+    {
+        mAsleep.assign(mAsleep.size(), 0);
+        mSleepTime.assign(mSleepTime.size(), 0);
+    }
+}
+
 void DynamicsWorld::deleteBodies(void)
 {
     BodyListT::const_iterator ci;
@@ -608,15 +1136,17 @@ void DynamicsWorld::deleteBodies(void)
     }
 
     mBodies.clear();
+    mBroadPhase.clear();
+    mPairs.clear();
 }
 
 void DynamicsWorld::deleteWitnesses(void)
 {
-    WitnessListT::const_iterator ci;
+    WitnessMapT::const_iterator ci;
         
     for (ci = mWitnesses.begin(); ci != mWitnesses.end(); ++ci)
     {
-        Witness *o = *ci;
+        Witness *o = (*ci).second;
         assert(o != NULL);
         delete o;
     }
@@ -624,18 +1154,29 @@ void DynamicsWorld::deleteWitnesses(void)
     mWitnesses.clear();
 }
 
-void DynamicsWorld::deleteContacts(void)
+// delete the witnesses of all pairs that include rb
+void DynamicsWorld::deleteWitnesses(RigidBody *rb)
 {
-    ContactListT::const_iterator ci;
+    WitnessMapT::iterator i = mWitnesses.begin();
         
-    for (ci = mContacts.begin(); ci != mContacts.end(); ++ci)
+    while (i != mWitnesses.end())
     {
-        Contact *o = *ci;
-        assert(o != NULL);
-        delete o;
+        if ((*i).first.first == rb->getId() || (*i).first.second == rb->getId())
+        {
+            delete (*i).second;
+            mWitnesses.erase(i++);
+        }
+        else
+        {
+            ++i;
+        }
     }
+}
 
+void DynamicsWorld::deleteContacts(void)
+{
     mContacts.clear();
+    mPrevContacts.clear();
 }
 
 //
@@ -725,13 +1266,40 @@ ESeparationState DynamicsWorld::findWitnessFromPrimaryFace(RigidBody &rbPri, Rig
     return witness.getState();
 }
 
+//
+// Return true if the arcs a-b and c-d on the Gauss map cross, given their
+// planes b x a and d x c.  The arc of an edge runs between the normals of
+// the two faces it joins; the edge is the part of the body furthest along
+// any direction on its arc.
+//
+static bool arcsCross(const hduVector3Dd &a, const hduVector3Dd &b, const hduVector3Dd &bxa,
+                      const hduVector3Dd &c, const hduVector3Dd &d, const hduVector3Dd &dxc)
+{
+    double cba = c.dotProduct(bxa);
+    double dba = d.dotProduct(bxa);
+    double adc = a.dotProduct(dxc);
+    double bdc = b.dotProduct(dxc);
+
+    // c and d on opposite sides of the plane of a-b, a and b on opposite
+    // sides of the plane of c-d, and the arcs on the same hemisphere
+    return cba * dba < 0 && adc * bdc < 0 && cba * bdc > 0;
+}
+
+//
+// A plane through an edge of rbPri and parallel to an edge of rbSec can
+// only be the best separating plane if the edges are the parts of the
+// bodies furthest toward each other along its normal, that is if the arc
+// of the edge of rbPri crosses the arc of the edge of rbSec turned around.
+// Checking that on the Gauss map first leaves only a few pairs of edges of
+// two boxes, instead of every pair, to make a plane for and measure.
+//
 ESeparationState DynamicsWorld::findWitnessFromPrimaryEdge(RigidBody &rbPri, RigidBody &rbSec, Witness &witness, double contactThreshold)
 {
     if (rbPri.noEdgeCollisions() || rbSec.noEdgeCollisions())
         return witness.getState();
 
     EdgeListT *edgesPri = rbPri.getEdges();
-    EdgeListT *edgesSec = rbSec.getNonParallelEdges();
+    EdgeListT *edgesSec = rbSec.getEdges();
     EdgeListT::const_iterator epi; // constant because not modifying list
     EdgeListT::const_iterator esi;
         
@@ -740,52 +1308,77 @@ ESeparationState DynamicsWorld::findWitnessFromPrimaryEdge(RigidBody &rbPri, Rig
     double distPri;
     double distSec;
 
+    hduVector3Dd a, b, bxa;
+    hduVector3Dd c, d, dxc;
+    bool arcPri;
+    bool arcsChecked;
+
     for (epi = edgesPri->begin(); epi != edgesPri->end(); ++epi)
     {
         DynEdge* edgePri = *epi;
         assert(edgePri != NULL);
+
+        arcPri = edgePri->getFaceNormals(a, b);
+        if (arcPri)
+            bxa = b.crossProduct(a);
                 
-        // FIXME: we don't need to re-check an edge from rbSec that is
-        //  parallel to an edge we have already checked
         for (esi = edgesSec->begin(); esi != edgesSec->end(); ++esi)
         {
             DynEdge* edgeSec = *esi;
             assert(edgeSec != NULL);
 
+            // edges without both faces can't be ruled out
+            arcsChecked = arcPri && edgeSec->getFaceNormals(c, d);
+            if (arcsChecked)
+            {
+                c = -c;
+                d = -d;
+                dxc = d.crossProduct(c);
+                if (!arcsCross(a, b, bxa, c, d, dxc))
+                    continue;
+            }
+
             // make a plane that contains edgePri and is parallel to edgeSec
             plane.setEdges(edgePri, edgeSec);
             validPlane = (plane.getNormal() != NULL);
             if (validPlane)
             {
-                // flip the plane's normal if it is pointing towared rbPri
-                hduVector3Dd *otherVertexPri = edgePri->getNonColinearVertex();
-                distPri = rbPri.distPlanePoint(&plane, otherVertexPri);
-                if (distPri > -0.0001)
+                if (arcsChecked)
+                {
+                    // the normal is where the arcs cross, between the
+                    // normals of the faces of rbPri
+                    if (plane.getNormal()->dotProduct(a + b) < 0)
+                        plane.reverse();
+                }
+                else
+                {
+                    // flip the plane's normal if it is pointing towared rbPri
+                    hduVector3Dd *otherVertexPri = edgePri->getNonColinearVertex();
+                    distPri = rbPri.distPlanePoint(&plane, otherVertexPri);
+                    if (distPri > -0.0001)
+                        plane.reverse();
+
+                    // make sure the plane doesn't intersect ourselves, which
+                    // the arcs crossing rules out
+                    plane.reverse();  // flip it over to check ourselves
+                    distPri = rbPri.distPlanePoly(&plane, &rbPri);
                     plane.reverse();
 
-                // make sure the plane doesn't intersect ourselves
+                    if (distPri <= -0.0001) // FIXME: optimal error coefficient?
+                        continue;
+                }
 
-                // FIXME: we only need to check one vertex from each of the
-                // two faces adjacent to edgePri, not all the vertices in rbPri
-                                
-                plane.reverse();  // flip it over to check ourselves
-                distPri = rbPri.distPlanePoly(&plane, &rbPri);
-                plane.reverse();
+                distSec = rbPri.distPlanePoly(&plane, &rbSec);
 
-                if (distPri > -0.0001) // FIXME: optimal error coefficient?
+                if (distSec > contactThreshold)
+                {
+                    // we have found a new witness for these bodies
+                    witness.establish(&rbPri, &rbSec, plane, distSec, contactThreshold);
+                    return separationState_Separation;
+                }
+                else if (witness.isBetterSeparation(distSec)) 
                 {
-                    distSec = rbPri.distPlanePoly(&plane, &rbSec);
-
-                    if (distSec > contactThreshold)
-                    {
-                        // we have found a new witness for these bodies
-                        witness.establish(&rbPri, &rbSec, plane, distSec, contactThreshold);
-                        return separationState_Separation;
-                    }
-                    else if (witness.isBetterSeparation(distSec)) 
-                    {
-                        witness.improveSeparation(&rbPri, &rbSec, plane, distSec, contactThreshold);
-                    }
+                    witness.improveSeparation(&rbPri, &rbSec, plane, distSec, contactThreshold);
                 }
             }
         }
@@ -807,8 +1400,7 @@ void DynamicsWorld::activateMouseSpring(int x, int y)
         
     contactFinder.setName("mouse");
 
-    // the RigidBody constructor will delete the vertex
-    contactFinder.addVertex(new hduVector3Dd(mousePos));
+    contactFinder.addVertex(mousePos);
 
     ESeparationState separationState;
     BodyListT::const_iterator ci; // constant because not modifying list
@@ -832,12 +1424,8 @@ void DynamicsWorld::activateMouseSpring(int x, int y)
     if (fabs(witness.getDistance()) >= kMouseContactThreshold)
         return;
         
-    // ContactListT mouseContacts;
-    // witness.createContacts(mouseContacts);
-        
-    // assert(mouseContacts.size() == 1);
-
-    // Contact &contact = **mouseContacts.begin();
+    // Contact contact;
+    // witness.createContact(contact);
         
     // FIXME: use the point we clicked on, p, not the center of the body;
     // mouseSpringBody = contact.a;
@@ -865,22 +1453,30 @@ void DynamicsWorld::deactivateMouseSpring(void)
     }
 }
 
-// get current position of body in simulation
+const BodyState& DynamicsWorld::getBodyState(HLuint id) const
+{
+    const WorldState& state = mStateBuffer.getReadBuffer();
+    unsigned int i;
+
+    for (i = 0; i < state.bodies.size(); i++)
+    {
+        if (state.bodies[i].id == id)
+            break;
+    }
+    assert(i != state.bodies.size());
+    return state.bodies[i];
+}
+
+// get position of body as of the last fetched state
 const hduVector3Dd& DynamicsWorld::getBodyPosition(HLuint id) const
 {
-    BodyListT::const_iterator i = mBodies.find(id);
-    assert(i != mBodies.end());
-    const RigidBody& rb = *((*i).second);
-    return rb.x;
+    return getBodyState(id).x;
 }
 
-// get current orientation of body in simulation
+// get orientation of body as of the last fetched state
 const hduQuaternion& DynamicsWorld::getBodyOrientation(HLuint id) const
 {
-    BodyListT::const_iterator i = mBodies.find(id);
-    assert(i != mBodies.end());
-    const RigidBody& rb = *((*i).second);
-    return rb.q;
+    return getBodyState(id).q;
 }
 
 
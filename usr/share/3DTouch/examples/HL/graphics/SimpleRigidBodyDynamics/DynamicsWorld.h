@@ -27,14 +27,81 @@ Description:
 
 #include <list>
 #include <map>
+#include <HDU/hduTripleBuffer.h>
 #include "RigidBody.h"
 #include "Contact.h"
 #include "Witness.h"
 #include "OdeSolver.h"
 #include "ContactList.h"
+#include "BroadPhase.h"
+#include "VirtualCoupling.h"
+#include "ThreadPool.h"
 
 typedef std::map<HLuint, RigidBody*> BodyListT;
-typedef std::list<Witness*> WitnessListT;
+
+// Reaction force of the haptic device on a body it touches.
+struct HapticTouch
+{
+    HLuint id;
+    hduVector3Dd force;
+};
+
+typedef std::vector<HapticTouch> HapticTouchListT;
+
+// Haptic device input for the simulation, sampled once a frame on the
+// client thread since HL may only be queried there.
+struct HapticInput
+{
+    HapticInput() : mode(0), controlObject(HL_OBJECT_ANY) {}
+
+    int mode;   // DynamicsWorld::HapticMode
+    HLuint controlObject;
+
+    hduVector3Dd proxyPosition;
+    HapticTouchListT touches;
+};
+
+// Transform of a body as of the last step.
+struct BodyState
+{
+    HLuint id;
+    hduVector3Dd x;
+    hduQuaternion q;
+    hduMatrix R;
+};
+
+// What the simulation publishes for drawing after every step.  The bodies
+// are in the same order as in the body list.
+struct WorldState
+{
+    WorldState() : numPairs(0), numContacts(0), numIslands(0), numAsleep(0) {}
+
+    std::vector<BodyState> bodies;
+    int numPairs;
+    int numContacts;
+    int numIslands;
+    int numAsleep;      // bodies
+};
+
+// Witnesses are keyed by the ids of the pair of bodies, lower id first.
+typedef std::pair<HLuint, HLuint> BodyIdPairT;
+typedef std::map<BodyIdPairT, Witness*> WitnessMapT;
+
+// A set of moving bodies that touch each other, directly or through others
+// of the set.  Fixed bodies belong to no island, so bodies resting on the
+// same wall can be in different ones.  Its bodies and contacts are
+// mIslandBodies and mIslandContacts from first to first + num.
+struct Island
+{
+    int firstBody;
+    int numBodies;
+    int firstContact;
+    int numContacts;
+    bool awake;
+    bool hadImpulse;    // the solver pushed at one of its contacts
+};
+
+typedef std::vector<Island> IslandListT;
 
 class DynamicsWorld  
 {
@@ -42,8 +109,20 @@ public:
 	DynamicsWorld();
 	virtual ~DynamicsWorld();
 
+	// advanceSimulation may run on a thread of its own; everything else is
+	// called from the client thread, and anything that changes the bodies
+	// only while the simulation is held off.
 	void advanceSimulation(double tPrev, double tCurr);
 	void initSimulation(void);
+
+	// Samples the haptic device for the next steps, and couples it to the
+	// controlled body.  Call between hlBeginFrame and hlEndFrame.
+	void updateHapticInput(void);
+
+	// Picks up the state published by the last step.  Returns false if there
+	// is none for the current set of bodies, in which case there is nothing
+	// to draw yet.
+	bool fetchState(void);
 	
 	bool getDrawWitnesses(void) { return mDrawWitnesses; }
 	void setDrawWitnesses(bool w) { mDrawWitnesses = w; }
@@ -51,15 +130,43 @@ public:
 	double getGravity(void) { return mGravity; }
 	void setGravity(double g) { mGravity = g; }
 
+	// Most sweeps of the contact solver over all contacts per step.  More
+	// make stacks stiffer; the time a step takes grows with them.
+	int getSolverIterations(void) { return mSolverIterations; }
+	void setSolverIterations(int n) { mSolverIterations = n; }
+
+	// Threads a step is spread over, counting the one stepping.  Starts at
+	// one per processor.
+	int getNumThreads(void) { return mThreadPool.getNumThreads(); }
+	void setNumThreads(int n) { mThreadPool.start(n); }
+
+	// Islands that have come to rest are put to sleep, and skipped until
+	// something touches them.
+	bool getSleepEnabled(void) { return mSleepEnabled; }
+	void setSleepEnabled(bool s);
+
 	void drawWorld();
 	void drawWorldHaptics();
+	void drawDebug();	// witnesses and mouse spring; reads the live bodies
 
 	void addBox(hduVector3Dd pos, hduQuaternion angle, hduVector3Dd size, hduVector3Dd vel, hduVector3Dd angularVel, const char *name = 0);
 	void addWall(hduVector3Dd v0, hduVector3Dd v1, hduVector3Dd v2, hduVector3Dd v3, const char *name = 0);
+	void removeBody(HLuint id);
+
+	int getNumBodies(void) { return mBodies.size(); }
+	int getNumPairs(void) { return mStateBuffer.getReadBuffer().numPairs; }
+	int getNumContacts(void) { return mStateBuffer.getReadBuffer().numContacts; }
+
+	// State of all the bodies after the last step, in the order of the body
+	// list.  Only for the thread stepping the simulation.
+	const nvectord& getStateVector(void) const { return xFinal; }
+	int getNumIslands(void) { return mStateBuffer.getReadBuffer().numIslands; }
+	int getNumAsleep(void) { return mStateBuffer.getReadBuffer().numAsleep; }
 	
 	void activateMouseSpring(int x, int y);
 	void moveMouseSpring(int x, int y);
 	void deactivateMouseSpring(void);
+	bool isMouseSpringActive(void) const { return mouseSpringBody != NULL; }
 
     // Two modes: can either be touching the objects
     // in the scene or can take control of one object
@@ -88,21 +195,54 @@ public:
         rot = hapticControlObjectRotOffset;
     }
     
-    // get current position of body in simulation
+    // get position of body as of the last fetched state
     const hduVector3Dd& getBodyPosition(HLuint id) const;
 
-    // get current orientation of body in simulation
+    // get orientation of body as of the last fetched state
     const hduQuaternion& getBodyOrientation(HLuint id) const;
 
 private:
 	BodyListT mBodies;
+	std::vector<RigidBody*> mBodyArray;	// mBodies in order, by RigidBody::index
 	ContactListT mContacts;
-	WitnessListT mWitnesses;
+	ContactListT mPrevContacts;	// contacts of the last solve, for warm starting
+	WitnessMapT mWitnesses;
+
+	BroadPhase mBroadPhase;
+	BodyPairListT mPairs;	// pairs of bodies close enough to check for contact
+
+	// Narrow phase of each of mPairs: its witness, what was found and the
+	// contact if any (a is NULL if none)
+	std::vector<Witness*> mPairWitnesses;
+	std::vector<int> mPairStates;	// ESeparationState, or -1 if not checked
+	ContactListT mPairContacts;
+
+	// Islands of the last step, and for each body its island (-1 if fixed)
+	IslandListT mIslands;
+	std::vector<int> mIslandBodies;
+	std::vector<int> mIslandContacts;	// indices into mContacts
+	std::vector<int> mBodyIsland;
+	std::vector<int> mIslandParent;	// union-find forest while finding them
+
+	// Sleeping; by body index.  Sleep time is how long a body has been
+	// nearly still.
+	bool mSleepEnabled;
+	std::vector<double> mSleepTime;
+	std::vector<char> mAsleep;
+
+	ThreadPool mThreadPool;
+
+	// What the tasks of the step in progress work on
+	double mStepTime;
+	nvectord *mStepX;
+	nvectord *mStepXdot;
+	bool mStepImpulses;
 
 	OdeSolverEuler odeSolver;
 	
 	bool mDrawWitnesses;
 	double mGravity;
+	int mSolverIterations;
 
 	nvectord x0;		// kSateSize * mBodies.size
 	nvectord xFinal;	// kSateSize * mBodies.size
@@ -118,21 +258,56 @@ private:
     hduVector3Dd hapticControlObjectOffset;
     hduQuaternion hapticControlObjectRotOffset;
 
+    hduTripleBuffer<HapticInput> mHapticInputBuffer;
+    hduTripleBuffer<WorldState> mStateBuffer;
+
+    // In control object mode the device moves the body through the virtual
+    // coupling, which hands the simulation impulses at the servo loop rate.
+    // Each step spreads those sent since the last one over the step.
+    VirtualCoupling mCoupling;
+    HLuint mCouplingBody;
+    hduVector3Dd mCouplingForce;
+    hduVector3Dd mCouplingTorque;
+    hduVector3Dd mExternalForce;    // on the controlled body, but for the device
+    hduVector3Dd mExternalTorque;
+
 	void arrayToBodies(nvectord &x);
 	void bodiesToArray(nvectord &x);
 
+	// Items of the parallel loops of a step; i is the body, pair or island
+	static void arrayToBodyTask(int i, void *userData);
+	static void narrowPhaseTask(int i, void *userData);
+	static void solveIslandTask(int i, void *userData);
+	static void derivativeTask(int i, void *userData);
+
+	bool isAwake(const RigidBody *rb) const
+	{
+		return rb->massInv != 0 && !mAsleep[rb->index];
+	}
+	void wakeBody(int index);
+	void disturbBody(HLuint id);
+	void wakeDisturbedBodies(void);
+	void findIslands(void);
+	int findIslandRoot(int i);
+	void updateSleep(double dt);
+
 	void computeForceAndTorque(double t, RigidBody *rb);
     void addHapticDeviceForce(RigidBody* rb);
+    void publishState(void);
+    const BodyState& getBodyState(HLuint id) const;
 	static bool dxdt(double t, nvectord &x, nvectord &xdot, void *userData);
 	void ddtStateToArray(RigidBody *rb, double *xdot);
 	
 	bool findAllCollisions(void);
+	void matchContacts(void);
+	static BodyIdPairT getContactKey(const Contact& c);
 	void findAllContacts(bool &interPenetration);
 	ESeparationState findSeparatingPlane(RigidBody &rbA, RigidBody &rbB, Witness &witness);
 	ESeparationState findWitnessFromPrimaryFace(RigidBody &rbPri, RigidBody &rbSec, Witness &witness, double contactThreshold);
 	ESeparationState findWitnessFromPrimaryEdge(RigidBody &rbPri, RigidBody &rbSec, Witness &witness, double contactThreshold);
 	void deleteBodies(void);
 	void deleteWitnesses(void);
+	void deleteWitnesses(RigidBody *rb);
 	void deleteContacts(void);
 };
 
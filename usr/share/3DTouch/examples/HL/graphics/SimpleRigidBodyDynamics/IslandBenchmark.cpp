@@ -0,0 +1,145 @@
+/*****************************************************************************
+
+Copyright (c) 2004 SensAble Technologies, Inc. All rights reserved.
+
+OpenHaptics(TM) toolkit. The material embodied in this software and use of
+this software is subject to the terms and conditions of the clickthrough
+Development License Agreement.
+
+For questions, comments or bug reports, go to forums at:
+    http://dsc.sensable.com
+
+Module Name:
+
+  IslandBenchmark.cpp
+
+Description:
+
+  Times the steps of the many stacks scene on 1 to 16 threads, and checks
+  that every thread count ends in the very same state as one thread.  All
+  islands are kept awake while timing; the time with sleeping on is shown
+  after.  Needs a haptic device, as the world makes haptic shapes.
+  Usage: IslandBenchmark [stacks] [boxes per stack] [steps]
+
+*******************************************************************************/
+
+#include "SimpleRigidBodyDynamicsAfx.h"
+#include "DynamicsWorld.h"
+#include "TestScenes.h"
+
+#include <HL/hl.h>
+#include <HDU/hduError.h>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+static const double kSimulationRate = 500; // steps per second, as main.cpp
+
+static const int kThreadCounts[] = { 1, 2, 4, 8, 16 };
+static const int kNumThreadCounts = sizeof(kThreadCounts) / sizeof(kThreadCounts[0]);
+
+// the scenes and DynamicsWorld expect these of the main program
+DynamicsWorld *mWorld = 0;
+int nHapticDeviceDOFInput = 3;
+
+static double getTime()
+{
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return now.tv_sec + now.tv_nsec * 1e-9;
+}
+
+// Builds the scene afresh, the same every time, and steps it.  Returns the
+// seconds taken per step.
+static double runScene(int numStacks, int stackHeight, int numSteps,
+                       int numThreads, bool sleepEnabled)
+{
+    srand(1);
+    testManyStacks(numStacks, stackHeight);
+    mWorld->setNumThreads(numThreads);
+    mWorld->setSleepEnabled(sleepEnabled);
+
+    double dt = 1 / kSimulationRate;
+    double start = getTime();
+    for (int i = 0; i < numSteps; i++)
+        mWorld->advanceSimulation(i * dt, (i + 1) * dt);
+    double elapsed = getTime() - start;
+
+    mWorld->fetchState();
+    return elapsed / numSteps;
+}
+
+int main(int argc, char *argv[])
+{
+    int numStacks = argc > 1 ? atoi(argv[1]) : 64;
+    int stackHeight = argc > 2 ? atoi(argv[2]) : 6;
+    int numSteps = argc > 3 ? atoi(argv[3]) : 500;
+    if (numStacks < 1 || stackHeight < 1 || numSteps < 1)
+    {
+        fprintf(stderr, "Usage: %s [stacks] [boxes per stack] [steps]\n", argv[0]);
+        return -1;
+    }
+
+    HDErrorInfo error;
+    HHD hHD = hdInitDevice(HD_DEFAULT_DEVICE);
+    if (HD_DEVICE_ERROR(error = hdGetError()))
+    {
+        hduPrintError(stderr, &error, "Failed to initialize haptic device");
+        return -1;
+    }
+    HHLRC hHLRC = hlCreateContext(hHD);
+    hlMakeCurrent(hHLRC);
+
+    printf("%d stacks of %d boxes, %d steps, %d processors\n",
+           numStacks, stackHeight, numSteps, ThreadPool::getNumProcessors());
+    printf("threads  ms/step  speedup  state\n");
+
+    nvectord reference;
+    double referenceTime = 0;
+    bool identical = true;
+
+    for (int i = 0; i < kNumThreadCounts; i++)
+    {
+        double time = runScene(numStacks, stackHeight, numSteps,
+                               kThreadCounts[i], false);
+        const nvectord &state = mWorld->getStateVector();
+
+        const char *check = "reference";
+        if (i == 0)
+        {
+            reference = state;
+            referenceTime = time;
+        }
+        else if (state.size() == reference.size() &&
+                 memcmp(&state[0], &reference[0],
+                        state.size() * sizeof(double)) == 0)
+        {
+            check = "identical";
+        }
+        else
+        {
+            check = "DIFFERS";
+            identical = false;
+        }
+
+        printf("%7d  %7.3f  %7.2f  %s\n", kThreadCounts[i], time * 1000,
+               referenceTime / time, check);
+    }
+
+    int numThreads = ThreadPool::getNumProcessors();
+    double time = runScene(numStacks, stackHeight, numSteps, numThreads, true);
+    printf("sleeping on, %d threads: %.3f ms/step, %d of %d bodies asleep\n",
+           numThreads, time * 1000, mWorld->getNumAsleep(),
+           mWorld->getNumBodies());
+
+    delete mWorld;
+    hlMakeCurrent(NULL);
+    hlDeleteContext(hHLRC);
+    hdDisableDevice(hHD);
+
+    return identical ? 0 : 1;
+}
+
+/*****************************************************************************/
@@ -47,7 +47,7 @@ void OdeSolverEuler::solve(nvectord &x0, nvectord &xFinal,
     // Euler's method.
     restartRequired = dxdt(t0, x0, fStart, userData);
     assert(!restartRequired);
-    xFinal = x0 + h * fStart;
+    addScaled(xFinal, x0, h, fStart);
 }
 
 OdeSolverMidpoint::OdeSolverMidpoint()
@@ -64,6 +64,7 @@ void OdeSolverMidpoint::setSize(int vecSize)
 {
     fStart.resize(vecSize);
     fMid.resize(vecSize);
+    xMid.resize(vecSize);
 }
 
 // Given x0 at t0, find xFinal at t1 using the derivative function dxdt
@@ -78,10 +79,10 @@ void OdeSolverMidpoint::solve(nvectord &x0, nvectord &xFinal,
     // We evaluate f = dxdt at t0 and at the midpoint.
     dxdt(t0, x0, fStart, userData);
 
-    nvectord temp = x0 + h/2 * fStart;
-    dxdt(t0 + h/2, temp, fMid, userData);
+    addScaled(xMid, x0, h/2, fStart);
+    dxdt(t0 + h/2, xMid, fMid, userData);
 
-    xFinal = x0 + h * fMid;
+    addScaled(xFinal, x0, h, fMid);
 }
 
 OdeSolverRungeKutta4::OdeSolverRungeKutta4()
@@ -98,6 +99,7 @@ void OdeSolverRungeKutta4::setSize(int vecSize)
     k2.resize(vecSize);
     k3.resize(vecSize);
     k4.resize(vecSize);
+    xTemp.resize(vecSize);
 }
 
 // Given x0 at t0, find xFinal at t1 using the derivative function dxdt
@@ -105,22 +107,18 @@ void OdeSolverRungeKutta4::solve(nvectord &x0, nvectord &xFinal, double t0, doub
 {
     bool restartRequired = false;
     double h = t1 - t0;
-    nvectord temp;
         
-    // Runge-Kutta of order 4.
+    // Runge-Kutta of order 4.  The k's are left unscaled by h and the
+    // scaling is folded into the sums.
     dxdt(t0, x0, k1, userData);
-    k1 *= h;
-    temp = x0 + k1 * (double)0.5;
-    dxdt(t0 + h * (double)0.5, temp, k2, userData);
-    k2 *= h;
-    temp = x0 + k2 * (double)0.5;
-    dxdt(t0 + h * (double)0.5, temp, k3, userData);
-    k3 *= h;
-    temp = x0 + k3;
-    dxdt(t0 + h, temp, k4, userData);
-    k4 *= h;
-
-    xFinal = x0 + k1 / (double)6 + k2 / (double)3 + k3 / (double)3 + k4 / (double)6;
+    addScaled(xTemp, x0, h * 0.5, k1);
+    dxdt(t0 + h * 0.5, xTemp, k2, userData);
+    addScaled(xTemp, x0, h * 0.5, k2);
+    dxdt(t0 + h * 0.5, xTemp, k3, userData);
+    addScaled(xTemp, x0, h, k3);
+    dxdt(t0 + h, xTemp, k4, userData);
+
+    addScaled(xFinal, x0, h / 6, k1, h / 3, k2, h / 3, k3, h / 6, k4);
 }
 
 /*****************************************************************************/
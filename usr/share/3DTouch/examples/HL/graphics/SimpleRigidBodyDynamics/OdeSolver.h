@@ -85,6 +85,7 @@ private:
     // vectors used by the ode solver; avoid continuously re-allocating
     nvectord fStart;
     nvectord fMid;
+    nvectord xMid;
 };
 
 class OdeSolverRungeKutta4 : public IOdeSolver
@@ -99,6 +100,7 @@ public:
 private:
     // vectors used by the ode solver; avoid continuously re-allocating
     nvectord k1, k2, k3, k4;
+    nvectord xTemp;
 };
 
 #endif // !defined(AFX_ODESOLVER_H__CDEE86EE_DBBF_4FDF_B9B0_9A54FEC95521__INCLUDED_)
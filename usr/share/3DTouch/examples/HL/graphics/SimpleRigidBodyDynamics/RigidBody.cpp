@@ -34,6 +34,7 @@ Description:
 #endif
 
 #include <stdlib.h>
+#include <HDU/hduTransform.h>
 
 #include "DynFace.h"
 #include "DynEdge.h"
@@ -52,7 +53,8 @@ RigidBody::RigidBody(const char *name) :
     v(0,0,0),
     omega(0,0,0),
     force(0,0,0),
-    torque(0,0,0)
+    torque(0,0,0),
+    index(-1)
 {
     zeroMatrix(Ibody);
     zeroMatrix(Ibodyinv);
@@ -66,7 +68,7 @@ RigidBody::RigidBody(const char *name) :
 
 RigidBody::~RigidBody()
 {
-    // delete our faces, edges, vertices, and normals
+    // delete our faces and edges
     deleteFaces();
     deleteEdges(edges);
 
@@ -75,10 +77,6 @@ RigidBody::~RigidBody()
     // edge objects) we don't need to delete them again, just
     // clear the list.
     nonParallelEdges.clear();
-    deleteVectorList(verticesWorld);
-    deleteVectorList(verticesObject);
-    deleteVectorList(normalsWorld);
-    deleteVectorList(normalsObject);
 
     hlDeleteShapes(shapeId, 1);
 }
@@ -111,20 +109,6 @@ void RigidBody::deleteEdges(EdgeListT &edgeList)
     edgeList.clear();
 }
 
-void RigidBody::deleteVectorList(VectorListT &vectors)
-{
-    VectorListT::const_iterator ci;
-        
-    for (ci = vectors.begin(); ci != vectors.end(); ++ci)
-    {
-        hduVector3Dd *o = *ci;
-        assert(o != NULL);
-        delete o;
-    }
-
-    vectors.clear();
-}
-
 void RigidBody::setName(const char *name)
 {
     if (name)
@@ -183,11 +167,11 @@ void RigidBody::arrayToState(double *y)
     transformObjectToWorld();
 }
 
-void RigidBody::draw(void)
+void RigidBody::draw(const hduVector3Dd &pos, const hduMatrix &rot)
 {
 }
 
-void RigidBody::drawHaptics(void)
+void RigidBody::drawHaptics(const hduVector3Dd &pos, const hduMatrix &rot)
 {
 }
 
@@ -199,7 +183,7 @@ hduVector3Dd RigidBody::pointVelocity(const hduVector3Dd &p)
 }
 
 // Determine the distance from the face to a point
-double RigidBody::distPlanePoint(DynPlane *plane, hduVector3Dd *point)
+double RigidBody::distPlanePoint(DynPlane *plane, const hduVector3Dd *point)
 {
     return (*point - *plane->getFirstVertex()).dotProduct(*plane->getNormal());
 }
@@ -215,53 +199,75 @@ double RigidBody::distPlanePoly(DynPlane *plane, RigidBody *poly)
 {
     double dist, smallest;
 
-    VectorListT *vertices = poly->getVerticesWorld();
+    // take the plane apart once rather than for every vertex
+    const hduVector3Dd &normal = *plane->getNormal();
+    double offset = plane->getFirstVertex()->dotProduct(normal);
+
+    const VectorListT &vertices = *poly->getVerticesWorld();
     VectorListT::const_iterator vi; // constant because not modifying list
         
-    vi = vertices->begin();
-    smallest = distPlanePoint(plane, *vertices->begin());
+    vi = vertices.begin();
+    smallest = (*vi).dotProduct(normal);
 
-    for (vi++; vi != vertices->end(); ++vi)
+    for (vi++; vi != vertices.end(); ++vi)
     {
-        hduVector3Dd *vert = *vi;
-        assert(vert != NULL);
-
-        dist = distPlanePoint(plane, vert);
+        dist = (*vi).dotProduct(normal);
         if (dist < smallest)
             smallest = dist;
     }
 
-    return(smallest);
+    return(smallest - offset);
 }
 
-// transform vertices and normals from object to world space
+// transform vertices and normals from object to world space, a whole
+// array at a time
 void RigidBody::transformObjectToWorld(void)
 {
-    unsigned int i;
-    for (i = 0; i < verticesWorld.size(); i++)
+    hduMatrix objectToWorld = R;
+    objectToWorld.multRight(hduMatrix::createTranslation(x));
+
+    if (!verticesWorld.empty())
     {
-        *verticesWorld[i] =  *verticesObject[i] * R + x;
+        hduTransformPoints(objectToWorld, &verticesObject[0],
+                           &verticesWorld[0], verticesWorld.size());
     }
-        
+
     // normals only get rotated, not translated
-    for (i = 0; i < normalsWorld.size(); i++)
+    if (!normalsWorld.empty())
+    {
+        hduTransformDirections(R, &normalsObject[0], &normalsWorld[0],
+                               normalsWorld.size());
+    }
+
+#ifdef _DEBUG
+    for (unsigned int i = 0; i < normalsWorld.size(); i++)
+    {
+        assert(fabs(normalsObject[i].magnitude() - 1) < 0.001);
+        assert(fabs(normalsWorld[i].magnitude() - 1) < 0.001);
+    }
+#endif
+}
+
+// bounding box of the world space vertices
+void RigidBody::getWorldBounds(hduBoundBox3Dd &bounds)
+{
+    bounds.setIsEmpty();
+    for (unsigned int i = 0; i < verticesWorld.size(); i++)
     {
-        assert(fabs(normalsObject[i]->magnitude() - 1) < 0.001);
-        R.multDirMatrix(*normalsObject[i], *normalsWorld[i]);
-        assert(fabs(normalsWorld[i]->magnitude() - 1) < 0.001);
+        bounds.Union(verticesWorld[i]);
     }
 }
 
-void RigidBody::addVertex(hduVector3Dd *vertex)
+void RigidBody::addVertex(const hduVector3Dd &vertex)
 {
     verticesObject.push_back(vertex);
-    verticesWorld.push_back(new hduVector3Dd(*vertex));
+    verticesWorld.push_back(vertex);
 }
 
-int RigidBody::addNormal(hduVector3Dd *normal)
+int RigidBody::addNormal(const hduVector3Dd &normal)
 {
     normalsObject.push_back(normal);
-    normalsWorld.push_back(new hduVector3Dd(*normal));
+    normalsWorld.push_back(normal);
 
     return normalsObject.size() - 1;
 }
@@ -292,9 +298,27 @@ void RigidBody::addEdge(DynEdge *edge)
     nonParallelEdges.push_back(edge);
 }
 
+//
+// Add the edge between vertices i and j.  Call after adding the faces, so
+// that the edge can find the two faces it joins.
+//
 void RigidBody::addEdge(int i, int j)
 {
-    addEdge(new DynEdge(this, i, j));
+    DynEdge *edge = new DynEdge(this, i, j);
+
+    FaceListT::const_iterator ci;
+    int numFaces = 0;
+
+    for (ci = faces.begin(); ci != faces.end() && numFaces < 2; ++ci)
+    {
+        DynFace *face = *ci;
+        assert(face != NULL);
+
+        if (face->hasEdge(i, j))
+            edge->setFace(numFaces++, face->getNormalIndex());
+    }
+
+    addEdge(edge);
 }
 
 // update force and torque based on force at point in world space
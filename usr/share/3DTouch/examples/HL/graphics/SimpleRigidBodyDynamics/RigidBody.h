@@ -30,6 +30,7 @@ Description:
 #include <vector>
 #include "DynamicsMath.h"
 #include <HL/hl.h>
+#include <HDU/hduBoundBox.h>
 
 class DynFace;
 class DynEdge;
@@ -37,7 +38,9 @@ class DynPlane;
 
 typedef std::vector<DynFace*> FaceListT;
 typedef std::vector<DynEdge*> EdgeListT;
-typedef std::vector<hduVector3Dd*> VectorListT;
+// Vertices and normals are stored by value, contiguously, and are only
+// added while building the body, so pointers to them stay valid.
+typedef std::vector<hduVector3Dd> VectorListT;
 
 class RigidBody  
 {
@@ -65,21 +68,26 @@ public:
     hduVector3Dd            force;          // F(t)
     hduVector3Dd            torque;         // tao(t)
 
+    // Position in the world's array of bodies and of its state in the
+    // state vector, set by DynamicsWorld::initSimulation
+    int                     index;
+
     RigidBody(const char *name = 0);
     virtual ~RigidBody();
 
-    void deleteVectorList(VectorListT &vectors);
     void deleteFaces(void);
     void deleteEdges(EdgeListT &edgeList);
 
     void stateToArray(double *y);
     void arrayToState(double *y);
 
-    virtual void draw();
-    virtual void drawHaptics();
+    // draw at the given position and orientation, which may be those of
+    // an earlier state than the body's own
+    virtual void draw(const hduVector3Dd &pos, const hduMatrix &rot);
+    virtual void drawHaptics(const hduVector3Dd &pos, const hduMatrix &rot);
 
-    virtual void addVertex(hduVector3Dd *vertex);
-    virtual int addNormal(hduVector3Dd *normal);
+    virtual void addVertex(const hduVector3Dd &vertex);
+    virtual int addNormal(const hduVector3Dd &normal);
     virtual void addFace(DynFace *face);
     virtual void addEdge(DynEdge *edge);
     virtual void addEdge(int i, int j);
@@ -92,16 +100,17 @@ public:
     virtual VectorListT *getNormalsObject(void) { return &normalsObject; }
     virtual VectorListT *getNormalsWorld(void) { return &normalsWorld; }
 
-    virtual hduVector3Dd *getNormal(int i) { return normalsWorld[i]; }
-    virtual hduVector3Dd *getNormalOS(int i) { return normalsObject[i]; }
-    virtual hduVector3Dd *getVertex(int i) { return verticesWorld[i]; }
-    virtual hduVector3Dd *getVertexOS(int i) { return verticesObject[i]; }
+    virtual hduVector3Dd *getNormal(int i) { return &normalsWorld[i]; }
+    virtual hduVector3Dd *getNormalOS(int i) { return &normalsObject[i]; }
+    virtual hduVector3Dd *getVertex(int i) { return &verticesWorld[i]; }
+    virtual hduVector3Dd *getVertexOS(int i) { return &verticesObject[i]; }
         
     hduVector3Dd pointVelocity(const hduVector3Dd &p);
-    double distPlanePoint(DynPlane *plane, hduVector3Dd *point);
+    double distPlanePoint(DynPlane *plane, const hduVector3Dd *point);
     double distPlanePoly(DynPlane *plane, RigidBody *poly);
         
     void transformObjectToWorld(void); // transform vertices and normals from object to world space
+    void getWorldBounds(hduBoundBox3Dd &bounds); // bounding box of the world space vertices
         
     void setName(const char *name);
 
@@ -133,8 +133,8 @@ void RigidBodyBox::addBoxFace(int i, int j, int k, int l)
     face->addVertexIndex(k);
     face->addVertexIndex(l);
 	
-    hduVector3Dd *normal = new hduVector3Dd;
-    face->calculateNormal(normal);
+    hduVector3Dd normal;
+    face->calculateNormal(&normal);
     int normalIndex = addNormal(normal);
 
     face->setNormalIndex(normalIndex);
@@ -142,25 +142,25 @@ void RigidBodyBox::addBoxFace(int i, int j, int k, int l)
 }
 
 // x, y, z are +1 or -1 to indicate the face
-hduVector3Dd *RigidBodyBox::newVertex(double x, double y, double z)
+hduVector3Dd RigidBodyBox::newVertex(double x, double y, double z)
 {
-    hduVector3Dd *vertex = new hduVector3Dd;
+    hduVector3Dd vertex;
 
-    (*vertex)[0] = mSize[0] / 2 * x;
-    (*vertex)[1] = mSize[1] / 2 * y;
-    (*vertex)[2] = mSize[2] / 2 * z;
+    vertex[0] = mSize[0] / 2 * x;
+    vertex[1] = mSize[1] / 2 * y;
+    vertex[2] = mSize[2] / 2 * z;
 
     return vertex;
 }
 
-void RigidBodyBox::draw(void)
+void RigidBodyBox::draw(const hduVector3Dd &pos, const hduMatrix &rot)
 {
     GLfloat matAmbDiff[] = { 1.0f, 0.2f, 0.2f, 1.0f };	// red
     glMaterialfv(GL_FRONT_AND_BACK, GL_AMBIENT_AND_DIFFUSE, matAmbDiff);
 
     glPushMatrix();
-    glTranslated(x[0], x[1], x[2]);
-    glMultMatrixd(R);
+    glTranslated(pos[0], pos[1], pos[2]);
+    glMultMatrixd(rot);
 
     drawGeom();
     glPopMatrix();
@@ -197,11 +197,11 @@ void RigidBodyBox::drawGeom(void)
     }
 }
 
-void RigidBodyBox::drawHaptics(void)
+void RigidBodyBox::drawHaptics(const hduVector3Dd &pos, const hduMatrix &rot)
 {
     glPushMatrix();
-    glTranslated(x[0], x[1], x[2]);
-    glMultMatrixd(R);
+    glTranslated(pos[0], pos[1], pos[2]);
+    glMultMatrixd(rot);
     hlHinti(HL_SHAPE_FEEDBACK_BUFFER_VERTICES, 
             getFaces()->size() * getFaces()->front()->getNumVertices() + 100);
     hlMaterialf(HL_FRONT, HL_STATIC_FRICTION, 0.8f);
@@ -36,8 +36,8 @@ public:
 
     virtual ~RigidBodyBox();
 
-    virtual void draw();
-    virtual void drawHaptics();
+    virtual void draw(const hduVector3Dd &pos, const hduMatrix &rot);
+    virtual void drawHaptics(const hduVector3Dd &pos, const hduMatrix &rot);
     void drawGeom();
 
 private:
@@ -45,7 +45,7 @@ private:
 
     void initialize(void);
     void createFacesAndVertices(void);
-    hduVector3Dd *newVertex(double x, double y, double z);
+    hduVector3Dd newVertex(double x, double y, double z);
     void addBoxFace(int i, int j, int k, int l);
 };
 
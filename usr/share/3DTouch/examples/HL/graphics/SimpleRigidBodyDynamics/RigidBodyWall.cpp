@@ -49,10 +49,10 @@ void RigidBodyWall::initialize(hduVector3Dd v0, hduVector3Dd v1, hduVector3Dd v2
 // Setup our faces and vertices
 void RigidBodyWall::createFacesAndVertices(hduVector3Dd v0, hduVector3Dd v1, hduVector3Dd v2, hduVector3Dd v3)
 {
-	addVertex(new hduVector3Dd(v0));
-	addVertex(new hduVector3Dd(v1));
-	addVertex(new hduVector3Dd(v2));
-	addVertex(new hduVector3Dd(v3));
+	addVertex(v0);
+	addVertex(v1);
+	addVertex(v2);
+	addVertex(v3);
 	assert(getVerticesObject()->size() == 4);
 	assert(getVerticesWorld()->size() == 4);
 
@@ -63,8 +63,8 @@ void RigidBodyWall::createFacesAndVertices(hduVector3Dd v0, hduVector3Dd v1, hdu
 	face->addVertexIndex(2);
 	face->addVertexIndex(3);
 	
-	hduVector3Dd *normal = new hduVector3Dd;
-	face->calculateNormal(normal);
+	hduVector3Dd normal;
+	face->calculateNormal(&normal);
 	int normalIndex = addNormal(normal);
 
 	face->setNormalIndex(normalIndex);
@@ -77,7 +77,7 @@ void RigidBodyWall::createFacesAndVertices(hduVector3Dd v0, hduVector3Dd v1, hdu
 	//assert((*getVertexOS(7))[2] == -mSize[2] / 2);
 }
 
-void RigidBodyWall::draw(void)
+void RigidBodyWall::draw(const hduVector3Dd &pos, const hduMatrix &rot)
 {
 
 	DynFace* face = *getFaces()->begin();
@@ -86,8 +86,8 @@ void RigidBodyWall::draw(void)
 	glMaterialfv(GL_FRONT_AND_BACK, GL_AMBIENT_AND_DIFFUSE, matAmbDiff);
 
     glPushMatrix();
-    glTranslated(x[0], x[1], x[2]);
-    glMultMatrixd(R);
+    glTranslated(pos[0], pos[1], pos[2]);
+    glMultMatrixd(rot);
 	drawGeom();
     glPopMatrix();
 }
@@ -98,11 +98,11 @@ void RigidBodyWall::drawGeom(void)
 	face->draw();
 }
 
-void RigidBodyWall::drawHaptics(void)
+void RigidBodyWall::drawHaptics(const hduVector3Dd &pos, const hduMatrix &rot)
 {
     glPushMatrix();
-    glTranslated(x[0], x[1], x[2]);
-    glMultMatrixd(R);
+    glTranslated(pos[0], pos[1], pos[2]);
+    glMultMatrixd(rot);
 	DynFace* face = *getFaces()->begin();
     hlHinti(HL_SHAPE_FEEDBACK_BUFFER_VERTICES, face->getNumVertices() + 100);
     hlMaterialf(HL_FRONT, HL_STATIC_FRICTION, 0);
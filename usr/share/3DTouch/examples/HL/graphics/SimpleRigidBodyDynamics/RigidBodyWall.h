@@ -33,12 +33,12 @@ public:
 	RigidBodyWall(hduVector3Dd v0, hduVector3Dd v1, hduVector3Dd v2, hduVector3Dd v3, const char *name = 0);
 	virtual ~RigidBodyWall();
 
-	virtual void draw();
+	virtual void draw(const hduVector3Dd &pos, const hduMatrix &rot);
 	
 	// walls never collide on their edges
 	virtual bool noEdgeCollisions(void) { return true; }
 
-    void drawHaptics();
+    void drawHaptics(const hduVector3Dd &pos, const hduMatrix &rot);
     void drawGeom();
 
 private:
@@ -521,6 +521,89 @@ void testPlateStack(void)
     mWorld->initSimulation();
 }
 
+//
+// Benchmark scene: numBoxes small boxes fill a cube shaped grid in the
+// room with random spins and velocities, then rain down into a pile.
+//
+void testBoxRain(int numBoxes)
+{
+    startNewWorld();
+    addWalls(10);
+
+    const double roomSize = 10;
+    const double spacing = 0.9;
+    int perSide = (int) ceil(pow((double) numBoxes, 1.0 / 3.0));
+    if (perSide * spacing > roomSize - spacing)
+        perSide = (int) ((roomSize - spacing) / spacing);
+
+    hduVector3Dd pos(0,0,0);
+    hduQuaternion angle;
+    hduVector3Dd size(0.4, 0.4, 0.4);
+    hduVector3Dd vel(0,0,0);
+    hduVector3Dd angularVel(0,0,0);
+
+    double start = -0.5 * spacing * (perSide - 1);
+    int count = 0;
+    for (int j = 0; j < perSide && count < numBoxes; j++)
+        for (int i = 0; i < perSide && count < numBoxes; i++)
+            for (int k = 0; k < perSide && count < numBoxes; k++, count++)
+            {
+                pos[0] = start + i * spacing;
+                pos[1] = start + j * spacing;
+                pos[2] = start + k * spacing;
+                for (int axis = 0; axis < 3; axis++)
+                {
+                    vel[axis] = (double)rand() / RAND_MAX - 0.5;
+                    angularVel[axis] = 2 * ((double)rand() / RAND_MAX - 0.5);
+                }
+                angle.fromRotationMatrix(hduMatrix::createRotationAroundY(M_PI/180 * (double)rand() / RAND_MAX * 360));
+                mWorld->addBox(pos, angle, size, vel, angularVel);
+            }
+
+    mWorld->initSimulation();
+}
+
+//
+// Benchmark scene: numStacks stacks of stackHeight small boxes standing in
+// a square grid on the floor, far enough apart to be islands of their own
+// until they topple into each other.
+//
+void testManyStacks(int numStacks, int stackHeight)
+{
+    startNewWorld();
+    addWalls(10);
+
+    const double roomSize = 10;
+    const double spacing = 1.0;
+    const double floor = -5;
+    const double initialSpaceBetween = 0.01;
+    int perSide = (int) ceil(sqrt((double) numStacks));
+    if (perSide * spacing > roomSize - spacing)
+        perSide = (int) ((roomSize - spacing) / spacing);
+
+    hduVector3Dd pos(0,0,0);
+    hduQuaternion angle;
+    hduVector3Dd size(0.4, 0.4, 0.4);
+    hduVector3Dd vel(0,0,0);
+    hduVector3Dd angularVel(0,0,0);
+
+    double start = -0.5 * spacing * (perSide - 1);
+    int count = 0;
+    for (int i = 0; i < perSide && count < numStacks; i++)
+        for (int k = 0; k < perSide && count < numStacks; k++, count++)
+        {
+            pos[0] = start + i * spacing;
+            pos[2] = start + k * spacing;
+            for (int j = 0; j < stackHeight; j++)
+            {
+                pos[1] = floor + initialSpaceBetween + (size[1] / 2) + j * (initialSpaceBetween + size[1]);
+                angle.fromRotationMatrix(hduMatrix::createRotationAroundY(M_PI/180 * (double)rand() / RAND_MAX * 20));
+                mWorld->addBox(pos, angle, size, vel, angularVel);
+            }
+        }
+
+    mWorld->initSimulation();
+}
 
 void startNewWorld(void)
 {
@@ -36,6 +36,8 @@ void testEdgePlaneInvalidateCollision(void);
 void testCatapult(void);
 void testDominos(void);
 void testReboundEdgeEdgeCollision(void);
+void testBoxRain(int numBoxes = 1000);
+void testManyStacks(int numStacks = 64, int stackHeight = 6);
 
 #endif
 
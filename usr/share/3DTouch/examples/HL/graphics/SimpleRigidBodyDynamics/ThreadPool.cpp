@@ -0,0 +1,188 @@
+/*****************************************************************************
+
+Copyright (c) 2004 SensAble Technologies, Inc. All rights reserved.
+
+OpenHaptics(TM) toolkit. The material embodied in this software and use of
+this software is subject to the terms and conditions of the clickthrough
+Development License Agreement.
+
+For questions, comments or bug reports, go to forums at:
+    http://dsc.sensable.com
+
+Module Name:
+
+  ThreadPool.cpp
+
+Description:
+
+  Spreads the items of a loop over a fixed set of threads.
+
+*******************************************************************************/
+
+#include "SimpleRigidBodyDynamicsAfx.h"
+#include "ThreadPool.h"
+
+#include <unistd.h>
+
+ThreadPool::ThreadPool() :
+    mNumThreads(1),
+    mGeneration(0),
+    mBusy(0),
+    mStopRequested(false),
+    mFunc(NULL),
+    mUserData(NULL),
+    mGrain(1)
+{
+    pthread_mutex_init(&mLock, NULL);
+    pthread_cond_init(&mWorkReady, NULL);
+    pthread_cond_init(&mWorkDone, NULL);
+}
+
+ThreadPool::~ThreadPool()
+{
+    stop();
+    pthread_cond_destroy(&mWorkDone);
+    pthread_cond_destroy(&mWorkReady);
+    pthread_mutex_destroy(&mLock);
+}
+
+bool ThreadPool::start(int numThreads)
+{
+    stop();
+
+    if (numThreads < 1)
+        numThreads = 1;
+
+    mShares.resize(numThreads);
+    mWorkerStarts.resize(numThreads);
+    mThreads.clear();
+    mStopRequested = false;
+
+    // thread 0 is the caller of parallelFor
+    for (int i = 1; i < numThreads; i++)
+    {
+        mWorkerStarts[i].pool = this;
+        mWorkerStarts[i].index = i;
+        mWorkerStarts[i].generation = mGeneration;
+
+        pthread_t thread;
+        if (pthread_create(&thread, NULL, threadProc, &mWorkerStarts[i]) != 0)
+            break;
+        mThreads.push_back(thread);
+    }
+
+    mNumThreads = mThreads.size() + 1;
+    return mNumThreads == numThreads;
+}
+
+void ThreadPool::stop(void)
+{
+    pthread_mutex_lock(&mLock);
+    mStopRequested = true;
+    pthread_cond_broadcast(&mWorkReady);
+    pthread_mutex_unlock(&mLock);
+
+    for (unsigned int i = 0; i < mThreads.size(); i++)
+        pthread_join(mThreads[i], NULL);
+
+    mThreads.clear();
+    mNumThreads = 1;
+}
+
+void ThreadPool::parallelFor(int count, TaskFunc func, void *userData, int grain)
+{
+    assert(grain > 0);
+
+    if (count <= 0)
+        return;
+
+    // not worth waking anyone
+    if (mNumThreads == 1 || count <= grain)
+    {
+        for (int i = 0; i < count; i++)
+            func(i, userData);
+        return;
+    }
+
+    for (int i = 0; i < mNumThreads; i++)
+    {
+        mShares[i].next = (int) ((long long) count * i / mNumThreads);
+        mShares[i].end = (int) ((long long) count * (i + 1) / mNumThreads);
+    }
+
+    pthread_mutex_lock(&mLock);
+    mFunc = func;
+    mUserData = userData;
+    mGrain = grain;
+    mBusy = mNumThreads - 1;
+    mGeneration++;
+    pthread_cond_broadcast(&mWorkReady);
+    pthread_mutex_unlock(&mLock);
+
+    work(0);
+
+    pthread_mutex_lock(&mLock);
+    while (mBusy > 0)
+        pthread_cond_wait(&mWorkDone, &mLock);
+    pthread_mutex_unlock(&mLock);
+}
+
+int ThreadPool::getNumProcessors(void)
+{
+    long n = sysconf(_SC_NPROCESSORS_ONLN);
+    return n > 0 ? (int) n : 1;
+}
+
+void *ThreadPool::threadProc(void *userData)
+{
+    WorkerStart *start = static_cast<WorkerStart *>(userData);
+    start->pool->runWorker(start->index, start->generation);
+    return NULL;
+}
+
+// Starts from the generation as of its creation, which is not 0 once loops
+// have run and the pool is started again.
+void ThreadPool::runWorker(int index, unsigned long generation)
+{
+    pthread_mutex_lock(&mLock);
+    for (;;)
+    {
+        while (mGeneration == generation && !mStopRequested)
+            pthread_cond_wait(&mWorkReady, &mLock);
+
+        if (mStopRequested)
+            break;
+
+        generation = mGeneration;
+        pthread_mutex_unlock(&mLock);
+
+        work(index);
+
+        pthread_mutex_lock(&mLock);
+        if (--mBusy == 0)
+            pthread_cond_signal(&mWorkDone);
+    }
+    pthread_mutex_unlock(&mLock);
+}
+
+// Do the items of our own share, then steal from the others in turn.
+void ThreadPool::work(int index)
+{
+    for (int k = 0; k < mNumThreads; k++)
+    {
+        Share &share = mShares[(index + k) % mNumThreads];
+
+        for (;;)
+        {
+            long begin = hduAtomicAdd(&share.next, mGrain) - mGrain;
+            if (begin >= share.end)
+                break;
+
+            long end = begin + mGrain < share.end ? begin + mGrain : share.end;
+            for (int i = (int) begin; i < end; i++)
+                mFunc(i, mUserData);
+        }
+    }
+}
+
+/*****************************************************************************/
@@ -0,0 +1,108 @@
+/*****************************************************************************
+
+Copyright (c) 2004 SensAble Technologies, Inc. All rights reserved.
+
+OpenHaptics(TM) toolkit. The material embodied in this software and use of
+this software is subject to the terms and conditions of the clickthrough
+Development License Agreement.
+
+For questions, comments or bug reports, go to forums at:
+    http://dsc.sensable.com
+
+Module Name:
+
+  ThreadPool.h
+
+Description:
+
+  Spreads the items of a loop over a fixed set of threads.
+
+*******************************************************************************/
+
+#if !defined(AFX_THREADPOOL_H__8C3F5A27_E14B_4D96_B02A_6D9E1F47C385__INCLUDED_)
+#define AFX_THREADPOOL_H__8C3F5A27_E14B_4D96_B02A_6D9E1F47C385__INCLUDED_
+
+#if _MSC_VER > 1000
+#pragma once
+#endif // _MSC_VER > 1000
+
+#include <pthread.h>
+#include <vector>
+#include <HDU/hduAtomic.h>
+
+// Does item i of a loop.
+typedef void (*TaskFunc)(int i, void *userData);
+
+// Each loop's items are split evenly between the threads.  A thread takes
+// items from the front of its own share, a grain at a time, and once that
+// is used up takes them from the shares of the others, so threads given
+// more work than the rest are helped out (work stealing).  Which thread
+// does an item is left to chance, so items must only write what is theirs
+// for the results not to depend on the number of threads.
+//
+// The thread calling parallelFor works on the loop too, and returns when
+// every item is done.  Loops are for one thread at a time.
+class ThreadPool
+{
+public:
+    ThreadPool();
+    virtual ~ThreadPool();
+
+    // numThreads counts the calling thread; 1 runs loops on it alone.
+    bool start(int numThreads);
+    void stop(void);
+    int getNumThreads(void) const { return mNumThreads; }
+
+    void parallelFor(int count, TaskFunc func, void *userData, int grain = 1);
+
+    static int getNumProcessors(void);
+
+private:
+    // A thread's share of the items; next is taken from by the owner and
+    // thieves alike.  One per cache line, so that threads taking items
+    // don't slow each other down.
+    struct Share
+    {
+        volatile long next;
+        long end;
+        char pad[HDU_CACHE_LINE_SIZE - 2 * sizeof(long)];
+    };
+
+    int mNumThreads;
+    std::vector<pthread_t> mThreads;
+    std::vector<Share> mShares;
+
+    pthread_mutex_t mLock;
+    pthread_cond_t mWorkReady;
+    pthread_cond_t mWorkDone;
+
+    // Written under mLock.
+    unsigned long mGeneration;      // counts loops, so workers see new ones
+    int mBusy;                      // workers not done with the loop yet
+    bool mStopRequested;
+
+    TaskFunc mFunc;
+    void *mUserData;
+    int mGrain;
+
+    // The generation is that of the last loop before the worker started,
+    // which it must not run.
+    struct WorkerStart
+    {
+        ThreadPool *pool;
+        int index;
+        unsigned long generation;
+    };
+    std::vector<WorkerStart> mWorkerStarts;
+
+    static void *threadProc(void *userData);
+    void runWorker(int index, unsigned long generation);
+    void work(int index);
+
+    ThreadPool(const ThreadPool &);
+    ThreadPool &operator=(const ThreadPool &);
+};
+
+#endif // !defined(AFX_THREADPOOL_H__8C3F5A27_E14B_4D96_B02A_6D9E1F47C385__INCLUDED_)
+
+/*****************************************************************************/
@@ -0,0 +1,340 @@
+/*****************************************************************************
+
+Copyright (c) 2004 SensAble Technologies, Inc. All rights reserved.
+
+OpenHaptics(TM) toolkit. The material embodied in this software and use of
+this software is subject to the terms and conditions of the clickthrough
+Development License Agreement.
+
+For questions, comments or bug reports, go to forums at:
+    http://dsc.sensable.com
+
+Module Name:
+
+  VirtualCoupling.cpp
+
+Description:
+
+  Couples the haptic device to a body of the simulation at the servo loop
+  rate.
+
+*******************************************************************************/
+
+#include "SimpleRigidBodyDynamicsAfx.h"
+#include "VirtualCoupling.h"
+#include "RigidBody.h"
+
+#include <HD/hd.h>
+
+// Fractions of the device's nominal maximum stiffness and damping that the
+// coupling renders, leaving headroom for stable rendering throughout the
+// workspace.
+static const double kStiffnessFraction = 0.5;
+static const double kDampingFraction = 0.5;
+
+// Rotational spring and damper, in simulation units.
+static const double kAngularStiffness = 3;
+static const double kAngularDamping = 2;
+
+VirtualCoupling::VirtualCoupling() :
+    mActive(false),
+    mDeviceStiffness(0),
+    mDeviceDamping(0),
+    mAppliedSerial(0),
+    mImpulseApplied(0, 0, 0),
+    mAngularImpulseApplied(0, 0, 0),
+    mHaveBody(false),
+    mSerial(0),
+    mImpulseSent(0, 0, 0),
+    mAngularImpulseSent(0, 0, 0)
+{
+    mEffect = hlGenEffects(1);
+}
+
+VirtualCoupling::~VirtualCoupling()
+{
+    if (mActive)
+    {
+        hlBeginFrame();
+        stop();
+        hlEndFrame();
+    }
+    hlDeleteEffects(mEffect, 1);
+}
+
+void VirtualCoupling::start(HLuint bodyId, const hduVector3Dd &offset,
+                            const hduQuaternion &rotOffset,
+                            bool coupleRotation, double forceScale)
+{
+    if (mActive)
+        stop();
+
+    hdGetDoublev(HD_NOMINAL_MAX_STIFFNESS, &mDeviceStiffness);
+    hdGetDoublev(HD_NOMINAL_MAX_DAMPING, &mDeviceDamping);
+    mDeviceStiffness *= kStiffnessFraction;
+    mDeviceDamping *= kDampingFraction;
+
+    mTarget.bodyId = bodyId;
+    mTarget.offset = offset;
+    mTarget.rotOffset = rotOffset;
+    mTarget.coupleRotation = coupleRotation;
+    mTarget.forceScale = forceScale;
+    update();
+
+    hlCallback(HL_EFFECT_COMPUTE_FORCE, (HLcallbackProc) computeForceCB, this);
+    hlCallback(HL_EFFECT_START, (HLcallbackProc) startEffectCB, this);
+    hlCallback(HL_EFFECT_STOP, (HLcallbackProc) stopEffectCB, this);
+    hlStartEffect(HL_EFFECT_CALLBACK, mEffect);
+
+    mActive = true;
+}
+
+void VirtualCoupling::stop(void)
+{
+    if (!mActive)
+        return;
+
+    hlStopEffect(mEffect);
+    mActive = false;
+}
+
+//
+// The servo loop works in workspace coordinates and the simulation in world
+// coordinates.  The spring is chosen so that the device feels a fixed
+// stiffness however the workspace is scaled.
+//
+void VirtualCoupling::update(void)
+{
+    hduMatrix worldTview;
+    hduMatrix viewTtouch;
+    hduMatrix touchTworkspace;
+    hlGetDoublev(HL_MODELVIEW_MATRIX, worldTview);
+    hlGetDoublev(HL_VIEWTOUCH_MATRIX, viewTtouch);
+    hlGetDoublev(HL_TOUCHWORKSPACE_MATRIX, touchTworkspace);
+
+    mTarget.worldTworkspace = worldTview * viewTtouch * touchTworkspace;
+    mTarget.workspaceTworld = mTarget.worldTworkspace.getInverse();
+
+    hduVector3Dd unit;
+    mTarget.worldTworkspace.multDirMatrix(hduVector3Dd(1, 0, 0), unit);
+    mTarget.workspaceScale = unit.magnitude();
+
+    double scale = mTarget.forceScale * mTarget.workspaceScale;
+    mTarget.stiffness = mDeviceStiffness * scale;
+    mTarget.damping = mDeviceDamping * scale;
+
+    mTargetBuffer.getWriteBuffer() = mTarget;
+    mTargetBuffer.publish();
+}
+
+//
+// Impulses the servo loop sent to an earlier coupling that did not arrive
+// before it coupled again are dropped, rather than applied to the body of
+// the new coupling.
+//
+void VirtualCoupling::fetchImpulse(HLuint &bodyId, hduVector3Dd &impulse,
+                                   hduVector3Dd &angularImpulse)
+{
+    mImpulseBuffer.update();
+    const CouplingImpulse &sent = mImpulseBuffer.getReadBuffer();
+
+    if (sent.serial != mAppliedSerial)
+    {
+        mAppliedSerial = sent.serial;
+        mImpulseApplied.set(0, 0, 0);
+        mAngularImpulseApplied.set(0, 0, 0);
+    }
+
+    bodyId = sent.bodyId;
+    impulse = sent.impulse - mImpulseApplied;
+    angularImpulse = sent.angularImpulse - mAngularImpulseApplied;
+
+    mImpulseApplied = sent.impulse;
+    mAngularImpulseApplied = sent.angularImpulse;
+}
+
+void VirtualCoupling::publishBody(const RigidBody &rb,
+                                  const hduVector3Dd &externalForce,
+                                  const hduVector3Dd &externalTorque)
+{
+    CouplingBody &body = mBodyBuffer.getWriteBuffer();
+
+    body.id = rb.getId();
+    body.x = rb.x;
+    body.v = rb.v;
+    body.q = rb.q;
+    body.omega = rb.omega;
+    body.massInv = rb.massInv;
+    body.Iinv = rb.Iinv;
+
+    body.accel = externalForce * rb.massInv;
+    body.angularAccel = rb.Iinv * externalTorque;
+
+    body.serial = mAppliedSerial;
+    body.impulse = mImpulseApplied;
+    body.angularImpulse = mAngularImpulseApplied;
+
+    mBodyBuffer.publish();
+}
+
+//
+// Resets the local copy to a step of the simulation, plus the impulses sent
+// that the step did not apply yet.  Coupling to a new body, or to the same
+// one again after a stop, starts the impulse totals over, so that nothing
+// sent to the old coupling is ever applied to the new one.
+//
+void VirtualCoupling::syncBody(const CouplingBody &body)
+{
+    if (!mHaveBody || body.id != mBody.id)
+    {
+        mSerial++;
+        mImpulseSent.set(0, 0, 0);
+        mAngularImpulseSent.set(0, 0, 0);
+    }
+
+    mBody = body;
+
+    // a step that has not seen this coupling yet applied none of it
+    if (body.serial == mSerial)
+    {
+        mBody.v += (mImpulseSent - body.impulse) * body.massInv;
+        mBody.omega += body.Iinv *
+            (mAngularImpulseSent - body.angularImpulse);
+    }
+    else
+    {
+        mBody.v += mImpulseSent * body.massInv;
+        mBody.omega += body.Iinv * mAngularImpulseSent;
+    }
+    mHaveBody = true;
+}
+
+void VirtualCoupling::computeForce(hduVector3Dd &force)
+{
+    mTargetBuffer.update();
+    const CouplingTarget &target = mTargetBuffer.getReadBuffer();
+
+    if (mBodyBuffer.update() &&
+        mBodyBuffer.getReadBuffer().id == target.bodyId)
+    {
+        syncBody(mBodyBuffer.getReadBuffer());
+    }
+
+    // nothing to couple to until the simulation has stepped the body
+    if (!mHaveBody || mBody.id != target.bodyId)
+        return;
+
+    HDdouble instRate;
+    hdGetDoublev(HD_INSTANTANEOUS_UPDATE_RATE, &instRate);
+    double dt = 1.0 / instRate;
+
+    hduVector3Dd positionWS;
+    hduVector3Dd velocityWS;
+    hduMatrix deviceTworkspace;
+    hdGetDoublev(HD_CURRENT_POSITION, positionWS);
+    hdGetDoublev(HD_CURRENT_VELOCITY, velocityWS);
+    hdGetDoublev(HD_CURRENT_TRANSFORM, deviceTworkspace);
+
+    hduVector3Dd goal;
+    hduVector3Dd goalVelocity;
+    target.workspaceTworld.multVecMatrix(positionWS, goal);
+    target.workspaceTworld.multDirMatrix(velocityWS, goalVelocity);
+    goal += target.offset;
+
+    // Step the local copy with the spring and damper taken at the end of the
+    // tick, which is stable however stiff the spring is for the body's mass:
+    //   v' = v + dt (massInv (ks (goal - x - dt v') + kd (vgoal - v')) + a)
+    double ks = target.stiffness;
+    double kd = target.damping;
+    double massInv = mBody.massInv;
+
+    hduVector3Dd rhs = mBody.v + dt * (mBody.accel + massInv *
+        (ks * (goal - mBody.x) + kd * goalVelocity));
+    mBody.v = rhs / (1 + dt * massInv * (kd + dt * ks));
+    mBody.x += dt * mBody.v;
+
+    hduVector3Dd couplingForce =
+        ks * (goal - mBody.x) + kd * (goalVelocity - mBody.v);
+    mImpulseSent += dt * couplingForce;
+
+    if (target.coupleRotation)
+    {
+        hduMatrix deviceTworld = deviceTworkspace;
+        deviceTworld.multRight(target.workspaceTworld);
+        hduMatrix rotation;
+        deviceTworld.getRotationMatrix(rotation);
+
+        hduQuaternion deviceRot(rotation);
+        deviceRot.normalize();
+
+        // rotation that takes the body to the device, as a torque of
+        // sin(theta) about its axis
+        hduQuaternion delta = deviceRot * target.rotOffset *
+            mBody.q.inverse();
+        hduVector3Dd couplingTorque =
+            kAngularStiffness * (2 * delta.s()) * delta.v() -
+            kAngularDamping * mBody.omega;
+
+        mBody.omega += dt * (mBody.angularAccel +
+                             mBody.Iinv * couplingTorque);
+        hduQuaternion omegaq(0, mBody.omega);
+        mBody.q = mBody.q + (0.5 * dt) * (omegaq * mBody.q);
+        mBody.q.normalize();
+
+        mAngularImpulseSent += dt * couplingTorque;
+    }
+    else
+    {
+        mBody.omega += dt * mBody.angularAccel;
+    }
+
+    CouplingImpulse &sent = mImpulseBuffer.getWriteBuffer();
+    sent.bodyId = mBody.id;
+    sent.serial = mSerial;
+    sent.impulse = mImpulseSent;
+    sent.angularImpulse = mAngularImpulseSent;
+    mImpulseBuffer.publish();
+
+    // the device feels the opposite of the force on the body
+    hduVector3Dd forceWS;
+    target.worldTworkspace.multDirMatrix(-couplingForce, forceWS);
+    force += forceWS / (target.forceScale * target.workspaceScale);
+}
+
+/******************************************************************************
+ Servo loop thread callback.  Computes the coupling force.
+******************************************************************************/
+void HLCALLBACK VirtualCoupling::computeForceCB(HDdouble force[3],
+                                                HLcache *cache,
+                                                void *userdata)
+{
+    VirtualCoupling *pThis = static_cast<VirtualCoupling *>(userdata);
+
+    hduVector3Dd couplingForce(0, 0, 0);
+    pThis->computeForce(couplingForce);
+
+    force[0] += couplingForce[0];
+    force[1] += couplingForce[1];
+    force[2] += couplingForce[2];
+}
+
+/******************************************************************************
+ Servo loop thread callback called when the effect is started.  Waits for
+ the simulation to publish the body before coupling to it.
+******************************************************************************/
+void HLCALLBACK VirtualCoupling::startEffectCB(HLcache *cache, void *userdata)
+{
+    VirtualCoupling *pThis = static_cast<VirtualCoupling *>(userdata);
+    pThis->mHaveBody = false;
+}
+
+/******************************************************************************
+ Servo loop thread callback called when the effect is stopped.
+******************************************************************************/
+void HLCALLBACK VirtualCoupling::stopEffectCB(HLcache *cache, void *userdata)
+{
+    VirtualCoupling *pThis = static_cast<VirtualCoupling *>(userdata);
+    pThis->mHaveBody = false;
+}
+
+/*****************************************************************************/
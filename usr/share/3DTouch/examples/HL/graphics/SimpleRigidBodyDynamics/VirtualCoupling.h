@@ -0,0 +1,170 @@
+/*****************************************************************************
+
+Copyright (c) 2004 SensAble Technologies, Inc. All rights reserved.
+
+OpenHaptics(TM) toolkit. The material embodied in this software and use of
+this software is subject to the terms and conditions of the clickthrough
+Development License Agreement.
+
+For questions, comments or bug reports, go to forums at:
+    http://dsc.sensable.com
+
+Module Name:
+
+  VirtualCoupling.h
+
+Description:
+
+  Couples the haptic device to a body of the simulation at the servo loop
+  rate, while the simulation steps at its own, slower rate.
+
+*******************************************************************************/
+
+#if !defined(AFX_VIRTUALCOUPLING_H__5E2B7C91_4D3A_4F86_A0C2_8B19D6E4F735__INCLUDED_)
+#define AFX_VIRTUALCOUPLING_H__5E2B7C91_4D3A_4F86_A0C2_8B19D6E4F735__INCLUDED_
+
+#if _MSC_VER > 1000
+#pragma once
+#endif // _MSC_VER > 1000
+
+#include <HL/hl.h>
+#include <HDU/hduVector.h>
+#include <HDU/hduMatrix.h>
+#include <HDU/hduQuaternion.h>
+
+#include <HDU/hduTripleBuffer.h>
+
+class RigidBody;
+
+// What the client thread hands the servo loop once a frame.
+struct CouplingTarget
+{
+    CouplingTarget() : bodyId(HL_OBJECT_ANY) {}
+
+    HLuint bodyId;
+    hduVector3Dd offset;            // body position less device position
+    hduQuaternion rotOffset;        // device to body rotation
+    bool coupleRotation;
+
+    hduMatrix worldTworkspace;      // world to device workspace
+    hduMatrix workspaceTworld;
+    double workspaceScale;          // workspace units per world unit
+    double forceScale;              // simulation force per device newton
+    double stiffness;               // simulation force per world unit
+    double damping;                 // simulation force per world unit/s
+};
+
+// What the simulation hands the servo loop after every step: the body, the
+// acceleration everything but the coupling gave it, and the coupling
+// impulses of coupling number serial it has applied so far.
+struct CouplingBody
+{
+    CouplingBody() : id(HL_OBJECT_ANY), serial(0) {}
+
+    HLuint id;
+    unsigned int serial;
+    hduVector3Dd x;
+    hduVector3Dd v;
+    hduQuaternion q;
+    hduVector3Dd omega;
+    double massInv;
+    hduMatrix Iinv;
+
+    hduVector3Dd accel;
+    hduVector3Dd angularAccel;
+
+    hduVector3Dd impulse;
+    hduVector3Dd angularImpulse;
+};
+
+// What the servo loop hands the simulation every tick: the coupling
+// impulses on the body so far.  Running totals, so the simulation loses
+// nothing when it misses some ticks.  The totals start from zero whenever
+// the servo loop couples to a body, which bumps the serial number.
+struct CouplingImpulse
+{
+    CouplingImpulse() : bodyId(HL_OBJECT_ANY), serial(0) {}
+
+    HLuint bodyId;
+    unsigned int serial;
+    hduVector3Dd impulse;
+    hduVector3Dd angularImpulse;
+};
+
+// A spring and damper between the device and the body, rendered by a
+// callback force effect.  The effect steps a local copy of the body under
+// the coupling force and the acceleration the simulation last gave it, so
+// the coupling stays stiff and stable at the servo loop rate; each step of
+// the simulation applies the impulses the effect sent since the last one,
+// and the local copy is reset to what the simulation made of them.
+//
+// start, stop and update are for the client thread, between hlBeginFrame
+// and hlEndFrame; fetchImpulse and publishBody for the simulation thread.
+class VirtualCoupling
+{
+public:
+    VirtualCoupling();
+    virtual ~VirtualCoupling();
+
+    // Couples the device to a body at the given offsets, as of the device
+    // position and rotation in world coordinates at the start.
+    void start(HLuint bodyId, const hduVector3Dd &offset,
+               const hduQuaternion &rotOffset, bool coupleRotation,
+               double forceScale);
+    void stop(void);
+    bool isActive(void) const { return mActive; }
+
+    // Hands the current workspace mapping to the servo loop.
+    void update(void);
+
+    // Returns the impulses the servo loop sent since the last call, and the
+    // body they are for.
+    void fetchImpulse(HLuint &bodyId, hduVector3Dd &impulse,
+                      hduVector3Dd &angularImpulse);
+
+    // Publishes the body after a step, with the force and torque on it
+    // apart from the coupling.
+    void publishBody(const RigidBody &rb, const hduVector3Dd &externalForce,
+                     const hduVector3Dd &externalTorque);
+
+private:
+    HLuint mEffect;
+
+    // Client thread.
+    bool mActive;
+    CouplingTarget mTarget;
+    double mDeviceStiffness;        // newtons per workspace unit
+    double mDeviceDamping;          // newtons per workspace unit/s
+
+    // Simulation thread: the impulses of coupling mAppliedSerial applied.
+    unsigned int mAppliedSerial;
+    hduVector3Dd mImpulseApplied;
+    hduVector3Dd mAngularImpulseApplied;
+
+    // Servo loop: the local copy of the body and the impulses sent since
+    // coupling to it.
+    bool mHaveBody;
+    unsigned int mSerial;
+    CouplingBody mBody;
+    hduVector3Dd mImpulseSent;
+    hduVector3Dd mAngularImpulseSent;
+
+    hduTripleBuffer<CouplingTarget> mTargetBuffer;
+    hduTripleBuffer<CouplingBody> mBodyBuffer;
+    hduTripleBuffer<CouplingImpulse> mImpulseBuffer;
+
+    static void HLCALLBACK computeForceCB(HDdouble force[3], HLcache *cache,
+                                          void *userdata);
+    static void HLCALLBACK startEffectCB(HLcache *cache, void *userdata);
+    static void HLCALLBACK stopEffectCB(HLcache *cache, void *userdata);
+
+    void computeForce(hduVector3Dd &force);
+    void syncBody(const CouplingBody &body);
+
+    VirtualCoupling(const VirtualCoupling &);
+    VirtualCoupling &operator=(const VirtualCoupling &);
+};
+
+#endif // !defined(AFX_VIRTUALCOUPLING_H__5E2B7C91_4D3A_4F86_A0C2_8B19D6E4F735__INCLUDED_)
+
+/*****************************************************************************/
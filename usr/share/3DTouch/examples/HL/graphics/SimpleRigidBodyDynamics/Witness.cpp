@@ -245,21 +245,21 @@ void Witness::draw(void)
 }
 
 //
-// Based on the witness, create a contact object(s)
+// Based on the witness, fill in a contact.
 // Currently, we are condensing (averaging) multiple contact
-// points to a single.
+// points to a single.  Returns false if no point is in contact.
 //
 // FIXME: averaging may cause mis-interpretation
 // of collision states, such as when one vertex is colliding
 // and another is separating but the average is in resting contact
 //
-void Witness::createContacts(ContactListT &inContacts)
+bool Witness::createContact(Contact &contact)
 {
     assert(rbPri);
     assert(rbSec);
 
     // Find all points that are in contact.
-    VectorListT *vertices = rbSec->getVerticesWorld();
+    const VectorListT &vertices = *rbSec->getVerticesWorld();
     VectorListT::const_iterator vi; // Constant because not modifying list
     double dist;
     double distAccum = 0;
@@ -267,12 +267,10 @@ void Witness::createContacts(ContactListT &inContacts)
     hduVector3Dd positionAccum(0,0,0);
     hduVector3Dd positionAverage(0,0,0);
     int numPointsInContact = 0;
-    Contact *contact;
 
-    for (vi = vertices->begin(); vi != vertices->end(); ++vi)
+    for (vi = vertices.begin(); vi != vertices.end(); ++vi)
     {
-        hduVector3Dd *vert = *vi;
-        assert(vert != NULL);
+        const hduVector3Dd *vert = &*vi;
         dist = rbPri->distPlanePoint(getSeparatingPlane(), vert);
         if (dist < contactThreshold)
         {
@@ -301,22 +299,23 @@ void Witness::createContacts(ContactListT &inContacts)
 
         assert(fabs(dist - distAverage) < 0.001);
 
-        contact = new Contact();
-        contact->a = rbSec;
-        contact->b = rbPri;
-        contact->p = positionAverage;
-        contact->n = *getSeparatingPlane()->getNormal();
-        //contact->ea   // not used
-        //contact->eb   // not used
-        //contact->vf = true;
-
-        inContacts.push_back(contact);
+        contact = Contact();
+        contact.a = rbSec;
+        contact.b = rbPri;
+        contact.p = positionAverage;
+        contact.n = *getSeparatingPlane()->getNormal();
+        contact.dist = distAverage;
+        //contact.ea   // not used
+        //contact.eb   // not used
+        //contact.vf = true;
+        return true;
     }
     else
     {
-        // We should never be called to createContacts unless there is one
+        // We should never be called to createContact unless there is one
         // or more points in contact.
         assert(false);
+        return false;
     }
 }
 
@@ -34,7 +34,7 @@ Description:
 class RigidBody;
 class DynFace;
 #include "DynFreePlane.h"
-#include "ContactList.h"
+class Contact;
 
 enum ESeparationState
 {
@@ -73,7 +73,7 @@ public:
         
     void updateFromBodies(void);
     void draw(void);
-    void createContacts(ContactListT &inContacts);
+    bool createContact(Contact &contact);
         
 private:
     RigidBody *rbPri;               // body containing face (or edge of freePlane)
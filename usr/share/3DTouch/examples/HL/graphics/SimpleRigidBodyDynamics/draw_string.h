@@ -24,7 +24,7 @@ Description:
 #pragma once
 #endif // _MSC_VER > 1000
 
-void DrawBitmapString(GLfloat x, GLfloat y, void *font, char *format,...);
+void DrawBitmapString(GLfloat x, GLfloat y, void *font, const char *format,...);
 
 #endif // !defined(_DRAW_STRING_H_)
 
@@ -36,9 +36,10 @@ Description:
 #include <HL/hl.h>
 #include <HDU/hdu.h>
 #include <HDU/hduError.h>
+#include <HDU/hduSimulationRunner.h>
 #include <HLU/hlu.h>
 
-const int kMaxStepSizeMs = 33;
+const double kSimulationRate = 500; // steps per second
 
 enum 
 {  
@@ -52,6 +53,7 @@ GLint mWindH=DEFAULT_WINDOW_HEIGHT;
 char mApplicationName[] = "Simple Rigid Body Dynamics";
 
 DynamicsWorld *mWorld = 0;
+hduSimulationRunner mRunner; // advances mWorld on its own thread
 
 float mManualTimeStep = 0.033; // time to increment by when stepping manually
 bool  mPause = false; // pause the simulation
@@ -82,8 +84,7 @@ void RedrawCursor(void);
 void Reshape(int width, int height);
 void Idle(void);
 
-void AdvanceTime(double dt);
-double GetTimeChange(void);
+void StepWorld(double t, double dt, void *userData);
 
 void HandleMouseButton(int button, int state, int x, int y);
 void HandleMouseMotion(int x, int y);
@@ -103,6 +104,10 @@ int main(int argc, char **argv)
 
         // spawn the main window
     SpawnWindow();
+
+    // start the simulation; from here on mWorld is only changed inside edits
+    mRunner.setRate(kSimulationRate);
+    mRunner.start(StepWorld, NULL);
         
     /* The GLUT main loop won't return control, so we need to perform cleanup
        using an exit handler. */
@@ -158,6 +163,9 @@ void InitHL()
 *******************************************************************************/
 void exitHandler()
 {
+    // stop stepping before the world goes away
+    mRunner.stop();
+
     if (mWorld != NULL)
     {
         delete mWorld;
@@ -274,6 +282,8 @@ void CreateMenus(void)
     glutAddMenuEntry("Test Cube Mahem (7)", '7');
     glutAddMenuEntry("Test Cube Tower (8)", '8');
     glutAddMenuEntry("Test Catapult (9)", '9');
+    glutAddMenuEntry("Test Box Rain (b)", 'b');
+    glutAddMenuEntry("Test Many Stacks (s)", 's');
     glutAddMenuEntry("-", 0);
 
     glutAddMenuEntry("Toggle Draw Witnesses (w)", 'w');
@@ -292,6 +302,8 @@ void CreateMenus(void)
 /* Handle menu commands. */
 void HandleMenuCommand(int option)
 {
+    mRunner.beginEdit();
+
     switch(option)
     {
         case '0':
@@ -347,19 +359,26 @@ void HandleMenuCommand(int option)
             testEdgePlaneInvalidateCollision();
             break;
 
+        case 'b':
+            testBoxRain();
+            break;
+
+        case 's':
+            testManyStacks();
+            break;
+
         case 'w':
             mWorld->setDrawWitnesses(!mWorld->getDrawWitnesses());
             break;
 
         case 'm':
             if (mPause)
-                AdvanceTime(mManualTimeStep);
+                mRunner.advance(mManualTimeStep);
             break;
                         
         case ' ':
             mPause = !mPause;
-            if (!mPause)
-                glutPostRedisplay();
+            mRunner.setPaused(mPause);
             break;
 
         case 'q':  // quit
@@ -370,6 +389,8 @@ void HandleMenuCommand(int option)
             //printf("Invalid menu choice: %c", option);
             break;
     }
+
+    mRunner.endEdit();
 }
 
 
@@ -444,6 +465,7 @@ void HandleSpecialKeys(int key, int x, int y)
 */
 void HandleMouseButton(int button, int state, int x, int y)
 {
+    mRunner.beginEdit();
 
     if (button == GLUT_LEFT_BUTTON)
     {
@@ -458,14 +480,18 @@ void HandleMouseButton(int button, int state, int x, int y)
                 break;
         }
     }    
+
+    mRunner.endEdit();
 }
 
 // Mouse motion callback
 void  HandleMouseMotion(int x, int y)
 {
+    mRunner.beginEdit();
 
     mWorld->moveMouseSpring(x, y);
 
+    mRunner.endEdit();
 }
 
 void Display(void)
@@ -476,8 +502,26 @@ void Display(void)
     // Clear the display.
     glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
 
+    // Hand the haptic device to the simulation and pick up the bodies as of
+    // its last step.
+    mWorld->updateHapticInput();
+    if (!mWorld->fetchState())
+    {
+        hlEndFrame();
+        glutSwapBuffers();
+        return;
+    }
+
     mWorld->drawWorld();
 
+    // The debug drawing reads the simulation itself, so hold it off.
+    if (mWorld->getDrawWitnesses() || mWorld->isMouseSpringActive())
+    {
+        mRunner.beginEdit();
+        mWorld->drawDebug();
+        mRunner.endEdit();
+    }
+
     if (mWorld->getHapticMode() == DynamicsWorld::TOUCH_OBJECTS)
     {
         // Touching objects - render world haptically.
@@ -493,10 +537,9 @@ void Display(void)
 
         // Grab offsets of body transform to initial haptic device
         // transform we saved off in button down event callback.  Use these
-        // offsets in setting proxy so that we get force/torque to pull us
-        // towards offset body not actual body which would give us a big 
-        // impulse when we first grabbed the object if the haptic device and 
-        // body transforms did not match.
+        // offsets in setting proxy so that the proxy is where the device
+        // holds the body, not at the body itself, and touching resumes from
+        // there when the button is released.
         hduVector3Dd linOffset;
         hduQuaternion angOffset;
         mWorld->getHapticControlObjectOffset(linOffset, angOffset);
@@ -506,7 +549,10 @@ void Display(void)
             mWorld->getBodyPosition(mWorld->getHapticControlObject())
             - linOffset;
         hlProxydv(HL_PROXY_POSITION, offsetPos);
-        hlProxyf(HL_STIFFNESS, .3);
+
+        // The virtual coupling renders the pull of the body at the servo
+        // loop rate, so the proxy spring adds none of its own.
+        hlProxyf(HL_STIFFNESS, 0);
         hlProxyf(HL_DAMPING, 0);
         
         // Set proxy rotation to offset rotation (this doesn't do anything
@@ -544,7 +590,13 @@ void DisplayInfo(void)
     int textRowUp = 0; // Lines of text already drawn upwards from the bottom.
 
     DrawBitmapString(mWindW - 10 * 9, 20 + textRowDown++ * 15, GLUT_BITMAP_9_BY_15, "FPS: %4.1f", DetermineFPS());
-    //DrawBitmapString(5, 20 + (textRowDown-1) * 15, GLUT_BITMAP_9_BY_15, "Objects: %d", mWorld->getNumBodies());
+    DrawBitmapString(5, 20 + (textRowDown-1) * 15, GLUT_BITMAP_9_BY_15, "Objects: %d", mWorld->getNumBodies());
+    DrawBitmapString(5, 20 + textRowDown++ * 15, GLUT_BITMAP_9_BY_15, "Close pairs: %d", mWorld->getNumPairs());
+    DrawBitmapString(5, 20 + textRowDown++ * 15, GLUT_BITMAP_9_BY_15, "Contacts: %d", mWorld->getNumContacts());
+    DrawBitmapString(5, 20 + textRowDown++ * 15, GLUT_BITMAP_9_BY_15, "Islands: %d", mWorld->getNumIslands());
+    DrawBitmapString(5, 20 + textRowDown++ * 15, GLUT_BITMAP_9_BY_15, "Asleep: %d", mWorld->getNumAsleep());
+    DrawBitmapString(5, 20 + textRowDown++ * 15, GLUT_BITMAP_9_BY_15, "Steps/sec: %.1f", mRunner.getStepRate());
+    DrawBitmapString(5, 20 + textRowDown++ * 15, GLUT_BITMAP_9_BY_15, "Overruns: %lu", mRunner.getOverruns());
 
     glMatrixMode(GL_PROJECTION);
     glPopMatrix();
@@ -721,45 +773,13 @@ void UpdateHapticMapping(void)
 
 void Idle(void)
 {
-    if (!mPause)
-        AdvanceTime(GetTimeChange());
-    else
-        glutPostRedisplay();
-}
-
-double GetTimeChange(void)
-{
-    unsigned int    timeMs;
-    unsigned int    timeSinceLastMs;
-    static unsigned int timeOldMs = 0;
-        
-    timeMs = glutGet(GLUT_ELAPSED_TIME);
-
-    timeSinceLastMs = timeMs - timeOldMs;
-
-    timeOldMs = timeMs;
-        
-    if (timeSinceLastMs > kMaxStepSizeMs)
-    {
-        timeSinceLastMs = kMaxStepSizeMs;
-    }
-    else if (timeSinceLastMs < 1)
-    {
-        timeSinceLastMs = 1;
-    }
-
-    return timeSinceLastMs/ 1000.;
+    // the world is stepped on its own thread; just keep the frames coming
+    glutPostRedisplay();
 }
 
-void AdvanceTime(double dt)
+void StepWorld(double t, double dt, void *userData)
 {
-    static double prevTime = 0;
-    double currTime = prevTime + dt;
-        
-    mWorld->advanceSimulation(prevTime, currTime);
-    prevTime = currTime;
-
-    glutPostRedisplay();
+    mWorld->advanceSimulation(t, t + dt);
 }
 
 /******************************************************************************/
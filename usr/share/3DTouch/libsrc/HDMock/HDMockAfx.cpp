@@ -8,23 +8,15 @@ Development License Agreement.
 
 For questions, comments or bug reports, go to forums at: 
     http://dsc.sensable.com
-
+ 
 Module Name:
 
-  StatsSampler.cpp
+  HDMockAfx.cpp
 
-Description:
+Description: 
 
-  Manages statistics.
+  Precompiled header
 
 *******************************************************************************/
 
-#include <StatsSampler.h>
-
-template class StatsSampler<double>;
-template class StatsSampler<float>;
-
-template std::ostream& operator<<(std::ostream&, const StatsSampler<float>&);
-template std::ostream& operator<<(std::ostream&, const StatsSampler<double>&);
-
-/******************************************************************************/
+#include "HDMockAfx.h"
@@ -8,23 +8,21 @@ Development License Agreement.
 
 For questions, comments or bug reports, go to forums at: 
     http://dsc.sensable.com
-
+ 
 Module Name:
 
-  StatsSampler.cpp
+    HDMockAfx.h
 
 Description: 
 
-  Manages statistics.
+    Precompiled header
 
 *******************************************************************************/
 
-#include <StatsSampler.h>
+#ifdef WIN32
 
-template class StatsSampler<double>;
-template class StatsSampler<float>;
+// truncating variables, e.g. double to float
+#pragma warning( disable: 4244 )
 
-template std::ostream& operator<<(std::ostream&, const StatsSampler<float>&);
-template std::ostream& operator<<(std::ostream&, const StatsSampler<double>&);
+#endif // WIN32
 
-/******************************************************************************/
@@ -0,0 +1,580 @@
+/*****************************************************************************
+
+Copyright (c) 2004 SensAble Technologies, Inc. All rights reserved.
+
+OpenHaptics(TM) toolkit. The material embodied in this software and use of
+this software is subject to the terms and conditions of the clickthrough
+Development License Agreement.
+
+For questions, comments or bug reports, go to forums at:
+    http://dsc.sensable.com
+
+Module Name:
+
+  hdMockBenchmark.cpp
+
+Description:
+
+  Headless benchmark of the servo loop paths in HDU, run against HDMock.
+  Usage: hdMockBenchmark [seconds per test]
+
+******************************************************************************/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <math.h>
+#include <unistd.h>
+
+#include <HD/hd.h>
+#include <HDU/hduError.h>
+#include <HDU/hduRecord.h>
+#include <HDU/hduHapticDevice.h>
+#include <HDU/hduMatrix.h>
+#include <HDU/hduTransformInterpolator.h>
+#include <HDU/hduDeviceGroup.h>
+#include <HDMock/hdMock.h>
+
+namespace
+{
+
+/* Graphics thread rate used by the IHapticDevice tests. */
+const int kGraphicsRate = 60;
+
+HHD ghHD = HD_INVALID_HANDLE;
+
+/* Every simulated device, ghHD first, for the device group tests. */
+HHD ghHDs[HD_MOCK_MAX_DEVICES];
+int gnDevices = 0;
+
+/*******************************************************************************
+ Moves the device around a 50 mm circle once a second, pressing button 1
+ every other revolution so that events are generated.
+*******************************************************************************/
+void HDCALLBACK circleTrajectory(HDdouble time, HDdouble position[3],
+                                 HDint *pButtons, void *pUserData)
+{
+    const HDdouble kRadius = 50.0;
+    HDdouble angle = 2.0 * M_PI * time;
+    position[0] = kRadius * cos(angle);
+    position[1] = kRadius * sin(angle);
+    position[2] = 0;
+    *pButtons = ((int) time % 2) ? HD_DEVICE_BUTTON_1 : 0;
+}
+
+HDdouble getTime()
+{
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return now.tv_sec + now.tv_nsec * 1e-9;
+}
+
+void printSchedulerStats(const char *pName)
+{
+    HDMockSchedulerStats stats;
+    hdMockGetSchedulerStats(&stats);
+
+    printf("%-28s %8lu ticks %6lu overruns  "
+           "tick mean %6.2f us max %7.2f us  "
+           "latency mean %6.2f us max %7.2f us\n",
+           pName, (unsigned long) stats.nTicks, (unsigned long) stats.nOverruns,
+           stats.meanTickDuration * 1e6, stats.maxTickDuration * 1e6,
+           stats.meanStartLatency * 1e6, stats.maxStartLatency * 1e6);
+}
+
+/*******************************************************************************
+ Scheduler baseline: one callback that only reads the position.
+*******************************************************************************/
+HDCallbackCode HDCALLBACK readPositionCallback(void *pUserData)
+{
+    hdBeginFrame(hdGetCurrentDevice());
+    HDdouble position[3];
+    hdGetDoublev(HD_CURRENT_POSITION, position);
+    hdEndFrame(hdGetCurrentDevice());
+    return HD_CALLBACK_CONTINUE;
+}
+
+void benchmarkScheduler(double seconds)
+{
+    hdMockResetSchedulerStats();
+    HDSchedulerHandle hHandle = hdScheduleAsynchronous(
+        readPositionCallback, 0, HD_DEFAULT_SCHEDULER_PRIORITY);
+    usleep((useconds_t) (seconds * 1e6));
+    hdUnschedule(hHandle);
+    printSchedulerStats("scheduler baseline");
+}
+
+/*******************************************************************************
+ IHapticDevice: the servo loop updates the haptic thread instance every
+ tick, and a 60 Hz graphics loop synchronizes the graphics thread instance
+ with it.  Reports the graphics side cost of beginUpdate, which is where the
+ two sync modes differ.
+*******************************************************************************/
+HDCallbackCode HDCALLBACK hapticDeviceCallback(void *pUserData)
+{
+    IHapticDevice *pHapticDeviceHT = static_cast<IHapticDevice *>(pUserData);
+
+    hdBeginFrame(hdGetCurrentDevice());
+    pHapticDeviceHT->beginUpdate(0);
+    pHapticDeviceHT->endUpdate(0);
+    hdEndFrame(hdGetCurrentDevice());
+
+    return HD_CALLBACK_CONTINUE;
+}
+
+void HDCALLBACK countEventCallback(IHapticDevice::EventType event,
+                                   const IHapticDevice::IHapticDeviceState * const pState,
+                                   void *pUserData)
+{
+    (*static_cast<int *>(pUserData))++;
+}
+
+void benchmarkHapticDevice(const char *pName,
+                           IHapticDevice::SyncMode eSyncMode,
+                           double seconds)
+{
+    IHapticDevice *pHapticDeviceHT = IHapticDevice::create(
+        IHapticDevice::HAPTIC_THREAD_INTERFACE, ghHD, eSyncMode);
+    IHapticDevice *pHapticDeviceGT = IHapticDevice::create(
+        IHapticDevice::GRAPHIC_THREAD_INTERFACE, ghHD, eSyncMode);
+
+    int nEvents = 0;
+    pHapticDeviceGT->setCallback(IHapticDevice::BUTTON_1_DOWN,
+                                 countEventCallback, &nEvents);
+
+    hdMockResetSchedulerStats();
+    HDSchedulerHandle hHandle = hdScheduleAsynchronous(
+        hapticDeviceCallback, pHapticDeviceHT, HD_DEFAULT_SCHEDULER_PRIORITY);
+
+    int nFrames = (int) (seconds * kGraphicsRate);
+    double totalUpdate = 0;
+    double maxUpdate = 0;
+    for (int i = 0; i < nFrames; i++)
+    {
+        double start = getTime();
+        pHapticDeviceGT->beginUpdate(pHapticDeviceHT);
+        pHapticDeviceGT->endUpdate(pHapticDeviceHT);
+        double duration = getTime() - start;
+
+        totalUpdate += duration;
+        if (duration > maxUpdate)
+        {
+            maxUpdate = duration;
+        }
+
+        usleep(1000000 / kGraphicsRate);
+    }
+
+    hdUnschedule(hHandle);
+    printSchedulerStats(pName);
+    printf("%-28s beginUpdate mean %7.2f us max %8.2f us, "
+           "%d button events, %lu dropped\n", "",
+           totalUpdate / nFrames * 1e6, maxUpdate * 1e6, nEvents,
+           (unsigned long) pHapticDeviceGT->getEventOverflowCount());
+
+    IHapticDevice::destroy(pHapticDeviceGT);
+    IHapticDevice::destroy(pHapticDeviceHT);
+}
+
+/*******************************************************************************
+ Streaming recorder: servo loop cost of recording every tick to a file.
+*******************************************************************************/
+void benchmarkStreamingRecord(double seconds)
+{
+    FILE *pFile = tmpfile();
+    if (!pFile)
+    {
+        perror("tmpfile");
+        return;
+    }
+
+    hdMockResetSchedulerStats();
+    HDURecordHandle hRecord = hduStartStreamingRecord(pFile, 0);
+    usleep((useconds_t) (seconds * 1e6));
+    HDulong nDropped = hduGetRecordDropCount(hRecord);
+    hduStopRecord(hRecord);
+    printSchedulerStats("streaming record");
+
+    long nBytes = ftell(pFile);
+    printf("%-28s %ld packets written, %lu dropped\n", "",
+           (nBytes - (long) sizeof(HDURecordFileHeader)) /
+           (long) sizeof(HDURecordPacket),
+           (unsigned long) nDropped);
+    fclose(pFile);
+}
+
+/*******************************************************************************
+ Transform handoff: a 60 Hz graphics loop hands the servo loop a pose that
+ moves around a 100 mm circle and turns once every two seconds, either
+ with hdScheduleSynchronous as the examples did, or through
+ hduTransformInterpolator.  Reports how far the pose the servo loop uses
+ jumps in one tick and how far it is from the true pose at the tick, and
+ what the handoff costs each side.
+*******************************************************************************/
+hduMatrix movingPose(double time)
+{
+    const double kRadius = 100.0;
+    double angle = M_PI * time;
+    hduMatrix pose = hduMatrix::createRotationAroundZ(angle);
+    pose.multRight(hduMatrix::createTranslation(
+        kRadius * cos(angle), kRadius * sin(angle), 0));
+    return pose;
+}
+
+struct TransformHandoff
+{
+    hduTransformInterpolator *pInterpolator;
+    hduMatrix pose;             /* set by the synchronous handoff */
+    bool bValid;
+
+    long nTicks;
+    double totalSample;
+    hduVector3Dd lastPosition;
+    double maxStep;
+    double totalError;
+    double maxError;
+};
+
+HDCallbackCode HDCALLBACK setPoseCallback(void *pUserData)
+{
+    TransformHandoff *pHandoff = static_cast<TransformHandoff *>(pUserData);
+    pHandoff->pose = movingPose(getTime() - hdGetSchedulerTimeStamp());
+    pHandoff->bValid = true;
+    return HD_CALLBACK_DONE;
+}
+
+HDCallbackCode HDCALLBACK samplePoseCallback(void *pUserData)
+{
+    TransformHandoff *pHandoff = static_cast<TransformHandoff *>(pUserData);
+    double tickStart = getTime() - hdGetSchedulerTimeStamp();
+
+    if (pHandoff->pInterpolator)
+    {
+        double start = getTime();
+        pHandoff->bValid = pHandoff->pInterpolator->sample(pHandoff->pose);
+        pHandoff->totalSample += getTime() - start;
+    }
+    if (!pHandoff->bValid)
+    {
+        return HD_CALLBACK_CONTINUE;
+    }
+
+    /* The point the pose puts the origin at. */
+    hduVector3Dd position;
+    pHandoff->pose.multVecMatrix(hduVector3Dd(0, 0, 0), position);
+
+    hduVector3Dd truePosition;
+    movingPose(tickStart).multVecMatrix(hduVector3Dd(0, 0, 0), truePosition);
+    double error = (position - truePosition).magnitude();
+
+    if (pHandoff->nTicks > 0)
+    {
+        double step = (position - pHandoff->lastPosition).magnitude();
+        if (step > pHandoff->maxStep)
+        {
+            pHandoff->maxStep = step;
+        }
+    }
+    pHandoff->lastPosition = position;
+    pHandoff->totalError += error;
+    if (error > pHandoff->maxError)
+    {
+        pHandoff->maxError = error;
+    }
+    pHandoff->nTicks++;
+
+    return HD_CALLBACK_CONTINUE;
+}
+
+void benchmarkTransformHandoff(const char *pName,
+                               hduTransformInterpolator *pInterpolator,
+                               double seconds)
+{
+    TransformHandoff handoff;
+    handoff.pInterpolator = pInterpolator;
+    handoff.bValid = false;
+    handoff.nTicks = 0;
+    handoff.totalSample = 0;
+    handoff.maxStep = 0;
+    handoff.totalError = 0;
+    handoff.maxError = 0;
+
+    hdMockResetSchedulerStats();
+    HDSchedulerHandle hHandle = hdScheduleAsynchronous(
+        samplePoseCallback, &handoff, HD_DEFAULT_SCHEDULER_PRIORITY);
+
+    int nFrames = (int) (seconds * kGraphicsRate);
+    double totalHandoff = 0;
+    double maxHandoff = 0;
+    for (int i = 0; i < nFrames; i++)
+    {
+        double start = getTime();
+        if (pInterpolator)
+        {
+            pInterpolator->push(start, movingPose(start));
+        }
+        else
+        {
+            hdScheduleSynchronous(setPoseCallback, &handoff,
+                                  HD_DEFAULT_SCHEDULER_PRIORITY);
+        }
+        double duration = getTime() - start;
+
+        totalHandoff += duration;
+        if (duration > maxHandoff)
+        {
+            maxHandoff = duration;
+        }
+
+        usleep(1000000 / kGraphicsRate);
+    }
+
+    hdUnschedule(hHandle);
+    printSchedulerStats(pName);
+
+    long nTicks = handoff.nTicks > 0 ? handoff.nTicks : 1;
+    printf("%-28s step max %6.3f mm  error mean %6.3f mm max %6.3f mm\n"
+           "%-28s handoff mean %7.2f us max %8.2f us, "
+           "sample mean %5.3f us\n", "",
+           handoff.maxStep, handoff.totalError / nTicks, handoff.maxError,
+           "", totalHandoff / nFrames * 1e6, maxHandoff * 1e6,
+           handoff.totalSample / nTicks * 1e6);
+}
+
+/*******************************************************************************
+ Device state of every device for a 60 Hz graphics loop, either with one
+ hdScheduleSynchronous per device as the dual device examples did, or
+ from the snapshot of an hduDeviceGroup.  All devices follow the same
+ trajectory, so the spread of their positions within a frame shows how
+ far apart the ticks they were read in are.
+*******************************************************************************/
+struct DeviceStateQuery
+{
+    HHD hHD;
+    hduVector3Dd position;
+    HDint buttons;
+};
+
+HDCallbackCode HDCALLBACK deviceStateCallback(void *pUserData)
+{
+    DeviceStateQuery *pQuery = static_cast<DeviceStateQuery *>(pUserData);
+
+    hdBeginFrame(pQuery->hHD);
+    hdGetDoublev(HD_CURRENT_POSITION, pQuery->position);
+    hdGetIntegerv(HD_CURRENT_BUTTONS, &pQuery->buttons);
+    hdEndFrame(pQuery->hHD);
+
+    return HD_CALLBACK_DONE;
+}
+
+void benchmarkDeviceState(const char *pName, bool bGroup, double seconds)
+{
+    hduDeviceGroup group;
+    if (bGroup)
+    {
+        for (int i = 0; i < gnDevices; i++)
+        {
+            group.addDevice(ghHDs[i]);
+        }
+    }
+
+    hdMockResetSchedulerStats();
+    if (bGroup)
+    {
+        group.start();
+    }
+
+    int nFrames = (int) (seconds * kGraphicsRate);
+    int nSampled = 0;
+    double totalQuery = 0;
+    double maxQuery = 0;
+    double totalSpread = 0;
+    double maxSpread = 0;
+    for (int i = 0; i < nFrames; i++)
+    {
+        DeviceStateQuery queries[HD_MOCK_MAX_DEVICES];
+
+        double start = getTime();
+        if (bGroup)
+        {
+            group.update();
+            const hduDeviceGroup::Snapshot &snapshot = group.getSnapshot();
+            for (int j = 0; j < snapshot.nDevices; j++)
+            {
+                queries[j].position = snapshot.devices[j].position;
+                queries[j].buttons = snapshot.devices[j].buttons;
+            }
+        }
+        else
+        {
+            for (int j = 0; j < gnDevices; j++)
+            {
+                queries[j].hHD = ghHDs[j];
+                hdScheduleSynchronous(deviceStateCallback, &queries[j],
+                                      HD_DEFAULT_SCHEDULER_PRIORITY);
+            }
+        }
+        double duration = getTime() - start;
+
+        totalQuery += duration;
+        if (duration > maxQuery)
+        {
+            maxQuery = duration;
+        }
+
+        if (!bGroup || group.getSnapshot().nDevices == gnDevices)
+        {
+            double spread = 0;
+            for (int j = 1; j < gnDevices; j++)
+            {
+                double distance =
+                    (queries[j].position - queries[0].position).magnitude();
+                if (distance > spread)
+                {
+                    spread = distance;
+                }
+            }
+            totalSpread += spread;
+            if (spread > maxSpread)
+            {
+                maxSpread = spread;
+            }
+            nSampled++;
+        }
+
+        usleep(1000000 / kGraphicsRate);
+    }
+
+    group.stop();
+    printSchedulerStats(pName);
+
+    printf("%-28s %d devices  query mean %7.2f us max %8.2f us  "
+           "spread mean %6.3f mm max %6.3f mm\n", "", gnDevices,
+           totalQuery / nFrames * 1e6, maxQuery * 1e6,
+           totalSpread / (nSampled > 0 ? nSampled : 1), maxSpread);
+}
+
+/* Sampling at the time of each pushed pose, with no delay, gives it back. */
+void checkTransformInterpolator()
+{
+    hduTransformInterpolator interpolator;
+    interpolator.setDelay(0);
+
+    hduMatrix scale = hduMatrix::createScale(2, 2, 0.5);
+    double maxError = 0;
+    for (int i = 0; i < 20; i++)
+    {
+        double time = i / (double) kGraphicsRate;
+        hduMatrix pose = scale;
+        pose.multRight(movingPose(time));
+        interpolator.push(time, pose);
+
+        for (int j = i > 3 ? i - 3 : 0; j <= i; j++)
+        {
+            double keyTime = j / (double) kGraphicsRate;
+            hduMatrix expected = scale;
+            expected.multRight(movingPose(keyTime));
+
+            hduMatrix sampled;
+            interpolator.sample(keyTime, sampled);
+            for (int r = 0; r < 4; r++)
+            {
+                for (int c = 0; c < 4; c++)
+                {
+                    double error = fabs(sampled(r, c) - expected(r, c));
+                    if (error > maxError)
+                    {
+                        maxError = error;
+                    }
+                }
+            }
+        }
+    }
+
+    printf("%-28s pushed poses error %.2g  %s\n", "transform interpolator",
+           maxError, maxError < 1e-9 ? "ok" : "MISMATCH");
+}
+
+} /* anonymous namespace */
+
+/*******************************************************************************
+ main
+*******************************************************************************/
+int main(int argc, char *argv[])
+{
+    double seconds = argc > 1 ? atof(argv[1]) : 2.0;
+    if (seconds <= 0)
+    {
+        fprintf(stderr, "Usage: %s [seconds per test]\n", argv[0]);
+        return -1;
+    }
+
+    HDErrorInfo error;
+    ghHD = hdInitDevice(HD_DEFAULT_DEVICE);
+    if (HD_DEVICE_ERROR(error = hdGetError()))
+    {
+        hduPrintError(stderr, &error, "Failed to initialize haptic device");
+        return -1;
+    }
+
+    /* The rest of the devices follow ghHD for the device group tests. */
+    ghHDs[gnDevices++] = ghHD;
+    while (gnDevices < HD_MOCK_MAX_DEVICES)
+    {
+        ghHDs[gnDevices] = hdInitDevice(HD_DEFAULT_DEVICE);
+        if (HD_DEVICE_ERROR(error = hdGetError()))
+        {
+            hduPrintError(stderr, &error, "Failed to initialize haptic device");
+            return -1;
+        }
+        hdMockSetTrajectoryCallback(ghHDs[gnDevices++], circleTrajectory, 0);
+    }
+    hdMakeCurrentDevice(ghHD);
+
+    hdMockSetTrajectoryCallback(ghHD, circleTrajectory, 0);
+    hdStartScheduler();
+    if (HD_DEVICE_ERROR(error = hdGetError()))
+    {
+        hduPrintError(stderr, &error, "Failed to start the scheduler");
+        return -1;
+    }
+
+    benchmarkScheduler(seconds);
+    benchmarkHapticDevice("IHapticDevice scheduler",
+                          IHapticDevice::SYNC_SCHEDULER, seconds);
+    benchmarkHapticDevice("IHapticDevice triple buffer",
+                          IHapticDevice::SYNC_TRIPLE_BUFFER, seconds);
+    benchmarkStreamingRecord(seconds);
+
+    checkTransformInterpolator();
+    benchmarkTransformHandoff("transform synchronous", 0, seconds);
+    {
+        hduTransformInterpolator interpolator;
+        interpolator.setDelay(0);
+        benchmarkTransformHandoff("transform hold", &interpolator, seconds);
+    }
+    {
+        hduTransformInterpolator interpolator;
+        benchmarkTransformHandoff("transform interpolate", &interpolator,
+                                  seconds);
+    }
+    {
+        hduTransformInterpolator interpolator;
+        interpolator.setDelay(0);
+        interpolator.setMaxExtrapolation(2.0 / kGraphicsRate);
+        benchmarkTransformHandoff("transform extrapolate", &interpolator,
+                                  seconds);
+    }
+
+    benchmarkDeviceState("device state synchronous", false, seconds);
+    benchmarkDeviceState("device group", true, seconds);
+
+    hdStopScheduler();
+    for (int i = 0; i < gnDevices; i++)
+    {
+        hdDisableDevice(ghHDs[i]);
+    }
+
+    return 0;
+}
+
+/******************************************************************************/
@@ -0,0 +1,766 @@
+/*****************************************************************************
+
+Copyright (c) 2004 SensAble Technologies, Inc. All rights reserved.
+
+OpenHaptics(TM) toolkit. The material embodied in this software and use of
+this software is subject to the terms and conditions of the clickthrough
+Development License Agreement.
+
+For questions, comments or bug reports, go to forums at:
+    http://dsc.sensable.com
+
+Module Name:
+
+  hdMockDevice.cpp
+
+Description:
+
+  Simulated haptic devices implementing the hdDevice.h entry points.  The
+  device position is driven by a scripted trajectory or a recording, and
+  forces sent to the device are only stored so they can be queried back.
+
+******************************************************************************/
+
+#include "HDMockAfx.h"
+
+#include <string.h>
+#include <pthread.h>
+
+#include <vector>
+
+#include <HD/hd.h>
+#include <HDU/hduRecord.h>
+#include <HDMock/hdMock.h>
+
+#include "hdMockInternal.h"
+
+namespace
+{
+
+/* Depth of the error stack, errors beyond this are discarded. */
+const int kMaxErrors = 16;
+
+/* Most values returned by hdGet fit in a 4x4 matrix. */
+const int kMaxParamValues = 16;
+
+/* Capabilities that can be enabled and disabled, from HD_FORCE_OUTPUT
+   through HD_ONE_FRAME_LIMIT. */
+const int kNumCapabilities = 5;
+
+struct MockDevice
+{
+    bool bInitialized;
+    int nFrameDepth;
+
+    HDdouble position[3];
+    HDdouble lastPosition[3];
+    HDdouble velocity[3];
+    HDdouble lastVelocity[3];
+    HDdouble transform[16];
+    HDdouble lastTransform[16];
+    HDint buttons;
+    HDint lastButtons;
+
+    HDdouble force[3];
+    HDdouble lastForce[3];
+    HDdouble jointTorque[3];
+    HDdouble gimbalTorque[3];
+    HDint statusLight;
+
+    HDboolean capabilities[kNumCapabilities];
+
+    /* Trajectory source. */
+    HDMockTrajectoryCallback pTrajectoryCallback;
+    void *pTrajectoryUserData;
+    std::vector<HDURecordPacket> recording;
+    size_t nRecordingIndex;
+    bool bLoopRecording;
+};
+
+MockDevice gDevices[HD_MOCK_MAX_DEVICES];
+HHD gCurrentDevice = HD_INVALID_HANDLE;
+
+/* Devices are set up by the application thread while the scheduler thread
+   reads them, so configuration changes are made under this lock. */
+pthread_mutex_t gDeviceLock = PTHREAD_MUTEX_INITIALIZER;
+
+HDErrorInfo gErrors[kMaxErrors];
+int gNumErrors = 0;
+pthread_mutex_t gErrorLock = PTHREAD_MUTEX_INITIALIZER;
+
+/******************************************************************************
+ Helpers
+******************************************************************************/
+bool isValidDevice(HHD hHD)
+{
+    return hHD < HD_MOCK_MAX_DEVICES && gDevices[hHD].bInitialized;
+}
+
+MockDevice *getCurrentDevice()
+{
+    if (!isValidDevice(gCurrentDevice))
+    {
+        hdMockSetError(HD_BAD_HANDLE);
+        return 0;
+    }
+    return &gDevices[gCurrentDevice];
+}
+
+void copy3(HDdouble *dst, const HDdouble *src)
+{
+    dst[0] = src[0];
+    dst[1] = src[1];
+    dst[2] = src[2];
+}
+
+/* Column-major transform with identity rotation, translated to position. */
+void makeTransform(HDdouble *xform, const HDdouble *position)
+{
+    memset(xform, 0, 16 * sizeof(HDdouble));
+    xform[0] = xform[5] = xform[10] = xform[15] = 1.0;
+    xform[12] = position[0];
+    xform[13] = position[1];
+    xform[14] = position[2];
+}
+
+void resetDevice(MockDevice &device)
+{
+    device.nFrameDepth = 0;
+    memset(device.position, 0, sizeof(device.position));
+    memset(device.lastPosition, 0, sizeof(device.lastPosition));
+    memset(device.velocity, 0, sizeof(device.velocity));
+    memset(device.lastVelocity, 0, sizeof(device.lastVelocity));
+    makeTransform(device.transform, device.position);
+    makeTransform(device.lastTransform, device.position);
+    device.buttons = 0;
+    device.lastButtons = 0;
+    memset(device.force, 0, sizeof(device.force));
+    memset(device.lastForce, 0, sizeof(device.lastForce));
+    memset(device.jointTorque, 0, sizeof(device.jointTorque));
+    memset(device.gimbalTorque, 0, sizeof(device.gimbalTorque));
+    device.statusLight = LED_STATUS_SOLID_GRN;
+    memset(device.capabilities, 0, sizeof(device.capabilities));
+    device.capabilities[HD_FORCE_OUTPUT - HD_FORCE_OUTPUT] = HD_TRUE;
+    device.capabilities[HD_MAX_FORCE_CLAMPING - HD_FORCE_OUTPUT] = HD_TRUE;
+    device.capabilities[HD_SOFTWARE_FORCE_LIMIT - HD_FORCE_OUTPUT] = HD_TRUE;
+    device.pTrajectoryCallback = 0;
+    device.pTrajectoryUserData = 0;
+    device.recording.clear();
+    device.nRecordingIndex = 0;
+    device.bLoopRecording = false;
+}
+
+/******************************************************************************
+ Reads a parameter of the current device as doubles.  Returns the number of
+ values, or 0 if the parameter is not supported.
+******************************************************************************/
+int getParameter(HDenum pname, HDdouble *values)
+{
+    MockDevice *pDevice = getCurrentDevice();
+    if (!pDevice)
+    {
+        return 0;
+    }
+
+    switch (pname)
+    {
+        case HD_CURRENT_BUTTONS:
+            values[0] = pDevice->buttons;
+            return 1;
+        case HD_LAST_BUTTONS:
+            values[0] = pDevice->lastButtons;
+            return 1;
+        case HD_CURRENT_SAFETY_SWITCH:
+        case HD_LAST_SAFETY_SWITCH:
+            values[0] = 1;
+            return 1;
+        case HD_CURRENT_INKWELL_SWITCH:
+        case HD_LAST_INKWELL_SWITCH:
+            values[0] = 0;
+            return 1;
+
+        case HD_CURRENT_POSITION:
+            copy3(values, pDevice->position);
+            return 3;
+        case HD_LAST_POSITION:
+            copy3(values, pDevice->lastPosition);
+            return 3;
+        case HD_CURRENT_VELOCITY:
+            copy3(values, pDevice->velocity);
+            return 3;
+        case HD_LAST_VELOCITY:
+            copy3(values, pDevice->lastVelocity);
+            return 3;
+        case HD_CURRENT_TRANSFORM:
+            memcpy(values, pDevice->transform, 16 * sizeof(HDdouble));
+            return 16;
+        case HD_LAST_TRANSFORM:
+            memcpy(values, pDevice->lastTransform, 16 * sizeof(HDdouble));
+            return 16;
+        case HD_CURRENT_ANGULAR_VELOCITY:
+        case HD_LAST_ANGULAR_VELOCITY:
+        case HD_CURRENT_JOINT_ANGLES:
+        case HD_LAST_JOINT_ANGLES:
+        case HD_CURRENT_GIMBAL_ANGLES:
+        case HD_LAST_GIMBAL_ANGLES:
+            memset(values, 0, 3 * sizeof(HDdouble));
+            return 3;
+        case HD_CURRENT_ENCODER_VALUES:
+        case HD_LAST_ENCODER_VALUES:
+            memset(values, 0, 6 * sizeof(HDdouble));
+            return 6;
+
+        case HD_CURRENT_FORCE:
+            copy3(values, pDevice->force);
+            return 3;
+        case HD_LAST_FORCE:
+            copy3(values, pDevice->lastForce);
+            return 3;
+        case HD_CURRENT_JOINT_TORQUE:
+        case HD_LAST_JOINT_TORQUE:
+            copy3(values, pDevice->jointTorque);
+            return 3;
+        case HD_CURRENT_GIMBAL_TORQUE:
+        case HD_LAST_GIMBAL_TORQUE:
+            copy3(values, pDevice->gimbalTorque);
+            return 3;
+
+        case HD_MAX_WORKSPACE_DIMENSIONS:
+            values[0] = -210; values[1] = -110; values[2] = -85;
+            values[3] = 210; values[4] = 205; values[5] = 130;
+            return 6;
+        case HD_USABLE_WORKSPACE_DIMENSIONS:
+            values[0] = -80; values[1] = -60; values[2] = -35;
+            values[3] = 80; values[4] = 60; values[5] = 35;
+            return 6;
+        case HD_TABLETOP_OFFSET:
+            values[0] = -110;
+            return 1;
+        case HD_INPUT_DOF:
+            values[0] = 6;
+            return 1;
+        case HD_OUTPUT_DOF:
+            values[0] = 3;
+            return 1;
+        case HD_CALIBRATION_STYLE:
+            values[0] = HD_CALIBRATION_INKWELL;
+            return 1;
+
+        case HD_UPDATE_RATE:
+            values[0] = (HDdouble) hdMockGetSchedulerRate();
+            return 1;
+        case HD_INSTANTANEOUS_UPDATE_RATE:
+            values[0] = hdMockGetInstantaneousRate();
+            return 1;
+        case HD_NOMINAL_MAX_STIFFNESS:
+            values[0] = 0.5;
+            return 1;
+        case HD_NOMINAL_MAX_DAMPING:
+            values[0] = 0.005;
+            return 1;
+        case HD_NOMINAL_MAX_FORCE:
+            values[0] = 3.3;
+            return 1;
+        case HD_NOMINAL_MAX_CONTINUOUS_FORCE:
+            values[0] = 0.88;
+            return 1;
+        case HD_MOTOR_TEMPERATURE:
+            memset(values, 0, 6 * sizeof(HDdouble));
+            return 6;
+        case HD_DEVICE_FIRMWARE_VERSION:
+            values[0] = 0;
+            return 1;
+        case HD_USER_STATUS_LIGHT:
+            values[0] = pDevice->statusLight;
+            return 1;
+
+        default:
+            hdMockSetError(HD_INVALID_ENUM);
+            return 0;
+    }
+}
+
+/******************************************************************************
+ Writes a parameter of the current device from doubles.
+******************************************************************************/
+void setParameter(HDenum pname, const HDdouble *values)
+{
+    MockDevice *pDevice = getCurrentDevice();
+    if (!pDevice)
+    {
+        return;
+    }
+
+    switch (pname)
+    {
+        case HD_CURRENT_FORCE:
+            copy3(pDevice->force, values);
+            break;
+        case HD_CURRENT_JOINT_TORQUE:
+            copy3(pDevice->jointTorque, values);
+            break;
+        case HD_CURRENT_GIMBAL_TORQUE:
+            copy3(pDevice->gimbalTorque, values);
+            break;
+        case HD_USER_STATUS_LIGHT:
+            pDevice->statusLight = (HDint) values[0];
+            break;
+        case HD_SOFTWARE_VELOCITY_LIMIT:
+        case HD_SOFTWARE_FORCE_IMPULSE_LIMIT:
+        case HD_FORCE_RAMPING_RATE:
+        case HD_CURRENT_MOTOR_DAC_VALUES:
+            /* Accepted, nothing to simulate. */
+            break;
+        default:
+            hdMockSetError(HD_INVALID_ENUM);
+            break;
+    }
+}
+
+/* Number of values hdSet reads for a parameter. */
+int getSetParameterCount(HDenum pname)
+{
+    switch (pname)
+    {
+        case HD_CURRENT_FORCE:
+        case HD_CURRENT_JOINT_TORQUE:
+        case HD_CURRENT_GIMBAL_TORQUE:
+        case HD_CURRENT_MOTOR_DAC_VALUES:
+            return 3;
+        default:
+            return 1;
+    }
+}
+
+template <class T>
+void getParameterAs(HDenum pname, T *params)
+{
+    HDdouble values[kMaxParamValues];
+    int nValues = getParameter(pname, values);
+    for (int i = 0; i < nValues; i++)
+    {
+        params[i] = (T) values[i];
+    }
+}
+
+template <class T>
+void setParameterFrom(HDenum pname, const T *params)
+{
+    HDdouble values[kMaxParamValues];
+    int nValues = getSetParameterCount(pname);
+    for (int i = 0; i < nValues; i++)
+    {
+        values[i] = (HDdouble) params[i];
+    }
+    setParameter(pname, values);
+}
+
+bool isValidCapability(HDenum cap)
+{
+    return cap >= HD_FORCE_OUTPUT && cap < HD_FORCE_OUTPUT + kNumCapabilities;
+}
+
+/******************************************************************************
+ Advances one device by one tick.
+******************************************************************************/
+void updateDevice(MockDevice &device, HDdouble time, HDdouble timeStep)
+{
+    copy3(device.lastPosition, device.position);
+    copy3(device.lastVelocity, device.velocity);
+    memcpy(device.lastTransform, device.transform, 16 * sizeof(HDdouble));
+    device.lastButtons = device.buttons;
+    copy3(device.lastForce, device.force);
+
+    /* Forces are only held for the frame they were commanded in. */
+    memset(device.force, 0, sizeof(device.force));
+
+    if (!device.recording.empty())
+    {
+        const HDURecordPacket &packet =
+            device.recording[device.nRecordingIndex];
+        copy3(device.position, packet.position);
+        copy3(device.velocity, packet.velocity);
+
+        if (device.nRecordingIndex + 1 < device.recording.size())
+        {
+            device.nRecordingIndex++;
+        }
+        else if (device.bLoopRecording)
+        {
+            device.nRecordingIndex = 0;
+        }
+    }
+    else if (device.pTrajectoryCallback)
+    {
+        device.pTrajectoryCallback(time, device.position, &device.buttons,
+                                   device.pTrajectoryUserData);
+        for (int i = 0; i < 3; i++)
+        {
+            device.velocity[i] = timeStep > 0 ?
+                (device.position[i] - device.lastPosition[i]) / timeStep : 0;
+        }
+    }
+    else
+    {
+        memset(device.velocity, 0, sizeof(device.velocity));
+    }
+
+    makeTransform(device.transform, device.position);
+}
+
+} /* anonymous namespace */
+
+/******************************************************************************
+ Internal interface
+******************************************************************************/
+void hdMockSetError(HDerror errorCode)
+{
+    pthread_mutex_lock(&gErrorLock);
+    if (gNumErrors < kMaxErrors)
+    {
+        HDErrorInfo &error = gErrors[gNumErrors++];
+        error.errorCode = errorCode;
+        error.internalErrorCode = 0;
+        error.hHD = gCurrentDevice;
+    }
+    pthread_mutex_unlock(&gErrorLock);
+}
+
+void hdMockUpdateDevices(HDdouble time, HDdouble timeStep)
+{
+    pthread_mutex_lock(&gDeviceLock);
+    for (int i = 0; i < HD_MOCK_MAX_DEVICES; i++)
+    {
+        if (gDevices[i].bInitialized)
+        {
+            updateDevice(gDevices[i], time, timeStep);
+        }
+    }
+    pthread_mutex_unlock(&gDeviceLock);
+}
+
+/******************************************************************************
+ Device management
+******************************************************************************/
+HDAPI HHD HDAPIENTRY hdInitDevice(HDstring pConfigName)
+{
+    pthread_mutex_lock(&gDeviceLock);
+    for (HHD hHD = 0; hHD < HD_MOCK_MAX_DEVICES; hHD++)
+    {
+        if (!gDevices[hHD].bInitialized)
+        {
+            resetDevice(gDevices[hHD]);
+            gDevices[hHD].bInitialized = true;
+            gCurrentDevice = hHD;
+            pthread_mutex_unlock(&gDeviceLock);
+            return hHD;
+        }
+    }
+    pthread_mutex_unlock(&gDeviceLock);
+
+    hdMockSetError(HD_DEVICE_FAULT);
+    return HD_INVALID_HANDLE;
+}
+
+HDAPI void HDAPIENTRY hdMakeCurrentDevice(HHD hHD)
+{
+    if (!isValidDevice(hHD))
+    {
+        hdMockSetError(HD_BAD_HANDLE);
+        return;
+    }
+    gCurrentDevice = hHD;
+}
+
+HDAPI void HDAPIENTRY hdDisableDevice(HHD hHD)
+{
+    if (!isValidDevice(hHD))
+    {
+        hdMockSetError(HD_BAD_HANDLE);
+        return;
+    }
+    pthread_mutex_lock(&gDeviceLock);
+    resetDevice(gDevices[hHD]);
+    gDevices[hHD].bInitialized = false;
+    if (gCurrentDevice == hHD)
+    {
+        gCurrentDevice = HD_INVALID_HANDLE;
+    }
+    pthread_mutex_unlock(&gDeviceLock);
+}
+
+HDAPI HHD HDAPIENTRY hdGetCurrentDevice()
+{
+    return gCurrentDevice;
+}
+
+/******************************************************************************
+ Frames.  Device state is sampled by the scheduler at the start of each tick,
+ so begin only makes the device current.  The outermost end commits forces.
+******************************************************************************/
+HDAPI void HDAPIENTRY hdBeginFrame(HHD hHD)
+{
+    if (!isValidDevice(hHD))
+    {
+        hdMockSetError(HD_BAD_HANDLE);
+        return;
+    }
+    gCurrentDevice = hHD;
+    gDevices[hHD].nFrameDepth++;
+}
+
+HDAPI void HDAPIENTRY hdEndFrame(HHD hHD)
+{
+    if (!isValidDevice(hHD))
+    {
+        hdMockSetError(HD_BAD_HANDLE);
+        return;
+    }
+    if (gDevices[hHD].nFrameDepth <= 0)
+    {
+        hdMockSetError(HD_ILLEGAL_END);
+        return;
+    }
+    gDevices[hHD].nFrameDepth--;
+}
+
+/******************************************************************************
+ Errors
+******************************************************************************/
+HDAPI HDErrorInfo HDAPIENTRY hdGetError()
+{
+    HDErrorInfo error;
+    error.errorCode = HD_SUCCESS;
+    error.internalErrorCode = 0;
+    error.hHD = gCurrentDevice;
+
+    pthread_mutex_lock(&gErrorLock);
+    if (gNumErrors > 0)
+    {
+        error = gErrors[--gNumErrors];
+    }
+    pthread_mutex_unlock(&gErrorLock);
+
+    return error;
+}
+
+HDAPI HDstring HDAPIENTRY hdGetErrorString(HDerror errorCode)
+{
+    switch (errorCode)
+    {
+        case HD_SUCCESS: return "No error";
+        case HD_INVALID_ENUM: return "Invalid enumeration";
+        case HD_INVALID_VALUE: return "Invalid value";
+        case HD_INVALID_OPERATION: return "Invalid operation";
+        case HD_BAD_HANDLE: return "Invalid device handle";
+        case HD_ILLEGAL_BEGIN: return "Illegal begin frame";
+        case HD_ILLEGAL_END: return "Illegal end frame";
+        case HD_DEVICE_FAULT: return "Device fault";
+        case HD_SCHEDULER_FULL: return "Scheduler full";
+        default: return "Unknown error";
+    }
+}
+
+/******************************************************************************
+ Capabilities
+******************************************************************************/
+HDAPI void HDAPIENTRY hdEnable(HDenum cap)
+{
+    MockDevice *pDevice = getCurrentDevice();
+    if (!pDevice) return;
+    if (!isValidCapability(cap))
+    {
+        hdMockSetError(HD_INVALID_ENUM);
+        return;
+    }
+    pDevice->capabilities[cap - HD_FORCE_OUTPUT] = HD_TRUE;
+}
+
+HDAPI void HDAPIENTRY hdDisable(HDenum cap)
+{
+    MockDevice *pDevice = getCurrentDevice();
+    if (!pDevice) return;
+    if (!isValidCapability(cap))
+    {
+        hdMockSetError(HD_INVALID_ENUM);
+        return;
+    }
+    pDevice->capabilities[cap - HD_FORCE_OUTPUT] = HD_FALSE;
+}
+
+HDAPI HDboolean HDAPIENTRY hdIsEnabled(HDenum cap)
+{
+    MockDevice *pDevice = getCurrentDevice();
+    if (!pDevice) return HD_FALSE;
+    if (!isValidCapability(cap))
+    {
+        hdMockSetError(HD_INVALID_ENUM);
+        return HD_FALSE;
+    }
+    return pDevice->capabilities[cap - HD_FORCE_OUTPUT];
+}
+
+/******************************************************************************
+ Parameter queries
+******************************************************************************/
+HDAPI void HDAPIENTRY hdGetBooleanv(HDenum pname, HDboolean *params)
+{
+    getParameterAs(pname, params);
+}
+
+HDAPI void HDAPIENTRY hdGetIntegerv(HDenum pname, HDint *params)
+{
+    getParameterAs(pname, params);
+}
+
+HDAPI void HDAPIENTRY hdGetFloatv(HDenum pname, HDfloat *params)
+{
+    getParameterAs(pname, params);
+}
+
+HDAPI void HDAPIENTRY hdGetDoublev(HDenum pname, HDdouble *params)
+{
+    getParameterAs(pname, params);
+}
+
+HDAPI void HDAPIENTRY hdGetLongv(HDenum pname, HDlong *params)
+{
+    getParameterAs(pname, params);
+}
+
+HDAPI HDstring HDAPIENTRY hdGetString(HDenum pname)
+{
+    switch (pname)
+    {
+        case HD_VERSION: return "3.00.66";
+        case HD_DEVICE_MODEL_TYPE: return "HDMock";
+        case HD_DEVICE_DRIVER_VERSION: return "HDMock";
+        case HD_DEVICE_VENDOR: return "HDMock";
+        case HD_DEVICE_SERIAL_NUMBER: return "00000000000";
+        default:
+            hdMockSetError(HD_INVALID_ENUM);
+            return "";
+    }
+}
+
+HDAPI void HDAPIENTRY hdSetBooleanv(HDenum pname, const HDboolean *params)
+{
+    setParameterFrom(pname, params);
+}
+
+HDAPI void HDAPIENTRY hdSetIntegerv(HDenum pname, const HDint *params)
+{
+    setParameterFrom(pname, params);
+}
+
+HDAPI void HDAPIENTRY hdSetFloatv(HDenum pname, const HDfloat *params)
+{
+    setParameterFrom(pname, params);
+}
+
+HDAPI void HDAPIENTRY hdSetDoublev(HDenum pname, const HDdouble *params)
+{
+    setParameterFrom(pname, params);
+}
+
+HDAPI void HDAPIENTRY hdSetLongv(HDenum pname, const HDlong *params)
+{
+    setParameterFrom(pname, params);
+}
+
+/******************************************************************************
+ Calibration and licensing.  Simulated devices are always calibrated.
+******************************************************************************/
+HDAPI HDenum HDAPIENTRY hdCheckCalibration()
+{
+    return HD_CALIBRATION_OK;
+}
+
+HDAPI HDenum HDAPIENTRY hdCheckCalibrationStyle()
+{
+    return HD_CALIBRATION_INKWELL;
+}
+
+HDAPI void HDAPIENTRY hdUpdateCalibrationMessage(HDenum style)
+{
+}
+
+HDAPI void HDAPIENTRY hdUpdateCalibration(HDenum style)
+{
+}
+
+HDAPI void HDAPIENTRY hdScaleGimbalAngles(HDdouble scaleX, HDdouble scaleY,
+                                          HDdouble scaleZ, HDdouble nT[16])
+{
+    /* The simulated gimbal never rotates. */
+    HDdouble origin[3] = { 0, 0, 0 };
+    makeTransform(nT, origin);
+}
+
+HDAPI HDboolean HDAPIENTRY hdDeploymentLicense(const char* vendorName,
+                                               const char* applicationName,
+                                               const char* password)
+{
+    return HD_TRUE;
+}
+
+/******************************************************************************
+ Trajectory sources
+******************************************************************************/
+void hdMockSetTrajectoryCallback(HHD hHD,
+                                 HDMockTrajectoryCallback pCallback,
+                                 void *pUserData)
+{
+    if (!isValidDevice(hHD))
+    {
+        hdMockSetError(HD_BAD_HANDLE);
+        return;
+    }
+    pthread_mutex_lock(&gDeviceLock);
+    gDevices[hHD].recording.clear();
+    gDevices[hHD].pTrajectoryCallback = pCallback;
+    gDevices[hHD].pTrajectoryUserData = pUserData;
+    pthread_mutex_unlock(&gDeviceLock);
+}
+
+HDboolean hdMockLoadRecording(HHD hHD, FILE *file, HDboolean bLoop)
+{
+    if (!isValidDevice(hHD) || !file)
+    {
+        hdMockSetError(HD_INVALID_VALUE);
+        return HD_FALSE;
+    }
+
+    HDURecordFileHeader header;
+    if (fread(&header, sizeof(header), 1, file) != 1 ||
+        header.magic != HDU_RECORD_FILE_MAGIC ||
+        header.version != HDU_RECORD_FILE_VERSION ||
+        header.headerSize != sizeof(HDURecordFileHeader) ||
+        header.packetSize != sizeof(HDURecordPacket))
+    {
+        hdMockSetError(HD_INVALID_VALUE);
+        return HD_FALSE;
+    }
+
+    std::vector<HDURecordPacket> recording;
+    HDURecordPacket packet;
+    while (fread(&packet, sizeof(packet), 1, file) == 1)
+    {
+        recording.push_back(packet);
+    }
+    if (recording.empty())
+    {
+        hdMockSetError(HD_INVALID_VALUE);
+        return HD_FALSE;
+    }
+
+    pthread_mutex_lock(&gDeviceLock);
+    gDevices[hHD].recording.swap(recording);
+    gDevices[hHD].nRecordingIndex = 0;
+    gDevices[hHD].bLoopRecording = bLoop != HD_FALSE;
+    pthread_mutex_unlock(&gDeviceLock);
+
+    return HD_TRUE;
+}
+
+/******************************************************************************/
@@ -0,0 +1,43 @@
+/*****************************************************************************
+
+Copyright (c) 2004 SensAble Technologies, Inc. All rights reserved.
+
+OpenHaptics(TM) toolkit. The material embodied in this software and use of
+this software is subject to the terms and conditions of the clickthrough
+Development License Agreement.
+
+For questions, comments or bug reports, go to forums at: 
+    http://dsc.sensable.com
+
+Module Name:
+
+  hdMockInternal.h
+
+Description: 
+
+  Routines shared between the simulated devices and the simulated scheduler.
+
+******************************************************************************/
+
+#ifndef hdMockInternal_H_
+#define hdMockInternal_H_
+
+#include <HD/hdDefines.h>
+
+/* Monotonic time in seconds. */
+HDdouble hdMockGetTime();
+
+/* Pushes an error onto the error stack of the current device. */
+void hdMockSetError(HDerror errorCode);
+
+/* Advances all initialized devices by one scheduler tick.  Called by the
+   scheduler thread at the start of each tick. */
+void hdMockUpdateDevices(HDdouble time, HDdouble timeStep);
+
+/* Scheduler rates, used to answer device queries. */
+HDulong hdMockGetSchedulerRate();
+HDdouble hdMockGetInstantaneousRate();
+
+#endif /* hdMockInternal_H_ */
+
+/******************************************************************************/
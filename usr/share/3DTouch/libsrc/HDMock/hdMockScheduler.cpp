@@ -0,0 +1,511 @@
+/*****************************************************************************
+
+Copyright (c) 2004 SensAble Technologies, Inc. All rights reserved.
+
+OpenHaptics(TM) toolkit. The material embodied in this software and use of
+this software is subject to the terms and conditions of the clickthrough
+Development License Agreement.
+
+For questions, comments or bug reports, go to forums at:
+    http://dsc.sensable.com
+
+Module Name:
+
+  hdMockScheduler.cpp
+
+Description:
+
+  Software servo loop implementing the hdScheduler.h entry points.  A
+  dedicated thread wakes up at the scheduler rate on absolute deadlines,
+  advances the simulated devices and runs the scheduled callbacks in
+  priority order.
+
+******************************************************************************/
+
+#include "HDMockAfx.h"
+
+#include <string.h>
+#include <time.h>
+#include <errno.h>
+#include <pthread.h>
+#include <sched.h>
+
+#include <HD/hd.h>
+#include <HDMock/hdMock.h>
+
+#include "hdMockInternal.h"
+
+namespace
+{
+
+/* Maximum number of callbacks that can be scheduled at once. */
+const int kMaxCallbacks = 64;
+
+const HDulong kDefaultSchedulerRate = 1000;
+const HDulong kMinSchedulerRate = 100;
+const HDulong kMaxSchedulerRate = 10000;
+
+struct CallbackEntry
+{
+    HDSchedulerHandle hHandle;  /* 0 if the slot is free. */
+    HDSchedulerCallback pCallback;
+    void *pUserData;
+    HDushort nPriority;
+    bool bSynchronous;
+};
+
+CallbackEntry gCallbacks[kMaxCallbacks];
+HDSchedulerHandle gNextHandle = 1;
+
+/* Guards the callback table.  Recursive so that callbacks may schedule and
+   unschedule other callbacks.  gCompletion is signaled whenever a callback
+   finishes. */
+pthread_mutex_t gLock;
+pthread_cond_t gCompletion;
+pthread_once_t gInitOnce = PTHREAD_ONCE_INIT;
+
+pthread_t gThread;
+volatile bool gbRunning = false;
+volatile bool gbStopRequested = false;
+
+HDulong gSchedulerRate = kDefaultSchedulerRate;
+HDdouble gStartTime = 0;
+HDdouble gTickStartTime = 0;
+HDdouble gInstantaneousRate = 0;
+
+HDMockSchedulerStats gStats;
+HDdouble gTotalTickDuration = 0;
+HDdouble gTotalStartLatency = 0;
+pthread_mutex_t gStatsLock = PTHREAD_MUTEX_INITIALIZER;
+
+/******************************************************************************
+ Helpers
+******************************************************************************/
+void initLock()
+{
+    pthread_mutexattr_t attr;
+    pthread_mutexattr_init(&attr);
+    pthread_mutexattr_settype(&attr, PTHREAD_MUTEX_RECURSIVE);
+    pthread_mutex_init(&gLock, &attr);
+    pthread_mutexattr_destroy(&attr);
+
+    pthread_cond_init(&gCompletion, 0);
+}
+
+void lock()
+{
+    pthread_once(&gInitOnce, initLock);
+    pthread_mutex_lock(&gLock);
+}
+
+void unlock()
+{
+    pthread_mutex_unlock(&gLock);
+}
+
+bool isSchedulerThread()
+{
+    return gbRunning && pthread_equal(pthread_self(), gThread);
+}
+
+CallbackEntry *findCallback(HDSchedulerHandle hHandle)
+{
+    if (hHandle == 0)
+    {
+        return 0;
+    }
+    for (int i = 0; i < kMaxCallbacks; i++)
+    {
+        if (gCallbacks[i].hHandle == hHandle)
+        {
+            return &gCallbacks[i];
+        }
+    }
+    return 0;
+}
+
+/* Must be called with the lock held. */
+HDSchedulerHandle addCallback(HDSchedulerCallback pCallback,
+                              void *pUserData,
+                              HDushort nPriority,
+                              bool bSynchronous)
+{
+    for (int i = 0; i < kMaxCallbacks; i++)
+    {
+        if (gCallbacks[i].hHandle == 0)
+        {
+            CallbackEntry &entry = gCallbacks[i];
+            entry.hHandle = gNextHandle++;
+            if (gNextHandle == 0)
+            {
+                gNextHandle = 1;
+            }
+            entry.pCallback = pCallback;
+            entry.pUserData = pUserData;
+            entry.nPriority = nPriority;
+            entry.bSynchronous = bSynchronous;
+            return entry.hHandle;
+        }
+    }
+
+    hdMockSetError(HD_SCHEDULER_FULL);
+    return 0;
+}
+
+void addTime(struct timespec &t, long nanoseconds)
+{
+    t.tv_nsec += nanoseconds;
+    while (t.tv_nsec >= 1000000000L)
+    {
+        t.tv_nsec -= 1000000000L;
+        t.tv_sec++;
+    }
+}
+
+HDdouble toSeconds(const struct timespec &t)
+{
+    return t.tv_sec + t.tv_nsec * 1e-9;
+}
+
+/******************************************************************************
+ Runs all scheduled callbacks once, highest priority first.  The set of
+ callbacks to run is fixed at the start of the tick, so callbacks scheduled
+ from within a callback first run on the next tick.
+******************************************************************************/
+void runCallbacks()
+{
+    HDSchedulerHandle handles[kMaxCallbacks];
+    HDushort priorities[kMaxCallbacks];
+    int nHandles = 0;
+
+    lock();
+
+    for (int i = 0; i < kMaxCallbacks; i++)
+    {
+        if (gCallbacks[i].hHandle == 0)
+        {
+            continue;
+        }
+
+        /* Insertion sort, stable for equal priorities. */
+        int j = nHandles++;
+        while (j > 0 && priorities[j - 1] < gCallbacks[i].nPriority)
+        {
+            handles[j] = handles[j - 1];
+            priorities[j] = priorities[j - 1];
+            j--;
+        }
+        handles[j] = gCallbacks[i].hHandle;
+        priorities[j] = gCallbacks[i].nPriority;
+    }
+
+    bool bCompleted = false;
+    for (int i = 0; i < nHandles; i++)
+    {
+        /* An earlier callback may have unscheduled this one. */
+        CallbackEntry *pEntry = findCallback(handles[i]);
+        if (!pEntry)
+        {
+            continue;
+        }
+
+        HDCallbackCode code = pEntry->pCallback(pEntry->pUserData);
+
+        pEntry = findCallback(handles[i]);
+        if (pEntry && (code == HD_CALLBACK_DONE || pEntry->bSynchronous))
+        {
+            pEntry->hHandle = 0;
+            bCompleted = true;
+        }
+    }
+
+    if (bCompleted)
+    {
+        pthread_cond_broadcast(&gCompletion);
+    }
+
+    unlock();
+}
+
+void updateStats(HDdouble tickDuration, HDdouble startLatency,
+                 HDdouble period)
+{
+    pthread_mutex_lock(&gStatsLock);
+
+    gStats.nTicks++;
+    if (tickDuration > period)
+    {
+        gStats.nOverruns++;
+    }
+
+    gTotalTickDuration += tickDuration;
+    gTotalStartLatency += startLatency;
+    gStats.meanTickDuration = gTotalTickDuration / gStats.nTicks;
+    gStats.meanStartLatency = gTotalStartLatency / gStats.nTicks;
+    if (tickDuration > gStats.maxTickDuration)
+    {
+        gStats.maxTickDuration = tickDuration;
+    }
+    if (startLatency > gStats.maxStartLatency)
+    {
+        gStats.maxStartLatency = startLatency;
+    }
+
+    pthread_mutex_unlock(&gStatsLock);
+}
+
+/******************************************************************************
+ Scheduler thread.
+******************************************************************************/
+void *schedulerThread(void *pUserData)
+{
+    struct timespec deadline;
+    clock_gettime(CLOCK_MONOTONIC, &deadline);
+
+    gStartTime = toSeconds(deadline);
+    HDdouble lastTickStart = gStartTime;
+
+    while (!gbStopRequested)
+    {
+        HDulong nRate = gSchedulerRate;
+        long nPeriod = 1000000000L / nRate;
+        HDdouble period = 1.0 / nRate;
+
+        HDdouble nominalStart = toSeconds(deadline);
+        HDdouble tickStart = hdMockGetTime();
+        gTickStartTime = tickStart;
+        gInstantaneousRate = tickStart > lastTickStart ?
+            1.0 / (tickStart - lastTickStart) : (HDdouble) nRate;
+
+        hdMockUpdateDevices(tickStart - gStartTime, tickStart - lastTickStart);
+        runCallbacks();
+
+        HDdouble tickEnd = hdMockGetTime();
+        updateStats(tickEnd - tickStart, tickStart - nominalStart, period);
+        lastTickStart = tickStart;
+
+        addTime(deadline, nPeriod);
+
+        /* If a whole period was missed, restart the schedule from now rather
+           than running a burst of back to back ticks to catch up. */
+        if (tickEnd > toSeconds(deadline) + period)
+        {
+            clock_gettime(CLOCK_MONOTONIC, &deadline);
+        }
+
+        while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME,
+                               &deadline, 0) == EINTR)
+        {
+        }
+    }
+
+    return 0;
+}
+
+} /* anonymous namespace */
+
+/******************************************************************************
+ Internal interface
+******************************************************************************/
+HDdouble hdMockGetTime()
+{
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return toSeconds(now);
+}
+
+HDulong hdMockGetSchedulerRate()
+{
+    return gSchedulerRate;
+}
+
+HDdouble hdMockGetInstantaneousRate()
+{
+    return gbRunning ? gInstantaneousRate : 0;
+}
+
+/******************************************************************************
+ Scheduler control
+******************************************************************************/
+HDAPI void HDAPIENTRY hdStartScheduler()
+{
+    if (gbRunning)
+    {
+        return;
+    }
+
+    pthread_once(&gInitOnce, initLock);
+    gbStopRequested = false;
+
+    pthread_attr_t attr;
+    pthread_attr_init(&attr);
+
+    /* Ask for real-time priority, as the real servo loop gets.  This needs
+       privileges, so fall back to normal scheduling if it is refused. */
+    struct sched_param param;
+    param.sched_priority = sched_get_priority_max(SCHED_FIFO);
+    pthread_attr_setinheritsched(&attr, PTHREAD_EXPLICIT_SCHED);
+    pthread_attr_setschedpolicy(&attr, SCHED_FIFO);
+    pthread_attr_setschedparam(&attr, &param);
+
+    int result = pthread_create(&gThread, &attr, schedulerThread, 0);
+    if (result == EPERM)
+    {
+        result = pthread_create(&gThread, 0, schedulerThread, 0);
+    }
+    pthread_attr_destroy(&attr);
+
+    if (result != 0)
+    {
+        hdMockSetError(HD_DEVICE_FAULT);
+        return;
+    }
+
+    gbRunning = true;
+}
+
+HDAPI void HDAPIENTRY hdStopScheduler()
+{
+    if (!gbRunning || isSchedulerThread())
+    {
+        return;
+    }
+
+    gbStopRequested = true;
+    pthread_join(gThread, 0);
+    gbRunning = false;
+
+    /* Release anyone still waiting on callbacks that will now never run. */
+    lock();
+    memset(gCallbacks, 0, sizeof(gCallbacks));
+    pthread_cond_broadcast(&gCompletion);
+    unlock();
+}
+
+HDAPI void HDAPIENTRY hdSetSchedulerRate(HDulong nRate)
+{
+    if (nRate < kMinSchedulerRate || nRate > kMaxSchedulerRate)
+    {
+        hdMockSetError(HD_INVALID_VALUE);
+        return;
+    }
+    gSchedulerRate = nRate;
+}
+
+/******************************************************************************
+ Scheduling.  A synchronous call made from the scheduler thread, or while
+ the scheduler is stopped, runs the callback immediately in the calling
+ thread.
+******************************************************************************/
+HDAPI void HDAPIENTRY hdScheduleSynchronous(HDSchedulerCallback pCallback,
+                                            void *pUserData,
+                                            HDushort nPriority)
+{
+    if (!pCallback)
+    {
+        hdMockSetError(HD_INVALID_VALUE);
+        return;
+    }
+
+    if (!gbRunning || isSchedulerThread())
+    {
+        lock();
+        pCallback(pUserData);
+        unlock();
+        return;
+    }
+
+    lock();
+    HDSchedulerHandle hHandle =
+        addCallback(pCallback, pUserData, nPriority, true);
+    while (hHandle != 0 && findCallback(hHandle))
+    {
+        pthread_cond_wait(&gCompletion, &gLock);
+    }
+    unlock();
+}
+
+HDAPI HDSchedulerHandle HDAPIENTRY hdScheduleAsynchronous(
+                                            HDSchedulerCallback pCallback,
+                                            void *pUserData,
+                                            HDushort nPriority)
+{
+    if (!pCallback)
+    {
+        hdMockSetError(HD_INVALID_VALUE);
+        return 0;
+    }
+
+    lock();
+    HDSchedulerHandle hHandle =
+        addCallback(pCallback, pUserData, nPriority, false);
+    unlock();
+
+    return hHandle;
+}
+
+HDAPI void HDAPIENTRY hdUnschedule(HDSchedulerHandle hHandle)
+{
+    lock();
+    CallbackEntry *pEntry = findCallback(hHandle);
+    if (pEntry)
+    {
+        pEntry->hHandle = 0;
+        pthread_cond_broadcast(&gCompletion);
+    }
+    else
+    {
+        hdMockSetError(HD_INVALID_VALUE);
+    }
+    unlock();
+}
+
+HDAPI HDboolean HDAPIENTRY hdWaitForCompletion(HDSchedulerHandle hHandle,
+                                               HDWaitCode param)
+{
+    lock();
+
+    bool bScheduled = findCallback(hHandle) != 0;
+    if (param == HD_WAIT_INFINITE && !isSchedulerThread())
+    {
+        while (gbRunning && findCallback(hHandle))
+        {
+            pthread_cond_wait(&gCompletion, &gLock);
+        }
+        bScheduled = findCallback(hHandle) != 0;
+    }
+
+    unlock();
+
+    return bScheduled ? HD_TRUE : HD_FALSE;
+}
+
+HDAPI HDdouble HDAPIENTRY hdGetSchedulerTimeStamp()
+{
+    if (!gbRunning)
+    {
+        return 0;
+    }
+    return hdMockGetTime() - gTickStartTime;
+}
+
+/******************************************************************************
+ Statistics
+******************************************************************************/
+void hdMockGetSchedulerStats(HDMockSchedulerStats *pStats)
+{
+    pthread_mutex_lock(&gStatsLock);
+    *pStats = gStats;
+    pthread_mutex_unlock(&gStatsLock);
+}
+
+void hdMockResetSchedulerStats()
+{
+    pthread_mutex_lock(&gStatsLock);
+    memset(&gStats, 0, sizeof(gStats));
+    gTotalTickDuration = 0;
+    gTotalStartLatency = 0;
+    pthread_mutex_unlock(&gStatsLock);
+}
+
+/******************************************************************************/
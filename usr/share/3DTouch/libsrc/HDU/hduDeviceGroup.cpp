@@ -0,0 +1,262 @@
+/*****************************************************************************
+
+Copyright (c) 2004 SensAble Technologies, Inc. All rights reserved.
+
+OpenHaptics(TM) toolkit. The material embodied in this software and use of
+this software is subject to the terms and conditions of the clickthrough
+Development License Agreement.
+
+For questions, comments or bug reports, go to forums at:
+    http://dsc.sensable.com
+
+Module Name:
+
+  hduDeviceGroup.cpp
+
+Description:
+
+  Reads the state of several haptic devices in one servo loop callback and
+  hands it to the graphics thread as one snapshot.
+
+******************************************************************************/
+
+#include "hduAfx.h"
+
+#include <HDU/hduDeviceGroup.h>
+#include <HDU/hduError.h>
+
+/*******************************************************************************
+ hduDeviceGroup
+*******************************************************************************/
+hduDeviceGroup::hduDeviceGroup() :
+    m_nDevices(0),
+    m_pForceCallback(0),
+    m_pForceUserData(0),
+    m_hBeginCallback(HD_INVALID_HANDLE),
+    m_hEndCallback(HD_INVALID_HANDLE),
+    m_tick(0),
+    m_bSchedulerError(false),
+    m_bFramesBegun(false),
+    m_bForcesPublished(false)
+{
+    m_error.errorCode = HD_SUCCESS;
+}
+
+hduDeviceGroup::~hduDeviceGroup()
+{
+    stop();
+}
+
+int hduDeviceGroup::addDevice(HHD hHD)
+{
+    if (m_nDevices == kMaxDevices || m_hBeginCallback != HD_INVALID_HANDLE)
+    {
+        return -1;
+    }
+    m_hHDs[m_nDevices] = hHD;
+    return m_nDevices++;
+}
+
+void hduDeviceGroup::setForceCallback(ForceCallback pCallback,
+                                      void *pUserData)
+{
+    m_pForceCallback = pCallback;
+    m_pForceUserData = pUserData;
+}
+
+/*******************************************************************************
+ On failure the callbacks are no longer scheduled, so this thread takes over
+ the writer side of the snapshot buffer to hand the reason to the reader.
+*******************************************************************************/
+bool hduDeviceGroup::start()
+{
+    if (m_hBeginCallback != HD_INVALID_HANDLE)
+    {
+        return false;
+    }
+
+    m_tick = 0;
+    m_error.errorCode = HD_SUCCESS;
+    m_bSchedulerError = false;
+    m_bFramesBegun = false;
+
+    m_hBeginCallback = hdScheduleAsynchronous(
+        beginCallback, this, HD_MAX_SCHEDULER_PRIORITY);
+    m_hEndCallback = hdScheduleAsynchronous(
+        endCallback, this, HD_MIN_SCHEDULER_PRIORITY);
+    if (isRunning())
+    {
+        return true;
+    }
+
+    stop();
+
+    HDErrorInfo error = hdGetError();
+    if (HD_DEVICE_ERROR(error))
+    {
+        m_error = error;
+    }
+
+    Snapshot &snapshot = m_buffer.getWriteBuffer();
+    snapshot.nDevices = 0;
+    snapshot.tick = 0;
+    snapshot.error = m_error;
+    m_buffer.publish();
+    return false;
+}
+
+/*******************************************************************************
+ The begin callback is unscheduled first.  The end callback only ends the
+ frames that beginFrames began, so a tick run between the two is harmless.
+ A callback that gave up is no longer scheduled.
+*******************************************************************************/
+void hduDeviceGroup::stop()
+{
+    HDSchedulerHandle *pHandles[2] = { &m_hBeginCallback, &m_hEndCallback };
+    for (int i = 0; i < 2; i++)
+    {
+        HDSchedulerHandle &hCallback = *pHandles[i];
+        if (hCallback == HD_INVALID_HANDLE)
+        {
+            continue;
+        }
+        if (hdWaitForCompletion(hCallback, HD_WAIT_CHECK_STATUS))
+        {
+            hdUnschedule(hCallback);
+        }
+        hCallback = HD_INVALID_HANDLE;
+    }
+}
+
+bool hduDeviceGroup::isRunning() const
+{
+    return m_hBeginCallback != HD_INVALID_HANDLE &&
+        m_hEndCallback != HD_INVALID_HANDLE &&
+        hdWaitForCompletion(m_hBeginCallback, HD_WAIT_CHECK_STATUS) &&
+        hdWaitForCompletion(m_hEndCallback, HD_WAIT_CHECK_STATUS);
+}
+
+bool hduDeviceGroup::update()
+{
+    return m_buffer.update();
+}
+
+void hduDeviceGroup::setForce(int i, const hduVector3Dd &force)
+{
+    m_forces[i] = force;
+}
+
+void hduDeviceGroup::publishForces()
+{
+    Forces &forces = m_forceBuffer.getWriteBuffer();
+    for (int i = 0; i < m_nDevices; i++)
+    {
+        forces.forces[i] = m_forces[i];
+    }
+    m_forceBuffer.publish();
+}
+
+HDCallbackCode HDCALLBACK hduDeviceGroup::beginCallback(void *pUserData)
+{
+    return static_cast<hduDeviceGroup *>(pUserData)->beginFrames();
+}
+
+HDCallbackCode HDCALLBACK hduDeviceGroup::endCallback(void *pUserData)
+{
+    return static_cast<hduDeviceGroup *>(pUserData)->endFrames();
+}
+
+/*******************************************************************************
+ Runs first in the tick.  Begins a frame on every device before any force
+ is set, so that the force callback sees the state of all the devices in
+ this tick.
+*******************************************************************************/
+HDCallbackCode hduDeviceGroup::beginFrames()
+{
+    Snapshot &snapshot = m_buffer.getWriteBuffer();
+    snapshot.nDevices = m_nDevices;
+    snapshot.tick = m_tick++;
+
+    for (int i = 0; i < m_nDevices; i++)
+    {
+        DeviceState &state = snapshot.devices[i];
+
+        /* Makes the device current. */
+        hdBeginFrame(m_hHDs[i]);
+        hdGetDoublev(HD_CURRENT_POSITION, state.position);
+        hdGetDoublev(HD_CURRENT_VELOCITY, state.velocity);
+        hdGetDoublev(HD_CURRENT_TRANSFORM, state.transform);
+        hdGetIntegerv(HD_CURRENT_BUTTONS, &state.buttons);
+    }
+    m_bFramesBegun = true;
+
+    popErrors();
+
+    return m_bSchedulerError ? HD_CALLBACK_DONE : HD_CALLBACK_CONTINUE;
+}
+
+/*******************************************************************************
+ Runs last in the tick.  Sets the forces, ends the frames begun by
+ beginFrames and publishes the snapshot.
+*******************************************************************************/
+HDCallbackCode hduDeviceGroup::endFrames()
+{
+    if (!m_bFramesBegun)
+    {
+        return m_bSchedulerError ? HD_CALLBACK_DONE : HD_CALLBACK_CONTINUE;
+    }
+    m_bFramesBegun = false;
+
+    Snapshot &snapshot = m_buffer.getWriteBuffer();
+
+    if (m_forceBuffer.update())
+    {
+        m_bForcesPublished = true;
+    }
+    const Forces &published = m_forceBuffer.getReadBuffer();
+
+    hduVector3Dd forces[kMaxDevices];
+    for (int i = 0; i < m_nDevices; i++)
+    {
+        forces[i] = published.forces[i];
+    }
+    if (m_pForceCallback)
+    {
+        m_pForceCallback(snapshot, forces, m_pForceUserData);
+    }
+    const bool bSetForces = m_pForceCallback || m_bForcesPublished;
+
+    for (int i = 0; i < m_nDevices; i++)
+    {
+        hdMakeCurrentDevice(m_hHDs[i]);
+        if (bSetForces)
+        {
+            hdSetDoublev(HD_CURRENT_FORCE, forces[i]);
+        }
+        hdGetDoublev(HD_CURRENT_FORCE, snapshot.devices[i].force);
+        hdEndFrame(m_hHDs[i]);
+    }
+
+    popErrors();
+    snapshot.error = m_error;
+
+    m_buffer.publish();
+
+    return m_bSchedulerError ? HD_CALLBACK_DONE : HD_CALLBACK_CONTINUE;
+}
+
+/*******************************************************************************
+ Empties the servo thread's error stack into m_error.  See the class
+ comment for the errors of other callbacks.
+*******************************************************************************/
+void hduDeviceGroup::popErrors()
+{
+    HDErrorInfo error;
+    while (HD_DEVICE_ERROR(error = hdGetError()))
+    {
+        m_error = error;
+        m_bSchedulerError = m_bSchedulerError || hduIsSchedulerError(&error);
+    }
+}
+
+/*****************************************************************************/
@@ -23,11 +23,14 @@ Description:
 #include "hduAfx.h"
 #include <string.h>
 #include <HDU/hduHapticDevice.h>
+#include <HDU/hduAtomic.h>
+#include <HDU/hduTripleBuffer.h>
 
 #include <assert.h>
-#include <queue>
 
-using namespace std;
+/* Number of events that can be pending between the haptic and graphic
+   threads.  Must be a power of two. */
+static const long kEventQueueCapacity = 64;
 
 class HapticDeviceStateCache : public IHapticDevice::IHapticDeviceState
 {
@@ -111,14 +114,129 @@ struct HapticDeviceEvent
     HapticDeviceStateCache m_state;
 };
 
-typedef queue<HapticDeviceEvent *> HapticDeviceEventQueue;
+/*******************************************************************************
+ HapticDeviceEventQueue
+
+ Fixed capacity queue of events from the haptic thread (single producer) to
+ the graphic thread (single consumer).  All storage is allocated when the
+ queue is created.  The read and write counters run freely and are only
+ masked when indexing, which lets the producer discard the oldest event by
+ advancing the read counter.  The consumer copies an event out and then 
+ claims it with a compare and swap, retrying if the producer discarded the 
+ event in the meantime.
+*******************************************************************************/
+class HapticDeviceEventQueue
+{
+public:
+
+    HapticDeviceEventQueue() :
+        m_head(0),
+        m_tail(0),
+        m_overflowCount(0),
+        m_ePolicy(IHapticDevice::EVENT_OVERFLOW_DROP_OLDEST)
+    {
+        m_events = new HapticDeviceEvent[kEventQueueCapacity];
+    }
+
+    ~HapticDeviceEventQueue()
+    {
+        delete [] m_events;
+    }
+
+    /* May be called from either thread. */
+    void setOverflowPolicy(IHapticDevice::EventOverflowPolicy ePolicy) 
+    { 
+        hduAtomicStore(&m_ePolicy, (long) ePolicy); 
+    }
+    IHapticDevice::EventOverflowPolicy getOverflowPolicy() const 
+    { 
+        return (IHapticDevice::EventOverflowPolicy) hduAtomicLoad(&m_ePolicy); 
+    }
+
+    HDulong getOverflowCount() const 
+    { 
+        return (HDulong) hduAtomicLoad(&m_overflowCount); 
+    }
+
+    /* Producer.  Returns the slot to fill in, or 0 if the event has to be 
+       discarded. */
+    HapticDeviceEvent *beginPush()
+    {
+        long tail = m_tail;
+        long head = hduAtomicLoad(&m_head);
+        if (distance(head, tail) >= (unsigned long) kEventQueueCapacity)
+        {
+            if (getOverflowPolicy() == IHapticDevice::EVENT_OVERFLOW_DROP_NEWEST)
+            {
+                hduAtomicIncrement(&m_overflowCount);
+                return 0;
+            }
+
+            /* If this fails the consumer just took the oldest event, which 
+               makes room all the same. */
+            if (hduAtomicCompareExchange(&m_head, head, next(head)))
+            {
+                hduAtomicIncrement(&m_overflowCount);
+            }
+        }
+        return &m_events[tail & (kEventQueueCapacity - 1)];
+    }
+
+    void endPush()
+    {
+        hduAtomicStore(&m_tail, next(m_tail));
+    }
+
+    /* Consumer.  Copies out the oldest event, returns false if empty. */
+    bool pop(HapticDeviceEvent &event)
+    {
+        for (;;)
+        {
+            long head = hduAtomicLoad(&m_head);
+            if (head == hduAtomicLoad(&m_tail))
+            {
+                return false;
+            }
+
+            event = m_events[head & (kEventQueueCapacity - 1)];
+
+            if (hduAtomicCompareExchange(&m_head, head, next(head)))
+            {
+                return true;
+            }
+        }
+    }
+
+private:
+
+    static long next(long counter) 
+    { 
+        return (long) ((unsigned long) counter + 1); 
+    }
+
+    static unsigned long distance(long from, long to) 
+    { 
+        return (unsigned long) to - (unsigned long) from; 
+    }
+
+    HapticDeviceEvent *m_events;
+
+    volatile long m_head;
+    volatile long m_tail;
+    volatile long m_overflowCount;
+
+    /* An IHapticDevice::EventOverflowPolicy. */
+    volatile long m_ePolicy;
+};
 
 /******************************************************************************/
 
 class HapticDevice : public IHapticDevice
 {
 public:
-    HapticDevice(HHD hHD) : m_hHD(hHD)
+    HapticDevice(HHD hHD, SyncMode eSyncMode) : 
+        m_hHD(hHD),
+        m_eSyncMode(eSyncMode)
     {
         memset(m_aCallbackFunc, 0, NUM_EVENT_TYPES * sizeof(void *));
         memset(m_aCallbackUserData, 0, NUM_EVENT_TYPES * sizeof(void *));
@@ -136,6 +254,8 @@ public:
         return &m_lastState; }
     IHapticDeviceState * const getLastState() { return &m_lastState; }
 
+    SyncMode getSyncMode() const { return m_eSyncMode; }
+
     void setCallback(EventType event, 
                      HapticDeviceCallback *pCallback, 
                      void *pUserData)
@@ -151,12 +271,11 @@ protected:
     static HDCallbackCode HDCALLBACK syncHapticDeviceState(void *pUserData);
 
     HHD m_hHD;
+    SyncMode m_eSyncMode;
 
     HapticDeviceStateCache m_currentState;
     HapticDeviceStateCache m_lastState;
 
-    HapticDeviceEventQueue m_eventQueue;
-
     HapticDeviceCallback *m_aCallbackFunc[NUM_EVENT_TYPES];
     void *m_aCallbackUserData[NUM_EVENT_TYPES];    
 };
@@ -167,7 +286,8 @@ class HapticDeviceHT : public HapticDevice
 {
 public:
 
-    HapticDeviceHT(HHD hHD) : HapticDevice(hHD)
+    HapticDeviceHT(HHD hHD, SyncMode eSyncMode) : 
+        HapticDevice(hHD, eSyncMode)
     {
     }
 
@@ -181,10 +301,26 @@ public:
     void beginUpdate(IHapticDevice *pSyncToDevice);
     void endUpdate(IHapticDevice *pSyncToDevice);
 
+    void setEventOverflowPolicy(EventOverflowPolicy ePolicy) {
+        m_eventQueue.setOverflowPolicy(ePolicy); }
+    EventOverflowPolicy getEventOverflowPolicy() const {
+        return m_eventQueue.getOverflowPolicy(); }
+    HDulong getEventOverflowCount() const {
+        return m_eventQueue.getOverflowCount(); }
+
+    HapticDeviceEventQueue &getEventQueue() { return m_eventQueue; }
+
+    hduTripleBuffer<HapticDeviceStateCache> &getStateBuffer() { 
+        return m_stateBuffer; }
+
 protected:
 
     void handleEvent(EventType event);
 
+    HapticDeviceEventQueue m_eventQueue;
+
+    /* Published state, used in SYNC_TRIPLE_BUFFER mode. */
+    hduTripleBuffer<HapticDeviceStateCache> m_stateBuffer;
 };
 
 /******************************************************************************/
@@ -193,7 +329,11 @@ class HapticDeviceGT : public HapticDevice
 {
 public:
 
-    HapticDeviceGT(HHD hHD) : HapticDevice(hHD)
+    HapticDeviceGT(HHD hHD, SyncMode eSyncMode) : 
+        HapticDevice(hHD, eSyncMode),
+        m_ePolicy(EVENT_OVERFLOW_DROP_OLDEST),
+        m_bPolicySet(false),
+        m_overflowCount(0)
     {
     }
 
@@ -208,19 +348,49 @@ public:
     void endUpdate(IHapticDevice *pSyncToDevice);
 
     void handleEvent(EventType event, const IHapticDeviceState *pState);
+
+    /* The queue belongs to the haptic thread instance, so the policy is
+       handed on to the instance synchronized with at every beginUpdate.
+       No pointer to that instance is kept, since it may be destroyed
+       first. */
+    void setEventOverflowPolicy(EventOverflowPolicy ePolicy) {
+        m_ePolicy = ePolicy;
+        m_bPolicySet = true; }
+    EventOverflowPolicy getEventOverflowPolicy() const { return m_ePolicy; }
+    HDulong getEventOverflowCount() const { return m_overflowCount; }
+
+private:
+
+    /* Set through this instance to be handed on, or else as of the last
+       beginUpdate. */
+    EventOverflowPolicy m_ePolicy;
+    bool m_bPolicySet;
+
+    /* As of the last beginUpdate. */
+    HDulong m_overflowCount;
+
+    /* Scratch event the queue is drained into. */
+    HapticDeviceEvent m_event;
 };
 /******************************************************************************/
 
 IHapticDevice *IHapticDevice::create(IHapticDevice::InterfaceType eType, 
                                      HHD hHD)
+{
+    return create(eType, hHD, IHapticDevice::SYNC_SCHEDULER);
+}
+
+IHapticDevice *IHapticDevice::create(IHapticDevice::InterfaceType eType, 
+                                     HHD hHD,
+                                     IHapticDevice::SyncMode eSyncMode)
 {
     if (eType == IHapticDevice::HAPTIC_THREAD_INTERFACE)
     {
-        return new HapticDeviceHT(hHD);
+        return new HapticDeviceHT(hHD, eSyncMode);
     }
     else if (eType == IHapticDevice::GRAPHIC_THREAD_INTERFACE)
     {
-        return new HapticDeviceGT(hHD);
+        return new HapticDeviceGT(hHD, eSyncMode);
     }
     else
     {
@@ -253,17 +423,11 @@ HDCallbackCode HapticDevice::syncHapticDeviceState(void *pUserData)
     HapticDevice *pSrcDevice = pPair->pSyncSrcDevice;
     HapticDevice *pDstDevice = pPair->pSyncDstDevice;
 
-    /* Update the device state from the src device. */
+    /* Update the device state from the src device.  Pending events are
+       drained by the destination directly from the src device's queue. */
     pDstDevice->m_lastState = pDstDevice->m_currentState;
     pDstDevice->m_currentState = pSrcDevice->m_currentState;
 
-    /* Grab all of the pending events from the src device. */
-    while (!pSrcDevice->m_eventQueue.empty())
-    {
-        pDstDevice->m_eventQueue.push(pSrcDevice->m_eventQueue.front());
-        pSrcDevice->m_eventQueue.pop();
-    }
-
     return HD_CALLBACK_DONE;
 }
 
@@ -348,6 +512,13 @@ void HapticDeviceHT::endUpdate(IHapticDevice *pSyncToDevice)
     {        
         handleEvent(DEVICE_ERROR);    
     }
+
+    /* Make this tick's state available to the graphic thread. */
+    if (m_eSyncMode == SYNC_TRIPLE_BUFFER)
+    {
+        m_stateBuffer.getWriteBuffer() = m_currentState;
+        m_stateBuffer.publish();
+    }
 }
 
 void HapticDeviceHT::handleEvent(EventType event)
@@ -359,10 +530,15 @@ void HapticDeviceHT::handleEvent(EventType event)
         pCallback(event, &m_currentState, m_aCallbackUserData[event]);
     }
 
-    HapticDeviceEvent *pEvent = new HapticDeviceEvent;
-    pEvent->event = event;
-    memcpy(&pEvent->m_state, &m_currentState, sizeof(HapticDeviceStateCache));
-    m_eventQueue.push(pEvent); 
+    /* Fill in a preallocated slot of the event queue, so that no memory is
+       allocated in the servo loop. */
+    HapticDeviceEvent *pEvent = m_eventQueue.beginPush();
+    if (pEvent)
+    {
+        pEvent->event = event;
+        pEvent->m_state = m_currentState;
+        m_eventQueue.endPush();
+    }
 }
 
 
@@ -371,21 +547,47 @@ void HapticDeviceHT::handleEvent(EventType event)
 *******************************************************************************/
 void HapticDeviceGT::beginUpdate(IHapticDevice *pSyncToDevice)
 {
-    DeviceSyncPair pair;
-    pair.pSyncSrcDevice = static_cast<HapticDevice *>(pSyncToDevice);
-    pair.pSyncDstDevice = this;
-    assert(pair.pSyncSrcDevice);
+    assert(pSyncToDevice);
+    assert(pSyncToDevice->getInterfaceType() == HAPTIC_THREAD_INTERFACE);
+    assert(pSyncToDevice->getSyncMode() == m_eSyncMode);
+    HapticDeviceHT *pSrcDevice = static_cast<HapticDeviceHT *>(pSyncToDevice);
 
-    hdScheduleSynchronous(syncHapticDeviceState, &pair, HD_MIN_SCHEDULER_PRIORITY);
-
-    /* Process any events that were added to the queue. */
-    while (!m_eventQueue.empty())
+    if (m_eSyncMode == SYNC_TRIPLE_BUFFER)
     {
-        handleEvent(m_eventQueue.front()->event, &m_eventQueue.front()->m_state);
+        /* Pick up the latest state published by the haptic thread, if any,
+           without waiting for the servo loop. */
+        hduTripleBuffer<HapticDeviceStateCache> &stateBuffer = 
+            pSrcDevice->getStateBuffer();
+        m_lastState = m_currentState;
+        if (stateBuffer.update())
+        {
+            m_currentState = stateBuffer.getReadBuffer();
+        }
+    }
+    else
+    {
+        DeviceSyncPair pair;
+        pair.pSyncSrcDevice = pSrcDevice;
+        pair.pSyncDstDevice = this;
+
+        hdScheduleSynchronous(syncHapticDeviceState, &pair, 
+                              HD_MIN_SCHEDULER_PRIORITY);
+    }
 
-        HapticDeviceEvent *pEvent = m_eventQueue.front();
-        m_eventQueue.pop();
-        delete pEvent;        
+    /* Process any events the haptic thread has queued. */
+    if (m_bPolicySet)
+    {
+        pSrcDevice->setEventOverflowPolicy(m_ePolicy);
+    }
+    else
+    {
+        m_ePolicy = pSrcDevice->getEventOverflowPolicy();
+    }
+    m_overflowCount = pSrcDevice->getEventOverflowCount();
+    HapticDeviceEventQueue &eventQueue = pSrcDevice->getEventQueue();
+    while (eventQueue.pop(m_event))
+    {
+        handleEvent(m_event.event, &m_event.m_state);
     }
 }
 
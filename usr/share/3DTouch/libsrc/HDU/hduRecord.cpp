@@ -26,16 +26,20 @@ Description:
 
 #include <HDU/hduRecord.h>
 #include <HDU/hduVector.h>
+#include <HDU/hduRingBuffer.h>
 
 #include <HD/hdCompilerConfig.h>
 #include <HD/hdScheduler.h>
 #include <HD/hdDevice.h>
 
 #if defined WIN32
+# include <windows.h>
 # include <process.h>
   typedef void thread_rv;
 #elif defined(linux) || defined(__APPLE__)
 # include <pthread.h>
+# include <unistd.h>
+# define Sleep(x) usleep((x) * 1000)
   typedef void* thread_rv;
 #endif
 
@@ -45,6 +49,15 @@ HDCallbackCode HDCALLBACK recordLoopCallback(void *_hduRecorder);
 /* Thread callback for writing out data to file. */
 thread_rv recordWriteCallback( void *data );
 
+/* Scheduler callback for streaming data for each iteration. */
+HDCallbackCode HDCALLBACK streamRecordLoopCallback(void *pUserData);
+
+/* Default number of packets queued between the scheduler and the writer. */
+static const unsigned int kDefaultStreamBufferPackets = 4096;
+
+/* Number of packets the writer thread hands to fwrite at once. */
+static const unsigned int kStreamWriteBatchPackets = 256;
+
 /******************************************************************************
  Data packet for each iteration. 
 ******************************************************************************/
@@ -133,6 +146,9 @@ thread_rv recordWriteCallback( void *data )
     hduRecorder *pRecord = (hduRecorder *)data;
     pRecord->writeDataToFile();
     delete pRecord;
+#if defined(linux) || defined(__APPLE__)
+    return 0;
+#endif
 }
 
 /******************************************************************************
@@ -171,7 +187,11 @@ HDCallbackCode HDCALLBACK recordLoopCallback(void *_hduRecorder)
 #if defined(WIN32)
         _beginthread(recordWriteCallback, 0, pRecord);
 #elif defined(linux) || defined(__APPLE__)
-        pthread_create(NULL, NULL, recordWriteCallback, pRecord);
+        pthread_t thread;
+        if (pthread_create(&thread, NULL, recordWriteCallback, pRecord) == 0)
+        {
+            pthread_detach(thread);
+        }
 #endif
         return HD_CALLBACK_DONE;
     }
@@ -212,7 +232,7 @@ HDboolean hduRecorder::addData()
 /******************************************************************************
  Create a recorder, start recording.  
 ******************************************************************************/
-HDboolean hdStartRecord(
+HDboolean hduStartRecord(
     FILE *file,
     HDURecordCallback pCallback,
     void *pCallbackData,
@@ -237,4 +257,270 @@ HDboolean hdStartRecord(
     }
 }
 
+/******************************************************************************
+ Streaming recorder.  The scheduler callback fills fixed size packets directly
+ in a preallocated ring buffer, and a worker thread drains the ring buffer to
+ file.  Nothing on the scheduler side allocates memory or touches stdio, so
+ the recording length is bounded only by disk space.
+******************************************************************************/
+struct hduStreamRecorder
+{
+public:
+
+    hduStreamRecorder(FILE *file, unsigned int nBufferPackets);
+    ~hduStreamRecorder();
+
+    HDboolean start();
+    void stop();
+
+    void addData();
+    void writeLoop();
+
+    HDulong getDropCount() const
+    {
+        return (HDulong) hduAtomicLoad(&m_dropCount);
+    }
+
+private:
+
+    FILE *m_file;
+    HDSchedulerHandle m_hCallback;
+    HDuint m_tick;
+
+    hduRingBuffer<HDURecordPacket> m_queue;
+
+    volatile long m_dropCount;
+    volatile long m_bStopWriter;
+
+#if defined(WIN32)
+    HANDLE m_hWriterThread;
+#elif defined(linux) || defined(__APPLE__)
+    pthread_t m_writerThread;
+#endif
+};
+
+/******************************************************************************
+ Worker thread callback to stream the data to file.
+******************************************************************************/
+#if defined(WIN32)
+static unsigned __stdcall streamWriteCallback(void *data)
+#elif defined(linux) || defined(__APPLE__)
+static void *streamWriteCallback(void *data)
+#endif
+{
+    hduStreamRecorder *pRecord = (hduStreamRecorder *) data;
+    pRecord->writeLoop();
+    return 0;
+}
+
+/******************************************************************************
+ Constructor
+******************************************************************************/
+hduStreamRecorder::hduStreamRecorder(FILE *file, 
+                                     unsigned int nBufferPackets) :
+    m_file(file),
+    m_hCallback(HD_INVALID_HANDLE),
+    m_tick(0),
+    m_queue(nBufferPackets),
+    m_dropCount(0),
+    m_bStopWriter(0)
+{
+}
+
+/******************************************************************************
+ Destructor
+******************************************************************************/
+hduStreamRecorder::~hduStreamRecorder()
+{
+}
+
+/******************************************************************************
+ Start the writer thread, then schedule a callback that queues device data 
+ for every scheduler tick.
+******************************************************************************/
+HDboolean hduStreamRecorder::start()
+{
+    HDURecordFileHeader header;
+    header.magic = HDU_RECORD_FILE_MAGIC;
+    header.version = HDU_RECORD_FILE_VERSION;
+    header.headerSize = sizeof(HDURecordFileHeader);
+    header.packetSize = sizeof(HDURecordPacket);
+    if (fwrite(&header, sizeof(header), 1, m_file) != 1)
+    {
+        return false;
+    }
+
+#if defined(WIN32)
+    m_hWriterThread = (HANDLE) _beginthreadex(
+        NULL, 0, streamWriteCallback, this, 0, NULL);
+    if (!m_hWriterThread)
+    {
+        return false;
+    }
+#elif defined(linux) || defined(__APPLE__)
+    if (pthread_create(&m_writerThread, NULL, streamWriteCallback, this) != 0)
+    {
+        return false;
+    }
+#endif
+
+    m_hCallback = hdScheduleAsynchronous(streamRecordLoopCallback,
+                                         this,
+                                         HD_MIN_SCHEDULER_PRIORITY);
+    if (m_hCallback == HD_INVALID_HANDLE)
+    {
+        stop();
+        return false;
+    }
+    return true;
+}
+
+/******************************************************************************
+ Unschedule the callback, then let the writer thread drain whatever is left
+ in the queue and wait for it to finish.
+******************************************************************************/
+void hduStreamRecorder::stop()
+{
+    if (m_hCallback != HD_INVALID_HANDLE)
+    {
+        hdUnschedule(m_hCallback);
+        m_hCallback = HD_INVALID_HANDLE;
+    }
+
+    hduAtomicStore(&m_bStopWriter, 1);
+
+#if defined(WIN32)
+    WaitForSingleObject(m_hWriterThread, INFINITE);
+    CloseHandle(m_hWriterThread);
+#elif defined(linux) || defined(__APPLE__)
+    pthread_join(m_writerThread, NULL);
+#endif
+
+    fflush(m_file);
+}
+
+/******************************************************************************
+ Adds data for one tick.  Runs in the scheduler thread.  If the writer has
+ fallen behind and the queue is full, the packet is dropped and counted.
+******************************************************************************/
+void hduStreamRecorder::addData()
+{
+    HDURecordPacket *pPacket = m_queue.beginPush();
+    if (pPacket)
+    {
+        pPacket->tick = m_tick;
+        pPacket->reserved = 0;
+        hdGetDoublev(HD_CURRENT_FORCE, pPacket->force);
+        hdGetDoublev(HD_CURRENT_POSITION, pPacket->position);
+        hdGetDoublev(HD_CURRENT_VELOCITY, pPacket->velocity);
+        m_queue.endPush();
+    }
+    else
+    {
+        hduAtomicIncrement(&m_dropCount);
+    }
+
+    m_tick++;
+}
+
+/******************************************************************************
+ Writer thread main loop.  Drains the queue in batches and sleeps briefly 
+ whenever it is empty.  Exits once asked to stop and the queue is empty.
+******************************************************************************/
+void hduStreamRecorder::writeLoop()
+{
+    HDURecordPacket batch[kStreamWriteBatchPackets];
+
+    for (;;)
+    {
+        /* Read the stop flag before draining, so that everything queued 
+           before the stop request is guaranteed to be written. */
+        bool bStopping = hduAtomicLoad(&m_bStopWriter) != 0;
+
+        unsigned int nBatch = 0;
+        while (nBatch < kStreamWriteBatchPackets && 
+               m_queue.pop(batch[nBatch]))
+        {
+            nBatch++;
+        }
+
+        if (nBatch > 0)
+        {
+            fwrite(batch, sizeof(HDURecordPacket), nBatch, m_file);
+        }
+        else if (bStopping)
+        {
+            break;
+        }
+        else
+        {
+            Sleep(1);
+        }
+    }
+}
+
+/******************************************************************************
+ Scheduler callback; at each scheduler tick, queue one tick's worth of data.
+******************************************************************************/
+HDCallbackCode HDCALLBACK streamRecordLoopCallback(void *pUserData)
+{
+    hduStreamRecorder *pRecord = (hduStreamRecorder *) pUserData;
+    pRecord->addData();
+    return HD_CALLBACK_CONTINUE;
+}
+
+/******************************************************************************
+ Create a streaming recorder, start recording.
+******************************************************************************/
+HDURecordHandle hduStartStreamingRecord(
+    FILE *file,
+    unsigned int nBufferPackets)
+{
+    if (!file)
+    {
+        return 0;
+    }
+    if (nBufferPackets == 0)
+    {
+        nBufferPackets = kDefaultStreamBufferPackets;
+    }
+
+    hduStreamRecorder *pRecord = new hduStreamRecorder(file, nBufferPackets);
+    if (pRecord->start())
+    {
+        return pRecord;
+    }
+    else
+    {
+        delete pRecord;
+        return 0;
+    }
+}
+
+/******************************************************************************
+ Stop a streaming recorder and release it.
+******************************************************************************/
+HDboolean hduStopRecord(HDURecordHandle hRecord)
+{
+    if (!hRecord)
+    {
+        return false;
+    }
+    hRecord->stop();
+    delete hRecord;
+    return true;
+}
+
+/******************************************************************************
+ Number of packets dropped by a streaming recorder.
+******************************************************************************/
+HDulong hduGetRecordDropCount(HDURecordHandle hRecord)
+{
+    if (!hRecord)
+    {
+        return 0;
+    }
+    return hRecord->getDropCount();
+}
+
 /*****************************************************************************/
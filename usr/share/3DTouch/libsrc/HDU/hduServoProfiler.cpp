@@ -0,0 +1,417 @@
+/*****************************************************************************
+
+Copyright (c) 2004 SensAble Technologies, Inc. All rights reserved.
+
+OpenHaptics(TM) toolkit. The material embodied in this software and use of
+this software is subject to the terms and conditions of the clickthrough
+Development License Agreement.
+
+For questions, comments or bug reports, go to forums at:
+    http://dsc.sensable.com
+
+Module Name:
+
+  hduServoProfiler.cpp
+
+Description:
+
+  Latency histograms for the servo loop.
+
+******************************************************************************/
+
+#include "hduAfx.h"
+
+#include <string.h>
+
+#include <HDU/hduServoProfiler.h>
+#include <HDU/hduAtomic.h>
+
+#include <HD/hdCompilerConfig.h>
+#include <HD/hdScheduler.h>
+#include <HD/hdDevice.h>
+
+namespace
+{
+
+/* Histogram layout.  Values are in nanoseconds.  Values below
+   kSubBucketCount get a bucket each; above that, every power of two range
+   [kSubBucketCount << shift, 2 * kSubBucketCount << shift) is split into
+   kSubBucketCount equal buckets, which bounds the relative error to
+   1/kSubBucketCount, about 3%.  Values beyond the last range, which ends
+   at 2 * kSubBucketCount << kMaxShift ns or about 268 ms, are clamped into
+   the last bucket. */
+const int kSubBucketCount = 32;
+const int kMaxShift = 22;
+const int kNumBuckets = kSubBucketCount * (kMaxShift + 2);
+
+const HDdouble kDefaultOverrunThreshold = 0.001;
+
+/* Maximum length of a callback name, including the terminator. */
+const int kMaxNameLength = 32;
+
+int getBucketIndex(HDdouble seconds)
+{
+    if (seconds <= 0)
+    {
+        return 0;
+    }
+
+    unsigned long value = (unsigned long) (seconds * 1e9 + 0.5);
+    if (value < (unsigned long) kSubBucketCount)
+    {
+        return (int) value;
+    }
+
+    int shift = 0;
+    while (value >= 2 * (unsigned long) kSubBucketCount)
+    {
+        value >>= 1;
+        shift++;
+    }
+    if (shift > kMaxShift)
+    {
+        return kNumBuckets - 1;
+    }
+
+    return kSubBucketCount * (shift + 1) +
+        (int) (value - kSubBucketCount);
+}
+
+/* Largest value, in seconds, that falls into the bucket. */
+HDdouble getBucketUpperBound(int nIndex)
+{
+    if (nIndex < kSubBucketCount)
+    {
+        return nIndex * 1e-9;
+    }
+
+    int shift = nIndex / kSubBucketCount - 1;
+    unsigned long sub = nIndex % kSubBucketCount + kSubBucketCount;
+    return (((sub + 1) << shift) - 1) * 1e-9;
+}
+
+/******************************************************************************
+ Histogram written by the servo thread.  There is only one writer, so
+ counters are bumped with a plain increment.  Readers load each counter
+ individually and may see a sample in some counters but not yet in others,
+ which only affects the sample in flight.
+******************************************************************************/
+struct Histogram
+{
+    volatile long counts[kNumBuckets];
+
+    /* Counts at the last reset, owned by the reader. */
+    long baseline[kNumBuckets];
+
+    void clear()
+    {
+        memset((void *) counts, 0, sizeof(counts));
+        memset(baseline, 0, sizeof(baseline));
+    }
+
+    void sample(HDdouble seconds)
+    {
+        int nIndex = getBucketIndex(seconds);
+        counts[nIndex] = counts[nIndex] + 1;
+    }
+
+    void reset()
+    {
+        for (int i = 0; i < kNumBuckets; i++)
+        {
+            baseline[i] = hduAtomicLoad(&counts[i]);
+        }
+    }
+
+    void getStats(hduServoProfileStats &stats) const
+    {
+        long interval[kNumBuckets];
+        long nSamples = 0;
+        for (int i = 0; i < kNumBuckets; i++)
+        {
+            interval[i] = hduAtomicLoad(&counts[i]) - baseline[i];
+            nSamples += interval[i];
+        }
+
+        stats.nSamples = nSamples;
+        stats.p50 = getPercentile(interval, nSamples, 0.5);
+        stats.p99 = getPercentile(interval, nSamples, 0.99);
+        stats.p999 = getPercentile(interval, nSamples, 0.999);
+        stats.max = getPercentile(interval, nSamples, 1.0);
+    }
+
+    static HDdouble getPercentile(const long *interval, long nSamples,
+                                  HDdouble fraction)
+    {
+        if (nSamples == 0)
+        {
+            return 0;
+        }
+
+        /* Rank of the sample, rounded up so that p99 of 100 samples is the
+           99th one. */
+        long nRank = (long) (fraction * nSamples);
+        if (nRank < fraction * nSamples)
+        {
+            nRank++;
+        }
+        if (nRank < 1)
+        {
+            nRank = 1;
+        }
+
+        long nCount = 0;
+        for (int i = 0; i < kNumBuckets; i++)
+        {
+            nCount += interval[i];
+            if (nCount >= nRank)
+            {
+                return getBucketUpperBound(i);
+            }
+        }
+        return getBucketUpperBound(kNumBuckets - 1);
+    }
+};
+
+struct ProfiledCallback
+{
+    hduServoProfilerData *pData;
+    HDSchedulerCallback pCallback;
+    void *pUserData;
+    HDSchedulerHandle hHandle;
+    char name[kMaxNameLength];
+    Histogram histogram;
+};
+
+} /* anonymous namespace */
+
+struct hduServoProfilerData
+{
+    Histogram phases[hduServoProfiler::NUM_PHASES];
+    ProfiledCallback callbacks[hduServoProfiler::MAX_CALLBACKS];
+    volatile long nCallbacks;
+
+    volatile long nOverruns;
+    long nOverrunBaseline;
+    volatile HDdouble overrunThreshold;
+
+    /* Scratch for the servo thread. */
+    HDdouble callbacksStartTime;
+
+    HDSchedulerHandle hBeginCallback;
+    HDSchedulerHandle hEndCallback;
+};
+
+namespace
+{
+
+/******************************************************************************
+ Runs first in the tick.
+******************************************************************************/
+HDCallbackCode HDCALLBACK beginTickCallback(void *pUserData)
+{
+    hduServoProfilerData *pData =
+        static_cast<hduServoProfilerData *>(pUserData);
+
+    HDdouble startTime = hdGetSchedulerTimeStamp();
+    hdBeginFrame(hdGetCurrentDevice());
+    HDdouble updateTime = hdGetSchedulerTimeStamp();
+
+    HDdouble rate = 0;
+    hdGetDoublev(HD_INSTANTANEOUS_UPDATE_RATE, &rate);
+    if (rate > 0)
+    {
+        pData->phases[hduServoProfiler::PHASE_INTERVAL].sample(1.0 / rate);
+    }
+
+    pData->phases[hduServoProfiler::PHASE_SCHEDULER].sample(startTime);
+    pData->phases[hduServoProfiler::PHASE_BEGIN_FRAME].sample(
+        updateTime - startTime);
+    pData->callbacksStartTime = updateTime;
+
+    return HD_CALLBACK_CONTINUE;
+}
+
+/******************************************************************************
+ Runs last in the tick.
+******************************************************************************/
+HDCallbackCode HDCALLBACK endTickCallback(void *pUserData)
+{
+    hduServoProfilerData *pData =
+        static_cast<hduServoProfilerData *>(pUserData);
+
+    HDdouble callbacksEndTime = hdGetSchedulerTimeStamp();
+    hdEndFrame(hdGetCurrentDevice());
+    HDdouble endTime = hdGetSchedulerTimeStamp();
+
+    pData->phases[hduServoProfiler::PHASE_CALLBACKS].sample(
+        callbacksEndTime - pData->callbacksStartTime);
+    pData->phases[hduServoProfiler::PHASE_END_FRAME].sample(
+        endTime - callbacksEndTime);
+    pData->phases[hduServoProfiler::PHASE_TICK].sample(endTime);
+
+    if (endTime > pData->overrunThreshold)
+    {
+        pData->nOverruns = pData->nOverruns + 1;
+    }
+
+    return HD_CALLBACK_CONTINUE;
+}
+
+/******************************************************************************
+ Times one invocation of a profiled callback.
+******************************************************************************/
+HDCallbackCode HDCALLBACK profiledCallback(void *pUserData)
+{
+    ProfiledCallback *pProfiled = static_cast<ProfiledCallback *>(pUserData);
+
+    HDdouble startTime = hdGetSchedulerTimeStamp();
+    HDCallbackCode result = pProfiled->pCallback(pProfiled->pUserData);
+    pProfiled->histogram.sample(hdGetSchedulerTimeStamp() - startTime);
+
+    return result;
+}
+
+} /* anonymous namespace */
+
+/******************************************************************************
+ hduServoProfiler
+******************************************************************************/
+hduServoProfiler::hduServoProfiler() :
+    m_pData(new hduServoProfilerData)
+{
+    for (int i = 0; i < NUM_PHASES; i++)
+    {
+        m_pData->phases[i].clear();
+    }
+    m_pData->nCallbacks = 0;
+    m_pData->nOverruns = 0;
+    m_pData->nOverrunBaseline = 0;
+    m_pData->callbacksStartTime = 0;
+
+    HDint nRate = 0;
+    hdGetIntegerv(HD_UPDATE_RATE, &nRate);
+    m_pData->overrunThreshold =
+        nRate > 0 ? 1.0 / nRate : kDefaultOverrunThreshold;
+
+    m_pData->hBeginCallback = hdScheduleAsynchronous(
+        beginTickCallback, m_pData, HD_MAX_SCHEDULER_PRIORITY);
+    m_pData->hEndCallback = hdScheduleAsynchronous(
+        endTickCallback, m_pData, HD_MIN_SCHEDULER_PRIORITY);
+}
+
+hduServoProfiler::~hduServoProfiler()
+{
+    int nCallbacks = getCallbackCount();
+    for (int i = 0; i < nCallbacks; i++)
+    {
+        HDSchedulerHandle hHandle = m_pData->callbacks[i].hHandle;
+        if (hdWaitForCompletion(hHandle, HD_WAIT_CHECK_STATUS))
+        {
+            hdUnschedule(hHandle);
+        }
+    }
+
+    hdUnschedule(m_pData->hEndCallback);
+    hdUnschedule(m_pData->hBeginCallback);
+
+    delete m_pData;
+}
+
+HDSchedulerHandle hduServoProfiler::scheduleAsynchronous(
+    HDSchedulerCallback pCallback,
+    void *pUserData,
+    HDushort nPriority,
+    const char *pName)
+{
+    long nIndex = m_pData->nCallbacks;
+    if (nIndex >= MAX_CALLBACKS)
+    {
+        return 0;
+    }
+
+    ProfiledCallback &profiled = m_pData->callbacks[nIndex];
+    profiled.pData = m_pData;
+    profiled.pCallback = pCallback;
+    profiled.pUserData = pUserData;
+    strncpy(profiled.name, pName ? pName : "", kMaxNameLength - 1);
+    profiled.name[kMaxNameLength - 1] = '\0';
+    profiled.histogram.clear();
+
+    profiled.hHandle = hdScheduleAsynchronous(
+        profiledCallback, &profiled, nPriority);
+
+    hduAtomicStore(&m_pData->nCallbacks, nIndex + 1);
+
+    return profiled.hHandle;
+}
+
+void hduServoProfiler::getPhaseStats(Phase ePhase,
+                                     hduServoProfileStats &stats) const
+{
+    m_pData->phases[ePhase].getStats(stats);
+}
+
+bool hduServoProfiler::getCallbackStats(HDSchedulerHandle hHandle,
+                                        hduServoProfileStats &stats) const
+{
+    int nCallbacks = getCallbackCount();
+    for (int i = 0; i < nCallbacks; i++)
+    {
+        if (m_pData->callbacks[i].hHandle == hHandle)
+        {
+            m_pData->callbacks[i].histogram.getStats(stats);
+            return true;
+        }
+    }
+    return false;
+}
+
+HDulong hduServoProfiler::getOverrunCount() const
+{
+    return hduAtomicLoad(&m_pData->nOverruns) - m_pData->nOverrunBaseline;
+}
+
+int hduServoProfiler::getCallbackCount() const
+{
+    return (int) hduAtomicLoad(&m_pData->nCallbacks);
+}
+
+const char *hduServoProfiler::getCallbackName(int nIndex) const
+{
+    return m_pData->callbacks[nIndex].name;
+}
+
+void hduServoProfiler::getCallbackStats(int nIndex,
+                                        hduServoProfileStats &stats) const
+{
+    m_pData->callbacks[nIndex].histogram.getStats(stats);
+}
+
+void hduServoProfiler::reset()
+{
+    for (int i = 0; i < NUM_PHASES; i++)
+    {
+        m_pData->phases[i].reset();
+    }
+
+    int nCallbacks = getCallbackCount();
+    for (int i = 0; i < nCallbacks; i++)
+    {
+        m_pData->callbacks[i].histogram.reset();
+    }
+
+    m_pData->nOverrunBaseline = hduAtomicLoad(&m_pData->nOverruns);
+}
+
+void hduServoProfiler::setOverrunThreshold(HDdouble period)
+{
+    m_pData->overrunThreshold = period;
+}
+
+HDdouble hduServoProfiler::getOverrunThreshold() const
+{
+    return m_pData->overrunThreshold;
+}
+
+/******************************************************************************/
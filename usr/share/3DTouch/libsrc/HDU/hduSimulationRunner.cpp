@@ -0,0 +1,436 @@
+/*****************************************************************************
+
+Copyright (c) 2004 SensAble Technologies, Inc. All rights reserved.
+
+OpenHaptics(TM) toolkit. The material embodied in this software and use of
+this software is subject to the terms and conditions of the clickthrough
+Development License Agreement.
+
+For questions, comments or bug reports, go to forums at:
+    http://dsc.sensable.com
+
+Module Name:
+
+  hduSimulationRunner.cpp
+
+Description:
+
+  Steps a simulation on its own thread at a fixed rate.
+
+******************************************************************************/
+
+#include "hduAfx.h"
+
+#include <assert.h>
+#include <math.h>
+
+#include <HDU/hduSimulationRunner.h>
+#include <HDU/hduAtomic.h>
+
+#if defined(WIN32)
+# include <windows.h>
+# include <process.h>
+#elif defined(linux) || defined(__APPLE__)
+# include <errno.h>
+# include <pthread.h>
+# include <time.h>
+#endif
+
+namespace
+{
+
+const double kDefaultRate = 1000;
+const int kDefaultMaxSubsteps = 10;
+
+/* Period over which the achieved step rate is measured. */
+const double kStatsPeriod = 1.0;
+
+} /* anonymous namespace */
+
+/******************************************************************************
+ The simulation thread, its locks and its clock.  The step lock is held by
+ the simulation thread while stepping and by editors; it is recursive, so
+ that edits may be nested.  The stats lock guards the statistics that do
+ not fit in an atomic long.
+******************************************************************************/
+struct hduSimulationRunnerData
+{
+#if defined(WIN32)
+    HANDLE hThread;
+    CRITICAL_SECTION stepLock;
+    CRITICAL_SECTION statsLock;
+    double ticksPerSecond;
+#elif defined(linux) || defined(__APPLE__)
+    pthread_t thread;
+    pthread_mutex_t stepLock;
+    pthread_mutex_t statsLock;
+#endif
+
+    hduSimulationRunnerData()
+    {
+#if defined(WIN32)
+        InitializeCriticalSection(&stepLock);
+        InitializeCriticalSection(&statsLock);
+        LARGE_INTEGER frequency;
+        QueryPerformanceFrequency(&frequency);
+        ticksPerSecond = (double) frequency.QuadPart;
+#elif defined(linux) || defined(__APPLE__)
+        pthread_mutexattr_t attr;
+        pthread_mutexattr_init(&attr);
+        pthread_mutexattr_settype(&attr, PTHREAD_MUTEX_RECURSIVE);
+        pthread_mutex_init(&stepLock, &attr);
+        pthread_mutexattr_destroy(&attr);
+        pthread_mutex_init(&statsLock, NULL);
+#endif
+    }
+
+    ~hduSimulationRunnerData()
+    {
+#if defined(WIN32)
+        DeleteCriticalSection(&stepLock);
+        DeleteCriticalSection(&statsLock);
+#elif defined(linux) || defined(__APPLE__)
+        pthread_mutex_destroy(&stepLock);
+        pthread_mutex_destroy(&statsLock);
+#endif
+    }
+
+#if defined(WIN32)
+    static unsigned __stdcall threadProc(void *pUserData)
+#elif defined(linux) || defined(__APPLE__)
+    static void *threadProc(void *pUserData)
+#endif
+    {
+        static_cast<hduSimulationRunner *>(pUserData)->run();
+        return 0;
+    }
+
+    bool startThread(hduSimulationRunner *pRunner)
+    {
+#if defined(WIN32)
+        hThread = (HANDLE) _beginthreadex(
+            NULL, 0, threadProc, pRunner, 0, NULL);
+        return hThread != 0;
+#elif defined(linux) || defined(__APPLE__)
+        return pthread_create(&thread, NULL, threadProc, pRunner) == 0;
+#endif
+    }
+
+    void joinThread()
+    {
+#if defined(WIN32)
+        WaitForSingleObject(hThread, INFINITE);
+        CloseHandle(hThread);
+#elif defined(linux) || defined(__APPLE__)
+        pthread_join(thread, NULL);
+#endif
+    }
+
+    void lockStep()
+    {
+#if defined(WIN32)
+        EnterCriticalSection(&stepLock);
+#elif defined(linux) || defined(__APPLE__)
+        pthread_mutex_lock(&stepLock);
+#endif
+    }
+
+    bool tryLockStep()
+    {
+#if defined(WIN32)
+        return TryEnterCriticalSection(&stepLock) != 0;
+#elif defined(linux) || defined(__APPLE__)
+        return pthread_mutex_trylock(&stepLock) == 0;
+#endif
+    }
+
+    void unlockStep()
+    {
+#if defined(WIN32)
+        LeaveCriticalSection(&stepLock);
+#elif defined(linux) || defined(__APPLE__)
+        pthread_mutex_unlock(&stepLock);
+#endif
+    }
+
+    void lockStats()
+    {
+#if defined(WIN32)
+        EnterCriticalSection(&statsLock);
+#elif defined(linux) || defined(__APPLE__)
+        pthread_mutex_lock(&statsLock);
+#endif
+    }
+
+    void unlockStats()
+    {
+#if defined(WIN32)
+        LeaveCriticalSection(&statsLock);
+#elif defined(linux) || defined(__APPLE__)
+        pthread_mutex_unlock(&statsLock);
+#endif
+    }
+
+    /* Monotonic time in seconds. */
+    double getClock() const
+    {
+#if defined(WIN32)
+        LARGE_INTEGER now;
+        QueryPerformanceCounter(&now);
+        return now.QuadPart / ticksPerSecond;
+#elif defined(linux) || defined(__APPLE__)
+        struct timespec now;
+        clock_gettime(CLOCK_MONOTONIC, &now);
+        return now.tv_sec + now.tv_nsec * 1e-9;
+#endif
+    }
+
+    void sleepUntil(double wakeTime) const
+    {
+#if defined(WIN32)
+        double delay = wakeTime - getClock();
+        Sleep(delay > 0 ? (DWORD) (delay * 1000) : 0);
+#elif defined(linux) || defined(__APPLE__)
+        struct timespec wake;
+        wake.tv_sec = (time_t) wakeTime;
+        wake.tv_nsec = (long) ((wakeTime - wake.tv_sec) * 1e9);
+        if (wake.tv_nsec >= 1000000000)
+        {
+            wake.tv_sec++;
+            wake.tv_nsec -= 1000000000;
+        }
+
+        /* Sleep the rest of the way if interrupted by a signal.  Any other
+           error leaves the wake time to the next pass of the loop. */
+        while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME,
+                               &wake, NULL) == EINTR)
+        {
+        }
+#endif
+    }
+};
+
+/******************************************************************************
+ hduSimulationRunner
+******************************************************************************/
+hduSimulationRunner::hduSimulationRunner() :
+    m_pData(new hduSimulationRunnerData),
+    m_bThreadStarted(false),
+    m_bStopRequested(0),
+    m_pStep(0),
+    m_pUserData(0),
+    m_rate(kDefaultRate),
+    m_nMaxSubsteps(kDefaultMaxSubsteps),
+    m_bPaused(false),
+    m_time(0),
+    m_stepRate(0),
+    m_nOverruns(0)
+{
+}
+
+hduSimulationRunner::~hduSimulationRunner()
+{
+    stop();
+    delete m_pData;
+}
+
+bool hduSimulationRunner::start(StepCallback pStep, void *pUserData)
+{
+    assert(pStep != 0);
+
+    if (m_bThreadStarted)
+    {
+        return false;
+    }
+
+    m_pStep = pStep;
+    m_pUserData = pUserData;
+    hduAtomicStore(&m_bStopRequested, 0);
+
+    if (!m_pData->startThread(this))
+    {
+        return false;
+    }
+
+    m_bThreadStarted = true;
+    return true;
+}
+
+/******************************************************************************
+ The simulation thread never waits on the step lock, so this may be called
+ from inside an edit.
+******************************************************************************/
+void hduSimulationRunner::stop()
+{
+    if (!m_bThreadStarted)
+    {
+        return;
+    }
+
+    hduAtomicStore(&m_bStopRequested, 1);
+    m_pData->joinThread();
+    m_bThreadStarted = false;
+
+    m_pData->lockStats();
+    m_stepRate = 0;
+    m_pData->unlockStats();
+}
+
+void hduSimulationRunner::setRate(double rate)
+{
+    assert(rate > 0);
+
+    beginEdit();
+    m_rate = rate;
+    endEdit();
+}
+
+void hduSimulationRunner::setMaxSubsteps(int nMaxSubsteps)
+{
+    assert(nMaxSubsteps > 0);
+
+    beginEdit();
+    m_nMaxSubsteps = nMaxSubsteps;
+    endEdit();
+}
+
+void hduSimulationRunner::setPaused(bool bPaused)
+{
+    if (bPaused == m_bPaused)
+    {
+        return;
+    }
+
+    beginEdit();
+    m_bPaused = bPaused;
+    endEdit();
+}
+
+void hduSimulationRunner::beginEdit()
+{
+    m_pData->lockStep();
+}
+
+void hduSimulationRunner::endEdit()
+{
+    m_pData->unlockStep();
+}
+
+void hduSimulationRunner::advance(double duration)
+{
+    beginEdit();
+
+    int nSteps = (int) (duration * m_rate + 0.5);
+    for (int i = 0; i < nSteps; i++)
+    {
+        doStep(1 / m_rate);
+    }
+
+    endEdit();
+}
+
+double hduSimulationRunner::getStepRate() const
+{
+    m_pData->lockStats();
+    double stepRate = m_stepRate;
+    m_pData->unlockStats();
+    return stepRate;
+}
+
+unsigned long hduSimulationRunner::getOverruns() const
+{
+    return (unsigned long) hduAtomicLoad(&m_nOverruns);
+}
+
+double hduSimulationRunner::getTime() const
+{
+    m_pData->lockStats();
+    double time = m_time;
+    m_pData->unlockStats();
+    return time;
+}
+
+/******************************************************************************
+ Called with the step lock held, so only this thread writes the time.
+******************************************************************************/
+void hduSimulationRunner::doStep(double dt)
+{
+    m_pStep(m_time, dt, m_pUserData);
+
+    m_pData->lockStats();
+    m_time += dt;
+    m_pData->unlockStats();
+}
+
+/******************************************************************************
+ The simulation thread.  An edit in progress holds off stepping; the time
+ keeps accumulating and is made up once the edit ends.
+******************************************************************************/
+void hduSimulationRunner::run()
+{
+    double last = m_pData->getClock();
+    double accumulator = 0;
+    double dt = 1 / m_rate;
+    bool bHeldOff = false;
+
+    double statsStart = last;
+    unsigned long nStatsSteps = 0;
+
+    while (!hduAtomicLoad(&m_bStopRequested))
+    {
+        if (m_pData->tryLockStep())
+        {
+            double now = m_pData->getClock();
+            accumulator += now - last;
+            last = now;
+            dt = 1 / m_rate;
+
+            if (m_bPaused)
+            {
+                accumulator = 0;
+            }
+
+            int nSubsteps = 0;
+            while (accumulator >= dt && nSubsteps < m_nMaxSubsteps)
+            {
+                doStep(dt);
+                accumulator -= dt;
+                nSubsteps++;
+            }
+            nStatsSteps += nSubsteps;
+
+            /* Can't keep up.  Drop the time rather than fall further behind;
+               time lost to a long edit is not the simulation's fault. */
+            if (accumulator >= dt)
+            {
+                if (!bHeldOff)
+                {
+                    hduAtomicIncrement(&m_nOverruns);
+                }
+                accumulator = fmod(accumulator, dt);
+            }
+            bHeldOff = false;
+
+            m_pData->unlockStep();
+        }
+        else
+        {
+            bHeldOff = true;
+        }
+
+        double now = m_pData->getClock();
+        if (now - statsStart >= kStatsPeriod)
+        {
+            m_pData->lockStats();
+            m_stepRate = nStatsSteps / (now - statsStart);
+            m_pData->unlockStats();
+            statsStart = now;
+            nStatsSteps = 0;
+        }
+
+        /* Wake up when the next step is due, or try again a step later. */
+        m_pData->sleepUntil(bHeldOff ? now + dt : last + dt - accumulator);
+    }
+}
+
+/*****************************************************************************/
@@ -0,0 +1,891 @@
+/*****************************************************************************
+
+Copyright (c) 2004 SensAble Technologies, Inc. All rights reserved.
+
+OpenHaptics(TM) toolkit. The material embodied in this software and use of
+this software is subject to the terms and conditions of the clickthrough
+Development License Agreement.
+
+For questions, comments or bug reports, go to forums at:
+    http://dsc.sensable.com
+
+Module Name:
+
+  hduSpatialIndex.cpp
+
+Description:
+
+  Nearest point queries over the vertices of a mesh or a set of particles.
+
+******************************************************************************/
+
+#include "hduAfx.h"
+
+#include <assert.h>
+#include <math.h>
+#include <stdlib.h>
+
+#include <algorithm>
+
+#include <HDU/hduSpatialIndex.h>
+
+namespace
+{
+
+/* Most points in a leaf of the k-d tree. */
+const int kLeafSize = 8;
+
+/* Points in the cell of a point, on average, that hduHashGrid aims for
+   when choosing its own cell size, how many it puts up with, and how many
+   points it samples to find out. */
+const double kTargetOccupancy = 2;
+const double kMaxOccupancy = 4;
+const int kOccupancySamples = 256;
+const int kMaxCellSizeTries = 5;
+
+/* Cells are numbered with ints; coordinates further out share the outermost
+   cells, which keeps queries exact but slow. */
+const double kMaxCell = 1 << 28;
+
+double distanceSqr(const double *a, const double *b)
+{
+    double dx = a[0] - b[0];
+    double dy = a[1] - b[1];
+    double dz = a[2] - b[2];
+    return dx * dx + dy * dy + dz * dz;
+}
+
+/* Squared distance from q to the nearest point of the box [lo, hi]. */
+double boxDistanceSqr(const double *q, const double *lo, const double *hi)
+{
+    double d2 = 0;
+    for (int j = 0; j < 3; j++)
+    {
+        double d = 0;
+        if (q[j] < lo[j])
+        {
+            d = lo[j] - q[j];
+        }
+        else if (q[j] > hi[j])
+        {
+            d = q[j] - hi[j];
+        }
+        d2 += d * d;
+    }
+    return d2;
+}
+
+double getBound(double maxDistance)
+{
+    return maxDistance < 0 ? HUGE_VAL : maxDistance * maxDistance;
+}
+
+/*******************************************************************************
+ Visitors collect the results of a search.  The searches visit every point
+ with a squared distance to the query up to bound, in any order, and skip
+ whatever lies further; visit may lower bound as it goes.
+*******************************************************************************/
+struct NearestVisitor
+{
+    explicit NearestVisitor(double maxDistance) :
+        bound(getBound(maxDistance)),
+        nearest(-1)
+    {
+    }
+
+    void visit(int i, double d2)
+    {
+        if (d2 <= bound)
+        {
+            bound = d2;
+            nearest = i;
+        }
+    }
+
+    double bound;
+    int nearest;
+};
+
+struct KNearestVisitor
+{
+    explicit KNearestVisitor(int k) :
+        bound(HUGE_VAL),
+        k(k)
+    {
+        heap.reserve(k + 1);
+    }
+
+    void visit(int i, double d2)
+    {
+        if ((int) heap.size() == k && d2 >= bound)
+        {
+            return;
+        }
+
+        heap.push_back(std::make_pair(d2, i));
+        std::push_heap(heap.begin(), heap.end());
+        if ((int) heap.size() > k)
+        {
+            std::pop_heap(heap.begin(), heap.end());
+            heap.pop_back();
+        }
+        if ((int) heap.size() == k)
+        {
+            bound = heap.front().first;
+        }
+    }
+
+    void getResult(std::vector<int> &result)
+    {
+        std::sort_heap(heap.begin(), heap.end());
+        result.resize(heap.size());
+        for (size_t j = 0; j < heap.size(); j++)
+        {
+            result[j] = heap[j].second;
+        }
+    }
+
+    double bound;
+    int k;
+    std::vector<std::pair<double, int> > heap;  /* farthest on top */
+};
+
+struct RadiusVisitor
+{
+    RadiusVisitor(double radius, std::vector<int> &result) :
+        bound(radius * radius),
+        result(result)
+    {
+        result.clear();
+    }
+
+    void visit(int i, double d2)
+    {
+        if (d2 <= bound)
+        {
+            result.push_back(i);
+        }
+    }
+
+    double bound;
+    std::vector<int> &result;
+};
+
+} /* anonymous namespace */
+
+/*******************************************************************************
+ hduKdTree
+*******************************************************************************/
+hduKdTree::hduKdTree()
+{
+}
+
+void hduKdTree::clear()
+{
+    m_nodes.clear();
+    m_index.clear();
+    m_points.clear();
+}
+
+void hduKdTree::build(const double *points, int nPoints)
+{
+    assert(nPoints >= 0);
+
+    clear();
+    if (nPoints == 0)
+    {
+        return;
+    }
+
+    m_points.assign(points, points + 3 * nPoints);
+    m_index.resize(nPoints);
+    for (int i = 0; i < nPoints; i++)
+    {
+        m_index[i] = i;
+    }
+
+    m_nodes.reserve(2 * (nPoints / kLeafSize + 1));
+    m_nodes.resize(1);
+    buildNode(0, 0, nPoints);
+
+    refit(points);
+}
+
+namespace
+{
+
+struct CompareAxis
+{
+    CompareAxis(const double *points, int axis) :
+        points(points), axis(axis)
+    {
+    }
+
+    bool operator()(int a, int b) const
+    {
+        return points[3 * a + axis] < points[3 * b + axis];
+    }
+
+    const double *points;
+    int axis;
+};
+
+} /* anonymous namespace */
+
+/* Splits the points at the median of the longest side of their box.  Runs
+   before the points are put in tree order, so m_points is still indexed by
+   point number. */
+void hduKdTree::buildNode(int iNode, int begin, int end)
+{
+    m_nodes[iNode].begin = begin;
+    m_nodes[iNode].end = end;
+    m_nodes[iNode].left = 0;
+
+    if (end - begin <= kLeafSize)
+    {
+        return;
+    }
+
+    double lo[3], hi[3];
+    const double *p = &m_points[3 * m_index[begin]];
+    for (int j = 0; j < 3; j++)
+    {
+        lo[j] = hi[j] = p[j];
+    }
+    for (int i = begin + 1; i < end; i++)
+    {
+        p = &m_points[3 * m_index[i]];
+        for (int j = 0; j < 3; j++)
+        {
+            lo[j] = std::min(lo[j], p[j]);
+            hi[j] = std::max(hi[j], p[j]);
+        }
+    }
+
+    int axis = 0;
+    for (int j = 1; j < 3; j++)
+    {
+        if (hi[j] - lo[j] > hi[axis] - lo[axis])
+        {
+            axis = j;
+        }
+    }
+
+    int mid = begin + (end - begin) / 2;
+    std::nth_element(m_index.begin() + begin, m_index.begin() + mid,
+                     m_index.begin() + end, CompareAxis(&m_points[0], axis));
+
+    int left = (int) m_nodes.size();
+    m_nodes[iNode].left = left;
+    m_nodes.resize(left + 2);
+
+    buildNode(left, begin, mid);
+    buildNode(left + 1, mid, end);
+}
+
+void hduKdTree::refit(const double *points)
+{
+    const int nPoints = (int) m_index.size();
+    for (int i = 0; i < nPoints; i++)
+    {
+        const double *p = points + 3 * m_index[i];
+        m_points[3 * i] = p[0];
+        m_points[3 * i + 1] = p[1];
+        m_points[3 * i + 2] = p[2];
+    }
+
+    computeBounds();
+}
+
+/* Children always come after their parent, so walking the nodes backwards
+   finishes both children before the parent. */
+void hduKdTree::computeBounds()
+{
+    for (int iNode = (int) m_nodes.size() - 1; iNode >= 0; iNode--)
+    {
+        Node &node = m_nodes[iNode];
+
+        if (node.left == 0)
+        {
+            const double *p = &m_points[3 * node.begin];
+            for (int j = 0; j < 3; j++)
+            {
+                node.lo[j] = node.hi[j] = p[j];
+            }
+            for (int i = node.begin + 1; i < node.end; i++)
+            {
+                p = &m_points[3 * i];
+                for (int j = 0; j < 3; j++)
+                {
+                    node.lo[j] = std::min(node.lo[j], p[j]);
+                    node.hi[j] = std::max(node.hi[j], p[j]);
+                }
+            }
+        }
+        else
+        {
+            const Node &left = m_nodes[node.left];
+            const Node &right = m_nodes[node.left + 1];
+            for (int j = 0; j < 3; j++)
+            {
+                node.lo[j] = std::min(left.lo[j], right.lo[j]);
+                node.hi[j] = std::max(left.hi[j], right.hi[j]);
+            }
+        }
+    }
+}
+
+/* Visits the nearer child first, so that the bound has shrunk by the time
+   the farther one is looked at. */
+template <class Visitor>
+void hduKdTree::searchNode(int iNode, const double *q,
+                           Visitor &visitor) const
+{
+    const Node &node = m_nodes[iNode];
+
+    if (node.left == 0)
+    {
+        for (int i = node.begin; i < node.end; i++)
+        {
+            double d2 = distanceSqr(q, &m_points[3 * i]);
+            if (d2 <= visitor.bound)
+            {
+                visitor.visit(m_index[i], d2);
+            }
+        }
+        return;
+    }
+
+    int near = node.left;
+    int far = node.left + 1;
+    double dNear = boxDistanceSqr(q, m_nodes[near].lo, m_nodes[near].hi);
+    double dFar = boxDistanceSqr(q, m_nodes[far].lo, m_nodes[far].hi);
+    if (dFar < dNear)
+    {
+        std::swap(near, far);
+        std::swap(dNear, dFar);
+    }
+
+    if (dNear <= visitor.bound)
+    {
+        searchNode(near, q, visitor);
+    }
+    if (dFar <= visitor.bound)
+    {
+        searchNode(far, q, visitor);
+    }
+}
+
+int hduKdTree::findNearest(const hduVector3Dd &query, double maxDistance,
+                           double *pDistanceSqr) const
+{
+    NearestVisitor visitor(maxDistance);
+    if (!m_nodes.empty() &&
+        boxDistanceSqr(&query[0], m_nodes[0].lo, m_nodes[0].hi) <=
+        visitor.bound)
+    {
+        searchNode(0, &query[0], visitor);
+    }
+
+    if (pDistanceSqr && visitor.nearest != -1)
+    {
+        *pDistanceSqr = visitor.bound;
+    }
+    return visitor.nearest;
+}
+
+void hduKdTree::findKNearest(const hduVector3Dd &query, int k,
+                             std::vector<int> &result) const
+{
+    result.clear();
+    if (k <= 0 || m_nodes.empty())
+    {
+        return;
+    }
+
+    KNearestVisitor visitor(k);
+    searchNode(0, &query[0], visitor);
+    visitor.getResult(result);
+}
+
+void hduKdTree::findInRadius(const hduVector3Dd &query, double radius,
+                             std::vector<int> &result) const
+{
+    RadiusVisitor visitor(radius, result);
+    if (radius >= 0 && !m_nodes.empty() &&
+        boxDistanceSqr(&query[0], m_nodes[0].lo, m_nodes[0].hi) <=
+        visitor.bound)
+    {
+        searchNode(0, &query[0], visitor);
+    }
+}
+
+/*******************************************************************************
+ hduHashGrid
+*******************************************************************************/
+hduHashGrid::hduHashGrid() :
+    m_cellSize(0),
+    m_invCellSize(0),
+    m_bAutoCellSize(true),
+    m_bucketMask(0)
+{
+}
+
+void hduHashGrid::setCellSize(double cellSize)
+{
+    assert(cellSize >= 0);
+
+    m_bAutoCellSize = cellSize == 0;
+    if (!m_bAutoCellSize)
+    {
+        m_cellSize = cellSize;
+        m_invCellSize = 1 / cellSize;
+    }
+}
+
+void hduHashGrid::clear()
+{
+    m_buckets.clear();
+    m_bucketMask = 0;
+    m_next.clear();
+    m_prev.clear();
+    m_cells.clear();
+    m_points.clear();
+}
+
+void hduHashGrid::setPoints(const double *points, int nPoints)
+{
+    assert(nPoints >= 0);
+
+    clear();
+    if (nPoints == 0)
+    {
+        return;
+    }
+
+    m_points.assign(points, points + 3 * nPoints);
+
+    unsigned int nBuckets = 16;
+    while (nBuckets < 2 * (unsigned int) nPoints)
+    {
+        nBuckets *= 2;
+    }
+    m_buckets.resize(nBuckets);
+    m_bucketMask = nBuckets - 1;
+
+    m_next.resize(nPoints);
+    m_prev.resize(nPoints);
+    m_cells.resize(nPoints);
+
+    if (m_bAutoCellSize)
+    {
+        chooseCellSize();
+    }
+    else
+    {
+        linkAll();
+    }
+}
+
+/* Aims for a few points per cell.  The first guess takes the largest of
+   the spacings the points would have if spread evenly through their box,
+   over its two longest sides, or along its longest side; the others come
+   out smaller.  Points that are not spread evenly, such as a curved
+   surface in a box of some depth, crowd into fewer cells, so the guess is
+   shrunk until a sample of the points finds few enough others in their
+   cells. */
+void hduHashGrid::chooseCellSize()
+{
+    const int nPoints = getNumPoints();
+
+    double lo[3], hi[3];
+    for (int j = 0; j < 3; j++)
+    {
+        lo[j] = hi[j] = m_points[j];
+    }
+    for (int i = 1; i < nPoints; i++)
+    {
+        for (int j = 0; j < 3; j++)
+        {
+            lo[j] = std::min(lo[j], m_points[3 * i + j]);
+            hi[j] = std::max(hi[j], m_points[3 * i + j]);
+        }
+    }
+
+    double extent[3];
+    for (int j = 0; j < 3; j++)
+    {
+        extent[j] = hi[j] - lo[j];
+    }
+    std::sort(extent, extent + 3);
+
+    double volumeSpacing = pow(extent[0] * extent[1] * extent[2] / nPoints,
+                               1.0 / 3);
+    double areaSpacing = sqrt(extent[1] * extent[2] / nPoints);
+    double lineSpacing = extent[2] / nPoints;
+
+    double cellSize = std::max(volumeSpacing,
+                               std::max(areaSpacing, lineSpacing));
+    if (!(cellSize > 0))
+    {
+        /* all the points in one place */
+        cellSize = 1;
+    }
+
+    for (int nTries = 0; ; nTries++)
+    {
+        m_cellSize = cellSize;
+        m_invCellSize = 1 / cellSize;
+        linkAll();
+
+        double occupancy = getOccupancy();
+        if (occupancy <= kMaxOccupancy || nTries == kMaxCellSizeTries)
+        {
+            break;
+        }
+        cellSize /= pow(occupancy / kTargetOccupancy, 1.0 / 3);
+    }
+}
+
+void hduHashGrid::linkAll()
+{
+    const int nPoints = getNumPoints();
+
+    std::fill(m_buckets.begin(), m_buckets.end(), -1);
+
+    getCell(&m_points[0], m_boundsLo);
+    m_boundsHi = m_boundsLo;
+
+    for (int i = 0; i < nPoints; i++)
+    {
+        getCell(&m_points[3 * i], m_cells[i]);
+        growBounds(m_cells[i]);
+        link(i);
+    }
+}
+
+/* Average number of points in the cell of a point, over a sample. */
+double hduHashGrid::getOccupancy() const
+{
+    const int nPoints = getNumPoints();
+    const int nSamples = std::min(nPoints, kOccupancySamples);
+
+    long total = 0;
+    for (int s = 0; s < nSamples; s++)
+    {
+        const Cell &cell = m_cells[(long) s * nPoints / nSamples];
+        for (int i = m_buckets[getBucket(cell)]; i != -1; i = m_next[i])
+        {
+            if (isSameCell(m_cells[i], cell))
+            {
+                total++;
+            }
+        }
+    }
+    return total / (double) nSamples;
+}
+
+void hduHashGrid::updatePoint(int i, const hduVector3Dd &position)
+{
+    assert(i >= 0 && i < getNumPoints());
+
+    double *p = &m_points[3 * i];
+    p[0] = position[0];
+    p[1] = position[1];
+    p[2] = position[2];
+
+    Cell cell;
+    getCell(p, cell);
+    if (!isSameCell(cell, m_cells[i]))
+    {
+        unlink(i);
+        m_cells[i] = cell;
+        growBounds(cell);
+        link(i);
+    }
+}
+
+void hduHashGrid::updatePoints(const double *points)
+{
+    const int nPoints = getNumPoints();
+    for (int i = 0; i < nPoints; i++)
+    {
+        updatePoint(i, hduVector3Dd(points[3 * i], points[3 * i + 1],
+                                    points[3 * i + 2]));
+    }
+}
+
+void hduHashGrid::getCell(const double *p, Cell &cell) const
+{
+    for (int j = 0; j < 3; j++)
+    {
+        double c = floor(p[j] * m_invCellSize);
+        c = std::max(-kMaxCell, std::min(kMaxCell, c));
+        cell.c[j] = (int) c;
+    }
+}
+
+unsigned int hduHashGrid::getBucket(const Cell &cell) const
+{
+    return (((unsigned int) cell.c[0] * 73856093u) ^
+            ((unsigned int) cell.c[1] * 19349663u) ^
+            ((unsigned int) cell.c[2] * 83492791u)) & m_bucketMask;
+}
+
+bool hduHashGrid::isSameCell(const Cell &a, const Cell &b)
+{
+    return a.c[0] == b.c[0] && a.c[1] == b.c[1] && a.c[2] == b.c[2];
+}
+
+void hduHashGrid::link(int i)
+{
+    int &head = m_buckets[getBucket(m_cells[i])];
+    m_prev[i] = -1;
+    m_next[i] = head;
+    if (head != -1)
+    {
+        m_prev[head] = i;
+    }
+    head = i;
+}
+
+void hduHashGrid::unlink(int i)
+{
+    if (m_prev[i] != -1)
+    {
+        m_next[m_prev[i]] = m_next[i];
+    }
+    else
+    {
+        m_buckets[getBucket(m_cells[i])] = m_next[i];
+    }
+
+    if (m_next[i] != -1)
+    {
+        m_prev[m_next[i]] = m_prev[i];
+    }
+}
+
+void hduHashGrid::growBounds(const Cell &cell)
+{
+    for (int j = 0; j < 3; j++)
+    {
+        m_boundsLo.c[j] = std::min(m_boundsLo.c[j], cell.c[j]);
+        m_boundsHi.c[j] = std::max(m_boundsHi.c[j], cell.c[j]);
+    }
+}
+
+/* A bucket holds the points of every cell that hashes to it; only those of
+   the cell asked for are visited, so no point is visited twice. */
+template <class Visitor>
+void hduHashGrid::visitCell(const Cell &cell, const double *q,
+                            Visitor &visitor) const
+{
+    for (int i = m_buckets[getBucket(cell)]; i != -1; i = m_next[i])
+    {
+        if (isSameCell(m_cells[i], cell))
+        {
+            double d2 = distanceSqr(q, &m_points[3 * i]);
+            if (d2 <= visitor.bound)
+            {
+                visitor.visit(i, d2);
+            }
+        }
+    }
+}
+
+/* Visits the cells at Chebyshev distance ring from center that lie within
+   the bounds, and returns how many there were. */
+template <class Visitor>
+int hduHashGrid::visitShell(const Cell &center, int ring, const double *q,
+                            Visitor &visitor) const
+{
+    int lo[3], hi[3];
+    for (int j = 0; j < 3; j++)
+    {
+        lo[j] = std::max(center.c[j] - ring, m_boundsLo.c[j]);
+        hi[j] = std::min(center.c[j] + ring, m_boundsHi.c[j]);
+        if (lo[j] > hi[j])
+        {
+            return 0;
+        }
+    }
+
+    int nCells = 0;
+    Cell cell;
+    for (cell.c[0] = lo[0]; cell.c[0] <= hi[0]; cell.c[0]++)
+    {
+        bool onX = abs(cell.c[0] - center.c[0]) == ring;
+        for (cell.c[1] = lo[1]; cell.c[1] <= hi[1]; cell.c[1]++)
+        {
+            bool onXY = onX || abs(cell.c[1] - center.c[1]) == ring;
+            if (onXY)
+            {
+                for (cell.c[2] = lo[2]; cell.c[2] <= hi[2]; cell.c[2]++)
+                {
+                    visitCell(cell, q, visitor);
+                    nCells++;
+                }
+            }
+            else
+            {
+                /* only the two faces normal to z */
+                int zs[2] = { center.c[2] - ring, center.c[2] + ring };
+                for (int s = 0; s < 2; s++)
+                {
+                    cell.c[2] = zs[s];
+                    if (cell.c[2] >= lo[2] && cell.c[2] <= hi[2])
+                    {
+                        visitCell(cell, q, visitor);
+                        nCells++;
+                    }
+                }
+            }
+        }
+    }
+    return nCells;
+}
+
+/* Searches rings of cells outward from the query, stopping once a ring is
+   too far away to hold anything within the bound.  A point in ring r is at
+   least (r - 1) cells away.  If the rings cover more cells than there are
+   points, as when the points are few and far between, the rest of the
+   points are checked one by one instead. */
+template <class Visitor>
+void hduHashGrid::searchOutward(const double *q, Visitor &visitor) const
+{
+    const int nPoints = getNumPoints();
+    if (nPoints == 0)
+    {
+        return;
+    }
+
+    Cell center;
+    getCell(q, center);
+
+    int firstRing = 0;
+    int lastRing = 0;
+    for (int j = 0; j < 3; j++)
+    {
+        firstRing = std::max(firstRing, m_boundsLo.c[j] - center.c[j]);
+        firstRing = std::max(firstRing, center.c[j] - m_boundsHi.c[j]);
+        lastRing = std::max(lastRing, center.c[j] - m_boundsLo.c[j]);
+        lastRing = std::max(lastRing, m_boundsHi.c[j] - center.c[j]);
+    }
+
+    int nCells = 0;
+    for (int ring = firstRing; ring <= lastRing; ring++)
+    {
+        double gap = (ring - 1) * m_cellSize;
+        if (ring > 0 && gap * gap > visitor.bound)
+        {
+            return;
+        }
+
+        if (nCells > nPoints)
+        {
+            for (int i = 0; i < nPoints; i++)
+            {
+                const Cell &cell = m_cells[i];
+                int distance = 0;
+                for (int j = 0; j < 3; j++)
+                {
+                    distance = std::max(distance,
+                                        abs(cell.c[j] - center.c[j]));
+                }
+
+                double d2 = distanceSqr(q, &m_points[3 * i]);
+                if (distance >= ring && d2 <= visitor.bound)
+                {
+                    visitor.visit(i, d2);
+                }
+            }
+            return;
+        }
+
+        nCells += visitShell(center, ring, q, visitor);
+    }
+}
+
+int hduHashGrid::findNearest(const hduVector3Dd &query, double maxDistance,
+                             double *pDistanceSqr) const
+{
+    NearestVisitor visitor(maxDistance);
+    searchOutward(&query[0], visitor);
+
+    if (pDistanceSqr && visitor.nearest != -1)
+    {
+        *pDistanceSqr = visitor.bound;
+    }
+    return visitor.nearest;
+}
+
+void hduHashGrid::findKNearest(const hduVector3Dd &query, int k,
+                               std::vector<int> &result) const
+{
+    result.clear();
+    if (k <= 0)
+    {
+        return;
+    }
+
+    KNearestVisitor visitor(k);
+    searchOutward(&query[0], visitor);
+    visitor.getResult(result);
+}
+
+void hduHashGrid::findInRadius(const hduVector3Dd &query, double radius,
+                               std::vector<int> &result) const
+{
+    RadiusVisitor visitor(radius, result);
+    const int nPoints = getNumPoints();
+    if (radius < 0 || nPoints == 0)
+    {
+        return;
+    }
+
+    const double *q = &query[0];
+    double lo[3] = { q[0] - radius, q[1] - radius, q[2] - radius };
+    double hi[3] = { q[0] + radius, q[1] + radius, q[2] + radius };
+
+    Cell cellLo, cellHi;
+    getCell(lo, cellLo);
+    getCell(hi, cellHi);
+
+    double nCells = 1;
+    for (int j = 0; j < 3; j++)
+    {
+        cellLo.c[j] = std::max(cellLo.c[j], m_boundsLo.c[j]);
+        cellHi.c[j] = std::min(cellHi.c[j], m_boundsHi.c[j]);
+        if (cellLo.c[j] > cellHi.c[j])
+        {
+            return;
+        }
+        nCells *= cellHi.c[j] - cellLo.c[j] + 1;
+    }
+
+    /* a radius much larger than the cells */
+    if (nCells > nPoints)
+    {
+        for (int i = 0; i < nPoints; i++)
+        {
+            visitor.visit(i, distanceSqr(q, &m_points[3 * i]));
+        }
+        return;
+    }
+
+    Cell cell;
+    for (cell.c[0] = cellLo.c[0]; cell.c[0] <= cellHi.c[0]; cell.c[0]++)
+    {
+        for (cell.c[1] = cellLo.c[1]; cell.c[1] <= cellHi.c[1]; cell.c[1]++)
+        {
+            for (cell.c[2] = cellLo.c[2]; cell.c[2] <= cellHi.c[2];
+                 cell.c[2]++)
+            {
+                visitCell(cell, q, visitor);
+            }
+        }
+    }
+}
+
+/******************************************************************************/
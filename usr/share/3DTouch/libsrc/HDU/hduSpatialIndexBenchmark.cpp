@@ -0,0 +1,300 @@
+/*****************************************************************************
+
+Copyright (c) 2004 SensAble Technologies, Inc. All rights reserved.
+
+OpenHaptics(TM) toolkit. The material embodied in this software and use of
+this software is subject to the terms and conditions of the clickthrough
+Development License Agreement.
+
+For questions, comments or bug reports, go to forums at:
+    http://dsc.sensable.com
+
+Module Name:
+
+  hduSpatialIndexBenchmark.cpp
+
+Description:
+
+  Times the queries of hduKdTree and hduHashGrid against a search through
+  every point, and checks that they find the same points.
+  Usage: hduSpatialIndexBenchmark [number of points]
+
+******************************************************************************/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <math.h>
+#include <time.h>
+
+#include <algorithm>
+#include <vector>
+
+#include <HDU/hduVector.h>
+#include <HDU/hduSpatialIndex.h>
+
+namespace
+{
+
+const int kNumQueries = 10000;
+const int kNumLinearQueries = 20;
+const int kK = 8;
+
+double getTime()
+{
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return now.tv_sec + now.tv_nsec * 1e-9;
+}
+
+double randomInRange(double lo, double hi)
+{
+    return lo + (hi - lo) * (rand() / (double) RAND_MAX);
+}
+
+/*******************************************************************************
+ The search callers write today.
+*******************************************************************************/
+int findNearestLinear(const std::vector<hduVector3Dd> &points,
+                      const hduVector3Dd &query)
+{
+    int nearest = -1;
+    double nearestDist = 0;
+    for (size_t i = 0; i < points.size(); i++)
+    {
+        double dist = query.distanceSqr(points[i]);
+        if (nearest == -1 || dist < nearestDist)
+        {
+            nearestDist = dist;
+            nearest = (int) i;
+        }
+    }
+    return nearest;
+}
+
+/* Squared distances of the k nearest points, nearest first. */
+void findKNearestLinear(const std::vector<hduVector3Dd> &points,
+                        const hduVector3Dd &query, int k,
+                        std::vector<double> &result)
+{
+    result.resize(points.size());
+    for (size_t i = 0; i < points.size(); i++)
+    {
+        result[i] = query.distanceSqr(points[i]);
+    }
+    k = std::min(k, (int) result.size());
+    std::partial_sort(result.begin(), result.begin() + k, result.end());
+    result.resize(k);
+}
+
+int countInRadiusLinear(const std::vector<hduVector3Dd> &points,
+                        const hduVector3Dd &query, double radius)
+{
+    int count = 0;
+    for (size_t i = 0; i < points.size(); i++)
+    {
+        if (query.distanceSqr(points[i]) <= radius * radius)
+        {
+            count++;
+        }
+    }
+    return count;
+}
+
+/*******************************************************************************
+ Times and checks one index.  Results are compared by distance, since
+ points at the same distance may come back in either order.
+*******************************************************************************/
+template <class Index>
+void benchmarkQueries(const char *pName, const Index &index,
+                      const std::vector<hduVector3Dd> &points,
+                      const std::vector<hduVector3Dd> &queries,
+                      double radius)
+{
+    std::vector<int> result;
+    long total = 0;
+
+    double start = getTime();
+    for (size_t q = 0; q < queries.size(); q++)
+    {
+        total += index.findNearest(queries[q]);
+    }
+    double nearestTime = (getTime() - start) / queries.size();
+
+    start = getTime();
+    for (size_t q = 0; q < queries.size(); q++)
+    {
+        index.findKNearest(queries[q], kK, result);
+        total += result[0];
+    }
+    double kNearestTime = (getTime() - start) / queries.size();
+
+    long nFound = 0;
+    start = getTime();
+    for (size_t q = 0; q < queries.size(); q++)
+    {
+        index.findInRadius(queries[q], radius, result);
+        nFound += result.size();
+    }
+    double radiusTime = (getTime() - start) / queries.size();
+
+    int nErrors = 0;
+    std::vector<double> expected;
+    for (int q = 0; q < kNumLinearQueries; q++)
+    {
+        const hduVector3Dd &query = queries[q];
+
+        int nearest = index.findNearest(query);
+        int expectedNearest = findNearestLinear(points, query);
+        if (query.distanceSqr(points[nearest]) !=
+            query.distanceSqr(points[expectedNearest]))
+        {
+            nErrors++;
+        }
+
+        index.findKNearest(query, kK, result);
+        findKNearestLinear(points, query, kK, expected);
+        if (result.size() != expected.size())
+        {
+            nErrors++;
+        }
+        else
+        {
+            for (size_t j = 0; j < result.size(); j++)
+            {
+                if (query.distanceSqr(points[result[j]]) != expected[j])
+                {
+                    nErrors++;
+                }
+            }
+        }
+
+        index.findInRadius(query, radius, result);
+        if ((int) result.size() != countInRadiusLinear(points, query, radius))
+        {
+            nErrors++;
+        }
+    }
+
+    printf("  %-9s nearest %7.2f us  %d-nearest %7.2f us  "
+           "radius %7.2f us (%.1f found)  %s\n",
+           pName, nearestTime * 1e6, kK, kNearestTime * 1e6,
+           radiusTime * 1e6, nFound / (double) queries.size(),
+           nErrors ? "MISMATCH" : "ok");
+    if (total == -1)
+    {
+        printf("\n");
+    }
+}
+
+void benchmark(const char *pName, std::vector<hduVector3Dd> &points,
+               double spacing)
+{
+    const int n = (int) points.size();
+    printf("%s, %d points\n", pName, n);
+
+    /* queries near the points, as from a device touching them */
+    std::vector<hduVector3Dd> queries(kNumQueries);
+    for (int q = 0; q < kNumQueries; q++)
+    {
+        const hduVector3Dd &p = points[rand() % n];
+        queries[q] = p + hduVector3Dd(randomInRange(-5, 5),
+                                      randomInRange(-5, 5),
+                                      randomInRange(-5, 5)) * spacing;
+    }
+    double radius = 2 * spacing;
+
+    long total = 0;
+    double start = getTime();
+    for (int q = 0; q < kNumLinearQueries; q++)
+    {
+        total += findNearestLinear(points, queries[q]);
+    }
+    printf("  %-9s nearest %7.2f us\n", "linear",
+           (getTime() - start) / kNumLinearQueries * 1e6);
+    if (total == -1)
+    {
+        printf("\n");
+    }
+
+    hduKdTree tree;
+    start = getTime();
+    tree.build(&points[0], n);
+    double buildTime = getTime() - start;
+
+    hduHashGrid grid;
+    start = getTime();
+    grid.setPoints(&points[0], n);
+    double setTime = getTime() - start;
+
+    printf("  k-d tree build %.1f ms, hash grid set %.1f ms "
+           "(cell %.3g)\n", buildTime * 1e3, setTime * 1e3,
+           grid.getCellSize());
+
+    benchmarkQueries("k-d tree", tree, points, queries, radius);
+    benchmarkQueries("hash grid", grid, points, queries, radius);
+
+    /* deform: every point moves up to half the spacing */
+    for (int i = 0; i < n; i++)
+    {
+        points[i] += hduVector3Dd(randomInRange(-0.5, 0.5),
+                                  randomInRange(-0.5, 0.5),
+                                  randomInRange(-0.5, 0.5)) * spacing;
+    }
+
+    start = getTime();
+    tree.refit(&points[0]);
+    double refitTime = getTime() - start;
+
+    start = getTime();
+    grid.updatePoints(&points[0]);
+    double updateTime = getTime() - start;
+
+    printf("  after moving every point: k-d tree refit %.1f ms, "
+           "hash grid update %.1f ms\n", refitTime * 1e3, updateTime * 1e3);
+
+    benchmarkQueries("k-d tree", tree, points, queries, radius);
+    benchmarkQueries("hash grid", grid, points, queries, radius);
+}
+
+} /* anonymous namespace */
+
+/*******************************************************************************
+ main
+*******************************************************************************/
+int main(int argc, char *argv[])
+{
+    long n = argc > 1 ? atol(argv[1]) : 1000000;
+    if (n <= 0)
+    {
+        fprintf(stderr, "Usage: %s [number of points]\n", argv[0]);
+        return -1;
+    }
+
+    /* scattered through a cube of side 100 */
+    std::vector<hduVector3Dd> points(n);
+    for (long i = 0; i < n; i++)
+    {
+        points[i].set(randomInRange(0, 100), randomInRange(0, 100),
+                      randomInRange(0, 100));
+    }
+    benchmark("volume", points, 100 / pow((double) n, 1.0 / 3));
+
+    /* a rippled sheet, like a deformable surface or a scanned mesh */
+    int side = (int) sqrt((double) n);
+    double spacing = 100.0 / side;
+    points.resize(side * side);
+    for (int i = 0; i < side; i++)
+    {
+        for (int j = 0; j < side; j++)
+        {
+            double x = i * spacing;
+            double y = j * spacing;
+            points[i * side + j].set(x, y, 5 * sin(x / 10) * cos(y / 10));
+        }
+    }
+    benchmark("surface", points, spacing);
+
+    return 0;
+}
+
+/******************************************************************************/
@@ -0,0 +1,640 @@
+/*****************************************************************************
+
+Copyright (c) 2004 SensAble Technologies, Inc. All rights reserved.
+
+OpenHaptics(TM) toolkit. The material embodied in this software and use of
+this software is subject to the terms and conditions of the clickthrough
+Development License Agreement.
+
+For questions, comments or bug reports, go to forums at:
+    http://dsc.sensable.com
+
+Module Name:
+
+  hduTransform.cpp
+
+Description:
+
+  Batched point, direction and normal transforms with SSE2 and AVX2 paths
+  selected at runtime.
+
+******************************************************************************/
+
+#include "hduAfx.h"
+
+#include <math.h>
+
+#include <HDU/hduTransform.h>
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define HDU_TRANSFORM_X86
+#include <immintrin.h>
+#endif
+
+namespace
+{
+
+/* Kinds of transform.  Directions are affine transforms with a zero
+   translation row, normals additionally get rescaled. */
+enum Mode
+{
+    MODE_AFFINE = 0,
+    MODE_PROJECTIVE,
+    MODE_NORMAL
+};
+
+/* Row-major matrix applied to row vectors, as in multVecMatrix. */
+struct Coefficients
+{
+    double m[4][4];
+};
+
+typedef void (*DoubleKernel)(const Coefficients &c, const double *in,
+                             double *out, size_t n);
+typedef void (*FloatKernel)(const Coefficients &c, const float *in,
+                            float *out, size_t n);
+
+struct KernelTable
+{
+    DoubleKernel doubleKernels[3];
+    FloatKernel floatKernels[3];
+};
+
+/*******************************************************************************
+ Portable kernel.  Also finishes the few vectors left over by the SIMD
+ kernels.
+*******************************************************************************/
+template <int MODE, class T>
+void transformScalar(const Coefficients &c, const T *in, T *out, size_t n)
+{
+    const double (*m)[4] = c.m;
+
+    for (size_t i = 0; i < n; ++i, in += 3, out += 3)
+    {
+        double x = in[0];
+        double y = in[1];
+        double z = in[2];
+
+        double rx = x * m[0][0] + y * m[1][0] + z * m[2][0] + m[3][0];
+        double ry = x * m[0][1] + y * m[1][1] + z * m[2][1] + m[3][1];
+        double rz = x * m[0][2] + y * m[1][2] + z * m[2][2] + m[3][2];
+
+        if (MODE == MODE_PROJECTIVE)
+        {
+            double rw = x * m[0][3] + y * m[1][3] + z * m[2][3] + m[3][3];
+            rx /= rw;
+            ry /= rw;
+            rz /= rw;
+        }
+        else if (MODE == MODE_NORMAL)
+        {
+            double length = sqrt(rx * rx + ry * ry + rz * rz);
+            double scale = length > 0 ? 1.0 / length : 0.0;
+            rx *= scale;
+            ry *= scale;
+            rz *= scale;
+        }
+
+        out[0] = (T) rx;
+        out[1] = (T) ry;
+        out[2] = (T) rz;
+    }
+}
+
+const KernelTable kScalarKernels =
+{
+    {
+        transformScalar<MODE_AFFINE, double>,
+        transformScalar<MODE_PROJECTIVE, double>,
+        transformScalar<MODE_NORMAL, double>
+    },
+    {
+        transformScalar<MODE_AFFINE, float>,
+        transformScalar<MODE_PROJECTIVE, float>,
+        transformScalar<MODE_NORMAL, float>
+    }
+};
+
+#ifdef HDU_TRANSFORM_X86
+
+/*******************************************************************************
+ SSE2 kernels.  Two vectors per iteration: x0 y0 z0 x1 y1 z1 is loaded as
+ three pairs and shuffled into x, y and z pairs.
+*******************************************************************************/
+#pragma GCC push_options
+#pragma GCC target("sse2")
+
+template <int MODE>
+inline void transformSSE2(const __m128d m[4][4],
+                          __m128d &x, __m128d &y, __m128d &z)
+{
+    __m128d rx = _mm_add_pd(
+        _mm_add_pd(_mm_mul_pd(x, m[0][0]), _mm_mul_pd(y, m[1][0])),
+        _mm_add_pd(_mm_mul_pd(z, m[2][0]), m[3][0]));
+    __m128d ry = _mm_add_pd(
+        _mm_add_pd(_mm_mul_pd(x, m[0][1]), _mm_mul_pd(y, m[1][1])),
+        _mm_add_pd(_mm_mul_pd(z, m[2][1]), m[3][1]));
+    __m128d rz = _mm_add_pd(
+        _mm_add_pd(_mm_mul_pd(x, m[0][2]), _mm_mul_pd(y, m[1][2])),
+        _mm_add_pd(_mm_mul_pd(z, m[2][2]), m[3][2]));
+
+    if (MODE == MODE_PROJECTIVE)
+    {
+        __m128d rw = _mm_add_pd(
+            _mm_add_pd(_mm_mul_pd(x, m[0][3]), _mm_mul_pd(y, m[1][3])),
+            _mm_add_pd(_mm_mul_pd(z, m[2][3]), m[3][3]));
+        rx = _mm_div_pd(rx, rw);
+        ry = _mm_div_pd(ry, rw);
+        rz = _mm_div_pd(rz, rw);
+    }
+    else if (MODE == MODE_NORMAL)
+    {
+        __m128d length = _mm_sqrt_pd(_mm_add_pd(
+            _mm_add_pd(_mm_mul_pd(rx, rx), _mm_mul_pd(ry, ry)),
+            _mm_mul_pd(rz, rz)));
+        __m128d scale = _mm_and_pd(
+            _mm_cmpgt_pd(length, _mm_setzero_pd()),
+            _mm_div_pd(_mm_set1_pd(1.0), length));
+        rx = _mm_mul_pd(rx, scale);
+        ry = _mm_mul_pd(ry, scale);
+        rz = _mm_mul_pd(rz, scale);
+    }
+
+    x = rx;
+    y = ry;
+    z = rz;
+}
+
+inline void broadcastSSE2(const Coefficients &c, __m128d m[4][4])
+{
+    for (int i = 0; i < 4; ++i)
+    {
+        for (int j = 0; j < 4; ++j)
+        {
+            m[i][j] = _mm_set1_pd(c.m[i][j]);
+        }
+    }
+}
+
+template <int MODE>
+void transformDoubleSSE2(const Coefficients &c, const double *in,
+                         double *out, size_t n)
+{
+    __m128d m[4][4];
+    broadcastSSE2(c, m);
+
+    size_t i = 0;
+    for (; i + 2 <= n; i += 2, in += 6, out += 6)
+    {
+        __m128d a = _mm_loadu_pd(in);       /* x0 y0 */
+        __m128d b = _mm_loadu_pd(in + 2);   /* z0 x1 */
+        __m128d d = _mm_loadu_pd(in + 4);   /* y1 z1 */
+
+        __m128d x = _mm_shuffle_pd(a, b, 2);
+        __m128d y = _mm_shuffle_pd(a, d, 1);
+        __m128d z = _mm_shuffle_pd(b, d, 2);
+
+        transformSSE2<MODE>(m, x, y, z);
+
+        _mm_storeu_pd(out, _mm_unpacklo_pd(x, y));
+        _mm_storeu_pd(out + 2, _mm_shuffle_pd(z, x, 2));
+        _mm_storeu_pd(out + 4, _mm_unpackhi_pd(y, z));
+    }
+
+    transformScalar<MODE>(c, in, out, n - i);
+}
+
+inline __m128d loadFloat2(const float *p)
+{
+    return _mm_cvtps_pd(_mm_loadl_pi(_mm_setzero_ps(), (const __m64 *) p));
+}
+
+inline void storeFloat2(float *p, __m128d v)
+{
+    _mm_storel_pi((__m64 *) p, _mm_cvtpd_ps(v));
+}
+
+template <int MODE>
+void transformFloatSSE2(const Coefficients &c, const float *in,
+                        float *out, size_t n)
+{
+    __m128d m[4][4];
+    broadcastSSE2(c, m);
+
+    size_t i = 0;
+    for (; i + 2 <= n; i += 2, in += 6, out += 6)
+    {
+        __m128d a = loadFloat2(in);
+        __m128d b = loadFloat2(in + 2);
+        __m128d d = loadFloat2(in + 4);
+
+        __m128d x = _mm_shuffle_pd(a, b, 2);
+        __m128d y = _mm_shuffle_pd(a, d, 1);
+        __m128d z = _mm_shuffle_pd(b, d, 2);
+
+        transformSSE2<MODE>(m, x, y, z);
+
+        storeFloat2(out, _mm_unpacklo_pd(x, y));
+        storeFloat2(out + 2, _mm_shuffle_pd(z, x, 2));
+        storeFloat2(out + 4, _mm_unpackhi_pd(y, z));
+    }
+
+    transformScalar<MODE>(c, in, out, n - i);
+}
+
+const KernelTable kSSE2Kernels =
+{
+    {
+        transformDoubleSSE2<MODE_AFFINE>,
+        transformDoubleSSE2<MODE_PROJECTIVE>,
+        transformDoubleSSE2<MODE_NORMAL>
+    },
+    {
+        transformFloatSSE2<MODE_AFFINE>,
+        transformFloatSSE2<MODE_PROJECTIVE>,
+        transformFloatSSE2<MODE_NORMAL>
+    }
+};
+
+#pragma GCC pop_options
+
+/*******************************************************************************
+ AVX2 kernels.  Four vectors per iteration, loaded as three registers
+
+   a = x0 y0 | z0 x1,  b = y1 z1 | x2 y2,  d = z2 x3 | y3 z3
+
+ and shuffled into x, y and z quadruples, then back again on the way out.
+ Floats are widened to doubles on load, which keeps the same layout.
+*******************************************************************************/
+#pragma GCC push_options
+#pragma GCC target("avx2,fma")
+
+inline __m256d fmaddAVX2(__m256d a, __m256d b, __m256d c)
+{
+    return _mm256_fmadd_pd(a, b, c);
+}
+
+template <int MODE>
+inline void transformAVX2(const __m256d m[4][4],
+                          __m256d &x, __m256d &y, __m256d &z)
+{
+    __m256d rx = fmaddAVX2(x, m[0][0], fmaddAVX2(y, m[1][0],
+                 fmaddAVX2(z, m[2][0], m[3][0])));
+    __m256d ry = fmaddAVX2(x, m[0][1], fmaddAVX2(y, m[1][1],
+                 fmaddAVX2(z, m[2][1], m[3][1])));
+    __m256d rz = fmaddAVX2(x, m[0][2], fmaddAVX2(y, m[1][2],
+                 fmaddAVX2(z, m[2][2], m[3][2])));
+
+    if (MODE == MODE_PROJECTIVE)
+    {
+        __m256d rw = fmaddAVX2(x, m[0][3], fmaddAVX2(y, m[1][3],
+                     fmaddAVX2(z, m[2][3], m[3][3])));
+        rx = _mm256_div_pd(rx, rw);
+        ry = _mm256_div_pd(ry, rw);
+        rz = _mm256_div_pd(rz, rw);
+    }
+    else if (MODE == MODE_NORMAL)
+    {
+        __m256d length = _mm256_sqrt_pd(fmaddAVX2(rx, rx,
+                         fmaddAVX2(ry, ry, _mm256_mul_pd(rz, rz))));
+        __m256d scale = _mm256_and_pd(
+            _mm256_cmp_pd(length, _mm256_setzero_pd(), _CMP_GT_OQ),
+            _mm256_div_pd(_mm256_set1_pd(1.0), length));
+        rx = _mm256_mul_pd(rx, scale);
+        ry = _mm256_mul_pd(ry, scale);
+        rz = _mm256_mul_pd(rz, scale);
+    }
+
+    x = rx;
+    y = ry;
+    z = rz;
+}
+
+inline void broadcastAVX2(const Coefficients &c, __m256d m[4][4])
+{
+    for (int i = 0; i < 4; ++i)
+    {
+        for (int j = 0; j < 4; ++j)
+        {
+            m[i][j] = _mm256_set1_pd(c.m[i][j]);
+        }
+    }
+}
+
+inline void deinterleaveAVX2(__m256d a, __m256d b, __m256d d,
+                             __m256d &x, __m256d &y, __m256d &z)
+{
+    __m256d m1 = _mm256_permute2f128_pd(a, d, 0x30);  /* x0 y0 | y3 z3 */
+    __m256d m2 = _mm256_permute2f128_pd(a, b, 0x31);  /* z0 x1 | x2 y2 */
+    __m256d m3 = _mm256_permute2f128_pd(b, d, 0x20);  /* y1 z1 | z2 x3 */
+
+    __m256d p1 = _mm256_blend_pd(m1, m2, 0xC);        /* x0 y0 | x2 y2 */
+    __m256d p2 = _mm256_blend_pd(m2, m3, 0xC);        /* z0 x1 | z2 x3 */
+    __m256d p3 = _mm256_blend_pd(m3, m1, 0xC);        /* y1 z1 | y3 z3 */
+
+    x = _mm256_shuffle_pd(p1, p2, 0xA);
+    y = _mm256_shuffle_pd(p1, p3, 0x5);
+    z = _mm256_shuffle_pd(p2, p3, 0xA);
+}
+
+inline void interleaveAVX2(__m256d x, __m256d y, __m256d z,
+                           __m256d &a, __m256d &b, __m256d &d)
+{
+    __m256d p1 = _mm256_unpacklo_pd(x, y);            /* x0 y0 | x2 y2 */
+    __m256d p2 = _mm256_shuffle_pd(z, x, 0xA);        /* z0 x1 | z2 x3 */
+    __m256d p3 = _mm256_unpackhi_pd(y, z);            /* y1 z1 | y3 z3 */
+
+    __m256d m1 = _mm256_blend_pd(p1, p3, 0xC);        /* x0 y0 | y3 z3 */
+    __m256d m2 = _mm256_blend_pd(p2, p1, 0xC);        /* z0 x1 | x2 y2 */
+    __m256d m3 = _mm256_blend_pd(p3, p2, 0xC);        /* y1 z1 | z2 x3 */
+
+    a = _mm256_permute2f128_pd(m1, m2, 0x20);
+    b = _mm256_permute2f128_pd(m3, m2, 0x30);
+    d = _mm256_permute2f128_pd(m3, m1, 0x31);
+}
+
+template <int MODE>
+void transformDoubleAVX2(const Coefficients &c, const double *in,
+                         double *out, size_t n)
+{
+    __m256d m[4][4];
+    broadcastAVX2(c, m);
+
+    size_t i = 0;
+    for (; i + 4 <= n; i += 4, in += 12, out += 12)
+    {
+        __m256d x, y, z;
+        deinterleaveAVX2(_mm256_loadu_pd(in), _mm256_loadu_pd(in + 4),
+                         _mm256_loadu_pd(in + 8), x, y, z);
+
+        transformAVX2<MODE>(m, x, y, z);
+
+        __m256d a, b, d;
+        interleaveAVX2(x, y, z, a, b, d);
+        _mm256_storeu_pd(out, a);
+        _mm256_storeu_pd(out + 4, b);
+        _mm256_storeu_pd(out + 8, d);
+    }
+
+    transformScalar<MODE>(c, in, out, n - i);
+}
+
+template <int MODE>
+void transformFloatAVX2(const Coefficients &c, const float *in,
+                        float *out, size_t n)
+{
+    __m256d m[4][4];
+    broadcastAVX2(c, m);
+
+    size_t i = 0;
+    for (; i + 4 <= n; i += 4, in += 12, out += 12)
+    {
+        __m256d x, y, z;
+        deinterleaveAVX2(_mm256_cvtps_pd(_mm_loadu_ps(in)),
+                         _mm256_cvtps_pd(_mm_loadu_ps(in + 4)),
+                         _mm256_cvtps_pd(_mm_loadu_ps(in + 8)), x, y, z);
+
+        transformAVX2<MODE>(m, x, y, z);
+
+        __m256d a, b, d;
+        interleaveAVX2(x, y, z, a, b, d);
+        _mm_storeu_ps(out, _mm256_cvtpd_ps(a));
+        _mm_storeu_ps(out + 4, _mm256_cvtpd_ps(b));
+        _mm_storeu_ps(out + 8, _mm256_cvtpd_ps(d));
+    }
+
+    transformScalar<MODE>(c, in, out, n - i);
+}
+
+const KernelTable kAVX2Kernels =
+{
+    {
+        transformDoubleAVX2<MODE_AFFINE>,
+        transformDoubleAVX2<MODE_PROJECTIVE>,
+        transformDoubleAVX2<MODE_NORMAL>
+    },
+    {
+        transformFloatAVX2<MODE_AFFINE>,
+        transformFloatAVX2<MODE_PROJECTIVE>,
+        transformFloatAVX2<MODE_NORMAL>
+    }
+};
+
+#pragma GCC pop_options
+
+#endif /* HDU_TRANSFORM_X86 */
+
+bool isSupported(hduTransformISA isa)
+{
+    switch (isa)
+    {
+        case HDU_TRANSFORM_ISA_SCALAR:
+            return true;
+#ifdef HDU_TRANSFORM_X86
+        case HDU_TRANSFORM_ISA_SSE2:
+            __builtin_cpu_init();
+            return __builtin_cpu_supports("sse2");
+        case HDU_TRANSFORM_ISA_AVX2:
+            __builtin_cpu_init();
+            return __builtin_cpu_supports("avx2") &&
+                   __builtin_cpu_supports("fma");
+#endif
+        default:
+            return false;
+    }
+}
+
+hduTransformISA detectISA()
+{
+    if (isSupported(HDU_TRANSFORM_ISA_AVX2))
+    {
+        return HDU_TRANSFORM_ISA_AVX2;
+    }
+    else if (isSupported(HDU_TRANSFORM_ISA_SSE2))
+    {
+        return HDU_TRANSFORM_ISA_SSE2;
+    }
+    return HDU_TRANSFORM_ISA_SCALAR;
+}
+
+hduTransformISA &activeISA()
+{
+    static hduTransformISA isa = detectISA();
+    return isa;
+}
+
+const KernelTable &activeKernels()
+{
+    switch (activeISA())
+    {
+#ifdef HDU_TRANSFORM_X86
+        case HDU_TRANSFORM_ISA_AVX2:
+            return kAVX2Kernels;
+        case HDU_TRANSFORM_ISA_SSE2:
+            return kSSE2Kernels;
+#endif
+        default:
+            return kScalarKernels;
+    }
+}
+
+/*******************************************************************************
+ Sets up the coefficients for transforming points by m.
+*******************************************************************************/
+Mode setupPoints(const hduMatrix &m, Coefficients &c)
+{
+    m.get(c.m);
+
+    if (m[0][3] == 0 && m[1][3] == 0 && m[2][3] == 0 && m[3][3] == 1)
+    {
+        return MODE_AFFINE;
+    }
+    return MODE_PROJECTIVE;
+}
+
+/*******************************************************************************
+ Sets up the coefficients for transforming directions by m.
+*******************************************************************************/
+Mode setupDirections(const hduMatrix &m, Coefficients &c)
+{
+    m.get(c.m);
+
+    c.m[3][0] = c.m[3][1] = c.m[3][2] = 0;
+    return MODE_AFFINE;
+}
+
+/*******************************************************************************
+ Sets up the coefficients for transforming normals by m.  The inverse
+ transpose of the upper 3x3 part is its cofactor matrix divided by the
+ determinant.  Since the result gets normalized, only the sign of the
+ determinant matters, and the cofactors are well defined for singular
+ matrices too.
+*******************************************************************************/
+Mode setupNormals(const hduMatrix &m, Coefficients &c)
+{
+    double cofactor[3][3];
+    for (int i = 0; i < 3; ++i)
+    {
+        int i1 = (i + 1) % 3;
+        int i2 = (i + 2) % 3;
+        for (int j = 0; j < 3; ++j)
+        {
+            int j1 = (j + 1) % 3;
+            int j2 = (j + 2) % 3;
+            cofactor[i][j] = m[i1][j1] * m[i2][j2] - m[i1][j2] * m[i2][j1];
+        }
+    }
+
+    double det = m[0][0] * cofactor[0][0] + m[0][1] * cofactor[0][1] +
+                 m[0][2] * cofactor[0][2];
+    double sign = det < 0 ? -1.0 : 1.0;
+
+    for (int i = 0; i < 4; ++i)
+    {
+        for (int j = 0; j < 4; ++j)
+        {
+            c.m[i][j] = (i < 3 && j < 3) ? sign * cofactor[i][j] : 0.0;
+        }
+    }
+    return MODE_NORMAL;
+}
+
+} /* anonymous namespace */
+
+/******************************************************************************
+ Transforms points by m.
+******************************************************************************/
+void hduTransformPoints(const hduMatrix &m, const double *in,
+                        double *out, size_t n)
+{
+    Coefficients c;
+    Mode mode = setupPoints(m, c);
+    activeKernels().doubleKernels[mode](c, in, out, n);
+}
+
+void hduTransformPoints(const hduMatrix &m, const float *in,
+                        float *out, size_t n)
+{
+    Coefficients c;
+    Mode mode = setupPoints(m, c);
+    activeKernels().floatKernels[mode](c, in, out, n);
+}
+
+/******************************************************************************
+ Transforms directions by m, ignoring translation.
+******************************************************************************/
+void hduTransformDirections(const hduMatrix &m, const double *in,
+                            double *out, size_t n)
+{
+    Coefficients c;
+    Mode mode = setupDirections(m, c);
+    activeKernels().doubleKernels[mode](c, in, out, n);
+}
+
+void hduTransformDirections(const hduMatrix &m, const float *in,
+                            float *out, size_t n)
+{
+    Coefficients c;
+    Mode mode = setupDirections(m, c);
+    activeKernels().floatKernels[mode](c, in, out, n);
+}
+
+/******************************************************************************
+ Transforms normals by the inverse transpose of m and normalizes them.
+******************************************************************************/
+void hduTransformNormals(const hduMatrix &m, const double *in,
+                         double *out, size_t n)
+{
+    Coefficients c;
+    Mode mode = setupNormals(m, c);
+    activeKernels().doubleKernels[mode](c, in, out, n);
+}
+
+void hduTransformNormals(const hduMatrix &m, const float *in,
+                         float *out, size_t n)
+{
+    Coefficients c;
+    Mode mode = setupNormals(m, c);
+    activeKernels().floatKernels[mode](c, in, out, n);
+}
+
+/******************************************************************************
+ Instruction set selection.
+******************************************************************************/
+hduTransformISA hduGetTransformISA()
+{
+    return activeISA();
+}
+
+bool hduSetTransformISA(hduTransformISA isa)
+{
+    if (!isSupported(isa))
+    {
+        return false;
+    }
+
+    activeISA() = isa;
+    return true;
+}
+
+bool hduIsTransformISASupported(hduTransformISA isa)
+{
+    return isSupported(isa);
+}
+
+const char *hduGetTransformISAName(hduTransformISA isa)
+{
+    switch (isa)
+    {
+        case HDU_TRANSFORM_ISA_SCALAR:
+            return "scalar";
+        case HDU_TRANSFORM_ISA_SSE2:
+            return "SSE2";
+        case HDU_TRANSFORM_ISA_AVX2:
+            return "AVX2";
+        default:
+            return "unknown";
+    }
+}
+
+/*****************************************************************************/
@@ -0,0 +1,242 @@
+/*****************************************************************************
+
+Copyright (c) 2004 SensAble Technologies, Inc. All rights reserved.
+
+OpenHaptics(TM) toolkit. The material embodied in this software and use of
+this software is subject to the terms and conditions of the clickthrough
+Development License Agreement.
+
+For questions, comments or bug reports, go to forums at:
+    http://dsc.sensable.com
+
+Module Name:
+
+  hduTransformBenchmark.cpp
+
+Description:
+
+  Compares the batched transforms in hduTransform.h against a per-element
+  hduMatrix loop, for every instruction set the processor supports.
+  Usage: hduTransformBenchmark [number of vectors]
+
+******************************************************************************/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <math.h>
+#include <time.h>
+
+#include <vector>
+
+#include <HDU/hduMatrix.h>
+#include <HDU/hduTransform.h>
+
+namespace
+{
+
+/* Minimum time spent timing each loop. */
+const double kMinSeconds = 0.2;
+
+enum Kind
+{
+    KIND_POINTS = 0,
+    KIND_DIRECTIONS,
+    KIND_NORMALS
+};
+
+double getTime()
+{
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return now.tv_sec + now.tv_nsec * 1e-9;
+}
+
+/*******************************************************************************
+ The loop callers write today.
+*******************************************************************************/
+template <class T>
+void transformPerElement(Kind kind, const hduMatrix &m,
+                         const hduMatrix &normalMatrix,
+                         const std::vector<T> &in, std::vector<T> &out)
+{
+    for (size_t i = 0; i < in.size(); i += 3)
+    {
+        hduVector3Dd src(in[i], in[i + 1], in[i + 2]);
+        hduVector3Dd dst;
+
+        switch (kind)
+        {
+            case KIND_POINTS:
+                m.multVecMatrix(src, dst);
+                break;
+            case KIND_DIRECTIONS:
+                m.multDirMatrix(src, dst);
+                break;
+            case KIND_NORMALS:
+                normalMatrix.multDirMatrix(src, dst);
+                dst.normalize();
+                break;
+        }
+
+        out[i] = (T) dst[0];
+        out[i + 1] = (T) dst[1];
+        out[i + 2] = (T) dst[2];
+    }
+}
+
+template <class T>
+void transformBatch(Kind kind, const hduMatrix &m,
+                    const std::vector<T> &in, std::vector<T> &out)
+{
+    size_t n = in.size() / 3;
+    switch (kind)
+    {
+        case KIND_POINTS:
+            hduTransformPoints(m, &in[0], &out[0], n);
+            break;
+        case KIND_DIRECTIONS:
+            hduTransformDirections(m, &in[0], &out[0], n);
+            break;
+        case KIND_NORMALS:
+            hduTransformNormals(m, &in[0], &out[0], n);
+            break;
+    }
+}
+
+/*******************************************************************************
+ Returns nanoseconds per vector, repeating the loop for at least
+ kMinSeconds.
+*******************************************************************************/
+template <class T>
+double timeLoop(bool bBatch, Kind kind, const hduMatrix &m,
+                const hduMatrix &normalMatrix,
+                const std::vector<T> &in, std::vector<T> &out)
+{
+    long nRuns = 0;
+    double start = getTime();
+    double elapsed;
+    do
+    {
+        if (bBatch)
+        {
+            transformBatch(kind, m, in, out);
+        }
+        else
+        {
+            transformPerElement(kind, m, normalMatrix, in, out);
+        }
+        nRuns++;
+        elapsed = getTime() - start;
+    } while (elapsed < kMinSeconds);
+
+    return elapsed / nRuns / (in.size() / 3) * 1e9;
+}
+
+template <class T>
+double maxError(const std::vector<T> &a, const std::vector<T> &b)
+{
+    double error = 0;
+    for (size_t i = 0; i < a.size(); i++)
+    {
+        double diff = fabs((double) a[i] - (double) b[i]);
+        if (diff > error)
+        {
+            error = diff;
+        }
+    }
+    return error;
+}
+
+template <class T>
+void benchmark(const char *pName, Kind kind, const hduMatrix &m,
+               const std::vector<T> &in)
+{
+    hduMatrix normalMatrix = m.getInverse().getTranspose();
+    std::vector<T> reference(in.size());
+    std::vector<T> out(in.size());
+
+    double perElement = timeLoop(false, kind, m, normalMatrix,
+                                 in, reference);
+    printf("%-26s per-element %7.2f ns", pName, perElement);
+
+    hduTransformISA defaultISA = hduGetTransformISA();
+    for (int isa = HDU_TRANSFORM_ISA_SCALAR; isa <= HDU_TRANSFORM_ISA_AVX2;
+         isa++)
+    {
+        if (!hduSetTransformISA((hduTransformISA) isa))
+        {
+            continue;
+        }
+
+        double batch = timeLoop(true, kind, m, normalMatrix, in, out);
+        printf("  %s %6.2f ns (%4.1fx, err %.1e)",
+               hduGetTransformISAName((hduTransformISA) isa), batch,
+               perElement / batch, maxError(reference, out));
+    }
+    hduSetTransformISA(defaultISA);
+
+    printf("\n");
+}
+
+template <class T>
+void benchmarkAll(const char *pType, size_t n)
+{
+    std::vector<T> points(3 * n);
+    std::vector<T> normals(3 * n);
+    for (size_t i = 0; i < n; i++)
+    {
+        hduVector3Dd p(rand() / (double) RAND_MAX - 0.5,
+                       rand() / (double) RAND_MAX - 0.5,
+                       rand() / (double) RAND_MAX - 0.5);
+        hduVector3Dd normal = p;
+        normal.normalize();
+        for (int j = 0; j < 3; j++)
+        {
+            points[3 * i + j] = (T) (100.0 * p[j]);
+            normals[3 * i + j] = (T) normal[j];
+        }
+    }
+
+    hduMatrix affine = hduMatrix::createScale(1.0, 2.0, 0.5) *
+        hduMatrix::createRotation(hduVector3Dd(1, 2, 3), 0.7) *
+        hduMatrix::createTranslation(10, -20, 30);
+
+    hduMatrix projective = affine;
+    projective[0][3] = 0.001;
+    projective[2][3] = -0.002;
+
+    char name[64];
+    snprintf(name, sizeof(name), "%s points", pType);
+    benchmark(name, KIND_POINTS, affine, points);
+    snprintf(name, sizeof(name), "%s projective points", pType);
+    benchmark(name, KIND_POINTS, projective, points);
+    snprintf(name, sizeof(name), "%s directions", pType);
+    benchmark(name, KIND_DIRECTIONS, affine, points);
+    snprintf(name, sizeof(name), "%s normals", pType);
+    benchmark(name, KIND_NORMALS, affine, normals);
+}
+
+} /* anonymous namespace */
+
+/*******************************************************************************
+ main
+*******************************************************************************/
+int main(int argc, char *argv[])
+{
+    long n = argc > 1 ? atol(argv[1]) : 10000;
+    if (n <= 0)
+    {
+        fprintf(stderr, "Usage: %s [number of vectors]\n", argv[0]);
+        return -1;
+    }
+
+    printf("%ld vectors, default instruction set %s\n", n,
+           hduGetTransformISAName(hduGetTransformISA()));
+
+    benchmarkAll<double>("double", (size_t) n);
+    benchmarkAll<float>("float", (size_t) n);
+
+    return 0;
+}
+
+/******************************************************************************/
@@ -0,0 +1,294 @@
+/*****************************************************************************
+
+Copyright (c) 2004 SensAble Technologies, Inc. All rights reserved.
+
+OpenHaptics(TM) toolkit. The material embodied in this software and use of
+this software is subject to the terms and conditions of the clickthrough
+Development License Agreement.
+
+For questions, comments or bug reports, go to forums at:
+    http://dsc.sensable.com
+
+Module Name:
+
+  hduTransformInterpolator.cpp
+
+Description:
+
+  Smooth servo loop sampling of a transform that the graphics thread
+  updates once a frame.
+
+******************************************************************************/
+
+#include "hduAfx.h"
+
+#include <math.h>
+
+#if defined(WIN32)
+#include <windows.h>
+#else
+#include <time.h>
+#endif
+
+#include <HDU/hduTransformInterpolator.h>
+
+#include <HD/hdScheduler.h>
+
+namespace
+{
+
+/* Weight of the latest interval in the average interval between pushes. */
+const double kIntervalWeight = 0.125;
+
+} /* anonymous namespace */
+
+/*******************************************************************************
+ hduTransformInterpolator
+*******************************************************************************/
+hduTransformInterpolator::hduTransformInterpolator() :
+    m_nKeys(0),
+    m_delay(-1),
+    m_maxExtrapolation(0),
+    m_interval(0)
+{
+    /* So that the first sample never reads an unwritten buffer. */
+    publish();
+}
+
+void hduTransformInterpolator::setDelay(double delay)
+{
+    m_delay = delay;
+}
+
+void hduTransformInterpolator::setMaxExtrapolation(double maxExtrapolation)
+{
+    m_maxExtrapolation = maxExtrapolation > 0 ? maxExtrapolation : 0;
+}
+
+void hduTransformInterpolator::push(double time, const hduMatrix &pose)
+{
+    if (m_nKeys > 0 && time <= m_keys[m_nKeys - 1].time)
+    {
+        /* Keep the time of the pose replaced, so that the interval to the
+           one before stays positive. */
+        decompose(m_keys[m_nKeys - 1].time, pose, m_keys[m_nKeys - 1]);
+    }
+    else
+    {
+        if (m_nKeys > 0)
+        {
+            double interval = time - m_keys[m_nKeys - 1].time;
+            m_interval = m_nKeys == 1 && m_interval == 0 ? interval :
+                m_interval + kIntervalWeight * (interval - m_interval);
+        }
+
+        if (m_nKeys == kMaxKeys)
+        {
+            for (int i = 1; i < kMaxKeys; i++)
+            {
+                m_keys[i - 1] = m_keys[i];
+            }
+            m_nKeys--;
+        }
+        decompose(time, pose, m_keys[m_nKeys++]);
+    }
+
+    publish();
+}
+
+void hduTransformInterpolator::reset(double time, const hduMatrix &pose)
+{
+    m_nKeys = 0;
+    push(time, pose);
+}
+
+void hduTransformInterpolator::publish()
+{
+    Keys &keys = m_buffer.getWriteBuffer();
+    for (int i = 0; i < m_nKeys; i++)
+    {
+        keys.keys[i] = m_keys[i];
+    }
+    keys.nKeys = m_nKeys;
+    keys.delay = m_delay >= 0 ? m_delay : m_interval;
+    keys.maxExtrapolation = m_maxExtrapolation;
+    m_buffer.publish();
+}
+
+bool hduTransformInterpolator::sample(double time, hduMatrix &pose)
+{
+    m_buffer.update();
+    const Keys &keys = m_buffer.getReadBuffer();
+    const int n = keys.nKeys;
+
+    if (n == 0)
+    {
+        return false;
+    }
+
+    const Key &first = keys.keys[0];
+    const Key &last = keys.keys[n - 1];
+    double t = time - keys.delay;
+
+    if (n == 1 || t <= first.time)
+    {
+        const Key &key = n == 1 || t > first.time ? last : first;
+        compose(key.rotation, key.stretch, key.translation, pose);
+        return true;
+    }
+
+    if (t >= last.time)
+    {
+        double extrapolation = t - last.time;
+        if (extrapolation > keys.maxExtrapolation)
+        {
+            extrapolation = keys.maxExtrapolation;
+        }
+        if (extrapolation == 0)
+        {
+            compose(last.rotation, last.stretch, last.translation, pose);
+            return true;
+        }
+
+        /* Carry on turning as from the pose before to the last one, and
+           moving at the velocity of the spline at the last pose. */
+        const Key &before = keys.keys[n - 2];
+        hduQuaternion rotation = hduSlerp(before.rotation, last.rotation,
+            1 + extrapolation / (last.time - before.time));
+        rotation.normalize();
+
+        hduVector3Dd translation = last.translation +
+            extrapolation * getTangent(keys, n - 1);
+
+        compose(rotation, last.stretch, translation, pose);
+        return true;
+    }
+
+    int i = n - 2;
+    while (t < keys.keys[i].time)
+    {
+        i--;
+    }
+    const Key &k0 = keys.keys[i];
+    const Key &k1 = keys.keys[i + 1];
+
+    double h = k1.time - k0.time;
+    double s = (t - k0.time) / h;
+
+    hduQuaternion rotation = hduSlerp(k0.rotation, k1.rotation, s);
+    rotation.normalize();
+
+    double stretch[3][3];
+    for (int r = 0; r < 3; r++)
+    {
+        for (int c = 0; c < 3; c++)
+        {
+            stretch[r][c] = k0.stretch[r][c] +
+                s * (k1.stretch[r][c] - k0.stretch[r][c]);
+        }
+    }
+
+    /* Cubic Hermite basis. */
+    double s2 = s * s;
+    double s3 = s2 * s;
+    double h00 = 2 * s3 - 3 * s2 + 1;
+    double h10 = s3 - 2 * s2 + s;
+    double h01 = -2 * s3 + 3 * s2;
+    double h11 = s3 - s2;
+
+    hduVector3Dd translation =
+        h00 * k0.translation + (h10 * h) * getTangent(keys, i) +
+        h01 * k1.translation + (h11 * h) * getTangent(keys, i + 1);
+
+    compose(rotation, stretch, translation, pose);
+    return true;
+}
+
+bool hduTransformInterpolator::sample(hduMatrix &pose)
+{
+    /* hdGetSchedulerTimeStamp is the time since the start of the tick. */
+    return sample(getTime() - hdGetSchedulerTimeStamp(), pose);
+}
+
+double hduTransformInterpolator::getTime()
+{
+#if defined(WIN32)
+    static LARGE_INTEGER frequency;
+    if (frequency.QuadPart == 0)
+    {
+        QueryPerformanceFrequency(&frequency);
+    }
+    LARGE_INTEGER now;
+    QueryPerformanceCounter(&now);
+    return (double) now.QuadPart / frequency.QuadPart;
+#else
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return now.tv_sec + now.tv_nsec * 1e-9;
+#endif
+}
+
+/*******************************************************************************
+ The upper 3x3 part of a pose, for row vectors, is stretch * rotation, with
+ the rotation found by polar decomposition.
+*******************************************************************************/
+void hduTransformInterpolator::decompose(double time, const hduMatrix &pose,
+                                         Key &key)
+{
+    double R[3][3];
+    pose.getRotationMatrix(R);
+
+    key.time = time;
+    key.rotation.fromRotationMatrix(R);
+    key.rotation.normalize();
+
+    /* stretch = M * R^T */
+    for (int r = 0; r < 3; r++)
+    {
+        for (int c = 0; c < 3; c++)
+        {
+            key.stretch[r][c] = pose(r, 0) * R[c][0] +
+                                pose(r, 1) * R[c][1] +
+                                pose(r, 2) * R[c][2];
+        }
+    }
+
+    key.translation.set(pose(3, 0), pose(3, 1), pose(3, 2));
+}
+
+void hduTransformInterpolator::compose(const hduQuaternion &rotation,
+                                       const double stretch[3][3],
+                                       const hduVector3Dd &translation,
+                                       hduMatrix &pose)
+{
+    double R[3][3];
+    rotation.toRotationMatrix(R);
+
+    for (int r = 0; r < 3; r++)
+    {
+        for (int c = 0; c < 3; c++)
+        {
+            pose(r, c) = stretch[r][0] * R[0][c] +
+                         stretch[r][1] * R[1][c] +
+                         stretch[r][2] * R[2][c];
+        }
+        pose(r, 3) = 0;
+        pose(3, r) = translation[r];
+    }
+    pose(3, 3) = 1;
+}
+
+/*******************************************************************************
+ Velocity of the translation at key i: the slope across its neighbours, or
+ to its one neighbour at either end.
+*******************************************************************************/
+hduVector3Dd hduTransformInterpolator::getTangent(const Keys &keys, int i)
+{
+    int i0 = i > 0 ? i - 1 : i;
+    int i1 = i < keys.nKeys - 1 ? i + 1 : i;
+
+    return (keys.keys[i1].translation - keys.keys[i0].translation) /
+        (keys.keys[i1].time - keys.keys[i0].time);
+}
+
+/*****************************************************************************/
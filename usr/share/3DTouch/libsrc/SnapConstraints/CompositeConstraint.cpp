@@ -25,13 +25,143 @@ Description:
 #include "SnapConstraintsAfx.h"
 #include <SnapConstraints/CompositeConstraint.h>
 #include <SnapConstraints/ConstraintHolder.h>
+#include <SnapConstraints/PointConstraint.h>
+#include <SnapConstraints/LineConstraint.h>
+#include <SnapConstraints/PlaneConstraint.h>
 
 #include <float.h>
+#include <math.h>
 #include <assert.h>
 
 namespace SnapConstraints
 {
 
+namespace
+{
+
+/******************************************************************************
+ Finds the closest constraint of a group of PointConstraints.  The group
+ holds only PointConstraints, so the distance is computed inline instead of
+ through a virtual call, and compared squared to avoid a sqrt per child.
+ Returns -1 if none is closer than minDistSqr.
+******************************************************************************/
+int findClosestPoint(SnapConstraint * const *pGroup, int nSize,
+                     const hduVector3Dd &testPt, double &minDistSqr)
+{
+    const double tx = testPt[0], ty = testPt[1], tz = testPt[2];
+    double bestDistSqr = minDistSqr;
+    int nClosest = -1;
+
+    for (int i = 0; i < nSize; i++)
+    {
+        const hduVector3Dd &point = 
+            static_cast<const PointConstraint *>(pGroup[i])->getPoint();
+
+        double dx = point[0] - tx;
+        double dy = point[1] - ty;
+        double dz = point[2] - tz;
+        double distSqr = dx * dx + dy * dy + dz * dz;
+
+        if (distSqr < bestDistSqr)
+        {
+            bestDistSqr = distSqr;
+            nClosest = i;
+        }
+    }
+
+    minDistSqr = bestDistSqr;
+    return nClosest;
+}
+
+/******************************************************************************
+ Finds the closest constraint of a group of LineConstraints.  Mirrors
+ LineConstraint::testConstraint, including a zero direction for a line whose
+ start and end points coincide.
+******************************************************************************/
+int findClosestLine(SnapConstraint * const *pGroup, int nSize,
+                    const hduVector3Dd &testPt, double &minDistSqr)
+{
+    const double tx = testPt[0], ty = testPt[1], tz = testPt[2];
+    double bestDistSqr = minDistSqr;
+    int nClosest = -1;
+
+    for (int i = 0; i < nSize; i++)
+    {
+        const LineConstraint *pLine = 
+            static_cast<const LineConstraint *>(pGroup[i]);
+        const hduVector3Dd &start = pLine->getStartPoint();
+        const hduVector3Dd &end = pLine->getEndPoint();
+
+        double ux = end[0] - start[0];
+        double uy = end[1] - start[1];
+        double uz = end[2] - start[2];
+        double lengthSqr = ux * ux + uy * uy + uz * uz;
+
+        double vx = tx - start[0];
+        double vy = ty - start[1];
+        double vz = tz - start[2];
+        double distSqr = vx * vx + vy * vy + vz * vz;
+
+        /* Remove the part of the test vector along the line. */
+        if (lengthSqr > 0)
+        {
+            double t = vx * ux + vy * uy + vz * uz;
+            distSqr -= t * t / lengthSqr;
+            if (distSqr < 0)
+            {
+                distSqr = 0;
+            }
+        }
+
+        if (distSqr < bestDistSqr)
+        {
+            bestDistSqr = distSqr;
+            nClosest = i;
+        }
+    }
+
+    minDistSqr = bestDistSqr;
+    return nClosest;
+}
+
+/******************************************************************************
+ Finds the closest constraint of a group of PlaneConstraints.  The normal is
+ not assumed to be unit length, since setNormal() does not normalize it.
+******************************************************************************/
+int findClosestPlane(SnapConstraint * const *pGroup, int nSize,
+                     const hduVector3Dd &testPt, double &minDistSqr)
+{
+    const double tx = testPt[0], ty = testPt[1], tz = testPt[2];
+    double bestDistSqr = minDistSqr;
+    int nClosest = -1;
+
+    for (int i = 0; i < nSize; i++)
+    {
+        const PlaneConstraint *pPlane = 
+            static_cast<const PlaneConstraint *>(pGroup[i]);
+        const hduVector3Dd &point = pPlane->getPoint();
+        const hduVector3Dd &normal = pPlane->getNormal();
+
+        double d = normal[0] * (tx - point[0]) + 
+                   normal[1] * (ty - point[1]) + 
+                   normal[2] * (tz - point[2]);
+        double distSqr = d * d * (normal[0] * normal[0] + 
+                                  normal[1] * normal[1] + 
+                                  normal[2] * normal[2]);
+
+        if (distSqr < bestDistSqr)
+        {
+            bestDistSqr = distSqr;
+            nClosest = i;
+        }
+    }
+
+    minDistSqr = bestDistSqr;
+    return nClosest;
+}
+
+} /* anonymous namespace */
+
 /******************************************************************************
  Constructor
 ******************************************************************************/
@@ -84,11 +214,11 @@ double CompositeConstraint::testConstraintSeries(const hduVector3Dd &testPt,
     bool bFirstTest = true;
     
     /* Test the constraints in the order provided. */
-    for (m_pConstraintHolder->begin();
-         !m_pConstraintHolder->done();
-         m_pConstraintHolder->next())
+    int nConstraints = m_pConstraintHolder->getNumConstraints();
+    for (int i = 0; i < nConstraints; i++)
     {
-        SnapConstraint *pConstraint = m_pConstraintHolder->current();
+        const SnapConstraint *pConstraint = 
+            m_pConstraintHolder->getConstraint(i);
         if (pConstraint)
         {
             double dist = pConstraint->testConstraint(tempTestPt, tempProxyPt);
@@ -116,27 +246,84 @@ double CompositeConstraint::testConstraintSeries(const hduVector3Dd &testPt,
 double CompositeConstraint::testConstraintParallel(const hduVector3Dd &testPt,
                                                    hduVector3Dd &proxyPt) const
 {
-    double minDist = DBL_MAX;
-    hduVector3Dd tempProxyPt;
+    const ConstraintHolder *pHolder = m_pConstraintHolder;
+
+    /* Points, lines and planes are compared by squared distance, one
+       group at a time.  Only the closest one is tested again to get its
+       proxy position. */
+    const SnapConstraint *pClosest = 0;
+    double minDistSqr = DBL_MAX;
     
-    /* Test the constraints in the order provided. */
-    for (m_pConstraintHolder->begin();
-         !m_pConstraintHolder->done();
-         m_pConstraintHolder->next())
+    SnapConstraint * const *pPoints = 
+        pHolder->getGroup(ConstraintHolder::POINT_GROUP);
+    int nPoint = findClosestPoint(
+        pPoints, pHolder->getGroupSize(ConstraintHolder::POINT_GROUP),
+        testPt, minDistSqr);
+    if (nPoint >= 0)
     {
-        SnapConstraint *pConstraint = m_pConstraintHolder->current();
-        if (pConstraint)
-        {
-            double dist = pConstraint->testConstraint(testPt, tempProxyPt);
+        pClosest = pPoints[nPoint];
+    }
 
-            /* Check to see if this constraint is closer and of the same
-               or greater priority. If so, it should take precedence. */
-            if (dist < minDist)
-            {
-                minDist = dist;                
-                proxyPt = tempProxyPt;
-            }              
+    SnapConstraint * const *pLines = 
+        pHolder->getGroup(ConstraintHolder::LINE_GROUP);
+    int nLine = findClosestLine(
+        pLines, pHolder->getGroupSize(ConstraintHolder::LINE_GROUP),
+        testPt, minDistSqr);
+    if (nLine >= 0)
+    {
+        pClosest = pLines[nLine];
+    }
+
+    SnapConstraint * const *pPlanes = 
+        pHolder->getGroup(ConstraintHolder::PLANE_GROUP);
+    int nPlane = findClosestPlane(
+        pPlanes, pHolder->getGroupSize(ConstraintHolder::PLANE_GROUP),
+        testPt, minDistSqr);
+    if (nPlane >= 0)
+    {
+        pClosest = pPlanes[nPlane];
+    }
+
+    hduVector3Dd tempProxyPt;
+    if (pClosest)
+    {
+        /* The type of the group is exact, so skip the virtual dispatch. */
+        if (nPlane >= 0)
+        {
+            static_cast<const PlaneConstraint *>(pClosest)->
+                PlaneConstraint::testConstraint(testPt, tempProxyPt);
+        }
+        else if (nLine >= 0)
+        {
+            static_cast<const LineConstraint *>(pClosest)->
+                LineConstraint::testConstraint(testPt, tempProxyPt);
+        }
+        else
+        {
+            static_cast<const PointConstraint *>(pClosest)->
+                PointConstraint::testConstraint(testPt, tempProxyPt);
         }
+        proxyPt = tempProxyPt;
+    }
+
+    /* Anything else, including subclasses of the batched types, is tested
+       one at a time. */
+    double minDist = pClosest ? sqrt(minDistSqr) : DBL_MAX;
+
+    int nOthers = pHolder->getGroupSize(ConstraintHolder::OTHER_GROUP);
+    SnapConstraint * const *pOthers = 
+        pHolder->getGroup(ConstraintHolder::OTHER_GROUP);
+    for (int i = 0; i < nOthers; i++)
+    {
+        double dist = pOthers[i]->testConstraint(testPt, tempProxyPt);
+
+        /* Check to see if this constraint is closer. If so, it should 
+           take precedence. */
+        if (dist < minDist)
+        {
+            minDist = dist;                
+            proxyPt = tempProxyPt;
+        }              
     }
 
     hduVector3Dd testToProxy(testPt - proxyPt);
@@ -22,8 +22,13 @@ Description:
 #include "SnapConstraintsAfx.h"
 #include <SnapConstraints/SnapConstraint.h>
 #include <SnapConstraints/ConstraintHolder.h>
+#include <SnapConstraints/PointConstraint.h>
+#include <SnapConstraints/LineConstraint.h>
+#include <SnapConstraints/PlaneConstraint.h>
 
-#include <list>
+#include <vector>
+#include <algorithm>
+#include <typeinfo>
 
 using namespace std;
 
@@ -34,16 +39,19 @@ class ConstraintHolderImp : public ConstraintHolder
 {
 public:
 
-    typedef list<SnapConstraint *> ConstraintList;
+    typedef vector<SnapConstraint *> ConstraintList;
 
-    ConstraintHolderImp() {}
+    ConstraintHolderImp() : m_nIterator(0) {}
     virtual ~ConstraintHolderImp() { clearConstraints(); }
 
     void addConstraintFront(SnapConstraint *pConstraint)
     {
         if (pConstraint)
         {
-            m_list.push_front(pConstraint);
+            m_list.insert(m_list.begin(), pConstraint);
+
+            ConstraintList &group = m_groups[getGroupOf(pConstraint)];
+            group.insert(group.begin(), pConstraint);
         }
     }
 
@@ -52,27 +60,56 @@ public:
         if (pConstraint)
         {
             m_list.push_back(pConstraint);
+            m_groups[getGroupOf(pConstraint)].push_back(pConstraint);
         }
     }
 
     void removeConstraint(SnapConstraint *pConstraint)
     { 
-        m_list.remove(pConstraint);
+        m_list.erase(remove(m_list.begin(), m_list.end(), pConstraint),
+                     m_list.end());
+
+        for (int i = 0; i < NUM_GROUPS; i++)
+        {
+            m_groups[i].erase(remove(m_groups[i].begin(), m_groups[i].end(),
+                                     pConstraint), m_groups[i].end());
+        }
     }
 
     void clearConstraints();
 
+    /* Indexed access. */
+    int getNumConstraints() const { return (int) m_list.size(); }
+    SnapConstraint *getConstraint(int nIndex) { return m_list[nIndex]; }
+    const SnapConstraint *getConstraint(int nIndex) const 
+    { 
+        return m_list[nIndex]; 
+    }
+
+    int getGroupSize(ConstraintGroup eGroup) const
+    {
+        return (int) m_groups[eGroup].size();
+    }
+
+    SnapConstraint * const *getGroup(ConstraintGroup eGroup) const
+    {
+        return m_groups[eGroup].empty() ? 0 : &m_groups[eGroup][0];
+    }
+
     /* Iteration methods. */
-    void begin() { m_it = m_list.begin(); }
-    void next() { ++m_it; }
-    bool done() const { return m_it == m_list.end(); }
-    const SnapConstraint *current() const { return *m_it; }
-    SnapConstraint *current() { return *m_it; }
+    void begin() { m_nIterator = 0; }
+    void next() { ++m_nIterator; }
+    bool done() const { return m_nIterator >= m_list.size(); }
+    const SnapConstraint *current() const { return m_list[m_nIterator]; }
+    SnapConstraint *current() { return m_list[m_nIterator]; }
 
 private:
 
+    static ConstraintGroup getGroupOf(const SnapConstraint *pConstraint);
+
     ConstraintList m_list;
-    ConstraintList::const_iterator m_it;
+    ConstraintList m_groups[NUM_GROUPS];
+    ConstraintList::size_type m_nIterator;
 };
 
 /******************************************************************************
@@ -102,6 +139,11 @@ void ConstraintHolder::destroy(ConstraintHolder *&pInstance)
 ******************************************************************************/
 void ConstraintHolderImp::clearConstraints()
 {
+    for (int i = 0; i < NUM_GROUPS; i++)
+    {
+        m_groups[i].clear();
+    }
+
     ConstraintList::iterator it = m_list.begin();
     ConstraintList::iterator iend = m_list.end();
     for (; it != iend; ++it)
@@ -116,6 +158,30 @@ void ConstraintHolderImp::clearConstraints()
     begin();
 }
 
+/******************************************************************************
+ Determines the batch group of a constraint from its exact type.
+******************************************************************************/
+ConstraintHolder::ConstraintGroup ConstraintHolderImp::getGroupOf(
+    const SnapConstraint *pConstraint)
+{
+    const type_info &type = typeid(*pConstraint);
+
+    if (type == typeid(PointConstraint))
+    {
+        return POINT_GROUP;
+    }
+    else if (type == typeid(LineConstraint))
+    {
+        return LINE_GROUP;
+    }
+    else if (type == typeid(PlaneConstraint))
+    {
+        return PLANE_GROUP;
+    }
+    
+    return OTHER_GROUP;
+}
+
 } /* namespace SnapConstraints */
 
 /*****************************************************************************/
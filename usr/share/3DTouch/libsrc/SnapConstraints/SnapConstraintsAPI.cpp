@@ -24,6 +24,7 @@ Description:
 #include "SnapConstraintsAfx.h"
 #include <SnapConstraints/ISnapConstraintsAPI.h>
 #include <SnapConstraints/SnapConstraint.h>
+#include <SnapConstraints/SnapIndex.h>
 
 #include <HDU/hduVector.h>
 
@@ -65,6 +66,11 @@ public:
     /* Clears the current applied constraint. */
     virtual void clearConstraint();
 
+    /* Applies the closest constraint in the index, unless a constraint is
+       already applied. */
+    virtual SnapConstraint *selectConstraint(const SnapIndex *pIndex,
+                                             const hduVector3Dd &devicePt);
+
 protected:
     SnapConstraint *m_pConstraint;
     hduVector3Dd m_proxyPt;
@@ -157,6 +163,29 @@ void SnapConstraintsAPI::clearConstraint()
     }
 }
 
+
+/******************************************************************************
+ If no constraint is applied, looks up the closest constraint in the index 
+ that the device is within snap distance of and applies it.
+******************************************************************************/
+SnapConstraint *SnapConstraintsAPI::selectConstraint(const SnapIndex *pIndex,
+                                                     const hduVector3Dd &devicePt)
+{
+    if (!m_pConstraint && pIndex)
+    {
+        hduVector3Dd proxyPt;
+        SnapConstraint *pConstraint = 
+            pIndex->findClosestConstraint(devicePt, proxyPt);
+        if (pConstraint)
+        {
+            setConstraint(pConstraint);
+            m_proxyPt = proxyPt;
+        }
+    }
+
+    return m_pConstraint;
+}
+
 } /* namespace SnapConstraints */
 
 /*****************************************************************************/
@@ -0,0 +1,221 @@
+/*****************************************************************************
+
+Copyright (c) 2004 SensAble Technologies, Inc. All rights reserved.
+
+OpenHaptics(TM) toolkit. The material embodied in this software and use of
+this software is subject to the terms and conditions of the clickthrough
+Development License Agreement.
+
+For questions, comments or bug reports, go to forums at:
+    http://dsc.sensable.com
+
+Module Name:
+
+  SnapConstraintsBenchmark.cpp
+
+Description:
+
+  Measures the cost of testing a PARALLEL CompositeConstraint against the
+  number of child constraints, comparing the batched evaluation of points,
+  lines and planes with one virtual testConstraint call per child.
+  Usage: SnapConstraintsBenchmark [tests per child count]
+
+******************************************************************************/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <math.h>
+#include <time.h>
+
+#include <SnapConstraints/CompositeConstraint.h>
+#include <SnapConstraints/ConstraintHolder.h>
+#include <SnapConstraints/PointConstraint.h>
+#include <SnapConstraints/LineConstraint.h>
+#include <SnapConstraints/PlaneConstraint.h>
+
+using namespace SnapConstraints;
+
+namespace
+{
+
+const int kMaxChildren = 4096;
+const int kNumTestPoints = 256;
+
+double getTime()
+{
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return now.tv_sec + now.tv_nsec * 1e-9;
+}
+
+double random(double min, double max)
+{
+    return min + (max - min) * rand() / (double) RAND_MAX;
+}
+
+hduVector3Dd randomPoint()
+{
+    return hduVector3Dd(random(-100, 100), random(-100, 100),
+                        random(-100, 100));
+}
+
+/* Same shape as PointConstraint, but of a different type, so the holder
+   puts it in the OTHER_GROUP and the composite tests it virtually. */
+class UnbatchedPointConstraint : public PointConstraint
+{
+public:
+    UnbatchedPointConstraint(const hduVector3Dd &point) :
+        PointConstraint(point) {}
+};
+
+class UnbatchedLineConstraint : public LineConstraint
+{
+public:
+    UnbatchedLineConstraint(const hduVector3Dd &startPoint,
+                            const hduVector3Dd &endPoint) :
+        LineConstraint(startPoint, endPoint) {}
+};
+
+class UnbatchedPlaneConstraint : public PlaneConstraint
+{
+public:
+    UnbatchedPlaneConstraint(const hduVector3Dd &point,
+                             const hduVector3Dd &normal) :
+        PlaneConstraint(point, normal) {}
+};
+
+/******************************************************************************
+ Fills two composites with the same mix of children: 80% points, 15% lines
+ and 5% planes, which is typical of snapping to a model.  The first gets
+ batchable constraints, the second the unbatched subclasses.
+******************************************************************************/
+void fillComposites(int nChildren, CompositeConstraint &batched,
+                    CompositeConstraint &unbatched)
+{
+    batched.getConstraintHolder()->clearConstraints();
+    unbatched.getConstraintHolder()->clearConstraints();
+
+    for (int i = 0; i < nChildren; i++)
+    {
+        int nKind = i % 20;
+        if (nKind < 16)
+        {
+            hduVector3Dd point = randomPoint();
+            batched.getConstraintHolder()->addConstraintBack(
+                new PointConstraint(point));
+            unbatched.getConstraintHolder()->addConstraintBack(
+                new UnbatchedPointConstraint(point));
+        }
+        else if (nKind < 19)
+        {
+            hduVector3Dd start = randomPoint();
+            hduVector3Dd end = randomPoint();
+            batched.getConstraintHolder()->addConstraintBack(
+                new LineConstraint(start, end));
+            unbatched.getConstraintHolder()->addConstraintBack(
+                new UnbatchedLineConstraint(start, end));
+        }
+        else
+        {
+            hduVector3Dd point = randomPoint();
+            hduVector3Dd normal = randomPoint();
+            batched.getConstraintHolder()->addConstraintBack(
+                new PlaneConstraint(point, normal));
+            unbatched.getConstraintHolder()->addConstraintBack(
+                new UnbatchedPlaneConstraint(point, normal));
+        }
+    }
+}
+
+/******************************************************************************
+ Returns the mean time of one testConstraint call, in seconds.
+******************************************************************************/
+double timeComposite(const CompositeConstraint &composite,
+                     const hduVector3Dd *pTestPts, int nTests,
+                     double &checksum)
+{
+    hduVector3Dd proxyPt;
+
+    double start = getTime();
+    for (int i = 0; i < nTests; i++)
+    {
+        checksum += composite.testConstraint(
+            pTestPts[i % kNumTestPoints], proxyPt);
+    }
+    return (getTime() - start) / nTests;
+}
+
+} /* anonymous namespace */
+
+/******************************************************************************
+ main
+******************************************************************************/
+int main(int argc, char *argv[])
+{
+    int nTestsPerCount = argc > 1 ? atoi(argv[1]) : 2000000;
+    if (nTestsPerCount <= 0)
+    {
+        fprintf(stderr, "Usage: %s [tests per child count]\n", argv[0]);
+        return -1;
+    }
+
+    srand(1);
+
+    hduVector3Dd testPts[kNumTestPoints];
+    for (int i = 0; i < kNumTestPoints; i++)
+    {
+        testPts[i] = randomPoint();
+    }
+
+    CompositeConstraint batched(CompositeConstraint::PARALLEL, false);
+    CompositeConstraint unbatched(CompositeConstraint::PARALLEL, false);
+
+    printf("%8s %14s %14s %8s %12s\n", "children", "batched (us)",
+           "virtual (us)", "speedup", "max error");
+
+    for (int nChildren = 1; nChildren <= kMaxChildren; nChildren *= 2)
+    {
+        fillComposites(nChildren, batched, unbatched);
+
+        /* Both paths must agree on the distance to the closest child. */
+        double maxError = 0;
+        for (int i = 0; i < kNumTestPoints; i++)
+        {
+            hduVector3Dd batchedPt, unbatchedPt;
+            double error = fabs(
+                batched.testConstraint(testPts[i], batchedPt) -
+                unbatched.testConstraint(testPts[i], unbatchedPt));
+            if (error > maxError)
+            {
+                maxError = error;
+            }
+        }
+
+        /* Keep the total work per child count roughly constant. */
+        int nTests = nTestsPerCount / nChildren;
+        if (nTests < kNumTestPoints)
+        {
+            nTests = kNumTestPoints;
+        }
+
+        double checksum = 0;
+        double batchedTime = timeComposite(batched, testPts, nTests, checksum);
+        double virtualTime = timeComposite(unbatched, testPts, nTests, checksum);
+
+        printf("%8d %14.3f %14.3f %7.2fx %12.3g\n", nChildren,
+               batchedTime * 1e6, virtualTime * 1e6,
+               virtualTime / batchedTime, maxError);
+
+        if (checksum != checksum)
+        {
+            printf("Invalid distance\n");
+        }
+    }
+
+    batched.getConstraintHolder()->clearConstraints();
+    unbatched.getConstraintHolder()->clearConstraints();
+
+    return 0;
+}
+
+/*****************************************************************************/
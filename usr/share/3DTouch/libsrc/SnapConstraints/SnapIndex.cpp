@@ -0,0 +1,743 @@
+/*****************************************************************************
+
+Copyright (c) 2004 SensAble Technologies, Inc. All rights reserved.
+
+OpenHaptics(TM) toolkit. The material embodied in this software and use of
+this software is subject to the terms and conditions of the clickthrough
+Development License Agreement.
+
+For questions, comments or bug reports, go to forums at:
+    http://dsc.sensable.com
+
+Module Name:
+
+  SnapIndex.cpp
+
+Description:
+
+  A spatial index over SnapConstraints, implemented as a dynamic bounding
+  volume hierarchy of axis aligned boxes.
+
+******************************************************************************/
+
+#include "SnapConstraintsAfx.h"
+#include <SnapConstraints/SnapIndex.h>
+#include <SnapConstraints/SnapConstraint.h>
+#include <SnapConstraints/PointConstraint.h>
+
+#include <map>
+#include <vector>
+#include <algorithm>
+
+#include <math.h>
+#include <float.h>
+#include <assert.h>
+
+using namespace std;
+
+namespace SnapConstraints
+{
+
+namespace
+{
+
+const int kNullNode = -1;
+
+/* Maximum depth of the traversal stack.  The tree is kept balanced, so
+   this is far more than any realistic number of constraints needs. */
+const int kMaxStackDepth = 256;
+
+/* Axis aligned box. */
+struct Bounds
+{
+    hduVector3Dd min;
+    hduVector3Dd max;
+
+    bool contains(const Bounds &bounds) const
+    {
+        return min[0] <= bounds.min[0] && min[1] <= bounds.min[1] &&
+               min[2] <= bounds.min[2] && max[0] >= bounds.max[0] &&
+               max[1] >= bounds.max[1] && max[2] >= bounds.max[2];
+    }
+
+    /* Half of the surface area, used as the cost of a node. */
+    double getCost() const
+    {
+        double dx = max[0] - min[0];
+        double dy = max[1] - min[1];
+        double dz = max[2] - min[2];
+        return dx * dy + dy * dz + dz * dx;
+    }
+
+    static Bounds combine(const Bounds &a, const Bounds &b)
+    {
+        Bounds result;
+        for (int i = 0; i < 3; i++)
+        {
+            result.min[i] = a.min[i] < b.min[i] ? a.min[i] : b.min[i];
+            result.max[i] = a.max[i] > b.max[i] ? a.max[i] : b.max[i];
+        }
+        return result;
+    }
+};
+
+/******************************************************************************
+ Default query, using the Euclidean distance to the test point.
+******************************************************************************/
+class PointQuery : public SnapIndex::Query
+{
+public:
+    explicit PointQuery(const hduVector3Dd &testPt) : m_testPt(testPt) {}
+
+    virtual double getBoundsDistance(const hduVector3Dd &boundsMin,
+                                     const hduVector3Dd &boundsMax) const
+    {
+        double distSqr = 0;
+        for (int i = 0; i < 3; i++)
+        {
+            double d = 0;
+            if (m_testPt[i] < boundsMin[i])
+                d = boundsMin[i] - m_testPt[i];
+            else if (m_testPt[i] > boundsMax[i])
+                d = m_testPt[i] - boundsMax[i];
+            distSqr += d * d;
+        }
+        return sqrt(distSqr);
+    }
+
+    virtual double testConstraint(const SnapConstraint *pConstraint,
+                                  hduVector3Dd &proxyPt) const
+    {
+        return pConstraint->testConstraint(m_testPt, proxyPt);
+    }
+
+private:
+    hduVector3Dd m_testPt;
+};
+
+class SnapIndexImp : public SnapIndex
+{
+public:
+
+    SnapIndexImp();
+    virtual ~SnapIndexImp() {}
+
+    virtual void addConstraint(SnapConstraint *pConstraint,
+                               const hduVector3Dd &boundsMin,
+                               const hduVector3Dd &boundsMax);
+    virtual void addConstraint(PointConstraint *pConstraint);
+    virtual void addUnboundedConstraint(SnapConstraint *pConstraint);
+
+    virtual void moveConstraint(SnapConstraint *pConstraint,
+                                const hduVector3Dd &boundsMin,
+                                const hduVector3Dd &boundsMax);
+    virtual void moveConstraint(PointConstraint *pConstraint);
+
+    virtual void removeConstraint(SnapConstraint *pConstraint);
+    virtual void clearConstraints();
+
+    virtual int getNumConstraints() const
+    {
+        return (int) (m_leafMap.size() + m_unbounded.size());
+    }
+
+    virtual SnapConstraint *findClosestConstraint(
+        const hduVector3Dd &testPt, hduVector3Dd &proxyPt) const;
+
+    virtual SnapConstraint *findClosestConstraint(
+        const Query &query, hduVector3Dd &proxyPt) const;
+
+    virtual void setMargin(double margin) { m_margin = margin; }
+    virtual double getMargin() const { return m_margin; }
+
+private:
+
+    struct Node
+    {
+        /* Bounds of the subtree, or the fattened bounds of a leaf. */
+        Bounds bounds;
+
+        /* Parent, or next free node when on the free list. */
+        int nParent;
+        int nChild1;
+        int nChild2;
+
+        /* Leaf is 0, free node is -1. */
+        int nHeight;
+
+        SnapConstraint *pConstraint;
+
+        bool isLeaf() const { return nChild1 == kNullNode; }
+    };
+
+    typedef map<SnapConstraint *, int> LeafMap;
+    typedef vector<SnapConstraint *> ConstraintList;
+
+    int allocateNode();
+    void freeNode(int nNode);
+
+    void insertLeaf(int nLeaf);
+    void removeLeaf(int nLeaf);
+    int balance(int nNode);
+    void refit(int nNode);
+
+    Bounds makeBounds(const hduVector3Dd &boundsMin,
+                      const hduVector3Dd &boundsMax) const;
+    void updateMaxSnapDistance(const SnapConstraint *pConstraint);
+
+    vector<Node> m_nodes;
+    int m_nRoot;
+    int m_nFreeList;
+
+    LeafMap m_leafMap;
+    ConstraintList m_unbounded;
+
+    double m_margin;
+
+    /* Largest snap distance of any constraint added, used as the initial
+       search radius. */
+    double m_maxSnapDistance;
+};
+
+} /* anonymous namespace */
+
+/******************************************************************************
+ Create
+******************************************************************************/
+SnapIndex *SnapIndex::create()
+{
+    return new SnapIndexImp;
+}
+
+/******************************************************************************
+ Destroy
+******************************************************************************/
+void SnapIndex::destroy(SnapIndex *&pInstance)
+{
+    if (pInstance)
+    {
+        SnapIndexImp *pImp = static_cast<SnapIndexImp *>(pInstance);
+        delete pImp;
+        pInstance = 0;
+    }
+}
+
+/******************************************************************************
+ Constructor
+******************************************************************************/
+SnapIndexImp::SnapIndexImp() :
+    m_nRoot(kNullNode),
+    m_nFreeList(kNullNode),
+    m_margin(SnapConstraint::getDefaultSnapDistance()),
+    m_maxSnapDistance(0)
+{
+}
+
+/******************************************************************************
+ Adds a constraint with the given bounds.
+******************************************************************************/
+void SnapIndexImp::addConstraint(SnapConstraint *pConstraint,
+                                 const hduVector3Dd &boundsMin,
+                                 const hduVector3Dd &boundsMax)
+{
+    if (!pConstraint)
+    {
+        return;
+    }
+
+    assert(m_leafMap.find(pConstraint) == m_leafMap.end());
+
+    int nLeaf = allocateNode();
+    m_nodes[nLeaf].bounds = makeBounds(boundsMin, boundsMax);
+    m_nodes[nLeaf].pConstraint = pConstraint;
+    insertLeaf(nLeaf);
+
+    m_leafMap[pConstraint] = nLeaf;
+    updateMaxSnapDistance(pConstraint);
+}
+
+void SnapIndexImp::addConstraint(PointConstraint *pConstraint)
+{
+    if (pConstraint)
+    {
+        addConstraint(pConstraint, pConstraint->getPoint(),
+                      pConstraint->getPoint());
+    }
+}
+
+void SnapIndexImp::addUnboundedConstraint(SnapConstraint *pConstraint)
+{
+    if (pConstraint)
+    {
+        m_unbounded.push_back(pConstraint);
+        updateMaxSnapDistance(pConstraint);
+    }
+}
+
+/******************************************************************************
+ Updates the bounds of a constraint.  The stored bounds are fattened by the
+ margin, so nothing needs to change while the new bounds still fit inside.
+******************************************************************************/
+void SnapIndexImp::moveConstraint(SnapConstraint *pConstraint,
+                                  const hduVector3Dd &boundsMin,
+                                  const hduVector3Dd &boundsMax)
+{
+    LeafMap::iterator it = m_leafMap.find(pConstraint);
+    if (it == m_leafMap.end())
+    {
+        return;
+    }
+
+    updateMaxSnapDistance(pConstraint);
+
+    int nLeaf = it->second;
+    Bounds bounds;
+    bounds.min = boundsMin;
+    bounds.max = boundsMax;
+    if (m_nodes[nLeaf].bounds.contains(bounds))
+    {
+        return;
+    }
+
+    removeLeaf(nLeaf);
+    m_nodes[nLeaf].bounds = makeBounds(boundsMin, boundsMax);
+    insertLeaf(nLeaf);
+}
+
+void SnapIndexImp::moveConstraint(PointConstraint *pConstraint)
+{
+    if (pConstraint)
+    {
+        moveConstraint(pConstraint, pConstraint->getPoint(),
+                       pConstraint->getPoint());
+    }
+}
+
+/******************************************************************************
+ Remove
+******************************************************************************/
+void SnapIndexImp::removeConstraint(SnapConstraint *pConstraint)
+{
+    LeafMap::iterator it = m_leafMap.find(pConstraint);
+    if (it != m_leafMap.end())
+    {
+        int nLeaf = it->second;
+        removeLeaf(nLeaf);
+        freeNode(nLeaf);
+        m_leafMap.erase(it);
+        return;
+    }
+
+    m_unbounded.erase(remove(m_unbounded.begin(), m_unbounded.end(),
+                             pConstraint), m_unbounded.end());
+}
+
+/******************************************************************************
+ Clear
+******************************************************************************/
+void SnapIndexImp::clearConstraints()
+{
+    m_nodes.clear();
+    m_nRoot = kNullNode;
+    m_nFreeList = kNullNode;
+    m_leafMap.clear();
+    m_unbounded.clear();
+    m_maxSnapDistance = 0;
+}
+
+/******************************************************************************
+ Finds the closest constraint within snap distance of the test point.
+******************************************************************************/
+SnapConstraint *SnapIndexImp::findClosestConstraint(
+    const hduVector3Dd &testPt, hduVector3Dd &proxyPt) const
+{
+    return findClosestConstraint(PointQuery(testPt), proxyPt);
+}
+
+/******************************************************************************
+ Finds the closest constraint for a query.  Subtrees are visited nearest
+ first and skipped once their lower bound is no better than the best
+ constraint found so far.
+******************************************************************************/
+SnapConstraint *SnapIndexImp::findClosestConstraint(
+    const Query &query, hduVector3Dd &proxyPt) const
+{
+    SnapConstraint *pClosest = 0;
+    double minDist = m_maxSnapDistance;
+    hduVector3Dd tempProxyPt;
+
+    ConstraintList::const_iterator it = m_unbounded.begin();
+    for (; it != m_unbounded.end(); ++it)
+    {
+        double dist = query.testConstraint(*it, tempProxyPt);
+        if (dist < minDist && dist < (*it)->getSnapDistance())
+        {
+            minDist = dist;
+            pClosest = *it;
+            proxyPt = tempProxyPt;
+        }
+    }
+
+    if (m_nRoot == kNullNode)
+    {
+        return pClosest;
+    }
+
+    int stack[kMaxStackDepth];
+    int nStack = 0;
+    stack[nStack++] = m_nRoot;
+
+    while (nStack > 0)
+    {
+        const Node &node = m_nodes[stack[--nStack]];
+
+        if (node.isLeaf())
+        {
+            double dist = query.testConstraint(node.pConstraint, tempProxyPt);
+            if (dist < minDist && dist < node.pConstraint->getSnapDistance())
+            {
+                minDist = dist;
+                pClosest = node.pConstraint;
+                proxyPt = tempProxyPt;
+            }
+            continue;
+        }
+
+        const Node &child1 = m_nodes[node.nChild1];
+        const Node &child2 = m_nodes[node.nChild2];
+        double dist1 = query.getBoundsDistance(child1.bounds.min,
+                                               child1.bounds.max);
+        double dist2 = query.getBoundsDistance(child2.bounds.min,
+                                               child2.bounds.max);
+
+        /* Push the farther child first so the nearer one is visited next. */
+        int nNear = node.nChild1;
+        int nFar = node.nChild2;
+        if (dist2 < dist1)
+        {
+            swap(dist1, dist2);
+            swap(nNear, nFar);
+        }
+
+        assert(nStack + 2 <= kMaxStackDepth);
+        if (dist2 < minDist)
+        {
+            stack[nStack++] = nFar;
+        }
+        if (dist1 < minDist)
+        {
+            stack[nStack++] = nNear;
+        }
+    }
+
+    return pClosest;
+}
+
+/******************************************************************************
+ Node allocation
+******************************************************************************/
+int SnapIndexImp::allocateNode()
+{
+    int nNode;
+    if (m_nFreeList != kNullNode)
+    {
+        nNode = m_nFreeList;
+        m_nFreeList = m_nodes[nNode].nParent;
+    }
+    else
+    {
+        nNode = (int) m_nodes.size();
+        m_nodes.push_back(Node());
+    }
+
+    Node &node = m_nodes[nNode];
+    node.nParent = kNullNode;
+    node.nChild1 = kNullNode;
+    node.nChild2 = kNullNode;
+    node.nHeight = 0;
+    node.pConstraint = 0;
+    return nNode;
+}
+
+void SnapIndexImp::freeNode(int nNode)
+{
+    m_nodes[nNode].nParent = m_nFreeList;
+    m_nodes[nNode].nHeight = -1;
+    m_nFreeList = nNode;
+}
+
+/******************************************************************************
+ Inserts a leaf next to the sibling that increases the total surface area
+ of the tree the least, then rebalances up to the root.
+******************************************************************************/
+void SnapIndexImp::insertLeaf(int nLeaf)
+{
+    if (m_nRoot == kNullNode)
+    {
+        m_nRoot = nLeaf;
+        m_nodes[nLeaf].nParent = kNullNode;
+        return;
+    }
+
+    Bounds leafBounds = m_nodes[nLeaf].bounds;
+    int nIndex = m_nRoot;
+    while (!m_nodes[nIndex].isLeaf())
+    {
+        const Node &node = m_nodes[nIndex];
+        double cost = node.bounds.getCost();
+        double combinedCost = Bounds::combine(node.bounds, leafBounds).getCost();
+
+        /* Cost of creating a new parent for this node and the leaf. */
+        double parentCost = 2.0 * combinedCost;
+
+        /* Minimum cost of pushing the leaf further down the tree. */
+        double inheritanceCost = 2.0 * (combinedCost - cost);
+
+        double childCost[2];
+        int children[2] = { node.nChild1, node.nChild2 };
+        for (int i = 0; i < 2; i++)
+        {
+            const Node &child = m_nodes[children[i]];
+            double newCost = Bounds::combine(child.bounds, leafBounds).getCost();
+            if (!child.isLeaf())
+            {
+                newCost -= child.bounds.getCost();
+            }
+            childCost[i] = newCost + inheritanceCost;
+        }
+
+        if (parentCost < childCost[0] && parentCost < childCost[1])
+        {
+            break;
+        }
+
+        nIndex = childCost[0] < childCost[1] ? children[0] : children[1];
+    }
+
+    int nSibling = nIndex;
+    int nOldParent = m_nodes[nSibling].nParent;
+    int nNewParent = allocateNode();
+
+    Node &newParent = m_nodes[nNewParent];
+    newParent.nParent = nOldParent;
+    newParent.bounds = Bounds::combine(leafBounds, m_nodes[nSibling].bounds);
+    newParent.nHeight = m_nodes[nSibling].nHeight + 1;
+    newParent.nChild1 = nSibling;
+    newParent.nChild2 = nLeaf;
+
+    if (nOldParent != kNullNode)
+    {
+        if (m_nodes[nOldParent].nChild1 == nSibling)
+            m_nodes[nOldParent].nChild1 = nNewParent;
+        else
+            m_nodes[nOldParent].nChild2 = nNewParent;
+    }
+    else
+    {
+        m_nRoot = nNewParent;
+    }
+    m_nodes[nSibling].nParent = nNewParent;
+    m_nodes[nLeaf].nParent = nNewParent;
+
+    refit(m_nodes[nLeaf].nParent);
+}
+
+/******************************************************************************
+ Unlinks a leaf, replacing its parent with its sibling.
+******************************************************************************/
+void SnapIndexImp::removeLeaf(int nLeaf)
+{
+    if (nLeaf == m_nRoot)
+    {
+        m_nRoot = kNullNode;
+        return;
+    }
+
+    int nParent = m_nodes[nLeaf].nParent;
+    int nGrandParent = m_nodes[nParent].nParent;
+    int nSibling = m_nodes[nParent].nChild1 == nLeaf ?
+        m_nodes[nParent].nChild2 : m_nodes[nParent].nChild1;
+
+    if (nGrandParent != kNullNode)
+    {
+        if (m_nodes[nGrandParent].nChild1 == nParent)
+            m_nodes[nGrandParent].nChild1 = nSibling;
+        else
+            m_nodes[nGrandParent].nChild2 = nSibling;
+        m_nodes[nSibling].nParent = nGrandParent;
+        freeNode(nParent);
+
+        refit(nGrandParent);
+    }
+    else
+    {
+        m_nRoot = nSibling;
+        m_nodes[nSibling].nParent = kNullNode;
+        freeNode(nParent);
+    }
+}
+
+/******************************************************************************
+ Walks from a node to the root, rebalancing and recomputing bounds and
+ heights.
+******************************************************************************/
+void SnapIndexImp::refit(int nNode)
+{
+    while (nNode != kNullNode)
+    {
+        nNode = balance(nNode);
+
+        Node &node = m_nodes[nNode];
+        const Node &child1 = m_nodes[node.nChild1];
+        const Node &child2 = m_nodes[node.nChild2];
+        node.nHeight = 1 + max(child1.nHeight, child2.nHeight);
+        node.bounds = Bounds::combine(child1.bounds, child2.bounds);
+
+        nNode = node.nParent;
+    }
+}
+
+/******************************************************************************
+ Performs a left or right rotation if node A is imbalanced.  Returns the
+ index of the node that took A's place.
+******************************************************************************/
+int SnapIndexImp::balance(int nA)
+{
+    Node &A = m_nodes[nA];
+    if (A.isLeaf() || A.nHeight < 2)
+    {
+        return nA;
+    }
+
+    int nB = A.nChild1;
+    int nC = A.nChild2;
+    Node &B = m_nodes[nB];
+    Node &C = m_nodes[nC];
+
+    int nBalance = C.nHeight - B.nHeight;
+
+    /* Rotate C up. */
+    if (nBalance > 1)
+    {
+        int nF = C.nChild1;
+        int nG = C.nChild2;
+        Node &F = m_nodes[nF];
+        Node &G = m_nodes[nG];
+
+        C.nChild1 = nA;
+        C.nParent = A.nParent;
+        A.nParent = nC;
+
+        if (C.nParent != kNullNode)
+        {
+            if (m_nodes[C.nParent].nChild1 == nA)
+                m_nodes[C.nParent].nChild1 = nC;
+            else
+                m_nodes[C.nParent].nChild2 = nC;
+        }
+        else
+        {
+            m_nRoot = nC;
+        }
+
+        if (F.nHeight > G.nHeight)
+        {
+            C.nChild2 = nF;
+            A.nChild2 = nG;
+            G.nParent = nA;
+            A.bounds = Bounds::combine(B.bounds, G.bounds);
+            C.bounds = Bounds::combine(A.bounds, F.bounds);
+            A.nHeight = 1 + max(B.nHeight, G.nHeight);
+            C.nHeight = 1 + max(A.nHeight, F.nHeight);
+        }
+        else
+        {
+            C.nChild2 = nG;
+            A.nChild2 = nF;
+            F.nParent = nA;
+            A.bounds = Bounds::combine(B.bounds, F.bounds);
+            C.bounds = Bounds::combine(A.bounds, G.bounds);
+            A.nHeight = 1 + max(B.nHeight, F.nHeight);
+            C.nHeight = 1 + max(A.nHeight, G.nHeight);
+        }
+
+        return nC;
+    }
+
+    /* Rotate B up. */
+    if (nBalance < -1)
+    {
+        int nD = B.nChild1;
+        int nE = B.nChild2;
+        Node &D = m_nodes[nD];
+        Node &E = m_nodes[nE];
+
+        B.nChild1 = nA;
+        B.nParent = A.nParent;
+        A.nParent = nB;
+
+        if (B.nParent != kNullNode)
+        {
+            if (m_nodes[B.nParent].nChild1 == nA)
+                m_nodes[B.nParent].nChild1 = nB;
+            else
+                m_nodes[B.nParent].nChild2 = nB;
+        }
+        else
+        {
+            m_nRoot = nB;
+        }
+
+        if (D.nHeight > E.nHeight)
+        {
+            B.nChild2 = nD;
+            A.nChild1 = nE;
+            E.nParent = nA;
+            A.bounds = Bounds::combine(C.bounds, E.bounds);
+            B.bounds = Bounds::combine(A.bounds, D.bounds);
+            A.nHeight = 1 + max(C.nHeight, E.nHeight);
+            B.nHeight = 1 + max(A.nHeight, D.nHeight);
+        }
+        else
+        {
+            B.nChild2 = nE;
+            A.nChild1 = nD;
+            D.nParent = nA;
+            A.bounds = Bounds::combine(C.bounds, D.bounds);
+            B.bounds = Bounds::combine(A.bounds, E.bounds);
+            A.nHeight = 1 + max(C.nHeight, D.nHeight);
+            B.nHeight = 1 + max(A.nHeight, E.nHeight);
+        }
+
+        return nB;
+    }
+
+    return nA;
+}
+
+/******************************************************************************
+ Helpers
+******************************************************************************/
+Bounds SnapIndexImp::makeBounds(const hduVector3Dd &boundsMin,
+                              const hduVector3Dd &boundsMax) const
+{
+    Bounds bounds;
+    for (int i = 0; i < 3; i++)
+    {
+        bounds.min[i] = boundsMin[i] - m_margin;
+        bounds.max[i] = boundsMax[i] + m_margin;
+    }
+    return bounds;
+}
+
+void SnapIndexImp::updateMaxSnapDistance(const SnapConstraint *pConstraint)
+{
+    if (pConstraint->getSnapDistance() > m_maxSnapDistance)
+    {
+        m_maxSnapDistance = pConstraint->getSnapDistance();
+    }
+}
+
+} /* namespace SnapConstraints */
+
+/*****************************************************************************/